@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -14,14 +14,70 @@ TEMPLATE = app
 #头文件包含路径    方便代码中直接包含子目录下的头文件
 INCLUDEPATH += 3rdparty/
 
+#启用C++20协程接口(usbcoroutine.h)需要编译器支持，默认不开启
+#CONFIG += c++2a
+
+#启用传输跟踪(usbtrace.h)，记录传输及事件循环的时间线，可导出为Chrome trace JSON，默认不开启
+#DEFINES += USBCOMM_TRACE
+
 SOURCES += main.cpp\
     usbmonitor.cpp \
         widget.cpp \
-    usbcomm.cpp
+    usbcomm.cpp \
+    usbeventhandler.cpp \
+    usbendpointdevice.cpp \
+    usbstreamreader.cpp \
+    usbframechannel.cpp \
+    usbduplexchannel.cpp \
+    usbmetrics.cpp \
+    usbtrace.cpp \
+    usbpcapwriter.cpp \
+    usbvirtualdevice.cpp \
+    usbreplaydevice.cpp \
+    usblibusbbackend.cpp \
+    usbsimbackend.cpp \
+    usbsimdevice.cpp \
+    usbautotuner.cpp \
+    usbdescriptor.cpp \
+    usbdevicedatabase.cpp \
+    usbhotplugpoller.cpp \
+    usbworkerpool.cpp \
+    usbshardedbackend.cpp \
+    usbrealtime.cpp \
+    usbbusypoll.cpp \
+    usbusbfsbackend.cpp \
+    usbbufferpool.cpp \
+    usbdeliveryqueue.cpp
 
 HEADERS  += widget.h \
     usbcomm.h \
-    usbmonitor.h
+    usbmonitor.h \
+    usbeventhandler.h \
+    usbcoroutine.h \
+    usbendpointdevice.h \
+    usbstreamreader.h \
+    usbframechannel.h \
+    usbduplexchannel.h \
+    usbmetrics.h \
+    usbtrace.h \
+    usbpcapwriter.h \
+    usbvirtualdevice.h \
+    usbreplaydevice.h \
+    usbbackend.h \
+    usblibusbbackend.h \
+    usbsimbackend.h \
+    usbsimdevice.h \
+    usbautotuner.h \
+    usbdescriptor.h \
+    usbdevicedatabase.h \
+    usbhotplugpoller.h \
+    usbworkerpool.h \
+    usbshardedbackend.h \
+    usbrealtime.h \
+    usbbusypoll.h \
+    usbusbfsbackend.h \
+    usbbufferpool.h \
+    usbdeliveryqueue.h
 
 FORMS    += widget.ui
 
@@ -0,0 +1,64 @@
+#-------------------------------------------------
+#
+# UsbComm性能基准测试(控制台程序，结果输出为JSON)
+#
+#-------------------------------------------------
+
+QT       += core concurrent
+QT       -= gui
+
+TARGET = UsbCommBench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+#组件源码位于上级目录
+INCLUDEPATH += .. ../3rdparty/
+
+SOURCES += main.cpp \
+    usbbench.cpp \
+    ../usbcomm.cpp \
+    ../usbmonitor.cpp \
+    ../usbeventhandler.cpp \
+    ../usbmetrics.cpp \
+    ../usbtrace.cpp \
+    ../usbpcapwriter.cpp \
+    ../usbvirtualdevice.cpp \
+    ../usblibusbbackend.cpp \
+    ../usbsimbackend.cpp \
+    ../usbsimdevice.cpp \
+    ../usbdescriptor.cpp \
+    ../usbdevicedatabase.cpp \
+    ../usbhotplugpoller.cpp \
+    ../usbworkerpool.cpp \
+    ../usbshardedbackend.cpp \
+    ../usbrealtime.cpp \
+    ../usbbusypoll.cpp \
+    ../usbusbfsbackend.cpp \
+    ../usbbufferpool.cpp \
+    ../usbdeliveryqueue.cpp
+
+HEADERS  += usbbench.h \
+    ../usbcomm.h \
+    ../usbmonitor.h \
+    ../usbeventhandler.h \
+    ../usbmetrics.h \
+    ../usbtrace.h \
+    ../usbpcapwriter.h \
+    ../usbvirtualdevice.h \
+    ../usbbackend.h \
+    ../usblibusbbackend.h \
+    ../usbsimbackend.h \
+    ../usbsimdevice.h \
+    ../usbdescriptor.h \
+    ../usbdevicedatabase.h \
+    ../usbhotplugpoller.h \
+    ../usbworkerpool.h \
+    ../usbshardedbackend.h \
+    ../usbrealtime.h \
+    ../usbbusypoll.h \
+    ../usbusbfsbackend.h \
+    ../usbbufferpool.h \
+    ../usbdeliveryqueue.h
+
+LIBS += -L../3rdparty/libusb-1.0/lib -lusb-1.0
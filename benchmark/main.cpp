@@ -0,0 +1,154 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   UsbComm性能基准测试程序
+ *
+ *用法: UsbCommBench [选项]
+ *  --backend auto|sim|libusb|sharded|usbfs 后端(默认auto，sharded为按总线分片的libusb后端，
+ *                            usbfs为直接访问usbfs的后端)
+ *  --vid 0x0525 --pid 0xa4a0   设备vpid
+ *  --interfaces 0,1            需要声明的接口
+ *  --size 16384 --depth 4      吞吐测试的传输长度和挂起深度
+ *  --duration 2000             每项吞吐测试的时长(ms)
+ *  --iterations 20             延迟类测试的次数
+ *  --message-size 64           往返延迟测试的消息长度(也是投递测试中流式读取的包长)
+ *  --source-ep 0x81 --sink-ep 0x01 --loop-out-ep 0x02 --loop-in-ep 0x82
+ *  --udc dummy_udc.0           热插拔测试使用的UDC
+ *  --poll-interval 500         轮询方式热插拔监测的周期(ms)，用于折算CPU占用
+ *  --workers 0                 完成回调的工作线程数(0=在事件线程中执行，-1=按CPU核数)
+ *  --jitter-iterations 1000    异步传输抖动测试的次数(每1ms触发一次)
+ *  --rt-priority 0             事件线程和工作线程的SCHED_FIFO优先级(0=默认调度，需要CAP_SYS_NICE)
+ *  --rt-cpu -1                 事件线程绑定的CPU，工作线程依次绑定之后的核(-1=不绑定)
+ *  --mlock 0                   1=锁定进程内存并预先触发缺页(需要CAP_IPC_LOCK)
+ *  --busy-poll-us 200          忙轮询测试的轮询窗口(us)
+ *  --zero-copy 0               1=启用零拷贝接收(IN传输使用池化buffer，对比buffer_pool的堆分配次数)
+ *  --output result.json        结果文件，默认输出到标准输出
+ *结果为JSON(schema为usbcomm-bench/1)，调试信息输出到标准错误。
+ */
+#include <QCoreApplication>
+#include <QStringList>
+#include <QMap>
+#include <QJsonDocument>
+#include <QFile>
+#include <QDebug>
+#include <stdio.h>
+#include "usbbench.h"
+
+/*
+ *@brief:   解析数字参数(支持0x前缀的十六进制)
+ *@date:    2026.10.18
+ *@param:   text:参数值
+ *@param:   ok:是否解析成功
+ *@return:  int:数值
+ */
+static int parseNumber(const QString &text, bool *ok)
+{
+    return text.startsWith("0x")?text.mid(2).toInt(ok,16):text.toInt(ok);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    UsbBenchConfig config;
+    QString outputFile;
+    QStringList args = a.arguments();
+    QStringList numberOptions;//数字参数
+    numberOptions<<"--vid"<<"--pid"<<"--size"<<"--depth"<<"--duration"<<"--iterations"<<"--message-size"
+                 <<"--source-ep"<<"--sink-ep"<<"--loop-out-ep"<<"--loop-in-ep"<<"--poll-interval"<<"--workers"
+                 <<"--jitter-iterations"<<"--rt-priority"<<"--rt-cpu"<<"--mlock"
+                 <<"--busy-poll-us"<<"--zero-copy";
+    QMap<QString,int> numberMap;
+    for(int i=1;i<args.size();i++)
+    {
+        QString option = args.at(i);
+        if(i+1 >= args.size())
+        {
+            fprintf(stderr,"missing value for %s\n",option.toLocal8Bit().constData());
+            return 2;
+        }
+        QString value = args.at(++i);
+        bool ok = true;
+        if(option == "--backend")
+        {
+            config.backend = value;
+        }
+        else if(option == "--output")
+        {
+            outputFile = value;
+        }
+        else if(option == "--udc")
+        {
+            config.udcName = value;
+        }
+        else if(option == "--interfaces")
+        {
+            config.interfaceList.clear();
+            QStringList interfaceList = value.split(',');
+            for(int j=0;j<interfaceList.size() && ok;j++)
+            {
+                config.interfaceList.append(parseNumber(interfaceList.at(j),&ok));
+            }
+        }
+        else if(numberOptions.contains(option))
+        {
+            numberMap.insert(option,parseNumber(value,&ok));
+        }
+        else
+        {
+            ok = false;
+        }
+        if(!ok)
+        {
+            fprintf(stderr,"invalid option: %s %s\n",option.toLocal8Bit().constData(),value.toLocal8Bit().constData());
+            return 2;
+        }
+    }
+
+    config.vendorId = numberMap.value("--vid",config.vendorId);
+    config.productId = numberMap.value("--pid",config.productId);
+    config.transferSize = qMax(numberMap.value("--size",config.transferSize),1);
+    config.queueDepth = qMax(numberMap.value("--depth",config.queueDepth),1);
+    config.durationMs = qMax(numberMap.value("--duration",config.durationMs),1);
+    config.iterations = qMax(numberMap.value("--iterations",config.iterations),1);
+    config.messageSize = qMax(numberMap.value("--message-size",config.messageSize),1);
+    config.sourceEndpoint = numberMap.value("--source-ep",config.sourceEndpoint);
+    config.sinkEndpoint = numberMap.value("--sink-ep",config.sinkEndpoint);
+    config.loopOutEndpoint = numberMap.value("--loop-out-ep",config.loopOutEndpoint);
+    config.loopInEndpoint = numberMap.value("--loop-in-ep",config.loopInEndpoint);
+    config.pollIntervalMs = qMax(numberMap.value("--poll-interval",config.pollIntervalMs),1);
+    config.completionWorkers = qMax(numberMap.value("--workers",config.completionWorkers),-1);
+    config.jitterIterations = qMax(numberMap.value("--jitter-iterations",config.jitterIterations),1);
+    config.rtPriority = qBound(0,numberMap.value("--rt-priority",config.rtPriority),99);
+    config.rtCpu = qMax(numberMap.value("--rt-cpu",config.rtCpu),-1);
+    config.lockMemory = (numberMap.value("--mlock",0) != 0);
+    config.busyPollUs = qMax(numberMap.value("--busy-poll-us",config.busyPollUs),1);
+    config.zeroCopy = (numberMap.value("--zero-copy",0) != 0);
+
+    QJsonObject result;
+    {
+        UsbBench bench(config);
+        result = bench.run();
+    }
+    QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+    if(outputFile.isEmpty())
+    {
+        fwrite(json.constData(),1,json.size(),stdout);
+    }
+    else
+    {
+        QFile file(outputFile);
+        if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            qDebug()<<"write result failed:"<<outputFile;
+            return 1;
+        }
+    }
+    return result.contains("error")?1:0;
+}
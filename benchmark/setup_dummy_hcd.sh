@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Copyright (C) 2026 MiaoQingrui. All rights reserved.
+# Author: 缪庆瑞 <justdoit_mqr@163.com>
+#
+# 在dummy_hcd虚拟控制器上创建UsbCommBench使用的测试gadget(需要root权限)
+# 通过configfs组合内核的SourceSink和Loopback功能(usb_f_ss_lb)，不需要用户态的FunctionFS守护进程:
+#   接口0(SourceSink):IN端点始终有数据，OUT端点丢弃数据，用于读/写吞吐测试
+#   接口1(Loopback):OUT端点收到的数据从IN端点返回，用于往返延迟测试
+# 端点地址由UDC分配，脚本最后会打印出来，与UsbCommBench默认参数不同时通过--source-ep等参数指定。
+#
+# 用法: setup_dummy_hcd.sh [up|down]
+
+VID=0x0525
+PID=0xa4a0
+GADGET=/sys/kernel/config/usb_gadget/usbcomm_bench
+
+up()
+{
+    modprobe dummy_hcd || exit 1
+    modprobe libcomposite || exit 1
+    modprobe usb_f_ss_lb || exit 1
+    mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+
+    mkdir -p $GADGET && cd $GADGET || exit 1
+    echo $VID > idVendor
+    echo $PID > idProduct
+    mkdir -p strings/0x409
+    echo "UsbComm" > strings/0x409/manufacturer
+    echo "UsbComm bench gadget" > strings/0x409/product
+    mkdir -p configs/c.1/strings/0x409
+    echo "source/sink + loopback" > configs/c.1/strings/0x409/configuration
+    mkdir -p functions/SourceSink.0 functions/Loopback.0
+    ln -s functions/SourceSink.0 configs/c.1/ 2>/dev/null
+    ln -s functions/Loopback.0 configs/c.1/ 2>/dev/null
+
+    UDC=$(ls /sys/class/udc | grep dummy_udc | head -n 1)
+    echo $UDC > UDC || exit 1
+    sleep 1
+    echo "gadget bound to $UDC"
+    lsusb -v -d ${VID#0x}:${PID#0x} 2>/dev/null | grep -E "bInterfaceNumber|bEndpointAddress"
+}
+
+down()
+{
+    [ -d $GADGET ] || exit 0
+    cd $GADGET
+    echo "" > UDC 2>/dev/null
+    rm -f configs/c.1/SourceSink.0 configs/c.1/Loopback.0
+    rmdir configs/c.1/strings/0x409 configs/c.1 functions/SourceSink.0 functions/Loopback.0 strings/0x409
+    cd / && rmdir $GADGET
+}
+
+case "$1" in
+    down) down ;;
+    *) up ;;
+esac
@@ -0,0 +1,933 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   UsbComm性能基准测试
+ */
+#include "usbbench.h"
+#include "usbmonitor.h"
+#include "usbhotplugpoller.h"
+#include "usbmetrics.h"
+#include "usblibusbbackend.h"
+#include "usbshardedbackend.h"
+#include "usbusbfsbackend.h"
+#include "usbbufferpool.h"
+#include "usbsimbackend.h"
+#include "usbsimdevice.h"
+#include "usbrealtime.h"
+#include "usbbusypoll.h"
+#include "usbdeliveryqueue.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSemaphore>
+#include <QDebug>
+#include <algorithm>
+#include <math.h>
+
+#define BENCH_JITTER_PERIOD_NS 1000000 //抖动测试的触发周期(1ms)
+#define BENCH_DELIVERY_CAPACITY 4096 //投递测试的队列容量
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   config:测试配置
+ *@param:   parent:父对象
+ */
+UsbBench::UsbBench(const UsbBenchConfig &config, QObject *parent)
+    :QObject(parent)
+{
+    this->config = config;
+    backend = NULL;
+    simBackend = NULL;
+    simDevice = NULL;
+    usbComm = NULL;
+    deviceHandle = NULL;
+    deadline = 0;
+    benchBytes = 0;
+    benchTransfers = 0;
+    benchErrors = 0;
+    deliveredPackets = 0;
+    hotplugReceived = false;
+    hotplugAttached = false;
+    hotplugTime = 0;
+}
+/*
+ *@brief:   析构函数，按UsbComm->模拟设备->后端的顺序释放
+ *@date:    2026.10.18
+ */
+UsbBench::~UsbBench()
+{
+    delete usbComm;
+    if(simBackend != NULL)
+    {
+        simBackend->unplugDevice(simDevice);
+        delete simDevice;
+    }
+    delete backend;
+}
+/*
+ *@brief:   执行全部测试
+ *@date:    2026.10.18
+ *@return:  QJsonObject:测试结果
+ */
+QJsonObject UsbBench::run()
+{
+    QJsonObject result;
+    result.insert("schema","usbcomm-bench/1");
+    result.insert("timestamp",QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    QJsonObject configObject;
+    configObject.insert("transfer_size",config.transferSize);
+    configObject.insert("queue_depth",config.queueDepth);
+    configObject.insert("duration_ms",config.durationMs);
+    configObject.insert("iterations",config.iterations);
+    configObject.insert("message_size",config.messageSize);
+    configObject.insert("poll_interval_ms",config.pollIntervalMs);
+    configObject.insert("completion_workers",config.completionWorkers);
+    configObject.insert("jitter_iterations",config.jitterIterations);
+    configObject.insert("rt_priority",config.rtPriority);
+    configObject.insert("rt_cpu",config.rtCpu);
+    configObject.insert("mlock",config.lockMemory);
+    configObject.insert("busy_poll_us",config.busyPollUs);
+    configObject.insert("zero_copy",config.zeroCopy);
+    result.insert("config",configObject);
+    if(!setup())
+    {
+        result.insert("backend",backendName);
+        result.insert("error","setup failed");
+        return result;
+    }
+    result.insert("backend",backendName);
+
+    QJsonObject results;
+    results.insert("open_claim_us",benchOpenClaim());
+    if(deviceHandle == NULL)
+    {
+        result.insert("results",results);
+        result.insert("error","open device failed");
+        return result;
+    }
+    UsbDeviceInfo info = backend->getDeviceInfo(deviceHandle);
+    QJsonObject deviceObject;
+    deviceObject.insert("vendor_id",QString("0x%1").arg((int)info.vendorId,4,16,QChar('0')));
+    deviceObject.insert("product_id",QString("0x%1").arg((int)info.productId,4,16,QChar('0')));
+    deviceObject.insert("speed",info.speed);
+    result.insert("device",deviceObject);
+
+    results.insert("bulk_write",benchWrite());
+    results.insert("bulk_read",benchRead());
+    results.insert("round_trip_us",benchRoundTrip());
+    results.insert("async_jitter_us",benchJitter());
+    results.insert("busy_poll",benchBusyPoll());
+    results.insert("delivery",benchDelivery());
+    if(backendName == "usbfs")
+    {
+        results.insert("usbfs_reap",usbfsReapStats());
+    }
+    results.insert("hotplug_us",benchHotplug());
+    results.insert("hotplug_poll_us",benchHotplugPoll());
+    results.insert("buffer_pool",bufferPoolStats());
+    result.insert("results",results);
+    return result;
+}
+/*
+ *@brief:   创建后端和UsbComm
+ * auto模式下，加载了dummy_hcd模块且能枚举到指定vpid的设备时使用libusb，否则使用模拟设备；
+ * usbfs模式使用直接访问usbfs的后端，与libusb的结果对比。
+ *@date:    2026.10.18
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbBench::setup()
+{
+    backendName = config.backend;
+    if(backendName == "auto" || backendName == "libusb" || backendName == "sharded")
+    {
+        bool found = false;
+        if(backendName != "auto" || QFileInfo("/sys/module/dummy_hcd").exists())
+        {
+            UsbShardedBackend *shardedBackend = (backendName == "sharded")?new UsbShardedBackend():NULL;
+            UsbLibusbBackend *libusbBackend = (shardedBackend != NULL)?shardedBackend:new UsbLibusbBackend();
+            libusbBackend->setEventThreadConfig(threadConfig());
+            backend = libusbBackend;
+            QList<UsbDeviceInfo> infoList = backend->getDeviceList();
+            for(int i=0;i<infoList.size();i++)
+            {
+                if(infoList.at(i).vendorId == config.vendorId && infoList.at(i).productId == config.productId)
+                {
+                    if(shardedBackend != NULL)//设备所在分片的事件线程使用相同的实时配置
+                    {
+                        shardedBackend->setShardThreadConfig(infoList.at(i).busNumber,threadConfig());
+                    }
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if(found)
+        {
+            backendName = (backendName == "sharded")?backendName:QString("libusb");
+        }
+        else if(backendName != "auto")
+        {
+            qDebug()<<"UsbBench: device not found";
+            return false;
+        }
+        else
+        {
+            delete backend;
+            backend = NULL;
+            backendName = "sim";
+        }
+    }
+    else if(backendName == "usbfs")
+    {
+        //与libusb后端使用相同的设备，结果可直接对比
+        UsbUsbfsBackend *usbfsBackend = new UsbUsbfsBackend();
+        backend = usbfsBackend;
+        bool found = false;
+        QList<UsbDeviceInfo> infoList = usbfsBackend->isAvailable()?backend->getDeviceList():QList<UsbDeviceInfo>();
+        for(int i=0;i<infoList.size();i++)
+        {
+            if(infoList.at(i).vendorId == config.vendorId && infoList.at(i).productId == config.productId)
+            {
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+        {
+            qDebug()<<"UsbBench: device not found";
+            return false;
+        }
+    }
+    if(backendName == "sim")
+    {
+        //模拟设备与setup_dummy_hcd.sh创建的gadget端点配置相同
+        simDevice = new UsbSimDevice();
+        simDevice->setDeviceInfo(config.vendorId,config.productId);
+        simDevice->setDeviceSpeed(LIBUSB_SPEED_HIGH);
+        simDevice->addEndpoint(config.sourceEndpoint);
+        simDevice->addEndpoint(config.sinkEndpoint);
+        simDevice->addEndpoint(config.loopOutEndpoint);
+        simDevice->addEndpoint(config.loopInEndpoint);
+        simDevice->setSourceEndpoint(config.sourceEndpoint);
+        simDevice->setLoopback(config.loopOutEndpoint,config.loopInEndpoint);
+        simDevice->setBandwidth(config.simBandwidth);
+        simDevice->setLatency(config.simLatencyNs,config.simJitterNs);
+        simDevice->setSeed(1);
+        simBackend = new UsbSimBackend();
+        simBackend->plugDevice(simDevice);
+        backend = simBackend;
+    }
+    if(backend == NULL)
+    {
+        qDebug()<<"UsbBench: unknown backend"<<config.backend;
+        return false;
+    }
+    if(config.lockMemory)
+    {
+        if(!UsbRealtime::lockMemory())
+        {
+            qDebug()<<"UsbBench: lock memory failed";
+        }
+        //按各项测试的传输大小和挂起数量预留已触发缺页的buffer(mlockall之后已被锁定)
+        UsbBufferPool::instance()->reserve(config.transferSize,config.queueDepth*2);
+        UsbBufferPool::instance()->reserve(config.messageSize,config.queueDepth*2);
+    }
+    usbComm = new UsbComm(backend);
+    //工作线程绑定在事件线程之后的核上
+    UsbThreadConfig workerConfig = threadConfig();
+    workerConfig.cpu = (workerConfig.cpu >= 0)?workerConfig.cpu+1:-1;
+    usbComm->setCompletionWorkerCount(config.completionWorkers,workerConfig);
+    return true;
+}
+/*
+ *@brief:   打开设备并声明接口
+ *@date:    2026.10.18
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbBench::openDevice()
+{
+    QMultiMap<quint16,quint16> vpidMap;
+    vpidMap.insert(config.vendorId,config.productId);
+    deviceHandle = NULL;
+    if(!usbComm->openUsbDevice(vpidMap))
+    {
+        return false;
+    }
+    deviceHandle = usbComm->getDeviceHandleFromIndex(0);
+    for(int i=0;i<config.interfaceList.size();i++)
+    {
+        if(!usbComm->claimUsbInterface(deviceHandle,config.interfaceList.at(i)))
+        {
+            usbComm->closeAllUsbDevice();
+            deviceHandle = NULL;
+            return false;
+        }
+    }
+    if(config.zeroCopy)
+    {
+        usbComm->setZeroCopyReceive(deviceHandle,true);
+    }
+    return true;
+}
+/*
+ *@brief:   打开设备+声明接口的耗时，测试结束后设备保持打开
+ *@date:    2026.10.18
+ *@return:  QJsonObject:延迟统计
+ */
+QJsonObject UsbBench::benchOpenClaim()
+{
+    QVector<qint64> samples;
+    for(int i=0;i<config.iterations;i++)
+    {
+        usbComm->closeAllUsbDevice();
+        qint64 startTime = UsbMetrics::nowNs();
+        if(!openDevice())
+        {
+            QJsonObject error;
+            error.insert("error","open/claim failed");
+            return error;
+        }
+        samples.append(UsbMetrics::nowNs()-startTime);
+    }
+    return latencyStats(samples);
+}
+/*
+ *@brief:   批量写吞吐:在OUT端点上同时挂起queueDepth个传输，完成后立即重新提交
+ *@date:    2026.10.18
+ *@return:  QJsonObject:吞吐统计
+ */
+QJsonObject UsbBench::benchWrite()
+{
+    writeBuffer = QByteArray(config.transferSize,(char)0x55);
+    benchBytes = 0;
+    benchTransfers = 0;
+    benchErrors = 0;
+    qint64 startTime = UsbMetrics::nowNs();
+    deadline = startTime+(qint64)config.durationMs*1000000;
+    for(int i=0;i<config.queueDepth;i++)
+    {
+        submitWrite();
+    }
+    QThread::msleep(config.durationMs);
+    usbComm->cancelTransfers(deviceHandle,config.sinkEndpoint);
+    return throughputStats(benchBytes,benchTransfers,benchErrors,deadline-startTime);
+}
+/*
+ *@brief:   批量读吞吐:在IN端点上保持queueDepth个流式传输
+ *@date:    2026.10.18
+ *@return:  QJsonObject:吞吐统计
+ */
+QJsonObject UsbBench::benchRead()
+{
+    benchBytes = 0;
+    benchTransfers = 0;
+    benchErrors = 0;
+    qint64 startTime = UsbMetrics::nowNs();
+    deadline = startTime+(qint64)config.durationMs*1000000;
+    for(int i=0;i<config.queueDepth;i++)
+    {
+        bool ok = usbComm->submitStreamTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,config.sourceEndpoint,
+                                                config.transferSize,1000,[this](const UsbTransferResult &result)
+        {
+            if(UsbMetrics::nowNs() > deadline)//测试结束之后完成的传输不计入
+            {
+                return false;
+            }
+            if(result.isCompleted())
+            {
+                benchBytes += result.actualLength;
+                benchTransfers++;
+                return true;
+            }
+            if(result.status != LIBUSB_TRANSFER_CANCELLED)
+            {
+                benchErrors++;
+            }
+            return false;
+        });
+        if(!ok)
+        {
+            benchErrors++;
+        }
+    }
+    QThread::msleep(config.durationMs);
+    usbComm->cancelTransfers(deviceHandle,config.sourceEndpoint);
+    return throughputStats(benchBytes,benchTransfers,benchErrors,deadline-startTime);
+}
+/*
+ *@brief:   小包往返延迟:向回环OUT端点同步写入messageSize字节，再从IN端点同步读回
+ *@date:    2026.10.18
+ *@return:  QJsonObject:延迟统计
+ */
+QJsonObject UsbBench::benchRoundTrip()
+{
+    QByteArray message(config.messageSize,'r');
+    //接收长度取最大包长的整数倍，避免对端多返回数据时溢出
+    QByteArray receiveBuffer(qMax(config.messageSize,512),0);
+    QVector<qint64> samples;
+    int errors = 0;
+    for(int i=0;i<=config.iterations;i++)//第一次作为预热，不计入统计
+    {
+        qint64 startTime = UsbMetrics::nowNs();
+        int written = usbComm->bulkTransfer(deviceHandle,config.loopOutEndpoint,(quint8 *)message.data(),
+                                            message.size(),1000);
+        int received = usbComm->bulkTransfer(deviceHandle,config.loopInEndpoint,(quint8 *)receiveBuffer.data(),
+                                             receiveBuffer.size(),1000);
+        qint64 elapsed = UsbMetrics::nowNs()-startTime;
+        if(written != message.size() || received != message.size())
+        {
+            errors++;
+            continue;
+        }
+        if(i > 0)
+        {
+            samples.append(elapsed);
+        }
+    }
+    QJsonObject stats = latencyStats(samples);
+    stats.insert("errors",errors);
+    return stats;
+}
+/*
+ *@brief:   异步完成延迟的抖动:按固定周期(模拟相机触发)执行异步往返，测量从提交到IN传输回调执行的时间。
+ * 完成经过事件线程(及工作线程)，可用于对比实时配置(--rt-priority、--rt-cpu、--mlock)前后的尾延迟。
+ *@date:    2026.10.18
+ *@return:  QJsonObject:延迟统计，另含stddev、jitter(p99-p50)，单位us
+ */
+QJsonObject UsbBench::benchJitter()
+{
+    int errors = 0;
+    QVector<qint64> samples = asyncRoundTrip(config.jitterIterations,BENCH_JITTER_PERIOD_NS,&errors);
+    QJsonObject stats = latencyStats(samples);
+    if(!samples.isEmpty())
+    {
+        double mean = stats.value("mean").toDouble();
+        double variance = 0;
+        for(int i=0;i<samples.size();i++)
+        {
+            double diff = samples.at(i)/1000.0-mean;
+            variance += diff*diff;
+        }
+        stats.insert("stddev",sqrt(variance/samples.size()));
+        stats.insert("jitter",stats.value("p99").toDouble()-stats.value("p50").toDouble());
+    }
+    stats.insert("errors",errors);
+    return stats;
+}
+/*
+ *@brief:   忙轮询的收益与开销:分别在关闭和开启忙轮询(--busy-poll-us)时连续执行异步往返，
+ * 对比延迟，并给出开启期间事件线程忙轮询消耗的CPU时间。
+ *@date:    2026.10.18
+ *@return:  QJsonObject:off/on的延迟统计(us)、每次往返消耗的CPU时间和节省的平均延迟(us)、命中/未命中次数，
+ * 后端不支持时包含skipped字段
+ */
+QJsonObject UsbBench::benchBusyPoll()
+{
+    QJsonObject stats;
+    if(!usbComm->setBusyPoll(deviceHandle,0))
+    {
+        stats.insert("skipped","backend does not support busy poll");
+        return stats;
+    }
+    int offErrors = 0;
+    QJsonObject offStats = latencyStats(asyncRoundTrip(config.jitterIterations,0,&offErrors));
+    offStats.insert("errors",offErrors);
+
+    usbComm->setBusyPoll(deviceHandle,config.busyPollUs);
+    UsbBusyPollStats startStats = usbComm->getBusyPollStats(deviceHandle);
+    int onErrors = 0;
+    QVector<qint64> onSamples = asyncRoundTrip(config.jitterIterations,0,&onErrors);
+    UsbBusyPollStats endStats = usbComm->getBusyPollStats(deviceHandle);
+    usbComm->setBusyPoll(deviceHandle,0);
+    QJsonObject onStats = latencyStats(onSamples);
+    onStats.insert("errors",onErrors);
+
+    stats.insert("window_us",config.busyPollUs);
+    stats.insert("off",offStats);
+    stats.insert("on",onStats);
+    stats.insert("spin_hits",(double)(endStats.hitCount-startStats.hitCount));
+    stats.insert("spin_misses",(double)(endStats.missCount-startStats.missCount));
+    if(!onSamples.isEmpty())
+    {
+        //每次往返包含两个传输(OUT和IN)，忙轮询的CPU时间按往返次数折算
+        stats.insert("spin_cpu_us_per_round_trip",(endStats.spinNs-startStats.spinNs)/1000.0/onSamples.size());
+        stats.insert("saved_us_per_round_trip",offStats.value("mean").toDouble()-onStats.value("mean").toDouble());
+    }
+    return stats;
+}
+/*
+ *@brief:   结果投递到主线程:小包流式读取时逐包排队投递与批量投递的对比
+ *@date:    2026.10.18
+ *@return:  QJsonObject:两种方式的送达速率、唤醒次数和测试结束时的积压
+ */
+QJsonObject UsbBench::benchDelivery()
+{
+    QJsonObject stats;
+    stats.insert("packet_size",config.messageSize);
+    stats.insert("per_packet",deliveryRun(false));
+    stats.insert("batched",deliveryRun(true));
+    return stats;
+}
+/*
+ *@brief:   usbfs后端的批量完成统计(覆盖此前全部测试):事件线程唤醒次数、取出的URB数及平均每次取出的URB数
+ *@date:    2026.10.18
+ *@return:  QJsonObject:统计
+ */
+QJsonObject UsbBench::usbfsReapStats()
+{
+    UsbUsbfsBackend *usbfsBackend = static_cast<UsbUsbfsBackend *>(backend);
+    quint64 batches = usbfsBackend->getReapBatchCount();
+    quint64 urbs = usbfsBackend->getReapUrbCount();
+    QJsonObject stats;
+    stats.insert("batches",(double)batches);
+    stats.insert("urbs",(double)urbs);
+    stats.insert("urbs_per_batch",(batches > 0)?(double)urbs/batches:0.0);
+    return stats;
+}
+/*
+ *@brief:   缓冲池统计(覆盖此前全部测试):申请次数、新申请的内存块数和高水位
+ *@date:    2026.10.18
+ *@return:  QJsonObject:统计
+ */
+QJsonObject UsbBench::bufferPoolStats()
+{
+    UsbBufferPoolStats poolStats = UsbBufferPool::instance()->getStats();
+    QJsonObject stats;
+    stats.insert("allocations",(double)poolStats.allocations);
+    stats.insert("thread_cache_hits",(double)poolStats.threadCacheHits);
+    stats.insert("heap_allocations",(double)poolStats.heapAllocations);
+    stats.insert("overflow_allocations",(double)poolStats.overflowAllocations);
+    stats.insert("peak_in_use_bytes",(double)poolStats.peakInUseBytes);
+    stats.insert("peak_owned_bytes",(double)poolStats.peakOwnedBytes);
+    stats.insert("transfer_allocations",(double)poolStats.transferAllocations);
+    stats.insert("transfer_heap_allocations",(double)poolStats.transferHeapAllocations);
+    stats.insert("peak_transfers_in_use",(double)poolStats.peakTransfersInUse);
+    return stats;
+}
+/*
+ *@brief:   连续执行异步往返:在回环IN端点挂起读传输后向OUT端点提交写传输，测量从提交到IN传输回调执行的时间
+ *@date:    2026.10.18
+ *@param:   iterations:次数(另有一次预热，不计入)
+ *@param:   periodNs:触发周期，0表示上一次完成后立即开始下一次
+ *@param:   errors:返回出错的次数
+ *@return:  QVector<qint64>:延迟样本(ns)
+ */
+QVector<qint64> UsbBench::asyncRoundTrip(int iterations, qint64 periodNs, int *errors)
+{
+    QByteArray message(config.messageSize,'j');
+    int receiveLength = qMax(config.messageSize,512);
+    QVector<qint64> samples;
+    QSemaphore done;
+    std::atomic<qint64> completeTime(0);
+    std::atomic<bool> received(false);
+    for(int i=0;i<=iterations;i++)//第一次作为预热，不计入统计
+    {
+        received = false;
+        qint64 startTime = UsbMetrics::nowNs();
+        bool ok = usbComm->submitTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,config.loopInEndpoint,QByteArray(),
+                                          receiveLength,1000,[&](const UsbTransferResult &result)
+        {
+            completeTime = UsbMetrics::nowNs();
+            received = (result.isCompleted() && result.actualLength == message.size());
+            done.release();
+        });
+        if(!ok)
+        {
+            (*errors)++;
+            continue;
+        }
+        ok = usbComm->submitTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,config.loopOutEndpoint,message,
+                                     message.size(),1000,[&](const UsbTransferResult &result)
+        {
+            Q_UNUSED(result)
+            done.release();
+        });
+        if(!ok || !done.tryAcquire(2,2000))
+        {
+            //取消并等待回调结束之后才能复用栈上的变量
+            usbComm->cancelTransfers(deviceHandle,config.loopInEndpoint);
+            usbComm->cancelTransfers(deviceHandle,config.loopOutEndpoint);
+            done.acquire(done.available());
+            (*errors)++;
+            continue;
+        }
+        if(!received)
+        {
+            (*errors)++;
+        }
+        else if(i > 0)
+        {
+            samples.append(completeTime-startTime);
+        }
+        qint64 nextTime = startTime+periodNs;
+        qint64 now = UsbMetrics::nowNs();
+        if(now < nextTime)
+        {
+            QThread::usleep((nextTime-now)/1000);
+        }
+    }
+    return samples;
+}
+/*
+ *@brief:   事件线程的实时配置(--rt-cpu、--rt-priority)
+ *@date:    2026.10.18
+ *@return:  UsbThreadConfig:实时配置
+ */
+UsbThreadConfig UsbBench::threadConfig() const
+{
+    UsbThreadConfig threadConfig;
+    threadConfig.cpu = config.rtCpu;
+    threadConfig.priority = config.rtPriority;
+    return threadConfig;
+}
+/*
+ *@brief:   热插拔延迟:从触发插入到UsbMonitor的信号在事件循环中送达的时间
+ * 模拟后端通过插拔模拟设备触发，libusb后端通过dummy_hcd UDC的soft_connect触发(需要写权限)。
+ * 测试期间设备被关闭，结束后重新打开。
+ *@date:    2026.10.18
+ *@return:  QJsonObject:延迟统计，无法触发插拔时包含skipped字段
+ */
+QJsonObject UsbBench::benchHotplug()
+{
+    QJsonObject stats;
+    if(simBackend == NULL && !setSoftConnect(true))
+    {
+        stats.insert("skipped","soft_connect of dummy_udc is not writable");
+        return stats;
+    }
+    usbComm->closeAllUsbDevice();
+    deviceHandle = NULL;
+    UsbMonitor *usbMonitor = new UsbMonitor(backend);
+    connect(usbMonitor,&UsbMonitor::deviceHotplugSig,this,[this](bool isAttached,int vendorId,int productId,int port)
+    {
+        Q_UNUSED(vendorId)
+        Q_UNUSED(productId)
+        Q_UNUSED(port)
+        hotplugReceived = true;
+        hotplugAttached = isAttached;
+        hotplugTime = UsbMetrics::nowNs();
+    },Qt::QueuedConnection);
+    QVector<qint64> samples;
+    int errors = 0;
+    if(!usbMonitor->registerHotplugMonitorService(LIBUSB_HOTPLUG_MATCH_ANY,config.vendorId,config.productId))
+    {
+        stats.insert("error","register hotplug failed");
+    }
+    else
+    {
+        for(int i=0;i<config.iterations;i++)
+        {
+            //拔出
+            hotplugReceived = false;
+            if(simBackend != NULL)
+            {
+                simBackend->unplugDevice(simDevice);
+            }
+            else
+            {
+                setSoftConnect(false);
+            }
+            if(!waitHotplug(false,3000))
+            {
+                errors++;
+                break;
+            }
+            //插入并计时
+            hotplugReceived = false;
+            qint64 startTime = UsbMetrics::nowNs();
+            if(simBackend != NULL)
+            {
+                simBackend->plugDevice(simDevice);
+            }
+            else
+            {
+                setSoftConnect(true);
+            }
+            if(!waitHotplug(true,3000))
+            {
+                errors++;
+                break;
+            }
+            samples.append(hotplugTime-startTime);
+        }
+        stats = latencyStats(samples);
+        stats.insert("errors",errors);
+    }
+    delete usbMonitor;
+    //确保设备处于接入状态后重新打开
+    if(simBackend != NULL)
+    {
+        simBackend->plugDevice(simDevice);
+    }
+    else
+    {
+        setSoftConnect(true);
+    }
+    openDevice();
+    return stats;
+}
+/*
+ *@brief:   轮询方式热插拔监测的开销
+ * 直接调用poll()测量单次轮询(快照+比较)的耗时，按设定的轮询周期折算CPU占用百分比。
+ *@date:    2026.10.18
+ *@return:  QJsonObject:单次轮询耗时的统计(us)及cpu_percent
+ */
+QJsonObject UsbBench::benchHotplugPoll()
+{
+    UsbHotplugPoller poller(backend);
+    poller.setPollInterval(config.pollIntervalMs);
+    poller.registerHotplug(LIBUSB_HOTPLUG_MATCH_ANY,LIBUSB_HOTPLUG_MATCH_ANY,LIBUSB_HOTPLUG_MATCH_ANY,
+                           [](bool isAttached,const UsbDeviceRecord &record)
+    {
+        Q_UNUSED(isAttached)
+        Q_UNUSED(record)
+    },NULL);
+    QVector<qint64> samples;
+    for(int i=0;i<config.iterations;i++)
+    {
+        poller.poll();
+        samples.append(poller.getLastPollCost());
+    }
+    QJsonObject stats = latencyStats(samples);
+    stats.insert("cpu_percent",(double)poller.getTotalPollCost()/poller.getPollCount()/
+                 ((double)config.pollIntervalMs*1000000)*100);
+    return stats;
+}
+/*
+ *@brief:   提交一个写传输，完成后在回调中重新提交，直到测试结束
+ *@date:    2026.10.18
+ */
+void UsbBench::submitWrite()
+{
+    bool ok = usbComm->submitTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,config.sinkEndpoint,writeBuffer,
+                                      writeBuffer.size(),1000,[this](const UsbTransferResult &result)
+    {
+        if(UsbMetrics::nowNs() > deadline)//测试结束之后完成的传输不计入
+        {
+            return;
+        }
+        if(result.isCompleted())
+        {
+            benchBytes += result.actualLength;
+            benchTransfers++;
+            submitWrite();
+        }
+        else if(result.status != LIBUSB_TRANSFER_CANCELLED)
+        {
+            benchErrors++;
+        }
+    });
+    if(!ok)
+    {
+        benchErrors++;
+    }
+}
+/*
+ *@brief:   小包流式读取:在IN端点上保持queueDepth个messageSize字节的流式传输，结果投递到主线程的事件循环
+ * 逐包方式每个结果投递一个排队调用(与跨线程信号相同，每包一个事件)，批量方式放入UsbDeliveryQueue。
+ * 测试结束时已完成但主线程尚未收到的结果计为积压，反映主线程是否跟得上。
+ *@date:    2026.10.18
+ *@param:   batched:true=批量投递  false=逐包投递
+ *@return:  QJsonObject:送达统计
+ */
+QJsonObject UsbBench::deliveryRun(bool batched)
+{
+    UsbDeliveryQueue queue(BENCH_DELIVERY_CAPACITY);
+    connect(&queue,&UsbDeliveryQueue::resultsReady,this,[this](const QVector<UsbTransferResult> &results)
+    {
+        deliveredPackets += results.size();
+    });
+    deliveredPackets = 0;
+    benchBytes = 0;
+    benchTransfers = 0;
+    benchErrors = 0;
+    quint64 dropped = 0;
+    qint64 startTime = UsbMetrics::nowNs();
+    deadline = startTime+(qint64)config.durationMs*1000000;
+    for(int i=0;i<config.queueDepth;i++)
+    {
+        bool ok = usbComm->submitStreamTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,config.sourceEndpoint,
+                                                config.messageSize,1000,[this,batched,&queue,&dropped](const UsbTransferResult &result)
+        {
+            if(UsbMetrics::nowNs() > deadline)
+            {
+                return false;
+            }
+            if(result.isCompleted())
+            {
+                benchBytes += result.actualLength;
+                benchTransfers++;
+                if(batched)
+                {
+                    if(!queue.push(result))
+                    {
+                        dropped++;//回调在事件线程中串行执行
+                    }
+                }
+                else
+                {
+                    QMetaObject::invokeMethod(this,[this,result](){deliveredPackets++;},Qt::QueuedConnection);
+                }
+                return true;
+            }
+            if(result.status != LIBUSB_TRANSFER_CANCELLED)
+            {
+                benchErrors++;
+            }
+            return false;
+        });
+        if(!ok)
+        {
+            benchErrors++;
+        }
+    }
+    QEventLoop loop;
+    QTimer::singleShot(config.durationMs,&loop,&QEventLoop::quit);
+    loop.exec();
+    quint64 delivered = deliveredPackets;
+    usbComm->cancelTransfers(deviceHandle,config.sourceEndpoint);
+    QCoreApplication::processEvents();//处理剩余的投递，避免影响之后的测试
+
+    quint64 completed = benchTransfers;
+    double elapsedSec = (deadline-startTime)/1e9;
+    QJsonObject stats;
+    stats.insert("completed",(double)completed);
+    stats.insert("delivered_per_sec",delivered/elapsedSec);
+    stats.insert("backlog",(double)qMax((qint64)(completed-dropped)-(qint64)delivered,(qint64)0));
+    stats.insert("errors",(double)benchErrors);
+    if(batched)
+    {
+        UsbDeliveryStats deliveryStats = queue.getStats();
+        stats.insert("wakeups",(double)deliveryStats.wakeups);
+        stats.insert("batches",(double)deliveryStats.batches);
+        stats.insert("mean_batch",(deliveryStats.batches > 0)?(double)deliveryStats.pushed/deliveryStats.batches:0.0);
+        stats.insert("max_batch",(double)deliveryStats.maxBatchSize);
+        stats.insert("dropped",(double)dropped);
+    }
+    else
+    {
+        stats.insert("wakeups",(double)completed);
+    }
+    return stats;
+}
+/*
+ *@brief:   在事件循环中等待热插拔信号
+ *@date:    2026.10.18
+ *@param:   isAttached:等待的事件，true=插入  false=拔出
+ *@param:   timeoutMs:超时时间
+ *@return:  bool:true=收到  false=超时
+ */
+bool UsbBench::waitHotplug(bool isAttached, int timeoutMs)
+{
+    qint64 endTime = UsbMetrics::nowNs()+(qint64)timeoutMs*1000000;
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    connect(&timer,&QTimer::timeout,&loop,&QEventLoop::quit);
+    while(!(hotplugReceived && hotplugAttached == isAttached))
+    {
+        if(UsbMetrics::nowNs() >= endTime)
+        {
+            return false;
+        }
+        timer.start(1);//每次最多等待1ms，信号送达的时间在槽中记录，不受等待粒度影响
+        loop.exec();
+        if(hotplugReceived && hotplugAttached != isAttached)//上一次插拔的信号
+        {
+            hotplugReceived = false;
+        }
+    }
+    return true;
+}
+/*
+ *@brief:   通过UDC的soft_connect控制gadget上拉电阻，模拟插拔
+ *@date:    2026.10.18
+ *@param:   connect:true=接入  false=断开
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbBench::setSoftConnect(bool connect)
+{
+    QString udcName = config.udcName;
+    if(udcName.isEmpty())
+    {
+        QStringList udcList = QDir("/sys/class/udc").entryList(QDir::Dirs|QDir::NoDotAndDotDot);
+        for(int i=0;i<udcList.size();i++)
+        {
+            if(udcList.at(i).startsWith("dummy_udc"))
+            {
+                udcName = udcList.at(i);
+                break;
+            }
+        }
+    }
+    if(udcName.isEmpty())
+    {
+        return false;
+    }
+    QFile file("/sys/class/udc/"+udcName+"/soft_connect");
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    return file.write(connect?"connect":"disconnect") > 0;
+}
+/*
+ *@brief:   延迟样本的统计
+ *@date:    2026.10.18
+ *@param:   samples:样本(ns)
+ *@return:  QJsonObject:count/min/mean/p50/p99/max，单位us
+ */
+QJsonObject UsbBench::latencyStats(QVector<qint64> samples)
+{
+    QJsonObject stats;
+    stats.insert("count",samples.size());
+    if(samples.isEmpty())
+    {
+        return stats;
+    }
+    std::sort(samples.begin(),samples.end());
+    double sum = 0;
+    for(int i=0;i<samples.size();i++)
+    {
+        sum += samples.at(i);
+    }
+    int last = samples.size()-1;
+    stats.insert("min",samples.first()/1000.0);
+    stats.insert("mean",sum/samples.size()/1000.0);
+    stats.insert("p50",samples.at(last/2)/1000.0);
+    stats.insert("p99",samples.at((int)(last*0.99+0.5))/1000.0);
+    stats.insert("max",samples.last()/1000.0);
+    return stats;
+}
+/*
+ *@brief:   吞吐统计
+ *@date:    2026.10.18
+ *@param:   bytes:传输的字节数
+ *@param:   transfers:完成的传输数
+ *@param:   errors:出错的传输数
+ *@param:   elapsedNs:测试时长
+ *@return:  QJsonObject:bytes/transfers/errors/seconds/mb_per_s(10^6字节)
+ */
+QJsonObject UsbBench::throughputStats(quint64 bytes, quint64 transfers, quint64 errors, qint64 elapsedNs)
+{
+    QJsonObject stats;
+    double seconds = elapsedNs/1e9;
+    stats.insert("bytes",(qint64)bytes);
+    stats.insert("transfers",(qint64)transfers);
+    stats.insert("errors",(qint64)errors);
+    stats.insert("seconds",seconds);
+    stats.insert("mb_per_s",(seconds > 0)?bytes/seconds/1e6:0.0);
+    return stats;
+}
@@ -0,0 +1,130 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   UsbComm性能基准测试
+ *
+ *测量以下指标，结果输出为JSON，便于在不同版本之间对比:
+ *1.打开设备+声明接口的耗时；
+ *2.批量写吞吐(OUT端点，对端丢弃数据)和批量读吞吐(IN端点，对端始终有数据)，按设定的深度同时挂起多个传输；
+ *3.小包往返延迟(回环端点对，同步写后同步读)；
+ *4.热插拔到UsbMonitor信号送达(事件循环)的延迟；
+ *5.轮询方式热插拔监测(UsbHotplugPoller)单次轮询的耗时和按轮询周期折算的CPU占用；
+ *6.按固定周期提交的小包异步传输从提交到回调的延迟抖动(可对比事件线程实时配置的效果)；
+ *7.关闭/开启事件线程忙轮询时的异步往返延迟，以及忙轮询消耗的CPU时间；
+ *8.usbfs后端(--backend usbfs)平均每次唤醒批量取出的URB数，其余各项与libusb后端的结果直接对比；
+ *9.缓冲池在全部测试中新申请的内存块数和高水位；
+ *10.小包流式读取的结果逐包以排队信号投递到主线程与经UsbDeliveryQueue批量投递的对比(送达速率、唤醒次数、积压)。
+ *真实设备使用Linux dummy_hcd虚拟控制器上的回环gadget(见setup_dummy_hcd.sh)，没有该内核模块时使用UsbSimBackend
+ *和UsbSimDevice，两者的端点配置相同，可以使用同样的参数。
+ */
+#ifndef USBBENCH_H
+#define USBBENCH_H
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QJsonObject>
+#include <atomic>
+#include "usbcomm.h"
+
+class UsbMonitor;
+class UsbSimBackend;
+class UsbSimDevice;
+
+/* 基准测试配置 */
+struct UsbBenchConfig
+{
+    UsbBenchConfig():backend("auto"),vendorId(0x0525),productId(0xa4a0),transferSize(16384),queueDepth(4),
+        durationMs(2000),iterations(20),messageSize(64),sourceEndpoint(0x81),sinkEndpoint(0x01),
+        loopOutEndpoint(0x02),loopInEndpoint(0x82),simBandwidth(40000000),simLatencyNs(125000),
+        simJitterNs(20000),pollIntervalMs(500),completionWorkers(0),jitterIterations(1000),rtPriority(0),
+        rtCpu(-1),lockMemory(false),busyPollUs(200),zeroCopy(false){interfaceList<<0<<1;}
+
+    QString backend;//auto/sim/libusb/sharded/usbfs，auto在存在dummy_hcd且找到设备时使用libusb，否则使用sim
+    quint16 vendorId;
+    quint16 productId;
+    QList<int> interfaceList;//需要声明的接口
+    int transferSize;//吞吐测试单个传输的长度
+    int queueDepth;//吞吐测试同时挂起的传输数
+    int durationMs;//每项吞吐测试的时长
+    int iterations;//延迟类测试的次数
+    int messageSize;//往返延迟测试的消息长度
+    quint8 sourceEndpoint;//读吞吐的IN端点
+    quint8 sinkEndpoint;//写吞吐的OUT端点
+    quint8 loopOutEndpoint;//往返延迟的OUT端点
+    quint8 loopInEndpoint;//往返延迟的IN端点(返回OUT端点收到的数据)
+    QString udcName;//dummy_hcd的UDC名称(热插拔测试使用)，为空时自动查找
+    qint64 simBandwidth;//模拟设备的总线带宽(字节/秒)
+    qint64 simLatencyNs;//模拟设备的传输延迟
+    qint64 simJitterNs;//模拟设备的传输抖动
+    int pollIntervalMs;//轮询方式热插拔监测的周期(折算CPU占用)
+    int completionWorkers;//完成回调的工作线程数(0=在事件线程中执行，-1=按CPU核数)
+    int jitterIterations;//抖动测试的次数
+    int rtPriority;//事件线程和工作线程的SCHED_FIFO优先级，0表示默认调度
+    int rtCpu;//事件线程绑定的CPU(工作线程依次绑定之后的核)，-1表示不绑定
+    bool lockMemory;//是否锁定进程内存并预先触发缺页
+    int busyPollUs;//忙轮询测试的轮询窗口(us)
+    bool zeroCopy;//是否启用零拷贝接收(IN传输使用池化buffer)
+};
+
+class UsbBench : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbBench(const UsbBenchConfig &config,QObject *parent = 0);
+    ~UsbBench();
+
+    QJsonObject run();//执行全部测试，返回JSON结果(失败的测试包含error字段)
+
+private:
+    bool setup();//创建后端和UsbComm
+    bool openDevice();//打开设备并声明接口
+    QJsonObject benchOpenClaim();
+    QJsonObject benchWrite();
+    QJsonObject benchRead();
+    QJsonObject benchRoundTrip();
+    QJsonObject benchJitter();
+    QJsonObject benchBusyPoll();
+    QJsonObject benchDelivery();
+    QJsonObject usbfsReapStats();//usbfs后端的批量完成统计
+    static QJsonObject bufferPoolStats();//缓冲池统计
+    QJsonObject benchHotplug();
+    QJsonObject benchHotplugPoll();
+
+    void submitWrite();//提交一个写传输(传输完成后在回调中重新提交，直到测试结束)
+    bool waitHotplug(bool isAttached,int timeoutMs);//在事件循环中等待热插拔信号
+    bool setSoftConnect(bool connect);//通过UDC的soft_connect模拟插拔
+    UsbThreadConfig threadConfig() const;//事件线程的实时配置
+    QVector<qint64> asyncRoundTrip(int iterations,qint64 periodNs,int *errors);//连续执行异步往返，返回延迟样本(ns)
+    static QJsonObject latencyStats(QVector<qint64> samples);//延迟样本(ns)的统计，单位us
+    static QJsonObject throughputStats(quint64 bytes,quint64 transfers,quint64 errors,qint64 elapsedNs);
+    QJsonObject deliveryRun(bool batched);//小包流式读取，结果投递到主线程(true=批量  false=逐包)
+
+    UsbBenchConfig config;
+    QString backendName;//实际使用的后端
+    UsbBackend *backend;
+    UsbSimBackend *simBackend;
+    UsbSimDevice *simDevice;
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+
+    QByteArray writeBuffer;
+    std::atomic<qint64> deadline;//吞吐测试结束的时间点(ns)
+    std::atomic<quint64> benchBytes;
+    std::atomic<quint64> benchTransfers;
+    std::atomic<quint64> benchErrors;
+
+    quint64 deliveredPackets;//投递测试中主线程收到的结果数(只在主线程访问)
+
+    bool hotplugReceived;
+    bool hotplugAttached;
+    qint64 hotplugTime;//信号送达的时间点(ns)
+};
+
+#endif // USBBENCH_H
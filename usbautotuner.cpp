@@ -0,0 +1,587 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   传输长度与挂起深度的自动调优组件
+ */
+#include "usbautotuner.h"
+#include "usbmetrics.h"
+#include <QTimer>
+#include <QThread>
+#include <QSettings>
+#include <QScopedPointer>
+#include <QDebug>
+#include <atomic>
+#include <memory>
+
+#define TUNE_MAX_DEPTH          32  //最大挂起深度
+#define TUNE_GAIN_RATIO         1.05//吞吐提升超过5%才认为更好
+#define TUNE_KEEP_RATIO         0.98//吞吐不低于98%时选择更小的配置(减少内存和延迟)
+#define TUNE_DROP_RATIO         0.8 //稳定后吞吐下降超过20%重新探索
+#define TUNE_TIMER_INTERVAL     100 //持续调优的检查周期(ms)
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   usbComm:调优的传输对象(需要在调优器之后销毁)
+ *@param:   parent:父对象
+ */
+UsbAutoTuner::UsbAutoTuner(UsbComm *usbComm, QObject *parent)
+    :QObject(parent),usbComm(usbComm),probeDuration(200)
+{
+    continuousTimer = new QTimer(this);
+    continuousTimer->setInterval(TUNE_TIMER_INTERVAL);
+    connect(continuousTimer,SIGNAL(timeout()),this,SLOT(continuousTimeoutSlot()));
+}
+/*
+ *@brief:   析构函数
+ *@date:    2026.10.18
+ */
+UsbAutoTuner::~UsbAutoTuner()
+{
+    continuousTimer->stop();
+}
+/*
+ *@brief:   设置保存调优结果的ini文件
+ *@date:    2026.10.18
+ *@param:   fileName:文件路径，为空时使用QSettings("UsbComm","UsbAutoTuner")的默认位置
+ */
+void UsbAutoTuner::setSettingsFile(const QString &fileName)
+{
+    settingsFile = fileName;
+}
+/*
+ *@brief:   获取端点的传输配置(不产生传输)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ *@return:  UsbTuneConfig:之前保存的调优结果，没有时根据连接速度和端点描述符推算
+ */
+UsbTuneConfig UsbAutoTuner::getConfig(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    UsbTuneConfig config;
+    if(loadConfig(settingsKey(deviceHandle,endpoint),config))
+    {
+        return config;
+    }
+    return defaultConfig(tuneLimits(deviceHandle,endpoint),usbComm->getDeviceInfo(deviceHandle).speed);
+}
+/*
+ *@brief:   探测IN端点的最优配置(阻塞)
+ *先在默认深度下从小到大尝试传输长度，再在最优长度下尝试挂起深度，连续两次提升不足5%时停止，
+ *最后选择吞吐不低于最大值98%的最小配置并保存。探测期间读取的数据被丢弃，所以只能在开始正式通信前调用，
+ *OUT端点和中断端点不探测(直接返回推算值)，可以使用startContinuousTuning()在运行期间调优。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄(需要已声明端点所在的接口)
+ *@param:   endpoint:端点地址
+ *@param:   reprobe:true=忽略保存的结果重新探测
+ *@return:  UsbTuneConfig:调优结果
+ */
+UsbTuneConfig UsbAutoTuner::tune(libusb_device_handle *deviceHandle, quint8 endpoint, bool reprobe)
+{
+    QString key = settingsKey(deviceHandle,endpoint);
+    UsbTuneConfig config;
+    if(!reprobe && loadConfig(key,config))
+    {
+        return config;
+    }
+    TuneLimits limits = tuneLimits(deviceHandle,endpoint);
+    UsbTuneConfig fallback = defaultConfig(limits,usbComm->getDeviceInfo(deviceHandle).speed);
+    if(!(endpoint & LIBUSB_ENDPOINT_IN) || limits.transferType != LIBUSB_TRANSFER_TYPE_BULK)
+    {
+        return fallback;
+    }
+
+    //1.固定深度，尝试传输长度
+    QList<QPair<int,double> > resultList;
+    double best = 0;
+    int miss = 0;
+    for(int size=qMax(limits.minSize,fallback.transferSize/4);size<=limits.maxSize && miss<2;size*=2)
+    {
+        double throughput = probe(deviceHandle,endpoint,limits.transferType,size,fallback.queueDepth);
+        if(throughput < 0)
+        {
+            break;
+        }
+        resultList.append(qMakePair(size,throughput));
+        miss = (throughput > best*TUNE_GAIN_RATIO)?0:miss+1;
+        best = qMax(best,throughput);
+    }
+    if(best <= 0)
+    {
+        qDebug()<<"UsbAutoTuner probe failed, use default config:"<<key;
+        return fallback;
+    }
+    int bestSize = 0;
+    for(int i=0;i<resultList.size() && bestSize==0;i++)
+    {
+        if(resultList.at(i).second >= best*TUNE_KEEP_RATIO)
+        {
+            bestSize = resultList.at(i).first;
+        }
+    }
+
+    //2.固定长度，尝试挂起深度
+    resultList.clear();
+    best = 0;
+    miss = 0;
+    for(int depth=1;depth<=limits.maxDepth && miss<2;depth*=2)
+    {
+        double throughput = probe(deviceHandle,endpoint,limits.transferType,bestSize,depth);
+        if(throughput < 0)
+        {
+            break;
+        }
+        resultList.append(qMakePair(depth,throughput));
+        miss = (throughput > best*TUNE_GAIN_RATIO)?0:miss+1;
+        best = qMax(best,throughput);
+    }
+    if(best <= 0)
+    {
+        qDebug()<<"UsbAutoTuner probe failed, use default config:"<<key;
+        return fallback;
+    }
+    for(int i=0;i<resultList.size();i++)
+    {
+        if(resultList.at(i).second >= best*TUNE_KEEP_RATIO)
+        {
+            config.transferSize = bestSize;
+            config.queueDepth = resultList.at(i).first;
+            config.throughput = resultList.at(i).second;
+            break;
+        }
+    }
+    config.source = UsbTuneConfig::Probed;
+    saveConfig(key,config);
+    return config;
+}
+/*
+ *@brief:   清除保存的调优结果
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ */
+void UsbAutoTuner::clearStoredConfig(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    QScopedPointer<QSettings> settings(createSettings());
+    settings->remove(settingsKey(deviceHandle,endpoint));
+}
+/*
+ *@brief:   开始运行期间的持续调优
+ *每intervalMsecs根据UsbComm的传输统计计算端点的实际吞吐(没有传输的周期被忽略)，依次尝试相邻的配置
+ *(长度加倍/减半，深度加倍/减半)，通过configChanged()信号通知使用者切换。新配置吞吐提升超过5%，或者配置更小
+ *且吞吐不低于98%时接受，所有相邻配置都不更好时保持当前配置，之后吞吐下降超过20%时重新开始尝试。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ *@param:   transferSize:使用者当前的传输长度
+ *@param:   queueDepth:使用者当前的挂起深度
+ *@param:   intervalMsecs:观察周期(ms)，需要远大于单次传输的耗时
+ *@return:  bool:true=成功 false=失败
+ */
+bool UsbAutoTuner::startContinuousTuning(libusb_device_handle *deviceHandle, quint8 endpoint, int transferSize,
+                                         int queueDepth, int intervalMsecs)
+{
+    bool opened = false;
+    for(int i=0;i<usbComm->getOpenedDeviceCount() && !opened;i++)
+    {
+        opened = (usbComm->getDeviceHandleFromIndex(i) == deviceHandle);
+    }
+    if(!opened || transferSize <= 0 || queueDepth <= 0)
+    {
+        qDebug()<<"UsbAutoTuner start continuous tuning failed: invalid device handle or config.";
+        return false;
+    }
+    stopContinuousTuning(deviceHandle,endpoint);
+
+    ContinuousState state;
+    state.deviceHandle = deviceHandle;
+    state.endpoint = endpoint;
+    state.limits = tuneLimits(deviceHandle,endpoint);
+    state.intervalMsecs = qMax(intervalMsecs,TUNE_TIMER_INTERVAL);
+    state.lastTime = UsbMetrics::nowNs();
+    state.lastBytes = 0;
+    QList<UsbEndpointMetricsSnapshot> endpointList = usbComm->getMetricsSnapshot(deviceHandle).endpoints;
+    for(int i=0;i<endpointList.size();i++)
+    {
+        if(endpointList.at(i).endpoint == endpoint)
+        {
+            state.lastBytes = endpointList.at(i).bytes;
+        }
+    }
+    state.warmup = true;
+    state.current = qMakePair(transferSize,queueDepth);
+    state.currentThroughput = -1;
+    state.bestThroughput = 0;
+    state.trial = qMakePair(0,0);
+    state.settled = false;
+    continuousList.append(state);
+    continuousTimer->start();
+    return true;
+}
+/*
+ *@brief:   停止持续调优
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址，-1表示设备的所有端点
+ */
+void UsbAutoTuner::stopContinuousTuning(libusb_device_handle *deviceHandle, int endpoint)
+{
+    for(int i=continuousList.size()-1;i>=0;i--)
+    {
+        const ContinuousState &state = continuousList.at(i);
+        if(state.deviceHandle == deviceHandle && (endpoint == -1 || state.endpoint == endpoint))
+        {
+            continuousList.removeAt(i);
+        }
+    }
+    if(continuousList.isEmpty())
+    {
+        continuousTimer->stop();
+    }
+}
+/*
+ *@brief:   持续调优的定时检查
+ *先完成所有观察再发送信号，避免使用者在槽函数中停止调优时修改正在遍历的列表。
+ *@date:    2026.10.18
+ */
+void UsbAutoTuner::continuousTimeoutSlot()
+{
+    QList<QPair<libusb_device_handle *,quint8> > changedList;
+    QList<QPair<int,int> > configList;
+    qint64 now = UsbMetrics::nowNs();
+    for(int i=0;i<continuousList.size();i++)
+    {
+        ContinuousState &state = continuousList[i];
+        if(now-state.lastTime < state.intervalMsecs*Q_INT64_C(1000000))
+        {
+            continue;
+        }
+        QPair<int,int> config = observe(state);
+        if(config.first > 0)
+        {
+            changedList.append(qMakePair(state.deviceHandle,state.endpoint));
+            configList.append(config);
+        }
+    }
+    for(int i=0;i<changedList.size();i++)
+    {
+        emit configChanged(changedList.at(i).first,changedList.at(i).second,
+                           configList.at(i).first,configList.at(i).second);
+    }
+}
+/*
+ *@brief:   获取端点的调优范围
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ *@return:  TuneLimits:调优范围，获取不到端点描述符时按批量端点和连接速度的最大包长处理
+ */
+UsbAutoTuner::TuneLimits UsbAutoTuner::tuneLimits(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    int speed = usbComm->getDeviceInfo(deviceHandle).speed;
+    TuneLimits limits;
+    UsbEndpointInfo endpointInfo;
+    if(usbComm->getEndpointInfo(deviceHandle,endpoint,endpointInfo))
+    {
+        limits.transferType = endpointInfo.transferType;
+        limits.maxPacketSize = endpointInfo.maxPacketSize;
+    }
+    else
+    {
+        limits.transferType = LIBUSB_TRANSFER_TYPE_BULK;
+        limits.maxPacketSize = 0;
+    }
+    if(limits.maxPacketSize <= 0)
+    {
+        limits.maxPacketSize = (speed == LIBUSB_SPEED_LOW)?8:(speed == LIBUSB_SPEED_FULL)?64:
+                               (speed >= LIBUSB_SPEED_SUPER)?1024:512;
+    }
+    limits.minSize = limits.maxPacketSize;
+    if(speed == LIBUSB_SPEED_LOW || speed == LIBUSB_SPEED_FULL)
+    {
+        limits.maxSize = 16*1024;
+    }
+    else if(speed >= LIBUSB_SPEED_SUPER)
+    {
+        limits.maxSize = 1024*1024;
+    }
+    else
+    {
+        limits.maxSize = 256*1024;
+    }
+    limits.maxSize = qMax(limits.maxSize/limits.maxPacketSize,1)*limits.maxPacketSize;
+    limits.maxDepth = TUNE_MAX_DEPTH;
+    return limits;
+}
+/*
+ *@brief:   根据连接速度推算初始配置
+ *@date:    2026.10.18
+ *@param:   limits:调优范围
+ *@param:   speed:连接速度，详见enum libusb_speed{}
+ *@return:  UsbTuneConfig:初始配置
+ */
+UsbTuneConfig UsbAutoTuner::defaultConfig(const TuneLimits &limits, int speed)
+{
+    UsbTuneConfig config;
+    if(limits.transferType == LIBUSB_TRANSFER_TYPE_INTERRUPT)
+    {
+        //中断端点的数据率由设备的轮询间隔决定，单包传输即可
+        config.transferSize = limits.maxPacketSize;
+        config.queueDepth = 2;
+        return config;
+    }
+    if(speed == LIBUSB_SPEED_LOW || speed == LIBUSB_SPEED_FULL)
+    {
+        config.transferSize = 4096;
+        config.queueDepth = 2;
+    }
+    else if(speed >= LIBUSB_SPEED_SUPER)
+    {
+        config.transferSize = 65536;
+        config.queueDepth = 8;
+    }
+    else
+    {
+        config.transferSize = 16384;
+        config.queueDepth = 4;
+    }
+    config.transferSize = qBound(limits.minSize,config.transferSize/limits.maxPacketSize*limits.maxPacketSize,
+                                 limits.maxSize);
+    return config;
+}
+/*
+ *@brief:   调优结果在QSettings中的键
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ *@return:  QString:vid_pid_s速度/ep端点
+ */
+QString UsbAutoTuner::settingsKey(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    UsbDeviceInfo info = usbComm->getDeviceInfo(deviceHandle);
+    return QString("%1_%2_s%3/ep%4").arg(info.vendorId,4,16,QChar('0')).arg(info.productId,4,16,QChar('0'))
+            .arg(info.speed).arg(endpoint,2,16,QChar('0'));
+}
+/*
+ *@brief:   读取保存的调优结果
+ *@date:    2026.10.18
+ *@param:   key:settingsKey()
+ *@param:   config:读取的结果
+ *@return:  bool:true=存在有效的结果 false=不存在
+ */
+bool UsbAutoTuner::loadConfig(const QString &key, UsbTuneConfig &config)
+{
+    QScopedPointer<QSettings> settings(createSettings());
+    int transferSize = settings->value(key+"/transferSize",0).toInt();
+    int queueDepth = settings->value(key+"/queueDepth",0).toInt();
+    if(transferSize <= 0 || queueDepth <= 0)
+    {
+        return false;
+    }
+    config.transferSize = transferSize;
+    config.queueDepth = queueDepth;
+    config.throughput = settings->value(key+"/throughput",0).toDouble();
+    config.source = UsbTuneConfig::Stored;
+    return true;
+}
+/*
+ *@brief:   保存调优结果
+ *@date:    2026.10.18
+ *@param:   key:settingsKey()
+ *@param:   config:调优结果
+ */
+void UsbAutoTuner::saveConfig(const QString &key, const UsbTuneConfig &config)
+{
+    QScopedPointer<QSettings> settings(createSettings());
+    settings->setValue(key+"/transferSize",config.transferSize);
+    settings->setValue(key+"/queueDepth",config.queueDepth);
+    settings->setValue(key+"/throughput",config.throughput);
+}
+/*
+ *@brief:   探测一个配置的吞吐
+ *挂起queueDepth个流式传输，统计探测窗口内完成的字节数，窗口前20%的时长作为预热不计入。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ *@param:   transferType:传输类型
+ *@param:   transferSize:传输长度
+ *@param:   queueDepth:挂起深度
+ *@return:  double:吞吐(字节/秒)，提交失败返回-1
+ */
+double UsbAutoTuner::probe(libusb_device_handle *deviceHandle, quint8 endpoint, int transferType,
+                           int transferSize, int queueDepth)
+{
+    struct ProbeState
+    {
+        qint64 startTime;
+        qint64 endTime;
+        std::atomic<quint64> bytes;
+    };
+    //回调可能在cancelTransfers()超时返回之后执行，状态由回调共享持有
+    std::shared_ptr<ProbeState> state(new ProbeState);
+    qint64 warmup = probeDuration/5;
+    state->startTime = UsbMetrics::nowNs()+warmup*Q_INT64_C(1000000);
+    state->endTime = state->startTime+probeDuration*Q_INT64_C(1000000);
+    state->bytes.store(0);
+    UsbStreamCallback callback = [state](const UsbTransferResult &result)->bool{
+        qint64 now = UsbMetrics::nowNs();
+        if(now > state->endTime)
+        {
+            return false;
+        }
+        if(!result.isCompleted() && result.status != LIBUSB_TRANSFER_TIMED_OUT)
+        {
+            return false;
+        }
+        if(now >= state->startTime)
+        {
+            state->bytes.fetch_add(result.actualLength,std::memory_order_relaxed);
+        }
+        return true;
+    };
+    int submitted = 0;
+    for(int i=0;i<queueDepth;i++)
+    {
+        if(usbComm->submitStreamTransfer(deviceHandle,transferType,endpoint,transferSize,1000,callback))
+        {
+            submitted++;
+        }
+    }
+    if(submitted == 0)
+    {
+        return -1;
+    }
+    QThread::msleep(warmup+probeDuration);
+    usbComm->cancelTransfers(deviceHandle,endpoint);
+    return state->bytes.load()*1000.0/probeDuration;
+}
+/*
+ *@brief:   获取相邻的配置(长度加倍/减半，深度加倍/减半)
+ *@date:    2026.10.18
+ *@param:   config:当前配置
+ *@param:   limits:调优范围
+ *@return:  QList<QPair<int,int> >:调优范围内的相邻配置
+ */
+QList<QPair<int,int> > UsbAutoTuner::neighbours(const QPair<int,int> &config, const TuneLimits &limits)
+{
+    QList<QPair<int,int> > configList;
+    int mps = limits.maxPacketSize;
+    int largerSize = config.first*2/mps*mps;
+    int smallerSize = config.first/2/mps*mps;
+    if(largerSize <= limits.maxSize)
+    {
+        configList.append(qMakePair(largerSize,config.second));
+    }
+    if(smallerSize >= limits.minSize && smallerSize != config.first)
+    {
+        configList.append(qMakePair(smallerSize,config.second));
+    }
+    if(config.second*2 <= limits.maxDepth)
+    {
+        configList.append(qMakePair(config.first,config.second*2));
+    }
+    if(config.second/2 >= 1)
+    {
+        configList.append(qMakePair(config.first,config.second/2));
+    }
+    return configList;
+}
+/*
+ *@brief:   持续调优的一次观察
+ *@date:    2026.10.18
+ *@param:   state:调优状态
+ *@return:  QPair<int,int>:需要使用者切换的配置，长度为0表示不需要切换
+ */
+QPair<int,int> UsbAutoTuner::observe(ContinuousState &state)
+{
+    qint64 now = UsbMetrics::nowNs();
+    quint64 bytes = 0;
+    QList<UsbEndpointMetricsSnapshot> endpointList = usbComm->getMetricsSnapshot(state.deviceHandle).endpoints;
+    for(int i=0;i<endpointList.size();i++)
+    {
+        if(endpointList.at(i).endpoint == state.endpoint)
+        {
+            bytes = endpointList.at(i).bytes;
+        }
+    }
+    quint64 delta = (bytes >= state.lastBytes)?bytes-state.lastBytes:0;//统计被重置时重新计数
+    double throughput = delta*1e9/qMax(now-state.lastTime,Q_INT64_C(1));
+    state.lastBytes = bytes;
+    state.lastTime = now;
+    if(state.warmup)
+    {
+        state.warmup = false;
+        return qMakePair(0,0);
+    }
+    if(delta == 0)
+    {
+        return qMakePair(0,0);//没有传输(使用者空闲)
+    }
+
+    if(state.trial.first == 0)
+    {
+        //观察当前配置
+        if(state.currentThroughput >= 0)
+        {
+            if(!state.settled || throughput >= state.currentThroughput*TUNE_DROP_RATIO)
+            {
+                return qMakePair(0,0);
+            }
+            qDebug()<<"UsbAutoTuner throughput dropped, restart tuning:"<<state.endpoint;
+        }
+        state.currentThroughput = throughput;
+        state.bestThroughput = throughput;
+        state.settled = false;
+        state.candidateList = neighbours(state.current,state.limits);
+    }
+    else
+    {
+        //评估尝试的配置
+        bool smaller = (qint64)state.trial.first*state.trial.second < (qint64)state.current.first*state.current.second;
+        if(throughput > state.currentThroughput*TUNE_GAIN_RATIO ||
+                (smaller && throughput >= state.bestThroughput*TUNE_KEEP_RATIO))
+        {
+            QPair<int,int> previous = state.current;
+            state.current = state.trial;
+            state.currentThroughput = throughput;
+            state.bestThroughput = qMax(state.bestThroughput,throughput);
+            state.candidateList = neighbours(state.current,state.limits);
+            state.candidateList.removeAll(previous);
+
+            UsbTuneConfig config;
+            config.transferSize = state.current.first;
+            config.queueDepth = state.current.second;
+            config.throughput = throughput;
+            saveConfig(settingsKey(state.deviceHandle,state.endpoint),config);
+        }
+        state.trial = qMakePair(0,0);
+    }
+
+    state.warmup = true;
+    if(state.candidateList.isEmpty())
+    {
+        state.settled = true;
+        return state.current;//恢复到接受的配置
+    }
+    state.trial = state.candidateList.takeFirst();
+    return state.trial;
+}
+/*
+ *@brief:   创建访问调优结果的QSettings(由调用者释放)
+ *@date:    2026.10.18
+ *@return:  QSettings *:QSettings对象
+ */
+QSettings *UsbAutoTuner::createSettings()
+{
+    if(settingsFile.isEmpty())
+    {
+        return new QSettings("UsbComm","UsbAutoTuner");
+    }
+    return new QSettings(settingsFile,QSettings::IniFormat);
+}
@@ -0,0 +1,119 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   传输长度与挂起深度的自动调优组件
+ *
+ *最优的单次传输长度和同时挂起的传输数随连接速度(Full/High/SuperSpeed)和设备而不同，该类提供三种方式:
+ *1.getConfig():根据连接速度和端点描述符给出初始值，或者读取之前保存的调优结果，不产生任何传输；
+ *2.tune():启动时探测IN端点，依次尝试不同的长度和深度，选择吞吐接近最大值的最小配置(探测读取的数据被丢弃)；
+ *3.startContinuousTuning():运行期间根据传输统计(UsbComm::getMetricsSnapshot())观察实际吞吐，逐步尝试相邻的配置，
+ *  通过configChanged()信号通知使用者应用新配置，适用于OUT端点和不能在启动时丢弃数据的设备。
+ *调优结果按vid/pid/速度/端点保存在QSettings中，下次启动时getConfig()直接返回。
+ */
+#ifndef USBAUTOTUNER_H
+#define USBAUTOTUNER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPair>
+#include <QList>
+#include "usbcomm.h"
+
+class QTimer;
+class QSettings;
+
+/* 调优结果 */
+struct UsbTuneConfig
+{
+    enum Source
+    {
+        Default,//根据速度和端点描述符推算
+        Stored,//之前保存的调优结果
+        Probed//本次探测的结果
+    };
+    UsbTuneConfig():transferSize(0),queueDepth(0),throughput(0),source(Default){}
+
+    int transferSize;//单次传输长度(最大包长的整数倍)
+    int queueDepth;//同时挂起的传输数
+    double throughput;//对应的吞吐(字节/秒)，未测量时为0
+    int source;//结果来源
+};
+
+class UsbAutoTuner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbAutoTuner(UsbComm *usbComm,QObject *parent = 0);
+    ~UsbAutoTuner();
+
+    void setSettingsFile(const QString &fileName);//保存调优结果的ini文件，为空时使用默认的QSettings位置
+    void setProbeDuration(int msecs){probeDuration = qMax(msecs,10);}//tune()每个候选配置的探测时长
+
+    UsbTuneConfig getConfig(libusb_device_handle *deviceHandle,quint8 endpoint);//获取配置(不产生传输)
+    UsbTuneConfig tune(libusb_device_handle *deviceHandle,quint8 endpoint,bool reprobe=false);//探测IN端点(阻塞)
+    void clearStoredConfig(libusb_device_handle *deviceHandle,quint8 endpoint);//清除保存的调优结果
+
+    //运行期间持续调优，transferSize/queueDepth为使用者当前的配置，每intervalMsecs观察一次吞吐
+    bool startContinuousTuning(libusb_device_handle *deviceHandle,quint8 endpoint,int transferSize,
+                               int queueDepth,int intervalMsecs=1000);
+    void stopContinuousTuning(libusb_device_handle *deviceHandle,int endpoint=-1);//endpoint=-1表示设备所有端点
+
+signals:
+    //持续调优需要使用者切换到新配置(使用者应用之后，下一个观察周期开始统计)
+    void configChanged(libusb_device_handle *deviceHandle,quint8 endpoint,int transferSize,int queueDepth);
+
+private slots:
+    void continuousTimeoutSlot();
+
+private:
+    /* 端点的调优范围 */
+    struct TuneLimits
+    {
+        int transferType;
+        int maxPacketSize;
+        int minSize;
+        int maxSize;
+        int maxDepth;
+    };
+    /* 持续调优的状态 */
+    struct ContinuousState
+    {
+        libusb_device_handle *deviceHandle;
+        quint8 endpoint;
+        TuneLimits limits;
+        int intervalMsecs;
+        qint64 lastTime;//上次观察的时间点(ns)
+        quint64 lastBytes;//上次观察时端点的累计字节数
+        bool warmup;//切换配置后的第一个周期不计入统计
+        QPair<int,int> current;//已接受的配置(长度,深度)
+        double currentThroughput;//已接受配置的吞吐，小于0表示尚未测量
+        double bestThroughput;//观察到的最大吞吐(接受更小的配置时以此为基准，避免逐步退化)
+        QPair<int,int> trial;//正在尝试的配置，长度为0表示没有
+        QList<QPair<int,int> > candidateList;//待尝试的相邻配置
+        bool settled;//相邻配置都不更好，保持当前配置
+    };
+
+    TuneLimits tuneLimits(libusb_device_handle *deviceHandle,quint8 endpoint);
+    UsbTuneConfig defaultConfig(const TuneLimits &limits,int speed);
+    QString settingsKey(libusb_device_handle *deviceHandle,quint8 endpoint);//vid_pid_速度/端点
+    bool loadConfig(const QString &key,UsbTuneConfig &config);
+    void saveConfig(const QString &key,const UsbTuneConfig &config);
+    double probe(libusb_device_handle *deviceHandle,quint8 endpoint,int transferType,int transferSize,int queueDepth);
+    QList<QPair<int,int> > neighbours(const QPair<int,int> &config,const TuneLimits &limits);
+    QPair<int,int> observe(ContinuousState &state);//持续调优的一次观察，返回需要使用者切换的配置(长度为0表示不需要)
+    QSettings *createSettings();
+
+    UsbComm *usbComm;
+    QString settingsFile;
+    int probeDuration;
+    QTimer *continuousTimer;
+    QList<ContinuousState> continuousList;
+};
+
+#endif // USBAUTOTUNER_H
@@ -0,0 +1,120 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输后端接口
+ *
+ *UsbComm和UsbMonitor不直接调用libusb，而是通过该接口访问设备，目前有两种实现:
+ *1.UsbLibusbBackend:基于libusb访问真实设备(默认)；
+ *2.UsbSimBackend:进程内的模拟总线，挂载UsbVirtualDevice(例如UsbSimDevice、UsbReplayDevice)，
+ *  用于在没有硬件的环境中进行确定性的测试和性能测量。
+ *设备句柄沿用libusb_device_handle *类型，模拟设备的句柄只用于查找，不会被libusb访问。
+ */
+#ifndef USBBACKEND_H
+#define USBBACKEND_H
+
+#include <QList>
+#include <QString>
+#include <QMetaType>
+#include <functional>
+#include "libusb-1.0/include/libusb.h"
+#include "usbdescriptor.h"
+
+class UsbDeviceDatabase;
+class UsbBusyPoll;
+
+/* 设备信息(枚举和热插拔时由后端填充) */
+struct UsbDeviceInfo
+{
+    UsbDeviceInfo():vendorId(0),productId(0),deviceClass(0),busNumber(0),deviceAddress(0),
+        portNumber(0),speed(LIBUSB_SPEED_UNKNOWN),device(NULL){}
+
+    quint16 vendorId;//厂商id
+    quint16 productId;//产品id
+    quint8 deviceClass;//设备类
+    quint8 busNumber;//总线号
+    quint8 deviceAddress;//设备地址
+    quint8 portNumber;//端口号
+    int speed;//连接速度，详见enum libusb_speed{}
+    QList<quint8> portPath;//从根集线器开始的完整端口路径(集线器后的设备只用端口号无法区分)
+    void *device;//后端内部的设备标识(libusb_device *或UsbVirtualDevice *)，只在枚举结果有效期内使用
+};
+
+//libusb 1.0.22新增的LIBUSB_SPEED_SUPER_PLUS(10/20Gbps)，内置的1.0.20头文件没有定义
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000106)
+#define USB_SPEED_SUPER_PLUS    LIBUSB_SPEED_SUPER_PLUS
+#else
+#define USB_SPEED_SUPER_PLUS    5
+#endif
+
+/* 设备记录:设备信息及描述符快照(sysfs枚举和热插拔事件使用，均来自缓存，不访问总线) */
+struct UsbDeviceRecord
+{
+    UsbDeviceRecord():bcdUSB(0),bcdDevice(0){}
+
+    QString sysfsName;//sysfs目录名(例如1-1.2，根集线器为usb1)，非sysfs来源时为空
+    UsbDeviceInfo info;//vpid、总线、地址、端口路径、速度等
+    quint16 bcdUSB;//USB协议版本
+    quint16 bcdDevice;//设备版本
+    QString manufacturer;//厂商字符串(只有sysfs来源有效)
+    QString product;//产品字符串(只有sysfs来源有效)
+    QString serial;//序列号(只有sysfs来源有效)
+    UsbConfigInfo config;//当前配置的描述符树，无法获取时为空
+};
+Q_DECLARE_METATYPE(UsbDeviceRecord)
+
+//热插拔回调(在后端的事件线程或触发插拔的线程中执行)，record.info.device只在回调期间有效
+typedef std::function<void(bool isAttached,const UsbDeviceRecord &record)> UsbHotplugCallback;
+
+class UsbBackend
+{
+public:
+    virtual ~UsbBackend(){}
+
+    /*设备枚举与打开，返回值均为enum libusb_error{}*/
+    virtual QList<UsbDeviceInfo> getDeviceList() = 0;//枚举当前接入的设备
+    virtual void printDeviceInfo(const UsbDeviceInfo &info) = 0;//打印设备详细信息(调试用)
+    virtual int openDevice(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle) = 0;
+    virtual void closeDevice(libusb_device_handle *deviceHandle) = 0;
+    virtual UsbDeviceInfo getDeviceInfo(libusb_device_handle *deviceHandle) = 0;//获取打开设备的信息
+    virtual int getConfigInfo(libusb_device_handle *deviceHandle,UsbConfigInfo *config) = 0;//解析当前配置的描述符树
+
+    /*设备操作*/
+    virtual int setConfiguration(libusb_device_handle *deviceHandle,int bConfigurationValue) = 0;
+    virtual int claimInterface(libusb_device_handle *deviceHandle,int interfaceNumber) = 0;//包括卸载内核驱动
+    virtual int releaseInterface(libusb_device_handle *deviceHandle,int interfaceNumber) = 0;
+    virtual int setInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,int bAlternateSetting) = 0;
+    virtual int resetDevice(libusb_device_handle *deviceHandle) = 0;
+    virtual int clearHalt(libusb_device_handle *deviceHandle,quint8 endpoint) = 0;
+
+    /*数据传输*/
+    //同步传输，阻塞直到完成或超时(控制传输的data包含8字节setup包)
+    virtual int syncTransfer(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                             quint8 *data,int length,int *actualLength,quint32 timeout) = 0;
+    //提交异步传输(由libusb_alloc_transfer申请并填充)，完成后在后端的事件线程中调用transfer->callback
+    virtual int submitTransfer(libusb_transfer *transfer) = 0;
+    virtual int cancelTransfer(libusb_transfer *transfer) = 0;
+
+    /*热插拔*/
+    virtual bool hasHotplug() = 0;//是否支持热插拔监测
+    virtual int registerHotplug(int deviceClass,int vendorId,int productId,UsbHotplugCallback callback,
+                                libusb_hotplug_callback_handle *hotplugHandle) = 0;
+    virtual void deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle) = 0;
+
+    /*快速枚举(可选)*/
+    virtual UsbDeviceDatabase *getDeviceDatabase(){return NULL;}//基于sysfs的设备数据库，不支持时返回NULL
+    //按info中的总线号和地址直接打开设备(设备数据库命中时使用，不需要完整枚举)，不支持时返回LIBUSB_ERROR_NOT_SUPPORTED
+    virtual int openDeviceByAddress(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle)
+    {Q_UNUSED(info) Q_UNUSED(deviceHandle) return LIBUSB_ERROR_NOT_SUPPORTED;}
+
+    /*忙轮询(可选)*/
+    //处理设备传输完成事件的会话的忙轮询状态，不支持时返回NULL
+    virtual UsbBusyPoll *getBusyPoll(libusb_device_handle *deviceHandle){Q_UNUSED(deviceHandle) return NULL;}
+};
+
+#endif // USBBACKEND_H
@@ -0,0 +1,557 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   传输buffer和libusb_transfer的缓冲池
+ */
+#include "usbbufferpool.h"
+#include <QDebug>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define BUFFER_HEADER_SIZE      32  //内存块头部的大小(保证buffer按16字节对齐)
+#define THREAD_CACHE_BLOCKS     4   //线程缓存中每个档位最多缓存的内存块数
+#define THREAD_CACHE_TRANSFERS  8   //线程缓存中最多缓存的libusb_transfer数
+#define DEFAULT_CAPACITY_BYTES  (64*1024*1024)
+#define DEFAULT_IDLE_TRANSFERS  1024
+
+/* 线程缓存，线程结束时归还到共享空闲链表 */
+struct UsbBufferThreadCache
+{
+    UsbBufferThreadCache()
+    {
+        memset(blockCount,0,sizeof(blockCount));
+        transferCount = 0;
+    }
+    ~UsbBufferThreadCache()
+    {
+        UsbBufferPool *pool = UsbBufferPool::instance();
+        for(int i=0;i<USB_BUFFER_CLASS_COUNT;i++)
+        {
+            for(int j=0;j<blockCount[i];j++)
+            {
+                pool->pushShared(blocks[i][j]);
+            }
+        }
+        for(int i=0;i<transferCount;i++)
+        {
+            pool->pushSharedTransfer(transfers[i]);
+        }
+    }
+
+    UsbBufferPool::BlockHeader *blocks[USB_BUFFER_CLASS_COUNT][THREAD_CACHE_BLOCKS];
+    int blockCount[USB_BUFFER_CLASS_COUNT];
+    libusb_transfer *transfers[THREAD_CACHE_TRANSFERS];
+    int transferCount;
+};
+
+static thread_local UsbBufferThreadCache threadCache;
+
+/*
+ *@brief:   更新高水位
+ *@date:    2026.10.18
+ *@param:   peak:高水位
+ *@param:   value:当前值
+ */
+static void updatePeak(std::atomic<qint64> &peak, qint64 value)
+{
+    qint64 current = peak.load(std::memory_order_relaxed);
+    while(value > current && !peak.compare_exchange_weak(current,value,std::memory_order_relaxed))
+    {
+    }
+}
+
+/*
+ *@brief:   获取进程内共享的缓冲池
+ * 缓冲池不会被释放，避免进程退出时仍在运行的线程归还buffer访问已析构的对象。
+ *@date:    2026.10.18
+ *@return:  UsbBufferPool*:缓冲池
+ */
+UsbBufferPool *UsbBufferPool::instance()
+{
+    static UsbBufferPool *pool = new UsbBufferPool();
+    return pool;
+}
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ */
+UsbBufferPool::UsbBufferPool()
+{
+    Q_STATIC_ASSERT(sizeof(BlockHeader) <= BUFFER_HEADER_SIZE);
+    memset(freeList,0,sizeof(freeList));
+    freeTransferList = NULL;
+    idleTransferCount = 0;
+    maxIdleTransfers = DEFAULT_IDLE_TRANSFERS;
+    capacityBytes = DEFAULT_CAPACITY_BYTES;
+    allocations = 0;
+    threadCacheHits = 0;
+    sharedHits = 0;
+    heapAllocations = 0;
+    overflowAllocations = 0;
+    inUseBytes = 0;
+    peakInUseBytes = 0;
+    ownedBytes = 0;
+    peakOwnedBytes = 0;
+    transferAllocations = 0;
+    transferHeapAllocations = 0;
+    transfersInUse = 0;
+    peakTransfersInUse = 0;
+}
+/*
+ *@brief:   设置内存上限
+ * 降低上限时，已持有的内存块在归还时释放，直到持有的字节数不超过上限。
+ *@date:    2026.10.18
+ *@param:   maxBytes:缓冲池持有内存(使用中+空闲)的上限
+ *@param:   maxIdleTransfers:共享空闲链表中libusb_transfer的上限
+ */
+void UsbBufferPool::setLimits(qint64 maxBytes, int maxIdleTransfers)
+{
+    QMutexLocker locker(&mutex);
+    capacityBytes = maxBytes;
+    this->maxIdleTransfers = maxIdleTransfers;
+}
+/*
+ *@brief:   预留内存块
+ * 新申请count个对应档位的内存块，逐页写入触发缺页(lockPages=true时再用mlock锁定)后放入共享空闲链表，
+ * 之后任意线程的申请都可以直接复用，运行中不再产生缺页。适合实时应用在启动时按传输大小和挂起数量调用，
+ * 不需要mlockall()锁定整个进程，也不需要修改malloc参数。预留的内存块计入持有字节数，超出上限的部分不预留，
+ * trim()同样会释放预留的内存块。
+ *@date:    2026.10.18
+ *@param:   size:每个buffer需要的长度(不超过最大档位)
+ *@param:   count:预留的数量
+ *@param:   lockPages:是否mlock锁定内存块(需要CAP_IPC_LOCK或足够的RLIMIT_MEMLOCK)
+ *@return:  int:实际预留的数量
+ */
+int UsbBufferPool::reserve(int size, int count, bool lockPages)
+{
+    int sizeClass = sizeClassOf(qMax(size,1));
+    if(sizeClass < 0)
+    {
+        qDebug()<<"UsbBufferPool reserve error: size exceeds the largest class:"<<size;
+        return 0;
+    }
+    int classBytes = 1<<(sizeClass+USB_BUFFER_MIN_SHIFT);
+    int blockBytes = BUFFER_HEADER_SIZE+classBytes;
+#ifdef Q_OS_LINUX
+    long pageSize = sysconf(_SC_PAGESIZE);
+#else
+    long pageSize = 4096;
+#endif
+    int reserved = 0;
+    for(;reserved<count;reserved++)
+    {
+        //先在上限之内占用持有字节数，缺页和锁定在锁外进行
+        mutex.lock();
+        bool withinCapacity = (ownedBytes.load(std::memory_order_relaxed)+classBytes <= capacityBytes.load(std::memory_order_relaxed));
+        if(withinCapacity)
+        {
+            updatePeak(peakOwnedBytes,ownedBytes.fetch_add(classBytes,std::memory_order_relaxed)+classBytes);
+        }
+        mutex.unlock();
+        if(!withinCapacity)
+        {
+            break;
+        }
+        BlockHeader *header = static_cast<BlockHeader *>(malloc(blockBytes));
+        if(header == NULL)
+        {
+            ownedBytes.fetch_sub(classBytes,std::memory_order_relaxed);
+            break;
+        }
+        volatile char *bytes = reinterpret_cast<volatile char *>(header);
+        for(int i=0;i<blockBytes;i+=pageSize)
+        {
+            bytes[i] = 0;
+        }
+        bytes[blockBytes-1] = 0;
+#ifdef Q_OS_LINUX
+        if(lockPages && mlock(header,blockBytes) != 0)
+        {
+            qDebug()<<"UsbBufferPool reserve mlock error:"<<strerror(errno);
+            lockPages = false;//之后的内存块只预先触发缺页
+        }
+#endif
+        header->sizeClass = sizeClass;
+        header->capacity = classBytes;
+        heapAllocations.fetch_add(1,std::memory_order_relaxed);
+        mutex.lock();
+        header->next = freeList[sizeClass];
+        freeList[sizeClass] = header;
+        mutex.unlock();
+    }
+    return reserved;
+}
+/*
+ *@brief:   申请buffer
+ * 依次从线程缓存、共享空闲链表申请，都没有时在上限之内新申请一个内存块，超出上限时直接从堆申请。
+ *@date:    2026.10.18
+ *@param:   size:需要的长度
+ *@return:  void*:buffer(按16字节对齐，可用长度见capacityOf())，失败返回NULL
+ */
+void *UsbBufferPool::allocate(int size)
+{
+    allocations.fetch_add(1,std::memory_order_relaxed);
+    int sizeClass = sizeClassOf(qMax(size,1));
+    BlockHeader *header = NULL;
+    if(sizeClass >= 0)
+    {
+        int classBytes = 1<<(sizeClass+USB_BUFFER_MIN_SHIFT);
+        if(threadCache.blockCount[sizeClass] > 0)
+        {
+            header = threadCache.blocks[sizeClass][--threadCache.blockCount[sizeClass]];
+            threadCacheHits.fetch_add(1,std::memory_order_relaxed);
+        }
+        else
+        {
+            QMutexLocker locker(&mutex);
+            if(freeList[sizeClass] != NULL)
+            {
+                header = freeList[sizeClass];
+                freeList[sizeClass] = header->next;
+                sharedHits.fetch_add(1,std::memory_order_relaxed);
+            }
+            else if(ownedBytes.load(std::memory_order_relaxed)+classBytes <= capacityBytes.load(std::memory_order_relaxed))
+            {
+                header = static_cast<BlockHeader *>(malloc(BUFFER_HEADER_SIZE+classBytes));
+                if(header != NULL)
+                {
+                    header->sizeClass = sizeClass;
+                    header->capacity = classBytes;
+                    updatePeak(peakOwnedBytes,ownedBytes.fetch_add(classBytes,std::memory_order_relaxed)+classBytes);
+                    heapAllocations.fetch_add(1,std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+    if(header == NULL)//超出上限或最大档位
+    {
+        header = static_cast<BlockHeader *>(malloc(BUFFER_HEADER_SIZE+size));
+        if(header == NULL)
+        {
+            return NULL;
+        }
+        header->sizeClass = -1;
+        header->capacity = size;
+        overflowAllocations.fetch_add(1,std::memory_order_relaxed);
+    }
+    header->next = NULL;
+    header->refCount.store(1,std::memory_order_relaxed);
+    addInUse(header->capacity);
+    return bufferOf(header);
+}
+/*
+ *@brief:   增加buffer的引用计数
+ *@date:    2026.10.18
+ *@param:   buffer:allocate()申请的buffer
+ */
+void UsbBufferPool::retain(void *buffer)
+{
+    headerOf(buffer)->refCount.fetch_add(1,std::memory_order_relaxed);
+}
+/*
+ *@brief:   释放buffer的一个引用，最后一个引用释放时归还
+ *@date:    2026.10.18
+ *@param:   buffer:allocate()申请的buffer
+ */
+void UsbBufferPool::release(void *buffer)
+{
+    if(buffer == NULL)
+    {
+        return;
+    }
+    BlockHeader *header = headerOf(buffer);
+    if(header->refCount.fetch_sub(1,std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    addInUse(-header->capacity);
+    if(header->sizeClass < 0)
+    {
+        free(header);
+        return;
+    }
+    int &count = threadCache.blockCount[header->sizeClass];
+    if(count < THREAD_CACHE_BLOCKS)
+    {
+        threadCache.blocks[header->sizeClass][count++] = header;
+        return;
+    }
+    pushShared(header);
+}
+/*
+ *@brief:   buffer的实际可用长度
+ *@date:    2026.10.18
+ *@param:   buffer:allocate()申请的buffer
+ *@return:  int:可用长度
+ */
+int UsbBufferPool::capacityOf(const void *buffer)
+{
+    return headerOf(buffer)->capacity;
+}
+/*
+ *@brief:   buffer是否有多个引用
+ *@date:    2026.10.18
+ *@param:   buffer:allocate()申请的buffer
+ *@return:  bool:true=有多个引用
+ */
+bool UsbBufferPool::isShared(const void *buffer)
+{
+    return headerOf(buffer)->refCount.load(std::memory_order_acquire) > 1;
+}
+/*
+ *@brief:   申请libusb_transfer
+ * 归还的libusb_transfer在其他线程中可以直接复用(libusb允许已完成的传输重新填充后提交)。
+ *@date:    2026.10.18
+ *@return:  libusb_transfer*:字段清零的传输，失败返回NULL
+ */
+libusb_transfer *UsbBufferPool::allocTransfer()
+{
+    transferAllocations.fetch_add(1,std::memory_order_relaxed);
+    libusb_transfer *transfer = NULL;
+    if(threadCache.transferCount > 0)
+    {
+        transfer = threadCache.transfers[--threadCache.transferCount];
+    }
+    else
+    {
+        mutex.lock();
+        if(freeTransferList != NULL)
+        {
+            transfer = freeTransferList;
+            freeTransferList = static_cast<libusb_transfer *>(transfer->user_data);
+            idleTransferCount--;
+        }
+        mutex.unlock();
+        if(transfer == NULL)
+        {
+            transfer = libusb_alloc_transfer(0);
+            if(transfer == NULL)
+            {
+                return NULL;
+            }
+            transferHeapAllocations.fetch_add(1,std::memory_order_relaxed);
+        }
+    }
+    memset(transfer,0,sizeof(libusb_transfer));
+    updatePeak(peakTransfersInUse,transfersInUse.fetch_add(1,std::memory_order_relaxed)+1);
+    return transfer;
+}
+/*
+ *@brief:   归还libusb_transfer
+ *@date:    2026.10.18
+ *@param:   transfer:allocTransfer()申请的传输(已完成，不再被后端引用)
+ */
+void UsbBufferPool::freeTransfer(libusb_transfer *transfer)
+{
+    if(transfer == NULL)
+    {
+        return;
+    }
+    transfersInUse.fetch_sub(1,std::memory_order_relaxed);
+    if(threadCache.transferCount < THREAD_CACHE_TRANSFERS)
+    {
+        threadCache.transfers[threadCache.transferCount++] = transfer;
+        return;
+    }
+    pushSharedTransfer(transfer);
+}
+/*
+ *@brief:   获取统计
+ *@date:    2026.10.18
+ *@return:  UsbBufferPoolStats:统计
+ */
+UsbBufferPoolStats UsbBufferPool::getStats() const
+{
+    UsbBufferPoolStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.threadCacheHits = threadCacheHits.load(std::memory_order_relaxed);
+    stats.sharedHits = sharedHits.load(std::memory_order_relaxed);
+    stats.heapAllocations = heapAllocations.load(std::memory_order_relaxed);
+    stats.overflowAllocations = overflowAllocations.load(std::memory_order_relaxed);
+    stats.inUseBytes = inUseBytes.load(std::memory_order_relaxed);
+    stats.peakInUseBytes = peakInUseBytes.load(std::memory_order_relaxed);
+    stats.ownedBytes = ownedBytes.load(std::memory_order_relaxed);
+    stats.peakOwnedBytes = peakOwnedBytes.load(std::memory_order_relaxed);
+    stats.capacityBytes = capacityBytes.load(std::memory_order_relaxed);
+    stats.transferAllocations = transferAllocations.load(std::memory_order_relaxed);
+    stats.transferHeapAllocations = transferHeapAllocations.load(std::memory_order_relaxed);
+    stats.transfersInUse = transfersInUse.load(std::memory_order_relaxed);
+    stats.peakTransfersInUse = peakTransfersInUse.load(std::memory_order_relaxed);
+    return stats;
+}
+/*
+ *@brief:   释放共享空闲链表中的内存块和libusb_transfer
+ *@date:    2026.10.18
+ */
+void UsbBufferPool::trim()
+{
+    QMutexLocker locker(&mutex);
+    for(int i=0;i<USB_BUFFER_CLASS_COUNT;i++)
+    {
+        while(freeList[i] != NULL)
+        {
+            BlockHeader *header = freeList[i];
+            freeList[i] = header->next;
+            ownedBytes.fetch_sub(header->capacity,std::memory_order_relaxed);
+            free(header);
+        }
+    }
+    while(freeTransferList != NULL)
+    {
+        libusb_transfer *transfer = freeTransferList;
+        freeTransferList = static_cast<libusb_transfer *>(transfer->user_data);
+        libusb_free_transfer(transfer);
+    }
+    idleTransferCount = 0;
+}
+/*
+ *@brief:   满足长度的最小档位
+ *@date:    2026.10.18
+ *@param:   size:长度(>0)
+ *@return:  int:档位序号，超过最大档位返回-1
+ */
+int UsbBufferPool::sizeClassOf(int size)
+{
+    int sizeClass = 0;
+    while((1<<(sizeClass+USB_BUFFER_MIN_SHIFT)) < size)
+    {
+        if(++sizeClass >= USB_BUFFER_CLASS_COUNT)
+        {
+            return -1;
+        }
+    }
+    return sizeClass;
+}
+/*
+ *@brief:   buffer对应的内存块头部
+ *@date:    2026.10.18
+ */
+UsbBufferPool::BlockHeader *UsbBufferPool::headerOf(const void *buffer)
+{
+    return reinterpret_cast<BlockHeader *>(const_cast<char *>(static_cast<const char *>(buffer))-BUFFER_HEADER_SIZE);
+}
+/*
+ *@brief:   内存块头部对应的buffer
+ *@date:    2026.10.18
+ */
+void *UsbBufferPool::bufferOf(BlockHeader *header)
+{
+    return reinterpret_cast<char *>(header)+BUFFER_HEADER_SIZE;
+}
+/*
+ *@brief:   归还内存块到共享空闲链表，持有的字节数超过上限(上限被降低)时直接释放
+ *@date:    2026.10.18
+ *@param:   header:内存块头部
+ */
+void UsbBufferPool::pushShared(BlockHeader *header)
+{
+    QMutexLocker locker(&mutex);
+    if(ownedBytes.load(std::memory_order_relaxed) > capacityBytes.load(std::memory_order_relaxed))
+    {
+        ownedBytes.fetch_sub(header->capacity,std::memory_order_relaxed);
+        free(header);
+        return;
+    }
+    header->next = freeList[header->sizeClass];
+    freeList[header->sizeClass] = header;
+}
+/*
+ *@brief:   归还libusb_transfer到共享空闲链表，超过上限时直接释放
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ */
+void UsbBufferPool::pushSharedTransfer(libusb_transfer *transfer)
+{
+    QMutexLocker locker(&mutex);
+    if(idleTransferCount >= maxIdleTransfers)
+    {
+        libusb_free_transfer(transfer);
+        return;
+    }
+    transfer->user_data = freeTransferList;
+    freeTransferList = transfer;
+    idleTransferCount++;
+}
+/*
+ *@brief:   更新使用中的字节数及其高水位
+ *@date:    2026.10.18
+ *@param:   bytes:增加的字节数(归还时为负)
+ */
+void UsbBufferPool::addInUse(qint64 bytes)
+{
+    qint64 value = inUseBytes.fetch_add(bytes,std::memory_order_relaxed)+bytes;
+    if(bytes > 0)
+    {
+        updatePeak(peakInUseBytes,value);
+    }
+}
+
+/*
+ *@brief:   构造函数，从缓冲池申请buffer
+ *@date:    2026.10.18
+ *@param:   size:需要的长度
+ */
+UsbPooledBuffer::UsbPooledBuffer(int size)
+{
+    buffer = static_cast<char *>(UsbBufferPool::instance()->allocate(size));
+}
+/*
+ *@brief:   拷贝构造函数，共享同一个buffer
+ *@date:    2026.10.18
+ */
+UsbPooledBuffer::UsbPooledBuffer(const UsbPooledBuffer &other)
+{
+    buffer = other.buffer;
+    if(buffer != NULL)
+    {
+        UsbBufferPool::instance()->retain(buffer);
+    }
+}
+/*
+ *@brief:   析构函数，释放对buffer的引用
+ *@date:    2026.10.18
+ */
+UsbPooledBuffer::~UsbPooledBuffer()
+{
+    UsbBufferPool::instance()->release(buffer);
+}
+/*
+ *@brief:   赋值，共享other的buffer并释放原来的引用
+ *@date:    2026.10.18
+ */
+UsbPooledBuffer &UsbPooledBuffer::operator=(const UsbPooledBuffer &other)
+{
+    if(other.buffer != NULL)
+    {
+        UsbBufferPool::instance()->retain(other.buffer);
+    }
+    UsbBufferPool::instance()->release(buffer);
+    buffer = other.buffer;
+    return *this;
+}
+/*
+ *@brief:   以QByteArray形式访问buffer，不拷贝数据
+ * QByteArray不持有buffer，需要跨线程或在回调之外使用时同时保留该句柄(例如保留整个UsbTransferResult)。
+ *@date:    2026.10.18
+ *@param:   length:有效数据长度
+ *@return:  QByteArray:引用buffer的QByteArray
+ */
+QByteArray UsbPooledBuffer::toByteArray(int length) const
+{
+    if(buffer == NULL)
+    {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(buffer,qBound(0,length,capacity()));
+}
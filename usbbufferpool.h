@@ -0,0 +1,140 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   传输buffer和libusb_transfer的缓冲池
+ *
+ *高速流式传输中每个传输都申请/释放一次数据buffer和libusb_transfer，堆分配器的锁和缺页在延迟分布中明显可见。
+ *该缓冲池按2的幂划分尺寸档位(64B~4MB)，每个线程为每个档位缓存少量空闲内存块，申请和归还优先在线程缓存中
+ *完成(无锁)，线程缓存满或为空时再访问共享的空闲链表(空闲链表使用内存块头部链接，本身不申请内存)。
+ *缓冲池持有的内存(使用中+空闲)不超过设定的上限，超出上限或超过最大档位的申请直接从堆申请，归还时释放。
+ *稳定运行后所有申请都由空闲内存块满足，getStats()中的heapAllocations不再增长，高水位用于确定合适的上限。
+ *实时应用可以在启动时reserve()预留内存块(逐页写入触发缺页，可选mlock锁定)，运行中的申请不再产生缺页。
+ *缓冲池在进程内共享(instance())，buffer可以在一个线程申请、在另一个线程归还。
+ *buffer带有引用计数，UsbPooledBuffer是其共享句柄，可以不拷贝地以QByteArray形式交给使用者，
+ *最后一个句柄释放时buffer归还缓冲池(UsbComm的零拷贝接收即基于此实现)。
+ */
+#ifndef USBBUFFERPOOL_H
+#define USBBUFFERPOOL_H
+
+#include <QMutex>
+#include <QByteArray>
+#include <atomic>
+#include "libusb-1.0/include/libusb.h"
+
+#define USB_BUFFER_MIN_SHIFT    6   //最小档位64B
+#define USB_BUFFER_MAX_SHIFT    22  //最大档位4MB
+#define USB_BUFFER_CLASS_COUNT  (USB_BUFFER_MAX_SHIFT-USB_BUFFER_MIN_SHIFT+1)
+
+/* 缓冲池统计 */
+struct UsbBufferPoolStats
+{
+    UsbBufferPoolStats():allocations(0),threadCacheHits(0),sharedHits(0),heapAllocations(0),
+        overflowAllocations(0),inUseBytes(0),peakInUseBytes(0),ownedBytes(0),peakOwnedBytes(0),capacityBytes(0),
+        transferAllocations(0),transferHeapAllocations(0),transfersInUse(0),peakTransfersInUse(0){}
+
+    quint64 allocations;//buffer申请次数
+    quint64 threadCacheHits;//由线程缓存满足的次数
+    quint64 sharedHits;//由共享空闲链表满足的次数
+    quint64 heapAllocations;//新申请的内存块数(预热之后应不再增长)
+    quint64 overflowAllocations;//超出上限或最大档位，直接从堆申请的次数
+    qint64 inUseBytes;//使用中的字节数(按档位计算)
+    qint64 peakInUseBytes;//使用中字节数的高水位
+    qint64 ownedBytes;//缓冲池持有的字节数(使用中+空闲，不包括直接从堆申请的部分)
+    qint64 peakOwnedBytes;//持有字节数的高水位
+    qint64 capacityBytes;//持有字节数的上限
+    quint64 transferAllocations;//libusb_transfer申请次数
+    quint64 transferHeapAllocations;//新申请的libusb_transfer数
+    qint64 transfersInUse;//使用中的libusb_transfer数
+    qint64 peakTransfersInUse;//使用中libusb_transfer数的高水位
+};
+
+class UsbBufferPool
+{
+public:
+    static UsbBufferPool *instance();//进程内共享的缓冲池(不会被释放)
+
+    //设置持有内存的上限(默认64MB)和空闲libusb_transfer的上限(默认1024)，超出部分归还时直接释放
+    void setLimits(qint64 maxBytes,int maxIdleTransfers);
+    //预留count个可容纳size字节的内存块:预先触发缺页，lockPages=true时mlock锁定(仅Linux)，返回实际预留的数量
+    int reserve(int size,int count,bool lockPages = false);
+    void *allocate(int size);//申请至少size字节的buffer(可在任意线程调用，引用计数为1)，失败返回NULL
+    void retain(void *buffer);//增加buffer的引用计数
+    void release(void *buffer);//释放一个引用(可在任意线程调用)，最后一个引用释放时归还，NULL时忽略
+    static bool isShared(const void *buffer);//buffer是否有多个引用
+    static int capacityOf(const void *buffer);//buffer的实际可用长度(所在档位的大小)
+
+    libusb_transfer *allocTransfer();//申请libusb_transfer(不含等时包)，字段已清零
+    void freeTransfer(libusb_transfer *transfer);//归还libusb_transfer(不会释放其buffer)
+
+    UsbBufferPoolStats getStats() const;
+    void trim();//释放共享空闲链表中的内存块和libusb_transfer(线程缓存不受影响)
+
+private:
+    friend struct UsbBufferThreadCache;
+    /* 内存块头部，位于buffer之前 */
+    struct BlockHeader
+    {
+        qint32 sizeClass;//尺寸档位，-1表示直接从堆申请
+        qint32 capacity;//buffer的可用长度
+        std::atomic<int> refCount;//引用计数(使用中有效)
+        BlockHeader *next;//空闲链表中的下一个内存块
+    };
+
+    UsbBufferPool();
+    static int sizeClassOf(int size);//满足size的最小档位，超过最大档位返回-1
+    static BlockHeader *headerOf(const void *buffer);
+    static void *bufferOf(BlockHeader *header);
+    void pushShared(BlockHeader *header);//归还到共享空闲链表(超出上限时释放)
+    void pushSharedTransfer(libusb_transfer *transfer);
+    void addInUse(qint64 bytes);
+
+    QMutex mutex;//保护空闲链表
+    BlockHeader *freeList[USB_BUFFER_CLASS_COUNT];
+    libusb_transfer *freeTransferList;//空闲的libusb_transfer，通过user_data链接
+    int idleTransferCount;
+    int maxIdleTransfers;
+    std::atomic<qint64> capacityBytes;
+
+    std::atomic<quint64> allocations;
+    std::atomic<quint64> threadCacheHits;
+    std::atomic<quint64> sharedHits;
+    std::atomic<quint64> heapAllocations;
+    std::atomic<quint64> overflowAllocations;
+    std::atomic<qint64> inUseBytes;
+    std::atomic<qint64> peakInUseBytes;
+    std::atomic<qint64> ownedBytes;
+    std::atomic<qint64> peakOwnedBytes;
+    std::atomic<quint64> transferAllocations;
+    std::atomic<quint64> transferHeapAllocations;
+    std::atomic<qint64> transfersInUse;
+    std::atomic<qint64> peakTransfersInUse;
+};
+
+/* 池化buffer的共享句柄，复制时只增加引用计数，最后一个句柄释放时buffer归还缓冲池 */
+class UsbPooledBuffer
+{
+public:
+    UsbPooledBuffer():buffer(NULL){}
+    explicit UsbPooledBuffer(int size);//从缓冲池申请，失败时isNull()
+    UsbPooledBuffer(const UsbPooledBuffer &other);
+    ~UsbPooledBuffer();
+    UsbPooledBuffer &operator=(const UsbPooledBuffer &other);
+
+    bool isNull() const{return buffer == NULL;}
+    char *data() const{return buffer;}
+    int capacity() const{return (buffer != NULL)?UsbBufferPool::capacityOf(buffer):0;}
+    bool isShared() const{return buffer != NULL && UsbBufferPool::isShared(buffer);}//是否有其他句柄引用
+    //不拷贝数据的QByteArray(QByteArray::fromRawData())，只在持有该buffer的句柄期间有效，修改时QByteArray自动拷贝
+    QByteArray toByteArray(int length) const;
+
+private:
+    char *buffer;
+};
+
+#endif // USBBUFFERPOOL_H
@@ -0,0 +1,192 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   事件线程的忙轮询低延迟模式
+ */
+#include "usbbusypoll.h"
+
+#define BUSY_POLL_WINDOW_BITS 40 //state低位保存轮询窗口的位数(最大约1100秒)
+#define BUSY_POLL_WINDOW_MASK ((Q_UINT64_C(1)<<BUSY_POLL_WINDOW_BITS)-1)
+#define BUSY_POLL_COUNT_ONE (Q_UINT64_C(1)<<BUSY_POLL_WINDOW_BITS) //挂起传输数加1
+
+static thread_local bool busyPollSpinning = false;//当前线程是否处于忙轮询
+
+/*
+ *@brief:   估算节省的延迟
+ * 没有阻塞等待完成的样本(窗口足够大，从未未命中)或没有忙轮询完成的样本时无法估算，返回0。
+ *@date:    2026.10.18
+ *@return:  qint64:节省的总延迟(ns)，为负表示忙轮询反而更慢
+ */
+qint64 UsbBusyPollStats::savedNs() const
+{
+    if(spinCompletions == 0 || blockCompletions == 0)
+    {
+        return 0;
+    }
+    double blockMean = (double)blockLatencyNs/blockCompletions;
+    double spinMean = (double)spinLatencyNs/spinCompletions;
+    return (qint64)((blockMean-spinMean)*spinCompletions);
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   windowNs:轮询窗口
+ */
+UsbDeviceBusyPoll::UsbDeviceBusyPoll(qint64 windowNs)
+{
+    this->windowNs = windowNs;
+    spinCompletions = 0;
+    spinLatencyNs = 0;
+    blockCompletions = 0;
+    blockLatencyNs = 0;
+}
+/*
+ *@brief:   记录一次传输完成(在事件线程的传输回调中调用)
+ *@date:    2026.10.18
+ *@param:   spinning:是否在忙轮询期间完成
+ *@param:   latencyNs:提交到完成的延迟
+ */
+void UsbDeviceBusyPoll::record(bool spinning, qint64 latencyNs)
+{
+    if(spinning)
+    {
+        spinCompletions.fetch_add(1,std::memory_order_relaxed);
+        spinLatencyNs.fetch_add(latencyNs,std::memory_order_relaxed);
+    }
+    else
+    {
+        blockCompletions.fetch_add(1,std::memory_order_relaxed);
+        blockLatencyNs.fetch_add(latencyNs,std::memory_order_relaxed);
+    }
+}
+/*
+ *@brief:   填充设备部分的统计
+ *@date:    2026.10.18
+ *@param:   stats:统计
+ */
+void UsbDeviceBusyPoll::fillStats(UsbBusyPollStats &stats) const
+{
+    stats.spinCompletions = spinCompletions.load(std::memory_order_relaxed);
+    stats.spinLatencyNs = spinLatencyNs.load(std::memory_order_relaxed);
+    stats.blockCompletions = blockCompletions.load(std::memory_order_relaxed);
+    stats.blockLatencyNs = blockLatencyNs.load(std::memory_order_relaxed);
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ */
+UsbBusyPoll::UsbBusyPoll()
+{
+    state = 0;
+    spinNs = 0;
+    spinCount = 0;
+    hitCount = 0;
+    missCount = 0;
+}
+/*
+ *@brief:   提交需要忙轮询的传输(在提交之前调用，确保事件线程处理完成事件时已经计入)
+ * 挂起传输数加1，轮询窗口取当前值与windowNs中的较大者，一次CAS同时完成。
+ *@date:    2026.10.18
+ *@param:   windowNs:设备的轮询窗口
+ */
+void UsbBusyPoll::begin(qint64 windowNs)
+{
+    quint64 window = qBound(Q_INT64_C(0),windowNs,(qint64)BUSY_POLL_WINDOW_MASK);
+    quint64 oldState = state.load(std::memory_order_relaxed);
+    quint64 newState;
+    do
+    {
+        newState = (oldState & ~BUSY_POLL_WINDOW_MASK)+BUSY_POLL_COUNT_ONE+qMax(oldState & BUSY_POLL_WINDOW_MASK,window);
+    }while(!state.compare_exchange_weak(oldState,newState,std::memory_order_release,std::memory_order_relaxed));
+}
+/*
+ *@brief:   需要忙轮询的传输完成或提交失败
+ * 挂起传输数减1，减到0时轮询窗口清零。传输数不为0时窗口保持本轮的最大值(不随单个传输完成而缩小)，
+ * 窗口较小的设备与窗口较大的设备同时挂起传输时最多多轮询一个较大的窗口。
+ *@date:    2026.10.18
+ */
+void UsbBusyPoll::end()
+{
+    quint64 oldState = state.load(std::memory_order_relaxed);
+    quint64 newState;
+    do
+    {
+        if(oldState < BUSY_POLL_COUNT_ONE)
+        {
+            return;//没有挂起的传输(与begin()不配对)
+        }
+        newState = oldState-BUSY_POLL_COUNT_ONE;
+        if(newState < BUSY_POLL_COUNT_ONE)
+        {
+            newState = 0;
+        }
+    }while(!state.compare_exchange_weak(oldState,newState,std::memory_order_release,std::memory_order_relaxed));
+}
+/*
+ *@brief:   是否有需要忙轮询的传输
+ *@date:    2026.10.18
+ *@return:  bool:true=有
+ */
+bool UsbBusyPoll::isActive() const
+{
+    return state.load(std::memory_order_acquire) >= BUSY_POLL_COUNT_ONE;
+}
+/*
+ *@brief:   获取本轮挂起传输中最大的轮询窗口
+ *@date:    2026.10.18
+ *@return:  qint64:轮询窗口(ns)，没有挂起的传输时为0
+ */
+qint64 UsbBusyPoll::getWindowNs() const
+{
+    return (qint64)(state.load(std::memory_order_relaxed) & BUSY_POLL_WINDOW_MASK);
+}
+/*
+ *@brief:   记录一次忙轮询(事件线程)
+ *@date:    2026.10.18
+ *@param:   spinNs:忙轮询的时长
+ *@param:   hit:true=窗口内传输全部完成  false=超过窗口
+ */
+void UsbBusyPoll::record(qint64 spinNs, bool hit)
+{
+    this->spinNs.fetch_add(spinNs,std::memory_order_relaxed);
+    spinCount.fetch_add(1,std::memory_order_relaxed);
+    (hit?hitCount:missCount).fetch_add(1,std::memory_order_relaxed);
+}
+/*
+ *@brief:   填充事件线程部分的统计
+ *@date:    2026.10.18
+ *@param:   stats:统计
+ */
+void UsbBusyPoll::fillStats(UsbBusyPollStats &stats) const
+{
+    stats.spinNs = spinNs.load(std::memory_order_relaxed);
+    stats.spinCount = spinCount.load(std::memory_order_relaxed);
+    stats.hitCount = hitCount.load(std::memory_order_relaxed);
+    stats.missCount = missCount.load(std::memory_order_relaxed);
+}
+/*
+ *@brief:   当前线程是否处于忙轮询
+ *@date:    2026.10.18
+ *@return:  bool:true=是
+ */
+bool UsbBusyPoll::isSpinning()
+{
+    return busyPollSpinning;
+}
+/*
+ *@brief:   设置当前线程的忙轮询状态(事件线程进入/退出忙轮询时调用)
+ *@date:    2026.10.18
+ *@param:   spinning:true=进入  false=退出
+ */
+void UsbBusyPoll::setSpinning(bool spinning)
+{
+    busyPollSpinning = spinning;
+}
@@ -0,0 +1,90 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   事件线程的忙轮询低延迟模式
+ *
+ *命令/应答类设备(控制器、测量仪器)每次往返只有一两个小包，事件线程阻塞在poll()中等待完成时，
+ *内核唤醒线程的延迟(数十微秒，负载高时更长)在往返时间中占主要部分。启用忙轮询的设备有挂起的传输时，
+ *事件线程以零超时反复处理事件，直到这些传输全部完成(命中)或超过轮询窗口(未命中)；未命中后退回一次
+ *阻塞等待，之后再次进入忙轮询。忙轮询期间事件线程始终占用一个CPU，消耗的CPU时间与节省的延迟
+ *通过UsbComm::getBusyPollStats()按设备查询，以便按设备权衡。
+ */
+#ifndef USBBUSYPOLL_H
+#define USBBUSYPOLL_H
+
+#include <QtGlobal>
+#include <atomic>
+
+/* 忙轮询统计 */
+struct UsbBusyPollStats
+{
+    UsbBusyPollStats():spinNs(0),spinCount(0),hitCount(0),missCount(0),spinCompletions(0),spinLatencyNs(0),
+        blockCompletions(0),blockLatencyNs(0){}
+    qint64 savedNs() const;//估算节省的延迟(阻塞等待与忙轮询的平均延迟之差乘以忙轮询完成的传输数)
+
+    //事件线程(同一后端会话的所有忙轮询设备共用)
+    quint64 spinNs;//忙轮询消耗的CPU时间(忙轮询期间线程始终占用CPU，即忙轮询的总时长)
+    quint64 spinCount;//忙轮询次数
+    quint64 hitCount;//窗口内等到传输完成的次数
+    quint64 missCount;//超过窗口退回阻塞等待的次数
+    //设备
+    quint64 spinCompletions;//在忙轮询期间完成的传输数
+    quint64 spinLatencyNs;//其提交到完成的总延迟
+    quint64 blockCompletions;//在阻塞等待中完成的传输数
+    quint64 blockLatencyNs;//其提交到完成的总延迟
+};
+
+/* 设备的忙轮询配置和完成统计(统计无锁) */
+class UsbDeviceBusyPoll
+{
+public:
+    explicit UsbDeviceBusyPoll(qint64 windowNs);
+
+    qint64 getWindowNs() const{return windowNs;}
+    void setWindowNs(qint64 windowNs){this->windowNs = windowNs;}
+    void record(bool spinning,qint64 latencyNs);//记录一次传输完成(事件线程)
+    void fillStats(UsbBusyPollStats &stats) const;
+
+private:
+    std::atomic<qint64> windowNs;//轮询窗口，0表示不使用忙轮询
+    std::atomic<quint64> spinCompletions;
+    std::atomic<quint64> spinLatencyNs;
+    std::atomic<quint64> blockCompletions;
+    std::atomic<quint64> blockLatencyNs;
+};
+
+/* 事件线程的忙轮询状态，每个libusb会话一个 */
+class UsbBusyPoll
+{
+public:
+    UsbBusyPoll();
+
+    //提交/完成需要忙轮询的传输(可在任意线程调用)，windowNs为设备的轮询窗口
+    void begin(qint64 windowNs);
+    void end();
+    bool isActive() const;//是否有需要忙轮询的传输
+    qint64 getWindowNs() const;//本轮挂起传输中最大的轮询窗口
+
+    void record(qint64 spinNs,bool hit);//记录一次忙轮询(事件线程)
+    void fillStats(UsbBusyPollStats &stats) const;
+
+    static bool isSpinning();//当前线程是否处于忙轮询(在传输回调中区分完成方式)
+    static void setSpinning(bool spinning);
+
+private:
+    //高位为挂起的忙轮询传输数，低位为从上次全部完成以来挂起传输中最大的轮询窗口(ns)，
+    //两者在同一个原子变量中更新，提交/完成只做一次CAS，不加锁
+    std::atomic<quint64> state;
+    std::atomic<quint64> spinNs;
+    std::atomic<quint64> spinCount;
+    std::atomic<quint64> hitCount;
+    std::atomic<quint64> missCount;
+};
+
+#endif // USBBUSYPOLL_H
@@ -1,59 +1,136 @@
 /****************************************************************************
 *
-* Copyright (C) 2021-2025 MiaoQingrui. All rights reserved.
+* Copyright (C) 2021-2026 MiaoQingrui. All rights reserved.
 * Author: 缪庆瑞 <justdoit_mqr@163.com>
 *
 ****************************************************************************/
 /*
  *@author:  缪庆瑞
  *@date:    2021.03.15
- *@update:  2025.06.06
+ *@update:  2026.10.18
  *@brief:   USB应用层通信组件
  */
 #include "usbcomm.h"
+#include "usblibusbbackend.h"
+#include "usbsimbackend.h"
+#include "usbmetrics.h"
+#include "usbtrace.h"
+#include "usbpcapwriter.h"
+#include "usbdevicedatabase.h"
+#include "usbworkerpool.h"
+#include "usbbusypoll.h"
+#include "usbbufferpool.h"
 #include <QDebug>
+#include <QJsonDocument>
+#include <algorithm>
+
+/* 异步传输的上下文，通过libusb_transfer的user_data在回调中传递 */
+struct UsbAsyncTransfer
+{
+    UsbComm *usbComm;//提交传输的实例对象
+    libusb_device_handle *deviceHandle;//设备句柄
+    QByteArray buffer;//传输使用的数据buffer(控制传输包含8字节的setup包)
+    UsbPooledBuffer pooledBuffer;//零拷贝接收时使用的池化buffer(此时不使用buffer)
+    int length;//buffer的完整长度，流式传输重新提交时使用
+    UsbTransferCallback callback;//传输完成的回调
+    UsbStreamCallback streamCallback;//流式传输完成的回调(与callback二选一)
+    UsbDeviceMetrics *metrics;//设备的传输统计对象(同时提供抓包使用的总线号和设备地址)
+    UsbBackend *backend;//设备句柄所属的后端
+    qint64 submitTime;//(重新)提交的时间戳(ns)，用于统计传输延迟
+    int workerIndex;//执行回调的工作线程序号(启用完成工作线程时有效)
+    UsbDeviceBusyPoll *deviceBusyPoll;//设备的忙轮询统计，NULL表示设备没有设置忙轮询
+    UsbBusyPoll *busyPoll;//处理该传输的会话的忙轮询状态，NULL表示该传输不需要忙轮询
+};
 
 /*
- *@brief:   构造函数，负责对libusb进行初始化
+ *@brief:   构造函数，创建基于libusb的传输后端(负责对libusb进行初始化)
  *@date:    2021.03.15
+ *@update:  2026.10.18
  */
 UsbComm::UsbComm(QObject *parent)
     : QObject(parent)
 {
     //成员变量初始化
-    context = NULL;
-    //libusb初始化
-    int err = libusb_init(&context);
-    if(err != LIBUSB_SUCCESS)
-    {
-        qDebug()<<"libusb_init error:"<<libusb_error_name(err);
-    }
-    //设置日志输出等级
-    libusb_set_debug(context,LIBUSB_LOG_LEVEL_WARNING);//旧版本
-    //libusb_set_option(context,LIBUSB_OPTION_LOG_LEVEL,LIBUSB_LOG_LEVEL_WARNING);//新版本
+    backend = new UsbLibusbBackend();
+    ownBackend = true;
+    virtualBackend = NULL;
+    pcapWriter = new UsbPcapWriter(this);
+    workerPool = NULL;
+}
+/*
+ *@brief:   构造函数，使用指定的传输后端
+ * 后端由调用者管理，需在该对象析构之后再释放；多个UsbComm(以及UsbMonitor)可以共用同一个后端。
+ *@date:    2026.10.18
+ *@param:   backend:传输后端，例如UsbSimBackend
+ *@param:   parent:父对象
+ */
+UsbComm::UsbComm(UsbBackend *backend, QObject *parent)
+    : QObject(parent)
+{
+    this->backend = backend;
+    ownBackend = false;
+    virtualBackend = NULL;
+    pcapWriter = new UsbPcapWriter(this);
+    workerPool = NULL;
 }
 /*
- *@brief:   析构函数，负责对libusb进行资源释放
+ *@brief:   析构函数，负责对后端进行资源释放
  *@date:    2021.03.15
+ *@update:  2026.10.18
  */
 UsbComm::~UsbComm()
 {
-    closeAllUsbDevice();//关闭所有打开的设备
-    libusb_exit(context);//libusb退出
+    closeAllUsbDevice();//关闭所有打开的设备(同时会取消挂起的异步传输)
+    delete workerPool;//等待工作线程执行完剩余的任务
+    pcapWriter->close();//将抓包缓冲区中剩余的数据写入文件
+    delete virtualBackend;
+    if(ownBackend)
+    {
+        delete backend;//停止事件线程，libusb退出
+    }
 }
 /*
  *@brief:   探测系统当前接入的usb设备，打印设备详细信息(调试用)
+ * 后端提供sysfs设备数据库时直接打印缓存的设备记录(不访问设备)，否则通过后端枚举。
  *@date:    2021.03.15
+ *@update:  2026.10.18
  */
 void UsbComm::findUsbDevices()
 {
-    libusb_device **devs;
-    ssize_t count = libusb_get_device_list(context,&devs);//获取设备列表
-    for(int i=0;i<count;i++)
+    UsbDeviceDatabase *database = backend->getDeviceDatabase();
+    if(database && database->isAvailable())
+    {
+        qDebug().noquote()<<QJsonDocument(database->toJson()).toJson();
+        return;
+    }
+    QList<UsbDeviceInfo> infoList = backend->getDeviceList();//获取设备列表
+    for(int i=0;i<infoList.size();i++)
+    {
+        backend->printDeviceInfo(infoList.at(i));//打印设备详情
+    }
+}
+/*
+ *@brief:   以JSON导出当前接入的usb设备
+ * 后端提供sysfs设备数据库时包含端口路径、字符串和当前配置的描述符树，否则只包含后端枚举得到的基本信息。
+ *@date:    2026.10.18
+ *@return:  QJsonArray:设备对象数组，格式见UsbDeviceDatabase::recordToJson()
+ */
+QJsonArray UsbComm::getUsbDevicesJson()
+{
+    UsbDeviceDatabase *database = backend->getDeviceDatabase();
+    if(database && database->isAvailable())
     {
-        printDevInfo(devs[i]);//打印设备详情
+        return database->toJson();
     }
-    libusb_free_device_list(devs,1);//释放设备列表(解引用)
+    QJsonArray array;
+    QList<UsbDeviceInfo> infoList = backend->getDeviceList();
+    for(int i=0;i<infoList.size();i++)
+    {
+        UsbDeviceRecord record;
+        record.info = infoList.at(i);
+        array.append(UsbDeviceDatabase::recordToJson(record));
+    }
+    return array;
 }
 
 /*
@@ -79,40 +156,69 @@ bool UsbComm::openUsbDevice(QMultiMap<quint16, quint16> &vpidMap)
 
     closeAllUsbDevice();//先关闭所有已打开的设备
 
-    libusb_device **devs;
-    ssize_t count = libusb_get_device_list(context,&devs);//获取设备列表
-    if(count < 0)
+    //sysfs设备数据库给出匹配设备的总线号和地址，直接打开，省去后端逐个读取设备描述符的完整枚举；
+    //没有匹配的设备时直接返回。后端不支持按地址打开或数据库已过期(设备重新枚举)时回退到完整枚举
+    UsbDeviceDatabase *database = backend->getDeviceDatabase();
+    if(database && database->isAvailable())
     {
-        qDebug()<<"libusb_get_device_list is error";
-        return false;
-    }
-    for(int i=0;i<count;i++)
-    {
-        //设备(device)
-        libusb_device_descriptor deviceDesc;
-        int err = libusb_get_device_descriptor(devs[i], &deviceDesc);
-        if(err != LIBUSB_SUCCESS)
+        QList<UsbDeviceRecord> recordList = database->getDeviceList();
+        bool matched = false;
+        bool fallback = false;
+        for(int i=0;i<recordList.size() && !fallback;i++)
+        {
+            const UsbDeviceInfo &info = recordList.at(i).info;
+            if(!vpidMap.values(info.vendorId).contains(info.productId))
+            {
+                continue;
+            }
+            matched = true;
+            libusb_device_handle *deviceHandle = NULL;
+            int err = backend->openDeviceByAddress(info,&deviceHandle);
+            if(err == LIBUSB_SUCCESS)
+            {
+                addDeviceHandle(deviceHandle,backend,info);
+            }
+            else if(err == LIBUSB_ERROR_NOT_SUPPORTED || err == LIBUSB_ERROR_NO_DEVICE)
+            {
+                fallback = true;
+            }
+            else
+            {
+                qDebug()<<"libusb_open error:"<<libusb_error_name(err);
+            }
+        }
+        if(!matched)
+        {
+            qDebug()<<"no matching device found in sysfs";
+            return false;
+        }
+        if(!fallback)
         {
-            qDebug()<<"libusb_get_device_descriptor error:"<<libusb_error_name(err);
-            continue;
+            return (bool)deviceHandleList.size();
         }
+        closeAllUsbDevice();
+    }
+
+    QList<UsbDeviceInfo> infoList = backend->getDeviceList();//获取设备列表(描述符读取失败的设备不包含在内)
+    for(int i=0;i<infoList.size();i++)
+    {
+        const UsbDeviceInfo &info = infoList.at(i);
         //寻找匹配的vid和pid的设备
-        if(vpidMap.uniqueKeys().contains(deviceDesc.idVendor) &&
-                vpidMap.values(deviceDesc.idVendor).contains(deviceDesc.idProduct))
+        if(vpidMap.uniqueKeys().contains(info.vendorId) &&
+                vpidMap.values(info.vendorId).contains(info.productId))
         {
             libusb_device_handle *deviceHandle = NULL;
-            int err = libusb_open(devs[i], &deviceHandle);
+            int err = backend->openDevice(info,&deviceHandle);
             if (err != LIBUSB_SUCCESS)
             {
                 qDebug()<<"libusb_open error:"<<libusb_error_name(err);
             }
             else
             {
-                deviceHandleList.append(deviceHandle);
+                addDeviceHandle(deviceHandle,backend,info);
             }
         }
     }
-    libusb_free_device_list(devs,1);//释放设备列表(解引用)
 
     return (bool)deviceHandleList.size();
 }
@@ -123,25 +229,75 @@ bool UsbComm::openUsbDevice(QMultiMap<quint16, quint16> &vpidMap)
  */
 void UsbComm::closeUsbDevice(libusb_device_handle *deviceHandle)
 {
+    //禁止再提交新的异步传输，并取消设备挂起的异步传输
+    pendingTransferMutex.lock();
+    transferHandleSet.remove(deviceHandle);
+    pendingTransferMutex.unlock();
+    cancelTransfers(deviceHandle);
     //释放设备声明的所有接口
     releaseUsbInterface(deviceHandle,-1);
     //关闭打开的设备
     if(deviceHandleList.contains(deviceHandle))
     {
-        libusb_close(deviceHandle);
+        handleBackend(deviceHandle)->closeDevice(deviceHandle);
         deviceHandleList.removeAll(deviceHandle);
+        configInfoHash.remove(deviceHandle);
+        removeDeviceMetrics(deviceHandle);
+        pendingTransferMutex.lock();
+        handleBackendHash.remove(deviceHandle);
+        workerIndexHash.remove(deviceHandle);
+        pendingTransferMutex.unlock();
     }
 }
 /*
  *@brief:   关闭所有usb设备
  *@date:    2022.02.22
+ *@update:  2026.10.18
  */
 void UsbComm::closeAllUsbDevice()
 {
-    for(int i=0;i<deviceHandleList.size();i++)
+    //closeUsbDevice()会将句柄从列表中移除，所以每次都关闭列表首个设备，直到列表为空
+    while(!deviceHandleList.isEmpty())
+    {
+        closeUsbDevice(deviceHandleList.first());
+    }
+}
+/*
+ *@brief:   打开虚拟设备
+ * 虚拟设备(例如UsbSimDevice、UsbReplayDevice)在没有硬件的环境中代替真实设备，返回的句柄与真实设备句柄的用法相同，
+ * 所有传输、统计和抓包接口都可以直接使用。设备被插入该对象内部的UsbSimBackend，可以与当前后端的真实设备同时使用；
+ * 如果需要热插拔等完整的模拟，请直接使用UsbSimBackend构造UsbComm和UsbMonitor。
+ * 注1：异步传输的回调在虚拟设备的完成线程中执行，而不是后端的事件线程。
+ * 注2：openUsbDevice()会先关闭所有已打开的设备(包括虚拟设备)，同时使用时需要先打开真实设备；
+ * 设备对象由调用者管理，需在关闭设备之后再释放。
+ *@date:    2026.10.18
+ *@param:   device:虚拟设备
+ *@return:  libusb_device_handle:设备句柄，失败时为NULL
+ */
+libusb_device_handle *UsbComm::openVirtualDevice(UsbVirtualDevice *device)
+{
+    if(device == NULL)
+    {
+        return NULL;
+    }
+    if(virtualBackend == NULL)
+    {
+        virtualBackend = new UsbSimBackend();
+    }
+    virtualBackend->plugDevice(device);
+    libusb_device_handle *deviceHandle = NULL;
+    UsbDeviceInfo info = virtualBackend->getDeviceInfo(reinterpret_cast<libusb_device_handle *>(device));
+    int err = virtualBackend->openDevice(info,&deviceHandle);
+    if(err != LIBUSB_SUCCESS)
+    {
+        qDebug()<<"openVirtualDevice error:"<<libusb_error_name(err);
+        return NULL;
+    }
+    if(!deviceHandleList.contains(deviceHandle))
     {
-        closeUsbDevice(deviceHandleList.at(i));
+        addDeviceHandle(deviceHandle,virtualBackend,info);
     }
+    return deviceHandle;
 }
 /*
  *@brief:   激活usb设备当前配置(通常对于只有一个配置的设备，默认已经激活，无需调用)
@@ -160,12 +316,13 @@ bool UsbComm::setUsbConfig(libusb_device_handle *deviceHandle, int bConfiguratio
      *可以通过libusb_get_configuration()获取当前激活的配置值(默认为1)，如果选择的配置已经激活，那么此调用将
      *会是一个轻量级的操作，用来重置相关usb设备的状态。
      */
-    int err = libusb_set_configuration(deviceHandle,bConfigurationValue);
+    int err = handleBackend(deviceHandle)->setConfiguration(deviceHandle,bConfigurationValue);
     if(err != LIBUSB_SUCCESS)
     {
         qDebug()<<"libusb_set_configuration error:"<<libusb_error_name(err);
         return false;
     }
+    loadConfigInfo(deviceHandle);//配置改变后接口和端点随之改变
     return true;
 }
 /*
@@ -182,20 +339,8 @@ bool UsbComm::claimUsbInterface(libusb_device_handle *deviceHandle, int interfac
     {
         return false;
     }
-    //确保指定接口的内核驱动程序未激活，否则将无法声明该接口
-    if(libusb_kernel_driver_active(deviceHandle, interfaceNumber) == 1)
-    {
-        qDebug()<<"Kernel driver active for interface"<<interfaceNumber;
-        //卸载指定接口的内核驱动
-        int err = libusb_detach_kernel_driver(deviceHandle,interfaceNumber);
-        if(err != LIBUSB_SUCCESS)
-        {
-            qDebug()<<"libusb_detach_kernel_driver error:"<<libusb_error_name(err);
-            return false;
-        }
-    }
-    //声明接口(该接口是一个单纯的逻辑操作,不会通过总线发送任何请求)
-    int err = libusb_claim_interface(deviceHandle, interfaceNumber);
+    //声明接口(后端会先卸载该接口激活的内核驱动，否则将无法声明该接口)
+    int err = handleBackend(deviceHandle)->claimInterface(deviceHandle, interfaceNumber);
     if(err != LIBUSB_SUCCESS)
     {
         qDebug()<<"libusb_claim_interface error:"<<libusb_error_name(err);
@@ -241,11 +386,12 @@ void UsbComm::releaseUsbInterface(libusb_device_handle *deviceHandle,int interfa
     }
 
     QList<int> claimedInterfaceList = handleClaimedInterfacesMap.value(deviceHandle);
+    UsbBackend *deviceBackend = handleBackend(deviceHandle);
     if(interfaceNumber != -1)
     {
         if(claimedInterfaceList.contains(interfaceNumber))
         {
-            libusb_release_interface(deviceHandle,interfaceNumber);
+            deviceBackend->releaseInterface(deviceHandle,interfaceNumber);
             claimedInterfaceList.removeAll(interfaceNumber);
             handleClaimedInterfacesMap.insert(deviceHandle,claimedInterfaceList);
         }
@@ -254,7 +400,7 @@ void UsbComm::releaseUsbInterface(libusb_device_handle *deviceHandle,int interfa
     {
         for(int i=0;i<claimedInterfaceList.size();i++)
         {
-            libusb_release_interface(deviceHandle,claimedInterfaceList.at(i));
+            deviceBackend->releaseInterface(deviceHandle,claimedInterfaceList.at(i));
         }
         handleClaimedInterfacesMap.remove(deviceHandle);
     }
@@ -282,15 +428,88 @@ bool UsbComm::setUsbInterfaceAltSetting(libusb_device_handle *deviceHandle, int
         return false;
     }
     //激活接口的备用设置(该函数是阻塞的)
-    int err = libusb_set_interface_alt_setting(deviceHandle, interfaceNumber,bAlternateSetting);
+    int err = handleBackend(deviceHandle)->setInterfaceAltSetting(deviceHandle, interfaceNumber,bAlternateSetting);
     if(err != LIBUSB_SUCCESS)
     {
         qDebug()<<"libusb_set_interface_alt_setting error:"<<libusb_error_name(err);
         return false;
     }
+    //更新描述符缓存，之后的端点查询对应新的备用设置
+    QHash<libusb_device_handle *,UsbConfigInfo>::iterator it = configInfoHash.find(deviceHandle);
+    if(it != configInfoHash.end())
+    {
+        it.value().setAltSetting(interfaceNumber,bAlternateSetting);
+    }
 
     return true;
 }
+/*
+ *@brief:   按需要的数据率自动选择并激活接口的备用设置
+ * 等时和高带宽中断接口通常提供多个备用设置，带宽越大的备用设置占用越多的周期总线时间，同一总线上的多个设备都选择
+ * 最大带宽时主机控制器会拒绝后激活的设备。该函数根据缓存的描述符计算每个备用设置保留的带宽，按以下顺序尝试激活:
+ * 1.满足需求的备用设置，带宽从小到大；
+ * 2.主机控制器都拒绝时(总线带宽不足)，降级尝试不满足需求的备用设置，带宽从大到小(最后通常是不占用带宽的备用设置0)。
+ * 通过selectedBytesPerSecond可以判断是否发生了降级，使用者据此降低采样率/分辨率等。该函数调用之前需要先声明接口。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@param:   bytesPerSecond:需要的数据率(字节/秒)，0表示释放带宽
+ *@param:   selectedBytesPerSecond:返回激活的备用设置保留的带宽，可以为NULL
+ *@return:  int:激活的备用设置号，-1表示失败
+ */
+int UsbComm::selectUsbInterfaceAltSetting(libusb_device_handle *deviceHandle, int interfaceNumber,
+                                          qint64 bytesPerSecond, qint64 *selectedBytesPerSecond)
+{
+    const UsbInterfaceInfo *interfaceInfo = NULL;
+    QHash<libusb_device_handle *,UsbConfigInfo>::const_iterator it = configInfoHash.constFind(deviceHandle);
+    if(it != configInfoHash.constEnd())
+    {
+        interfaceInfo = it.value().interfaceInfo(interfaceNumber);
+    }
+    if(interfaceInfo == NULL)
+    {
+        qDebug()<<"selectUsbInterfaceAltSetting error: interface not found"<<interfaceNumber;
+        return -1;
+    }
+
+    //<带宽,备用设置号>，激活备用设置会更新缓存，所以先复制出候选列表
+    int speed = getDeviceInfo(deviceHandle).speed;
+    QList<QPair<qint64,int> > enoughList;
+    QList<QPair<qint64,int> > degradedList;
+    for(int i=0;i<interfaceInfo->altSettingList.size();i++)
+    {
+        const UsbAltSettingInfo &altSetting = interfaceInfo->altSettingList.at(i);
+        QPair<qint64,int> candidate(altSetting.bytesPerSecond(speed),altSetting.alternateSetting);
+        if(candidate.first >= bytesPerSecond)
+        {
+            enoughList.append(candidate);
+        }
+        else
+        {
+            degradedList.append(candidate);
+        }
+    }
+    std::sort(enoughList.begin(),enoughList.end());
+    std::sort(degradedList.begin(),degradedList.end(),std::greater<QPair<qint64,int> >());
+
+    QList<QPair<qint64,int> > candidateList = enoughList+degradedList;
+    for(int i=0;i<candidateList.size();i++)
+    {
+        if(setUsbInterfaceAltSetting(deviceHandle,interfaceNumber,candidateList.at(i).second))
+        {
+            if(candidateList.at(i).first < bytesPerSecond)
+            {
+                qDebug()<<"selectUsbInterfaceAltSetting degraded:"<<candidateList.at(i).first<<"<"<<bytesPerSecond;
+            }
+            if(selectedBytesPerSecond != NULL)
+            {
+                *selectedBytesPerSecond = candidateList.at(i).first;
+            }
+            return candidateList.at(i).second;
+        }
+    }
+    return -1;
+}
 /*
  *@brief:   重置usb设备(重置一般会清空当前缓冲区的数据)
  * 重新初始化设备，重置完成后，系统将尝试恢复之前的配置和备用设置。
@@ -308,20 +527,55 @@ bool UsbComm::resetUsbDevice(libusb_device_handle *deviceHandle)
         return false;
     }
     //重置设备
-    int err = libusb_reset_device(deviceHandle);
+    UsbBackend *deviceBackend = handleBackend(deviceHandle);
+    int err = deviceBackend->resetDevice(deviceHandle);
     if(err != LIBUSB_SUCCESS)
     {
         qDebug()<<"libusb_reset_device error:"<<libusb_error_name(err);
         if(err == LIBUSB_ERROR_NOT_FOUND)//句柄已经无效
         {
-            libusb_close(deviceHandle);
+            pendingTransferMutex.lock();
+            transferHandleSet.remove(deviceHandle);
+            pendingTransferMutex.unlock();
+            cancelTransfers(deviceHandle);
+            deviceBackend->closeDevice(deviceHandle);
             deviceHandleList.removeAll(deviceHandle);
+            handleClaimedInterfacesMap.remove(deviceHandle);//设备已不存在，无需释放接口
+            configInfoHash.remove(deviceHandle);
+            removeDeviceMetrics(deviceHandle);
+            pendingTransferMutex.lock();
+            handleBackendHash.remove(deviceHandle);
+            workerIndexHash.remove(deviceHandle);
+            pendingTransferMutex.unlock();
         }
         return false;
     }
 
     return true;
 }
+/*
+ *@brief:   清除端点的halt/stall状态
+ * 端点STALL之后，在清除之前该端点上的所有传输都会失败。同步的bulkTransfer()内部已自动处理，
+ * 异步传输的回调中不能调用阻塞方法，需要回到调用线程后再调用该函数。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbComm::clearUsbHalt(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    if(!deviceHandleList.contains(deviceHandle))
+    {
+        return false;
+    }
+    int err = handleBackend(deviceHandle)->clearHalt(deviceHandle,endpoint);
+    if(err != LIBUSB_SUCCESS)
+    {
+        qDebug()<<"libusb_clear_halt error:"<<libusb_error_name(err);
+        return false;
+    }
+    return true;
+}
 /*
  *@brief:   (批量(块)传输)
  *@date:    2022.02.22
@@ -340,9 +594,34 @@ int UsbComm::bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint,
         return -100;
     }
     int actual_length=0;
+    //metricsHash和handleBackendHash只在当前线程修改，这里读取无需加锁
+    UsbDeviceMetrics *metrics = metricsHash.value(deviceHandle);
+    UsbBackend *deviceBackend = handleBackend(deviceHandle);
+    //设置了忙轮询的设备在传输期间让事件线程忙轮询(同步传输的完成同样由事件线程处理)
+    UsbDeviceBusyPoll *deviceBusyPoll = busyPollHash.value(deviceHandle);
+    qint64 busyPollWindowNs = (deviceBusyPoll != NULL)?deviceBusyPoll->getWindowNs():0;
+    UsbBusyPoll *busyPoll = (busyPollWindowNs > 0)?deviceBackend->getBusyPoll(deviceHandle):NULL;
+    if(busyPoll != NULL)
+    {
+        busyPoll->begin(busyPollWindowNs);
+    }
+    qint64 startTime = UsbMetrics::nowNs();
+    USB_TRACE(SyncBegin,deviceHandle,endpoint,length,0);
+    //同步传输没有URB指针，使用局部变量的地址作为抓包标识(传输期间唯一)
+    pcapWriter->captureSync(metrics->getBusNumber(),metrics->getDeviceAddress(),(quint64)(quintptr)&actual_length,
+                            false,endpoint,data,length,0);
     //该函数是阻塞的，只有数据传输完成或者超时才会返回
-    int err = libusb_bulk_transfer(deviceHandle,endpoint,
-                                   data,length,&actual_length,timeout);
+    int err = deviceBackend->syncTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,endpoint,data,length,
+                                          &actual_length,timeout);
+    USB_TRACE(SyncEnd,deviceHandle,endpoint,actual_length,err);
+    if(busyPoll != NULL)
+    {
+        busyPoll->end();
+    }
+    pcapWriter->captureSync(metrics->getBusNumber(),metrics->getDeviceAddress(),(quint64)(quintptr)&actual_length,
+                            true,endpoint,data,actual_length,err);
+    metrics->record(endpoint,UsbMetrics::statusFromError(err),length,actual_length,
+                    UsbMetrics::nowNs()-startTime);
     if(err == LIBUSB_SUCCESS || err == LIBUSB_ERROR_TIMEOUT)
     {
         return actual_length;
@@ -351,12 +630,713 @@ int UsbComm::bulkTransfer(libusb_device_handle *deviceHandle, quint8 endpoint,
     {
         if(err == LIBUSB_ERROR_PIPE)
         {
-            libusb_clear_halt(deviceHandle,endpoint);
+            deviceBackend->clearHalt(deviceHandle,endpoint);
         }
         qDebug()<<"libusb_bulk_transfer error:"<<libusb_error_name(err);
         return err;
     }
 }
+/*
+ *@brief:   异步批量传输(OUT)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点(OUT方向)
+ *@param:   data:待发送的数据
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  QFuture<UsbTransferResult>:传输结果，传输完成后可用
+ */
+QFuture<UsbTransferResult> UsbComm::bulkTransferAsync(libusb_device_handle *deviceHandle, quint8 endpoint,
+                                                      const QByteArray &data, quint32 timeout)
+{
+    return transferAsync(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,endpoint,data,data.size(),timeout);
+}
+/*
+ *@brief:   异步批量传输(IN)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点(IN方向)
+ *@param:   length:期望接收的最大长度
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  QFuture<UsbTransferResult>:传输结果，接收到的数据存放在UsbTransferResult::data中
+ */
+QFuture<UsbTransferResult> UsbComm::bulkTransferAsync(libusb_device_handle *deviceHandle, quint8 endpoint,
+                                                      int length, quint32 timeout)
+{
+    return transferAsync(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,endpoint,QByteArray(),length,timeout);
+}
+/*
+ *@brief:   异步中断传输(OUT)
+ *@date:    2026.10.18
+ *@param:   参数同bulkTransferAsync()
+ *@return:  QFuture<UsbTransferResult>:传输结果
+ */
+QFuture<UsbTransferResult> UsbComm::interruptTransferAsync(libusb_device_handle *deviceHandle, quint8 endpoint,
+                                                           const QByteArray &data, quint32 timeout)
+{
+    return transferAsync(deviceHandle,LIBUSB_TRANSFER_TYPE_INTERRUPT,endpoint,data,data.size(),timeout);
+}
+/*
+ *@brief:   异步中断传输(IN)
+ *@date:    2026.10.18
+ *@param:   参数同bulkTransferAsync()
+ *@return:  QFuture<UsbTransferResult>:传输结果
+ */
+QFuture<UsbTransferResult> UsbComm::interruptTransferAsync(libusb_device_handle *deviceHandle, quint8 endpoint,
+                                                           int length, quint32 timeout)
+{
+    return transferAsync(deviceHandle,LIBUSB_TRANSFER_TYPE_INTERRUPT,endpoint,QByteArray(),length,timeout);
+}
+/*
+ *@brief:   异步控制传输
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   requestType:请求类型(bmRequestType)，bit7表示数据阶段的方向
+ *@param:   request:请求(bRequest)
+ *@param:   value:请求值(wValue)
+ *@param:   index:索引(wIndex)
+ *@param:   data:OUT方向时数据阶段待发送的数据，IN方向忽略
+ *@param:   length:IN方向时期望接收的最大长度(wLength)，OUT方向忽略
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  QFuture<UsbTransferResult>:传输结果
+ */
+QFuture<UsbTransferResult> UsbComm::controlTransferAsync(libusb_device_handle *deviceHandle, quint8 requestType,
+                                                         quint8 request, quint16 value, quint16 index,
+                                                         const QByteArray &data, quint16 length, quint32 timeout)
+{
+    //控制传输的buffer由8字节setup包和数据阶段组成
+    quint16 wLength = (requestType & LIBUSB_ENDPOINT_IN)?length:(quint16)data.size();
+    QByteArray buffer(LIBUSB_CONTROL_SETUP_SIZE+wLength,0);
+    libusb_fill_control_setup((unsigned char *)buffer.data(),requestType,request,value,index,wLength);
+    if(!(requestType & LIBUSB_ENDPOINT_IN))
+    {
+        memcpy(buffer.data()+LIBUSB_CONTROL_SETUP_SIZE,data.constData(),wLength);
+    }
+    return transferAsync(deviceHandle,LIBUSB_TRANSFER_TYPE_CONTROL,0,buffer,buffer.size(),timeout);
+}
+/*
+ *@brief:   提交异步传输
+ * 该函数只负责提交传输，不会阻塞，传输完成(包括成功、超时、出错、取消)后会在后端的事件线程中
+ * 调用callback，所以callback内只做最小处理，不要调用阻塞的同步传输方法。事件线程由后端在首次提交传输时自动启动。
+ * 注:可以在任意线程调用，包括在传输回调中提交下一个传输(例如发送队列)。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   transferType:传输类型，目前支持LIBUSB_TRANSFER_TYPE_BULK/INTERRUPT/CONTROL
+ *@param:   endpoint:端点，控制传输忽略
+ *@param:   data:OUT方向待发送的数据；控制传输时为8字节setup包+数据阶段的完整buffer
+ *@param:   length:IN方向期望接收的最大长度；控制传输时为完整buffer的长度
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@param:   callback:传输完成的回调
+ *@return:  bool:true=提交成功  false=提交失败(此时callback不会被调用)
+ */
+bool UsbComm::submitTransfer(libusb_device_handle *deviceHandle, quint8 transferType, quint8 endpoint,
+                             const QByteArray &data, int length, quint32 timeout, UsbTransferCallback callback)
+{
+    return submitTransferInternal(deviceHandle,transferType,endpoint,data,length,timeout,
+                                  callback,UsbStreamCallback());
+}
+/*
+ *@brief:   提交流式传输
+ * 与submitTransfer()不同，传输完成后如果callback返回true，会在事件线程中使用同一个libusb_transfer和buffer
+ * 直接重新提交，不经过调用线程，从而保证IN端点上始终有挂起的传输，不会因为调用线程繁忙而丢失总线带宽。
+ * 状态为LIBUSB_TRANSFER_CANCELLED/NO_DEVICE的传输不会被重新提交；如果重新提交失败，callback会再被调用
+ * 一次，状态为LIBUSB_TRANSFER_ERROR，此时返回值被忽略。
+ * 注:callback中传入的result.data与传输buffer共享内存，如果需要保留数据请在回调内拷贝，否则重新提交时
+ * 会因为buffer被共享而重新申请内存。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   transferType:传输类型，LIBUSB_TRANSFER_TYPE_BULK/INTERRUPT
+ *@param:   endpoint:端点(IN方向)
+ *@param:   length:每次传输期望接收的最大长度
+ *@param:   timeout:超时时间，单位ms， 0 无限制。超时后同样会调用callback(可能带有部分数据)
+ *@param:   callback:传输完成的回调
+ *@return:  bool:true=提交成功  false=提交失败(此时callback不会被调用)
+ */
+bool UsbComm::submitStreamTransfer(libusb_device_handle *deviceHandle, quint8 transferType, quint8 endpoint,
+                                   int length, quint32 timeout, UsbStreamCallback callback)
+{
+    if(!(endpoint & LIBUSB_ENDPOINT_IN) || transferType == LIBUSB_TRANSFER_TYPE_CONTROL || !callback)
+    {
+        return false;
+    }
+    return submitTransferInternal(deviceHandle,transferType,endpoint,QByteArray(),length,timeout,
+                                  UsbTransferCallback(),callback);
+}
+/*
+ *@brief:   提交异步传输的内部实现
+ *@date:    2026.10.18
+ *@param:   callback/streamCallback:普通传输和流式传输的回调，二选一
+ *@param:   其余参数同submitTransfer()
+ *@return:  bool:true=提交成功  false=提交失败
+ */
+bool UsbComm::submitTransferInternal(libusb_device_handle *deviceHandle, quint8 transferType, quint8 endpoint,
+                                     const QByteArray &data, int length, quint32 timeout,
+                                     UsbTransferCallback callback, UsbStreamCallback streamCallback)
+{
+    //libusb_transfer从缓冲池申请，完成后归还复用
+    UsbBufferPool *bufferPool = UsbBufferPool::instance();
+    libusb_transfer *transfer = bufferPool->allocTransfer();
+    if(transfer == NULL)
+    {
+        qDebug()<<"libusb_alloc_transfer error";
+        return false;
+    }
+    UsbAsyncTransfer *asyncTransfer = new UsbAsyncTransfer;
+    asyncTransfer->usbComm = this;
+    asyncTransfer->deviceHandle = deviceHandle;
+    asyncTransfer->callback = callback;
+    asyncTransfer->streamCallback = streamCallback;
+    //加锁提交，确保回调中移除挂起记录时该传输已经被记录(零拷贝接收的设置同样在锁内读取)
+    QMutexLocker locker(&pendingTransferMutex);
+    if(!transferHandleSet.contains(deviceHandle))//设备未打开或正在关闭
+    {
+        delete asyncTransfer;
+        bufferPool->freeTransfer(transfer);
+        return false;
+    }
+    //OUT方向直接共享外部数据(libusb不会修改发送buffer)，IN方向申请接收空间
+    bool isIn = (transferType == LIBUSB_TRANSFER_TYPE_CONTROL)?
+                (data.size() >= (int)LIBUSB_CONTROL_SETUP_SIZE && (data.at(0) & LIBUSB_ENDPOINT_IN)):
+                (endpoint & LIBUSB_ENDPOINT_IN);
+    unsigned char *buffer = NULL;
+    if(isIn && transferType != LIBUSB_TRANSFER_TYPE_CONTROL && zeroCopyHandleSet.contains(deviceHandle))
+    {
+        asyncTransfer->pooledBuffer = UsbPooledBuffer(length);
+        if(asyncTransfer->pooledBuffer.isNull())
+        {
+            delete asyncTransfer;
+            bufferPool->freeTransfer(transfer);
+            return false;
+        }
+        asyncTransfer->length = length;
+        buffer = (unsigned char *)asyncTransfer->pooledBuffer.data();
+    }
+    else
+    {
+        if(isIn && transferType != LIBUSB_TRANSFER_TYPE_CONTROL)
+        {
+            asyncTransfer->buffer.resize(length);
+        }
+        else
+        {
+            asyncTransfer->buffer = data;
+            if(isIn)//控制传输IN方向会将数据写入buffer，需要先分离出独立的数据
+            {
+                asyncTransfer->buffer.detach();
+            }
+        }
+        asyncTransfer->length = asyncTransfer->buffer.size();
+        buffer = (unsigned char *)asyncTransfer->buffer.constData();
+    }
+    switch(transferType)
+    {
+    case LIBUSB_TRANSFER_TYPE_BULK:
+        libusb_fill_bulk_transfer(transfer,deviceHandle,endpoint,buffer,asyncTransfer->length,
+                                  transferCallback,asyncTransfer,timeout);
+        break;
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        libusb_fill_interrupt_transfer(transfer,deviceHandle,endpoint,buffer,asyncTransfer->length,
+                                       transferCallback,asyncTransfer,timeout);
+        break;
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+        if(asyncTransfer->length < (int)LIBUSB_CONTROL_SETUP_SIZE)
+        {
+            delete asyncTransfer;
+            bufferPool->freeTransfer(transfer);
+            return false;
+        }
+        libusb_fill_control_transfer(transfer,deviceHandle,buffer,transferCallback,asyncTransfer,timeout);
+        break;
+    default:
+        qDebug()<<"submitTransfer unsupported transfer type:"<<transferType;
+        delete asyncTransfer;
+        bufferPool->freeTransfer(transfer);
+        return false;
+    }
+    UsbDeviceMetrics *metrics = metricsHash.value(deviceHandle);
+    asyncTransfer->metrics = metrics;
+    asyncTransfer->backend = handleBackend(deviceHandle);
+    asyncTransfer->workerIndex = workerIndexHash.value(deviceHandle);
+    asyncTransfer->deviceBusyPoll = busyPollHash.value(deviceHandle);
+    qint64 busyPollWindowNs = (asyncTransfer->deviceBusyPoll != NULL)?
+                asyncTransfer->deviceBusyPoll->getWindowNs():0;
+    asyncTransfer->busyPoll = (busyPollWindowNs > 0)?
+                asyncTransfer->backend->getBusyPoll(deviceHandle):NULL;
+    if(asyncTransfer->busyPoll != NULL)//提交之前计入，确保事件线程处理其完成事件时处于忙轮询
+    {
+        asyncTransfer->busyPoll->begin(busyPollWindowNs);
+    }
+    asyncTransfer->submitTime = UsbMetrics::nowNs();
+    USB_TRACE(Submit,transfer,endpoint,transfer->length,0);
+    pcapWriter->captureTransfer(transfer,metrics->getBusNumber(),metrics->getDeviceAddress(),'S');
+    int err = asyncTransfer->backend->submitTransfer(transfer);
+    if(err != LIBUSB_SUCCESS)
+    {
+        qDebug()<<"libusb_submit_transfer error:"<<libusb_error_name(err);
+        if(asyncTransfer->busyPoll != NULL)
+        {
+            asyncTransfer->busyPoll->end();
+        }
+        pcapWriter->captureTransfer(transfer,metrics->getBusNumber(),metrics->getDeviceAddress(),'E',err);
+        delete asyncTransfer;
+        bufferPool->freeTransfer(transfer);
+        return false;
+    }
+    pendingTransferHash.insert(deviceHandle,transfer);
+    return true;
+}
+/*
+ *@brief:   取消设备挂起的异步传输，并等待其回调结束
+ * 注:不能在异步传输的回调中调用该函数。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点，-1表示取消设备所有端点的传输
+ */
+void UsbComm::cancelTransfers(libusb_device_handle *deviceHandle, int endpoint)
+{
+    QMutexLocker locker(&pendingTransferMutex);
+    UsbBackend *deviceBackend = handleBackend(deviceHandle);
+    //等待取消的传输在事件线程中回调结束(超时保护，避免事件线程异常退出时卡死)
+    while(hasPendingTransfer(deviceHandle,endpoint))
+    {
+        /*每次唤醒后都重新取消一遍，因为流式传输可能在取消之前刚好完成并被重新提交，
+         *对已经取消的传输再次取消会返回LIBUSB_ERROR_NOT_FOUND，不影响*/
+        QList<libusb_transfer *> transferList = pendingTransferHash.values(deviceHandle);
+        for(int i=0;i<transferList.size();i++)
+        {
+            if(endpoint == -1 || transferList.at(i)->endpoint == endpoint)
+            {
+                int err = deviceBackend->cancelTransfer(transferList.at(i));
+                USB_TRACE(Cancel,transferList.at(i),transferList.at(i)->endpoint,0,err);
+                Q_UNUSED(err)
+            }
+        }
+        if(!pendingTransferCond.wait(&pendingTransferMutex,1000))
+        {
+            qDebug()<<"cancelTransfers wait timeout";
+            break;
+        }
+    }
+}
+/*
+ *@brief:   设置完成回调的工作线程数
+ * 默认所有设备的回调都在后端的事件线程中串行执行；启用之后每个设备固定分配到一个工作线程，
+ * 同一设备的回调按完成顺序执行，不同设备的回调并行执行，适用于同时连接多个高速设备的场景。
+ * 工作线程中执行的回调不能调用cancelTransfers()/closeUsbDevice()(与事件线程的限制相同)。
+ *@date:    2026.10.18
+ *@param:   count:工作线程数，0=在事件线程中执行回调，-1=按CPU核数创建
+ *@param:   config:工作线程的实时配置，config.cpu>=0时工作线程依次绑定到config.cpu开始的各个核
+ *@return:  bool:true=成功  false=有挂起的传输
+ */
+bool UsbComm::setCompletionWorkerCount(int count, const UsbThreadConfig &config)
+{
+    QMutexLocker locker(&pendingTransferMutex);
+    if(!pendingTransferHash.isEmpty())
+    {
+        qDebug()<<"setCompletionWorkerCount: there are pending transfers";
+        return false;
+    }
+    UsbWorkerPool *oldPool = workerPool;
+    workerPool = (count == 0)?NULL:new UsbWorkerPool(qMax(count,0),config);
+    workerIndexHash.clear();
+    if(workerPool != NULL)
+    {
+        for(int i=0;i<deviceHandleList.size();i++)
+        {
+            workerIndexHash.insert(deviceHandleList.at(i),workerPool->nextWorkerIndex());
+        }
+    }
+    locker.unlock();
+    delete oldPool;//等待最后一个回调执行完成(移除挂起记录之后仍会释放传输)
+    return true;
+}
+/*
+ *@brief:   获取完成回调的工作线程数
+ *@date:    2026.10.18
+ *@return:  int:工作线程数，0表示在事件线程中执行回调
+ */
+int UsbComm::getCompletionWorkerCount() const
+{
+    return (workerPool != NULL)?workerPool->getWorkerCount():0;
+}
+/*
+ *@brief:   设置设备的忙轮询窗口
+ * 设备有挂起的传输(包括同步传输)时，后端的事件线程以零超时反复处理事件，直到传输全部完成或超过窗口，
+ * 省去阻塞等待时内核唤醒线程的延迟；未命中时退回一次阻塞等待。忙轮询期间事件线程占满一个CPU，
+ * 适用于每次只有少量小包往返的命令/应答类设备，流式传输的设备不建议启用(端点上始终有挂起的传输)。
+ * 修改只对之后提交的传输生效。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   windowUs:轮询窗口(us)，一般取设备正常应答时间的1~2倍，0表示关闭(保留已有统计)
+ *@return:  bool:true=成功  false=设备未打开或后端不支持忙轮询
+ */
+bool UsbComm::setBusyPoll(libusb_device_handle *deviceHandle, quint32 windowUs)
+{
+    if(!deviceHandleList.contains(deviceHandle))
+    {
+        return false;
+    }
+    if(handleBackend(deviceHandle)->getBusyPoll(deviceHandle) == NULL)
+    {
+        qDebug()<<"setBusyPoll: backend does not support busy poll";
+        return false;
+    }
+    QMutexLocker locker(&pendingTransferMutex);
+    UsbDeviceBusyPoll *deviceBusyPoll = busyPollHash.value(deviceHandle);
+    if(deviceBusyPoll == NULL)
+    {
+        busyPollHash.insert(deviceHandle,new UsbDeviceBusyPoll((qint64)windowUs*1000));
+    }
+    else
+    {
+        deviceBusyPoll->setWindowNs((qint64)windowUs*1000);
+    }
+    return true;
+}
+/*
+ *@brief:   获取设备的忙轮询统计
+ * 忙轮询消耗的CPU时间和命中次数属于处理该设备的事件线程(同一会话的忙轮询设备共用)，完成延迟只统计
+ * 该设备的异步传输:忙轮询期间完成的与阻塞等待中完成的(未命中或关闭忙轮询之后)分别累计，
+ * 两者的平均延迟之差即忙轮询节省的延迟(savedNs())。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbBusyPollStats:统计，设备从未设置忙轮询时全部为0
+ */
+UsbBusyPollStats UsbComm::getBusyPollStats(libusb_device_handle *deviceHandle)
+{
+    UsbBusyPollStats stats;
+    QMutexLocker locker(&pendingTransferMutex);
+    UsbDeviceBusyPoll *deviceBusyPoll = busyPollHash.value(deviceHandle);
+    if(deviceBusyPoll == NULL)
+    {
+        return stats;
+    }
+    deviceBusyPoll->fillStats(stats);
+    UsbBusyPoll *busyPoll = handleBackend(deviceHandle)->getBusyPoll(deviceHandle);
+    if(busyPoll != NULL)
+    {
+        busyPoll->fillStats(stats);
+    }
+    return stats;
+}
+/*
+ *@brief:   设置设备的零拷贝接收
+ * 启用后该设备之后提交的IN方向批量/中断传输(包括流式传输)使用UsbBufferPool的池化buffer，result.data通过
+ * QByteArray::fromRawData()直接引用该buffer，不拷贝数据；result.buffer持有buffer的引用，最后一个引用释放时
+ * buffer归还缓冲池。流式传输重新提交时，如果使用者仍持有上次的结果，则换用新的池化buffer。
+ * 注:result.data本身不持有buffer，在回调之外(例如跨线程排队)使用数据时需要同时保留result或result.buffer，
+ * 只转发result.data的使用者不要启用，或者自行拷贝。控制传输不受影响。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   enable:true=启用  false=关闭
+ *@return:  bool:true=成功  false=设备未打开
+ */
+bool UsbComm::setZeroCopyReceive(libusb_device_handle *deviceHandle, bool enable)
+{
+    if(!deviceHandleList.contains(deviceHandle))
+    {
+        return false;
+    }
+    QMutexLocker locker(&pendingTransferMutex);
+    if(enable)
+    {
+        zeroCopyHandleSet.insert(deviceHandle);
+    }
+    else
+    {
+        zeroCopyHandleSet.remove(deviceHandle);
+    }
+    return true;
+}
+/*
+ *@brief:   判断设备是否有挂起的异步传输(调用前需对pendingTransferMutex加锁)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点，-1表示任意端点
+ *@return:  bool:true=有  false=没有
+ */
+bool UsbComm::hasPendingTransfer(libusb_device_handle *deviceHandle, int endpoint)
+{
+    QList<libusb_transfer *> transferList = pendingTransferHash.values(deviceHandle);
+    for(int i=0;i<transferList.size();i++)
+    {
+        if(endpoint == -1 || transferList.at(i)->endpoint == endpoint)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+/*
+ *@brief:   获取所有打开设备的传输统计快照
+ *@date:    2026.10.18
+ *@return:  QList<UsbDeviceMetricsSnapshot>:快照列表
+ */
+QList<UsbDeviceMetricsSnapshot> UsbComm::getMetricsSnapshot()
+{
+    QList<UsbDeviceMetricsSnapshot> snapshotList;
+    QMutexLocker locker(&pendingTransferMutex);
+    QHash<libusb_device_handle *,UsbDeviceMetrics *>::const_iterator it = metricsHash.constBegin();
+    for(;it != metricsHash.constEnd();++it)
+    {
+        snapshotList.append(it.value()->snapshot());
+    }
+    return snapshotList;
+}
+/*
+ *@brief:   获取指定设备的传输统计快照
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbDeviceMetricsSnapshot:快照，设备未打开时为空
+ */
+UsbDeviceMetricsSnapshot UsbComm::getMetricsSnapshot(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&pendingTransferMutex);
+    UsbDeviceMetrics *metrics = metricsHash.value(deviceHandle);
+    if(metrics == NULL)
+    {
+        return UsbDeviceMetricsSnapshot();
+    }
+    return metrics->snapshot();
+}
+/*
+ *@brief:   获取Prometheus文本格式的传输统计，可直接作为/metrics接口的应答内容
+ *@date:    2026.10.18
+ *@return:  QByteArray:Prometheus文本
+ */
+QByteArray UsbComm::getMetricsPrometheusText()
+{
+    return UsbMetrics::toPrometheusText(getMetricsSnapshot());
+}
+/*
+ *@brief:   清零所有设备的传输统计
+ *@date:    2026.10.18
+ */
+void UsbComm::resetMetrics()
+{
+    QMutexLocker locker(&pendingTransferMutex);
+    QHash<libusb_device_handle *,UsbDeviceMetrics *>::const_iterator it = metricsHash.constBegin();
+    for(;it != metricsHash.constEnd();++it)
+    {
+        it.value()->reset();
+    }
+}
+/*
+ *@brief:   开始抓包
+ * 按usbmon格式(LINKTYPE_USB_LINUX_MMAPPED)记录之后经过该对象的所有同步/异步传输，数据由独立线程批量写入文件。
+ *@date:    2026.10.18
+ *@param:   fileName:pcap文件路径
+ *@param:   snapLength:每个包最多保存的数据长度
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbComm::startCapture(const QString &fileName, int snapLength)
+{
+    return pcapWriter->open(fileName,snapLength);
+}
+/*
+ *@brief:   停止抓包
+ *@date:    2026.10.18
+ */
+void UsbComm::stopCapture()
+{
+    pcapWriter->close();
+}
+/*
+ *@brief:   是否正在抓包
+ *@date:    2026.10.18
+ *@return:  bool:true=是  false=否
+ */
+bool UsbComm::isCapturing() const
+{
+    return pcapWriter->isCapturing();
+}
+/*
+ *@brief:   释放设备的传输统计对象(设备挂起的传输需已全部结束)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ */
+void UsbComm::removeDeviceMetrics(libusb_device_handle *deviceHandle)
+{
+    pendingTransferMutex.lock();
+    UsbDeviceMetrics *metrics = metricsHash.take(deviceHandle);
+    UsbDeviceBusyPoll *deviceBusyPoll = busyPollHash.take(deviceHandle);
+    zeroCopyHandleSet.remove(deviceHandle);
+    pendingTransferMutex.unlock();
+    delete metrics;
+    delete deviceBusyPoll;
+}
+/*
+ *@brief:   异步传输的QFuture封装
+ *@date:    2026.10.18
+ *@param:   参数同submitTransfer()
+ *@return:  QFuture<UsbTransferResult>:传输结果，提交失败时返回已完成且status为LIBUSB_TRANSFER_ERROR的结果
+ */
+QFuture<UsbTransferResult> UsbComm::transferAsync(libusb_device_handle *deviceHandle, quint8 transferType,
+                                                  quint8 endpoint, const QByteArray &data, int length, quint32 timeout)
+{
+    QFutureInterface<UsbTransferResult> futureInterface;
+    futureInterface.reportStarted();
+    QFuture<UsbTransferResult> future = futureInterface.future();
+    bool ok = submitTransfer(deviceHandle,transferType,endpoint,data,length,timeout,
+                             [futureInterface](const UsbTransferResult &result) mutable
+    {
+        futureInterface.reportResult(result);
+        futureInterface.reportFinished();
+    });
+    if(!ok)
+    {
+        futureInterface.reportResult(UsbTransferResult());
+        futureInterface.reportFinished();
+    }
+    return future;
+}
+/*
+ *@brief:   异步传输完成回调函数(在后端的事件线程中执行)
+ * 事件线程中只记录统计和抓包(时间戳不受工作线程排队的影响)，启用完成工作线程时其余处理交给设备对应的工作线程。
+ *@date:    2026.10.18
+ *@param:   transfer:完成的传输，user_data为提交时创建的UsbAsyncTransfer
+ */
+void UsbComm::transferCallback(libusb_transfer *transfer)
+{
+    UsbAsyncTransfer *asyncTransfer = static_cast<UsbAsyncTransfer *>(transfer->user_data);
+    UsbComm *usbComm = asyncTransfer->usbComm;
+    UsbDeviceMetrics *metrics = asyncTransfer->metrics;
+    USB_TRACE(Complete,transfer,transfer->endpoint,transfer->actual_length,transfer->status);
+    usbComm->pcapWriter->captureTransfer(transfer,metrics->getBusNumber(),metrics->getDeviceAddress(),'C');
+    //统计对象在设备关闭时才释放，此时该传输仍处于挂起状态，可以直接访问
+    int requested = transfer->length;
+    if(transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL)
+    {
+        requested -= (int)LIBUSB_CONTROL_SETUP_SIZE;
+    }
+    qint64 latencyNs = UsbMetrics::nowNs()-asyncTransfer->submitTime;
+    metrics->record(transfer->endpoint,transfer->status,requested,transfer->actual_length,latencyNs);
+    if(asyncTransfer->busyPoll != NULL)//所有忙轮询传输完成后事件线程结束本次忙轮询
+    {
+        asyncTransfer->busyPoll->end();
+    }
+    if(asyncTransfer->deviceBusyPoll != NULL)
+    {
+        asyncTransfer->deviceBusyPoll->record(UsbBusyPoll::isSpinning(),latencyNs);
+    }
+    //工作线程池只在没有挂起的传输时替换，该传输完成处理之前一直有效
+    if(usbComm->workerPool != NULL)
+    {
+        usbComm->workerPool->post(asyncTransfer->workerIndex,completeTransfer,transfer);
+    }
+    else
+    {
+        completeTransfer(transfer);
+    }
+}
+/*
+ *@brief:   执行用户回调，之后重新提交(流式传输)或移除挂起记录并释放传输
+ *@date:    2026.10.18
+ *@param:   data:完成的传输(libusb_transfer *)
+ */
+void UsbComm::completeTransfer(void *data)
+{
+    libusb_transfer *transfer = static_cast<libusb_transfer *>(data);
+    UsbAsyncTransfer *asyncTransfer = static_cast<UsbAsyncTransfer *>(transfer->user_data);
+    UsbComm *usbComm = asyncTransfer->usbComm;
+    UsbDeviceMetrics *metrics = asyncTransfer->metrics;
+
+    UsbTransferResult result;
+    result.status = transfer->status;
+    result.actualLength = transfer->actual_length;
+    if(transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL)
+    {
+        if(libusb_control_transfer_get_setup(transfer)->bmRequestType & LIBUSB_ENDPOINT_IN)
+        {
+            result.data = asyncTransfer->buffer.mid(LIBUSB_CONTROL_SETUP_SIZE,transfer->actual_length);
+        }
+    }
+    else if(!asyncTransfer->pooledBuffer.isNull())//零拷贝接收，结果持有buffer的引用
+    {
+        result.buffer = asyncTransfer->pooledBuffer;
+        result.data = result.buffer.toByteArray(transfer->actual_length);
+    }
+    else if(transfer->endpoint & LIBUSB_ENDPOINT_IN)
+    {
+        asyncTransfer->buffer.resize(transfer->actual_length);
+        result.data = asyncTransfer->buffer;
+    }
+    //超时是轮询式读取的正常结果(已计入UsbMetrics并交给回调)，不输出调试信息，避免在事件线程中刷屏
+    if(transfer->status != LIBUSB_TRANSFER_COMPLETED && transfer->status != LIBUSB_TRANSFER_CANCELLED &&
+            transfer->status != LIBUSB_TRANSFER_TIMED_OUT)
+    {
+        qDebug()<<"async transfer error, status:"<<(int)transfer->status;
+    }
+    //先执行回调再移除挂起记录，确保cancelTransfers()返回时回调已经执行完毕
+    if(asyncTransfer->streamCallback)
+    {
+        bool resubmit = asyncTransfer->streamCallback(result);
+        if(resubmit && transfer->status != LIBUSB_TRANSFER_CANCELLED &&
+                transfer->status != LIBUSB_TRANSFER_NO_DEVICE)
+        {
+            //释放结果对buffer的引用后重新提交
+            result.data.clear();
+            result.buffer = UsbPooledBuffer();
+            bool bufferReady = true;
+            if(!asyncTransfer->pooledBuffer.isNull())
+            {
+                //使用者仍持有上次的数据时换用新的池化buffer，旧buffer在最后一个引用释放时归还缓冲池
+                if(asyncTransfer->pooledBuffer.isShared())
+                {
+                    asyncTransfer->pooledBuffer = UsbPooledBuffer(asyncTransfer->length);
+                    bufferReady = !asyncTransfer->pooledBuffer.isNull();
+                }
+                transfer->buffer = (unsigned char *)asyncTransfer->pooledBuffer.data();
+            }
+            else
+            {
+                //恢复buffer完整长度(容量不变，不会重新申请内存)
+                asyncTransfer->buffer.resize(asyncTransfer->length);
+                transfer->buffer = (unsigned char *)asyncTransfer->buffer.data();
+            }
+            transfer->length = asyncTransfer->length;
+
+            QMutexLocker locker(&usbComm->pendingTransferMutex);
+            int err = bufferReady?LIBUSB_ERROR_NO_DEVICE:LIBUSB_ERROR_NO_MEM;
+            //设备正在关闭时不再重新提交
+            if(bufferReady && usbComm->transferHandleSet.contains(asyncTransfer->deviceHandle))
+            {
+                if(asyncTransfer->busyPoll != NULL)
+                {
+                    asyncTransfer->busyPoll->begin(asyncTransfer->deviceBusyPoll->getWindowNs());
+                }
+                asyncTransfer->submitTime = UsbMetrics::nowNs();
+                USB_TRACE(Submit,transfer,transfer->endpoint,transfer->length,0);
+                usbComm->pcapWriter->captureTransfer(transfer,metrics->getBusNumber(),metrics->getDeviceAddress(),'S');
+                err = asyncTransfer->backend->submitTransfer(transfer);
+                if(err != LIBUSB_SUCCESS && asyncTransfer->busyPoll != NULL)
+                {
+                    asyncTransfer->busyPoll->end();
+                }
+            }
+            usbComm->pendingTransferCond.wakeAll();//唤醒cancelTransfers()再次取消
+            if(err == LIBUSB_SUCCESS)
+            {
+                return;
+            }
+            locker.unlock();
+            qDebug()<<"libusb_submit_transfer error:"<<libusb_error_name(err);
+            UsbTransferResult errorResult;
+            asyncTransfer->streamCallback(errorResult);
+        }
+    }
+    else if(asyncTransfer->callback)
+    {
+        asyncTransfer->callback(result);
+    }
+
+    usbComm->pendingTransferMutex.lock();
+    usbComm->pendingTransferHash.remove(asyncTransfer->deviceHandle,transfer);
+    usbComm->pendingTransferCond.wakeAll();
+    usbComm->pendingTransferMutex.unlock();
+
+    delete asyncTransfer;
+    UsbBufferPool::instance()->freeTransfer(transfer);
+}
 /*
  *@brief:   通过索引获取打开的设备句柄
  *@date:    2022.02.22
@@ -383,103 +1363,151 @@ libusb_device_handle *UsbComm::getDeviceHandleFromVpidAndPort(quint16 vid, quint
 {
     for(int i=0;i<deviceHandleList.size();i++)
     {
-        libusb_device *dev = libusb_get_device(deviceHandleList.at(i));
-        libusb_device_descriptor deviceDesc;
-        int err = libusb_get_device_descriptor(dev, &deviceDesc);
-        if(err != LIBUSB_SUCCESS)
+        UsbDeviceInfo info = handleBackend(deviceHandleList.at(i))->getDeviceInfo(deviceHandleList.at(i));
+        //查找匹配的设备(port为-1时不匹配端口)
+        if(info.vendorId == vid && info.productId == pid && (port == -1 || info.portNumber == port))
         {
-            continue;
-        }
-        //查找匹配的设备
-        if(deviceDesc.idVendor == vid && deviceDesc.idProduct == pid)
-        {
-            //不匹配端口
-            if(port == -1)
-            {
-                return deviceHandleList.at(i);
-            }
-            else
-            {
-                if(libusb_get_port_number(dev) == port)
-                {
-                    return deviceHandleList.at(i);
-                }
-            }
+            return deviceHandleList.at(i);
         }
     }
     return NULL;
 }
 /*
- *@brief:   打印USB设备详细信息
- *@date:    2021.03.15
- *@param:   usbDevice:对应一个usb设备
+ *@brief:   获取打开设备的信息
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbDeviceInfo:设备信息，设备未打开时各字段为0
  */
-void UsbComm::printDevInfo(libusb_device *usbDevice)
+UsbDeviceInfo UsbComm::getDeviceInfo(libusb_device_handle *deviceHandle)
 {
-    /*设备描述符层级:
-     *设备(device)->配置(configuration)->接口(interface)->备用设置(altsetting)->端点(endpoint)*/
-
-    /*设备(device)*/
-    libusb_device_descriptor deviceDesc;
-    int err = libusb_get_device_descriptor(usbDevice, &deviceDesc);
-    if(err != LIBUSB_SUCCESS)
+    if(!deviceHandleList.contains(deviceHandle))
     {
-        qDebug()<<"libusb_get_device_descriptor error:"<<libusb_error_name(err);
-        return;
+        return UsbDeviceInfo();
     }
-//    if(!(deviceDesc.idVendor == 0x04b4 && deviceDesc.idProduct == 0x00f1))
-//    {
-//        return;
-//    }
-    qDebug()<<"***************************************";
-    qDebug()<<"Bus: "<<(int)libusb_get_bus_number(usbDevice);//设备所在总线
-    qDebug()<<"Device Address: "<<(int)libusb_get_device_address(usbDevice);//设备在总线上的地址
-    qDebug()<<"Device Port: "<<(int)libusb_get_port_number(usbDevice);//设备端口号
-    qDebug()<<"Device Speed: "<<(int)libusb_get_device_speed(usbDevice);//设备连接速度，详见enum libusb_speed{}
-    qDebug()<<"Device Class: "<<QString("0x%1").arg((int)deviceDesc.bDeviceClass,2,16,QChar('0'));//设备类
-    qDebug()<<"VendorID: "<<QString("0x%1").arg((int)deviceDesc.idVendor,4,16,QChar('0'));//设备厂商id
-    qDebug()<<"ProductID: "<<QString("0x%1").arg((int)deviceDesc.idProduct,4,16,QChar('0'));//设备产品id
-    qDebug()<<"Number of configurations: "<<(int)deviceDesc.bNumConfigurations;//设备的配置数
-    /*配置(configuration)*/
-    for(int i=0;i<(int)deviceDesc.bNumConfigurations;i++)
-    {
-        qDebug()<<"Configuration index:"<<i;
-        libusb_config_descriptor *configDesc;
-        libusb_get_config_descriptor(usbDevice,i,&configDesc);
-        qDebug()<<"Configuration Value: "<<(int)configDesc->bConfigurationValue;
-        qDebug()<<"Number of interfaces: "<<(int)configDesc->bNumInterfaces;
-        /*接口(interface)*/
-        for(int j=0; j<(int)configDesc->bNumInterfaces;j++)
-        {
-            qDebug()<<"\tInterface index:"<<j;
-            const libusb_interface *usbInterface;
-            usbInterface = &configDesc->interface[j];
-            qDebug()<<"\tNumber of alternate settings: "<<usbInterface->num_altsetting;
-            /*备用设置(altsetting)*/
-            for(int k=0; k<usbInterface->num_altsetting; k++)
-            {
-                qDebug()<<"\t\tAltsetting index:"<<k;
-                const libusb_interface_descriptor *interfaceDesc;
-                interfaceDesc = &usbInterface->altsetting[k];
-                qDebug()<<"\t\tInterface Class: "<<
-                          QString("0x%1").arg((int)interfaceDesc->bInterfaceClass,2,16,QChar('0'));//接口类
-                qDebug()<<"\t\tInterface Number: "<<(int)interfaceDesc->bInterfaceNumber;
-                qDebug()<<"\t\tAlternate settings: "<<(int)interfaceDesc->bAlternateSetting;
-                qDebug()<<"\t\tNumber of endpoints: "<<(int)interfaceDesc->bNumEndpoints;
-                /*端点(endpoint)*/
-                for(int m=0; m<(int)interfaceDesc->bNumEndpoints; m++)
-                {
-                    qDebug()<<"\t\t\tEndpoint index:"<<m;
-                    const libusb_endpoint_descriptor *endpointDesc;
-                    endpointDesc = &interfaceDesc->endpoint[m];
-                    qDebug()<<"\t\t\tEP address: "<<
-                              QString("0x%1").arg((int)endpointDesc->bEndpointAddress,2,16,QChar('0'));
-                    qDebug()<<"\t\t\tEP transfer type:"<<
-                              (endpointDesc->bmAttributes&0x03);//端点传输类型，详见enum libusb_transfer_type{}
-                }
-            }
-        }
-        libusb_free_config_descriptor(configDesc);//释放配置描述符空间
+    return handleBackend(deviceHandle)->getDeviceInfo(deviceHandle);
+}
+/*
+ *@brief:   获取当前配置的描述符树(缓存的副本)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbConfigInfo:描述符树，设备未打开或解析失败时isValid()为false
+ */
+UsbConfigInfo UsbComm::getConfigInfo(libusb_device_handle *deviceHandle)
+{
+    return configInfoHash.value(deviceHandle);
+}
+/*
+ *@brief:   获取端点信息(接口当前激活的备用设置中的端点)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点地址
+ *@param:   info:返回的端点信息
+ *@return:  bool:true=成功  false=端点不存在
+ */
+bool UsbComm::getEndpointInfo(libusb_device_handle *deviceHandle, quint8 endpoint, UsbEndpointInfo &info)
+{
+    QHash<libusb_device_handle *,UsbConfigInfo>::const_iterator it = configInfoHash.constFind(deviceHandle);
+    if(it == configInfoHash.constEnd())
+    {
+        return false;
+    }
+    const UsbEndpointInfo *endpointInfo = it.value().endpointInfo(endpoint);
+    if(endpointInfo == NULL)
+    {
+        return false;
+    }
+    info = *endpointInfo;
+    return true;
+}
+/*
+ *@brief:   按角色查找端点，例如findEndpoint(handle,LIBUSB_TRANSFER_TYPE_BULK,LIBUSB_ENDPOINT_IN)获取首个批量IN端点，
+ * 或者指定接口类(如LIBUSB_CLASS_PRINTER)在复合设备中查找对应功能的端点
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   transferType:传输类型，详见enum libusb_transfer_type{}
+ *@param:   direction:方向，LIBUSB_ENDPOINT_IN或LIBUSB_ENDPOINT_OUT
+ *@param:   interfaceClass:接口类，-1表示不限制
+ *@param:   interfaceSubClass:接口子类，-1表示不限制
+ *@param:   interfaceProtocol:接口协议，-1表示不限制
+ *@return:  int:端点地址，-1表示没有
+ */
+int UsbComm::findEndpoint(libusb_device_handle *deviceHandle, quint8 transferType, quint8 direction,
+                          int interfaceClass, int interfaceSubClass, int interfaceProtocol)
+{
+    QHash<libusb_device_handle *,UsbConfigInfo>::const_iterator it = configInfoHash.constFind(deviceHandle);
+    if(it == configInfoHash.constEnd())
+    {
+        return -1;
+    }
+    return it.value().findEndpoint(transferType,direction,interfaceClass,interfaceSubClass,interfaceProtocol);
+}
+/*
+ *@brief:   按接口类查找接口
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceClass:接口类
+ *@param:   interfaceSubClass:接口子类，-1表示不限制
+ *@param:   interfaceProtocol:接口协议，-1表示不限制
+ *@return:  int:接口号，-1表示没有
+ */
+int UsbComm::findInterface(libusb_device_handle *deviceHandle, int interfaceClass, int interfaceSubClass,
+                           int interfaceProtocol)
+{
+    QHash<libusb_device_handle *,UsbConfigInfo>::const_iterator it = configInfoHash.constFind(deviceHandle);
+    if(it == configInfoHash.constEnd())
+    {
+        return -1;
+    }
+    return it.value().findInterface(interfaceClass,interfaceSubClass,interfaceProtocol);
+}
+/*
+ *@brief:   获取设备句柄所属的后端(虚拟设备属于内部的模拟后端，其余属于backend)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbBackend:后端
+ */
+UsbBackend *UsbComm::handleBackend(libusb_device_handle *deviceHandle)
+{
+    return handleBackendHash.value(deviceHandle,backend);
+}
+/*
+ *@brief:   记录打开的设备，创建其传输统计对象
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   handleBackend:设备所属的后端
+ *@param:   info:设备信息
+ */
+void UsbComm::addDeviceHandle(libusb_device_handle *deviceHandle, UsbBackend *handleBackend, const UsbDeviceInfo &info)
+{
+    deviceHandleList.append(deviceHandle);
+    QMutexLocker locker(&pendingTransferMutex);
+    transferHandleSet.insert(deviceHandle);
+    if(handleBackend != backend)
+    {
+        handleBackendHash.insert(deviceHandle,handleBackend);
+    }
+    metricsHash.insert(deviceHandle,new UsbDeviceMetrics(info.vendorId,info.productId,
+                                                         info.busNumber,info.deviceAddress));
+    if(workerPool != NULL)
+    {
+        workerIndexHash.insert(deviceHandle,workerPool->nextWorkerIndex());
+    }
+    locker.unlock();
+    loadConfigInfo(deviceHandle);
+}
+/*
+ *@brief:   解析并缓存设备当前配置的描述符树
+ * 只在打开设备和切换配置时调用，之后的端点查询直接使用缓存，不再访问libusb的描述符接口。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ */
+void UsbComm::loadConfigInfo(libusb_device_handle *deviceHandle)
+{
+    UsbConfigInfo config;
+    int err = handleBackend(deviceHandle)->getConfigInfo(deviceHandle,&config);
+    if(err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_NOT_FOUND)//NOT_FOUND:设备未配置或虚拟设备不描述端点
+    {
+        qDebug()<<"getConfigInfo error:"<<libusb_error_name(err);
     }
-    qDebug()<<"***************************************"<<endl;
+    configInfoHash.insert(deviceHandle,config);
 }
@@ -1,18 +1,20 @@
 /****************************************************************************
 *
-* Copyright (C) 2021-2025 MiaoQingrui. All rights reserved.
+* Copyright (C) 2021-2026 MiaoQingrui. All rights reserved.
 * Author: 缪庆瑞 <justdoit_mqr@163.com>
 *
 ****************************************************************************/
 /*
  *@author:  缪庆瑞
  *@date:    2021.03.15
- *@update:  2025.06.06
+ *@update:  2026.10.18
  *@brief:   USB应用层通信组件
  *
  *该类主要实现与usb设备端进行通信数据传输
  *内部按需封装libusb的方法接口，并维护着当前打开的设备句柄列表和声明的接口列表，所以对于设备句柄和接口的相关操作尽量都使用该类的方法处理，
  *不要在外边单独使用原生libusb接口，避免造成内部维护的列表失效而产生异常。
+ *设备访问通过UsbBackend接口完成，默认使用UsbLibusbBackend访问真实设备，也可以传入UsbSimBackend在没有硬件的环境中
+ *使用模拟设备，其余用法完全相同。
  */
 #ifndef USBCOMM_H
 #define USBCOMM_H
@@ -20,42 +22,169 @@
 #include <QObject>
 #include <QList>
 #include <QMultiMap>
-#include "libusb-1.0/include/libusb.h"
+#include <QMultiHash>
+#include <QSet>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QJsonArray>
+#include <functional>
+#include "usbbackend.h"
+#include "usbrealtime.h"
+#include "usbbufferpool.h"
+
+class UsbSimBackend;
+class UsbDeviceMetrics;
+class UsbPcapWriter;
+class UsbVirtualDevice;
+class UsbWorkerPool;
+class UsbDeviceBusyPoll;
+struct UsbDeviceMetricsSnapshot;
+struct UsbBusyPollStats;
+
+/* 异步传输结果 */
+struct UsbTransferResult
+{
+    UsbTransferResult():status(LIBUSB_TRANSFER_ERROR),actualLength(0){}
+    bool isCompleted() const{return status == LIBUSB_TRANSFER_COMPLETED;}//传输是否成功完成
+
+    int status;//传输状态，详见enum libusb_transfer_status{}
+    int actualLength;//真实传输的字节数
+    QByteArray data;//IN方向接收到的数据(控制传输不包含8字节的setup包)，OUT方向为空
+    UsbPooledBuffer buffer;//零拷贝接收时data引用的池化buffer(见setZeroCopyReceive())，否则为空
+};
+Q_DECLARE_METATYPE(UsbTransferResult)
+
+//异步传输完成回调(在后端的事件线程中执行，启用完成工作线程时在设备对应的工作线程中执行)
+typedef std::function<void(const UsbTransferResult &result)> UsbTransferCallback;
+//流式传输完成回调(执行线程同上)，返回true表示使用同一buffer重新提交该传输
+typedef std::function<bool(const UsbTransferResult &result)> UsbStreamCallback;
 
 class UsbComm : public QObject
 {
     Q_OBJECT
 public:
     explicit UsbComm(QObject *parent = 0);
+    explicit UsbComm(UsbBackend *backend,QObject *parent = 0);//使用指定的传输后端(不转移所有权)
     ~UsbComm();
 
+    UsbBackend *getBackend() const{return backend;}
+
     void findUsbDevices();//探测系统当前接入的usb设备，打印设备详细信息(调试用)
+    QJsonArray getUsbDevicesJson();//以JSON导出当前接入的usb设备及其描述符树
 
     /*设备初始化*/
     bool openUsbDevice(QMultiMap<quint16,quint16> &vpidMap);//打开指定设备(可能有多个)
     void closeUsbDevice(libusb_device_handle *deviceHandle);//关闭指定设备
     void closeAllUsbDevice();//关闭所有设备
+    libusb_device_handle *openVirtualDevice(UsbVirtualDevice *device);//打开虚拟设备(无硬件测试用)，返回其设备句柄
     bool setUsbConfig(libusb_device_handle *deviceHandle,int bConfigurationValue=1);//激活usb设备当前配置
     bool claimUsbInterface(libusb_device_handle *deviceHandle,int interfaceNumber);//声明usb设备的接口
     void releaseUsbInterface(libusb_device_handle *deviceHandle,int interfaceNumber);//释放usb设备声明的接口
     bool setUsbInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,int bAlternateSetting);//激活usb设备接口备用设置
+    //按需要的数据率自动选择并激活备用设置(满足需求的最小带宽，被拒绝时依次回退)，返回激活的备用设置号，-1表示失败
+    int selectUsbInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,qint64 bytesPerSecond,
+                                     qint64 *selectedBytesPerSecond=NULL);
     bool resetUsbDevice(libusb_device_handle *deviceHandle);//重置usb设备
+    bool clearUsbHalt(libusb_device_handle *deviceHandle,quint8 endpoint);//清除端点的halt/stall状态
     /*数据传输*/
     int bulkTransfer(libusb_device_handle *deviceHandle,quint8 endpoint, quint8 *data,
                      int length, quint32 timeout);//(批量(块)传输)
+    /*异步数据传输(不阻塞调用线程，传输完成后通过QFuture获取结果)
+     *OUT端点传递待发送的data，IN端点传递期望接收的最大长度length*/
+    QFuture<UsbTransferResult> bulkTransferAsync(libusb_device_handle *deviceHandle,quint8 endpoint,
+                                                 const QByteArray &data,quint32 timeout);//批量传输(OUT)
+    QFuture<UsbTransferResult> bulkTransferAsync(libusb_device_handle *deviceHandle,quint8 endpoint,
+                                                 int length,quint32 timeout);//批量传输(IN)
+    QFuture<UsbTransferResult> interruptTransferAsync(libusb_device_handle *deviceHandle,quint8 endpoint,
+                                                      const QByteArray &data,quint32 timeout);//中断传输(OUT)
+    QFuture<UsbTransferResult> interruptTransferAsync(libusb_device_handle *deviceHandle,quint8 endpoint,
+                                                      int length,quint32 timeout);//中断传输(IN)
+    QFuture<UsbTransferResult> controlTransferAsync(libusb_device_handle *deviceHandle,quint8 requestType,
+                                                    quint8 request,quint16 value,quint16 index,
+                                                    const QByteArray &data,quint16 length,quint32 timeout);//控制传输
+    //提交异步传输(底层接口，QFuture和协程接口均基于该方法实现)
+    bool submitTransfer(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                        const QByteArray &data,int length,quint32 timeout,UsbTransferCallback callback);
+    //提交流式传输(IN方向，完成后在事件线程中直接重新提交，使端点上始终有挂起的传输)
+    bool submitStreamTransfer(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                              int length,quint32 timeout,UsbStreamCallback callback);
+    //取消设备挂起的异步传输(endpoint=-1表示所有端点)，并等待其结束
+    void cancelTransfers(libusb_device_handle *deviceHandle,int endpoint=-1);
+    //设置完成回调的工作线程数(0=在事件线程中执行，-1=按CPU核数)及其实时配置，需在没有挂起的传输时调用
+    bool setCompletionWorkerCount(int count,const UsbThreadConfig &config = UsbThreadConfig());
+    int getCompletionWorkerCount() const;
+    /*忙轮询低延迟模式(命令/应答类设备，以CPU换取事件线程的唤醒延迟，仅libusb后端)*/
+    bool setBusyPoll(libusb_device_handle *deviceHandle,quint32 windowUs);//设置设备的忙轮询窗口(us)，0表示关闭
+    UsbBusyPollStats getBusyPollStats(libusb_device_handle *deviceHandle);//忙轮询消耗的CPU时间和节省的延迟
+    //零拷贝接收:IN传输使用池化buffer，result.data直接引用该buffer(只在持有result或result.buffer期间有效)
+    bool setZeroCopyReceive(libusb_device_handle *deviceHandle,bool enable);
 
     /*设备查询*/
     int getOpenedDeviceCount(){return deviceHandleList.size();}//获取当前打开的设备数量
     /*该类中所有方法的函参(libusb_device_handle *deviceHandle)必须通过以下getDeviceHandleFrom*方法获取*/
     libusb_device_handle *getDeviceHandleFromIndex(int index);//通过索引获取打开的设备句柄
     libusb_device_handle *getDeviceHandleFromVpidAndPort(quint16 vid,quint16 pid,qint16 port);//通过vpid和端口号获取打开的设备句柄
+    UsbDeviceInfo getDeviceInfo(libusb_device_handle *deviceHandle);//获取打开设备的信息(vpid、速度等)
+
+    /*描述符查询(打开设备时解析并缓存，切换配置/备用设置时更新，查询不会访问设备)*/
+    UsbConfigInfo getConfigInfo(libusb_device_handle *deviceHandle);//获取当前配置的描述符树
+    bool getEndpointInfo(libusb_device_handle *deviceHandle,quint8 endpoint,UsbEndpointInfo &info);//获取端点信息(最大包长、轮询间隔等)
+    //按角色查找端点(例如首个批量IN端点)，返回端点地址，-1表示没有
+    int findEndpoint(libusb_device_handle *deviceHandle,quint8 transferType,quint8 direction,
+                     int interfaceClass=-1,int interfaceSubClass=-1,int interfaceProtocol=-1);
+    //按接口类查找接口，返回接口号，-1表示没有
+    int findInterface(libusb_device_handle *deviceHandle,int interfaceClass,int interfaceSubClass=-1,
+                      int interfaceProtocol=-1);
+
+    /*传输统计(可在任意线程调用，设备关闭后其统计随之清除)*/
+    QList<UsbDeviceMetricsSnapshot> getMetricsSnapshot();//获取所有打开设备的传输统计快照
+    UsbDeviceMetricsSnapshot getMetricsSnapshot(libusb_device_handle *deviceHandle);//获取指定设备的传输统计快照
+    QByteArray getMetricsPrometheusText();//获取Prometheus文本格式的传输统计
+    void resetMetrics();//清零所有设备的传输统计
+
+    /*抓包(usbmon格式的pcap文件，可用Wireshark分析)*/
+    bool startCapture(const QString &fileName,int snapLength=65535);//开始抓包，记录之后经过该对象的所有传输
+    void stopCapture();//停止抓包
+    bool isCapturing() const;
 
 private:
-    void printDevInfo(libusb_device *usbDevice);//打印USB设备详细信息
+    UsbBackend *handleBackend(libusb_device_handle *deviceHandle);//设备句柄所属的后端
+    void addDeviceHandle(libusb_device_handle *deviceHandle,UsbBackend *handleBackend,const UsbDeviceInfo &info);//记录打开的设备
+    void loadConfigInfo(libusb_device_handle *deviceHandle);//解析并缓存设备当前配置的描述符树
+    //提交异步传输的内部实现
+    bool submitTransferInternal(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                                const QByteArray &data,int length,quint32 timeout,
+                                UsbTransferCallback callback,UsbStreamCallback streamCallback);
+    bool hasPendingTransfer(libusb_device_handle *deviceHandle,int endpoint);//是否有挂起的传输(调用前需加锁)
+    void removeDeviceMetrics(libusb_device_handle *deviceHandle);//释放设备的传输统计对象
+    //异步传输的QFuture封装
+    QFuture<UsbTransferResult> transferAsync(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                                             const QByteArray &data,int length,quint32 timeout);
+    //异步传输完成回调函数
+    static void LIBUSB_CALL transferCallback(libusb_transfer *transfer);
+    static void completeTransfer(void *data);//执行用户回调、重新提交或释放传输(事件线程或工作线程)
 
-    libusb_context *context;//表示libusb的一个会话，由libusb_init创建
+    UsbBackend *backend;//传输后端
+    bool ownBackend;//后端是否由该对象创建(析构时释放)
+    UsbSimBackend *virtualBackend;//openVirtualDevice()使用的模拟后端(按需创建)
     QList<libusb_device_handle *> deviceHandleList;//打开的usb设备句柄列表
     QMap<libusb_device_handle *,QList<int> > handleClaimedInterfacesMap;//句柄对应声明的接口列表的map
+    QHash<libusb_device_handle *,UsbConfigInfo> configInfoHash;//句柄对应的描述符树缓存(只在UsbComm所在线程访问)
+
+    QMultiHash<libusb_device_handle *,libusb_transfer *> pendingTransferHash;//句柄对应挂起的异步传输
+    QSet<libusb_device_handle *> transferHandleSet;//允许提交异步传输的句柄集合(供其他线程安全地判断句柄有效性)
+    QMutex pendingTransferMutex;//挂起的异步传输互斥锁(事件线程与调用线程共同访问)
+    QWaitCondition pendingTransferCond;//异步传输结束条件变量，用于等待取消的传输完成
+    UsbPcapWriter *pcapWriter;//抓包写入对象(构造时创建，之后各线程直接使用)
+    QHash<libusb_device_handle *,UsbDeviceMetrics *> metricsHash;//句柄对应的传输统计(只在UsbComm所在线程修改，修改时加pendingTransferMutex)
+    QHash<libusb_device_handle *,UsbBackend *> handleBackendHash;//不属于backend的句柄(虚拟设备)对应的后端(修改规则同metricsHash)
+    UsbWorkerPool *workerPool;//完成回调的工作线程池，NULL表示在事件线程中执行回调(只在没有挂起的传输时替换)
+    QHash<libusb_device_handle *,int> workerIndexHash;//句柄对应的工作线程序号(修改规则同metricsHash)
+    QHash<libusb_device_handle *,UsbDeviceBusyPoll *> busyPollHash;//句柄对应的忙轮询配置和统计(修改规则同metricsHash)
+    QSet<libusb_device_handle *> zeroCopyHandleSet;//启用零拷贝接收的句柄(修改规则同metricsHash)
 
 };
 
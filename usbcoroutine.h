@@ -0,0 +1,128 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   UsbComm异步传输的C++20协程封装
+ *
+ *基于UsbComm::submitTransfer()实现可co_await的传输对象，方便以顺序的写法实现"发送命令->等待应答->等待数据"
+ *这类协议逻辑，而不需要为每个设备单独阻塞一个线程。协程挂起期间不占用线程，传输完成后通过队列调用在UsbComm
+ *对象所在线程(一般是主线程)恢复执行，所以协程体内可以直接继续调用UsbComm的其他方法。
+ *用法示例:
+ *    UsbTask protocol(UsbComm *usbComm,libusb_device_handle *handle)
+ *    {
+ *        UsbTransferResult ret = co_await usbBulkTransfer(usbComm,handle,0x07,command,1000);
+ *        ret = co_await usbBulkTransfer(usbComm,handle,0x81,512,1000);
+ *        ...
+ *    }
+ *注:该头文件需要编译器支持C++20协程(在pro文件中添加CONFIG += c++2a)，否则其中内容不参与编译，
+ *此时可以使用UsbComm中返回QFuture的异步接口。
+ */
+#ifndef USBCOROUTINE_H
+#define USBCOROUTINE_H
+
+#include "usbcomm.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#include <exception>
+#include <QMetaObject>
+
+/* 异步传输等待对象
+ * co_await该对象时提交传输并挂起协程，传输完成后在UsbComm对象所在线程恢复，co_await表达式的值为传输结果。*/
+class UsbTransferAwaiter
+{
+public:
+    UsbTransferAwaiter(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 transferType,
+                       quint8 endpoint,const QByteArray &data,int length,quint32 timeout)
+        :usbComm(usbComm),deviceHandle(deviceHandle),transferType(transferType),
+          endpoint(endpoint),data(data),length(length),timeout(timeout){}
+
+    bool await_ready() const noexcept{return false;}
+    //提交传输，提交失败时返回false，协程不挂起直接得到失败结果
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        UsbComm *comm = usbComm;
+        UsbTransferResult *resultPtr = &result;
+        bool ok = usbComm->submitTransfer(deviceHandle,transferType,endpoint,data,length,timeout,
+                                          [comm,resultPtr,handle](const UsbTransferResult &transferResult)
+        {
+            //回调在事件线程中执行，队列调用保证协程在UsbComm对象所在线程恢复
+            *resultPtr = transferResult;
+            QMetaObject::invokeMethod(comm,[handle](){handle.resume();},Qt::QueuedConnection);
+        });
+        return ok;
+    }
+    UsbTransferResult await_resume() const{return result;}
+
+private:
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 transferType;
+    quint8 endpoint;
+    QByteArray data;
+    int length;
+    quint32 timeout;
+    UsbTransferResult result;//传输结果(默认状态为LIBUSB_TRANSFER_ERROR)
+};
+
+/* 协程返回类型
+ * 即发即忘(fire-and-forget)，协程创建后立即执行，执行结束后自动销毁。*/
+struct UsbTask
+{
+    struct promise_type
+    {
+        UsbTask get_return_object() noexcept{return UsbTask();}
+        std::suspend_never initial_suspend() const noexcept{return {};}
+        std::suspend_never final_suspend() const noexcept{return {};}
+        void return_void() noexcept{}
+        void unhandled_exception() noexcept{std::terminate();}
+    };
+};
+
+//批量传输(OUT)
+inline UsbTransferAwaiter usbBulkTransfer(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 endpoint,
+                                          const QByteArray &data,quint32 timeout)
+{
+    return UsbTransferAwaiter(usbComm,deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,endpoint,data,data.size(),timeout);
+}
+//批量传输(IN)
+inline UsbTransferAwaiter usbBulkTransfer(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 endpoint,
+                                          int length,quint32 timeout)
+{
+    return UsbTransferAwaiter(usbComm,deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,endpoint,QByteArray(),length,timeout);
+}
+//中断传输(OUT)
+inline UsbTransferAwaiter usbInterruptTransfer(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 endpoint,
+                                               const QByteArray &data,quint32 timeout)
+{
+    return UsbTransferAwaiter(usbComm,deviceHandle,LIBUSB_TRANSFER_TYPE_INTERRUPT,endpoint,data,data.size(),timeout);
+}
+//中断传输(IN)
+inline UsbTransferAwaiter usbInterruptTransfer(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 endpoint,
+                                               int length,quint32 timeout)
+{
+    return UsbTransferAwaiter(usbComm,deviceHandle,LIBUSB_TRANSFER_TYPE_INTERRUPT,endpoint,QByteArray(),length,timeout);
+}
+//控制传输(参数含义同UsbComm::controlTransferAsync())
+inline UsbTransferAwaiter usbControlTransfer(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 requestType,
+                                             quint8 request,quint16 value,quint16 index,
+                                             const QByteArray &data,quint16 length,quint32 timeout)
+{
+    quint16 wLength = (requestType & LIBUSB_ENDPOINT_IN)?length:(quint16)data.size();
+    QByteArray buffer(LIBUSB_CONTROL_SETUP_SIZE+wLength,0);
+    libusb_fill_control_setup((unsigned char *)buffer.data(),requestType,request,value,index,wLength);
+    if(!(requestType & LIBUSB_ENDPOINT_IN))
+    {
+        memcpy(buffer.data()+LIBUSB_CONTROL_SETUP_SIZE,data.constData(),wLength);
+    }
+    return UsbTransferAwaiter(usbComm,deviceHandle,LIBUSB_TRANSFER_TYPE_CONTROL,0,buffer,buffer.size(),timeout);
+}
+
+#endif // __cpp_impl_coroutine
+
+#endif // USBCOROUTINE_H
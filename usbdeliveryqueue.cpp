@@ -0,0 +1,155 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   传输结果从事件线程到使用者线程的批量投递队列
+ */
+#include "usbdeliveryqueue.h"
+#include "usbmetrics.h"
+#include <QTimer>
+#include <QMetaObject>
+
+/*
+ *@brief:   构造函数(在使用者线程中调用)
+ *@date:    2026.10.18
+ *@param:   capacity:队列容量，向上取整为2的幂
+ *@param:   frameIntervalMs:两次交出的最小间隔(ms)，0表示唤醒后立即交出
+ *@param:   parent:父对象
+ */
+UsbDeliveryQueue::UsbDeliveryQueue(int capacity, int frameIntervalMs, QObject *parent)
+    :QObject(parent)
+{
+    quint32 size = 2;
+    while((int)size < capacity && size < 0x40000000)
+    {
+        size <<= 1;
+    }
+    ring.resize(size);
+    ringData = ring.data();
+    mask = size-1;
+    head = 0;
+    tail = 0;
+    wakeupPending = false;
+    this->frameIntervalMs = qMax(frameIntervalMs,0);
+    lastDrainNs = 0;
+    frameTimer = new QTimer(this);
+    frameTimer->setSingleShot(true);
+    connect(frameTimer,&QTimer::timeout,this,&UsbDeliveryQueue::drain);
+    batch.reserve(size);
+
+    pushed = 0;
+    dropped = 0;
+    wakeups = 0;
+    batches = 0;
+    maxBatchSize = 0;
+}
+/*
+ *@brief:   放入一个结果(生产者线程，同一时刻只能有一个线程调用)
+ * 只写入槽位并发布尾索引，队列从空变为非空(使用者尚未被唤醒)时才向使用者线程投递唤醒。
+ * 零拷贝接收的结果持有池化buffer的引用，放入队列不拷贝数据。
+ *@date:    2026.10.18
+ *@param:   result:传输结果
+ *@return:  bool:true=成功  false=队列满，结果被丢弃
+ */
+bool UsbDeliveryQueue::push(const UsbTransferResult &result)
+{
+    quint32 t = tail.load(std::memory_order_relaxed);
+    if(t-head.load(std::memory_order_acquire) > mask)
+    {
+        dropped.fetch_add(1,std::memory_order_relaxed);
+        return false;
+    }
+    ringData[t & mask] = result;
+    tail.store(t+1,std::memory_order_release);
+    pushed.fetch_add(1,std::memory_order_relaxed);
+
+    //使用者在取数据之前清除该标志，因此清除之后放入的结果一定会触发新的唤醒
+    if(!wakeupPending.exchange(true,std::memory_order_acq_rel))
+    {
+        wakeups.fetch_add(1,std::memory_order_relaxed);
+        QMetaObject::invokeMethod(this,"wakeup",Qt::QueuedConnection);
+    }
+    return true;
+}
+/*
+ *@brief:   取出全部结果(使用者线程)
+ * 取出后槽位重置为空结果，及时释放其中的数据和池化buffer。
+ *@date:    2026.10.18
+ *@param:   results:取出的结果追加到该容器
+ *@return:  int:取出的数量
+ */
+int UsbDeliveryQueue::takeAll(QVector<UsbTransferResult> &results)
+{
+    quint32 h = head.load(std::memory_order_relaxed);
+    quint32 t = tail.load(std::memory_order_acquire);
+    for(quint32 i=h;i!=t;i++)
+    {
+        UsbTransferResult &slot = ringData[i & mask];
+        results.append(slot);
+        slot = UsbTransferResult();
+    }
+    head.store(t,std::memory_order_release);
+    return (int)(t-h);
+}
+/*
+ *@brief:   获取投递统计(可在任意线程调用)
+ *@date:    2026.10.18
+ *@return:  UsbDeliveryStats:统计
+ */
+UsbDeliveryStats UsbDeliveryQueue::getStats() const
+{
+    UsbDeliveryStats stats;
+    stats.pushed = pushed.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.wakeups = wakeups.load(std::memory_order_relaxed);
+    stats.batches = batches.load(std::memory_order_relaxed);
+    stats.maxBatchSize = maxBatchSize.load(std::memory_order_relaxed);
+    return stats;
+}
+/*
+ *@brief:   使用者线程收到唤醒，帧间隔未到时延迟到下一帧交出(期间wakeupPending保持置位，生产者不再投递唤醒)
+ *@date:    2026.10.18
+ */
+void UsbDeliveryQueue::wakeup()
+{
+    if(frameIntervalMs > 0)
+    {
+        qint64 elapsedMs = (UsbMetrics::nowNs()-lastDrainNs)/1000000;
+        if(elapsedMs < frameIntervalMs)
+        {
+            if(!frameTimer->isActive())
+            {
+                frameTimer->start(frameIntervalMs-(int)elapsedMs);
+            }
+            return;
+        }
+    }
+    drain();
+}
+/*
+ *@brief:   取走全部结果并通过resultsReady()信号整批交出
+ *@date:    2026.10.18
+ */
+void UsbDeliveryQueue::drain()
+{
+    //读-改-写与生产者的exchange同步，保证能看到清除之前放入的所有结果
+    wakeupPending.exchange(false,std::memory_order_acq_rel);
+    lastDrainNs = UsbMetrics::nowNs();
+    int count = takeAll(batch);
+    if(count == 0)
+    {
+        return;
+    }
+    batches.fetch_add(1,std::memory_order_relaxed);
+    if((quint64)count > maxBatchSize.load(std::memory_order_relaxed))
+    {
+        maxBatchSize.store(count,std::memory_order_relaxed);
+    }
+    emit resultsReady(batch);
+    batch.clear();
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   传输结果从事件线程到使用者线程的批量投递队列
+ *
+ *在回调中为每个接收到的包发射一次跨线程(排队连接)信号，每个包都要申请一个事件并对接收线程的事件队列加锁，
+ *高包率的设备上投递本身就限制了吞吐(每秒数万包)，使用者线程也被逐个的槽调用占满。
+ *该队列是单生产者单消费者的无锁环形队列:
+ *1.生产者(事件线程或设备对应的完成工作线程)push()只写入槽位并发布尾索引，不加锁、不申请内存；
+ *2.队列从空变为非空时才向使用者线程投递一次唤醒，使用者取走数据之前的后续push()不再投递；
+ *3.使用者线程被唤醒后一次取走所有数据，通过resultsReady()信号整批交出，设置帧间隔时两次交出至少间隔
+ *  一个帧间隔(例如按界面刷新率合并)，期间到达的数据并入下一批。
+ *队列对象需在使用者线程中创建(或移动到使用者线程)，同一时刻只能有一个线程调用push()。
+ *队列满时push()丢弃该结果并计数，容量应能容纳一个帧间隔内到达的数据。
+ */
+#ifndef USBDELIVERYQUEUE_H
+#define USBDELIVERYQUEUE_H
+
+#include <QObject>
+#include <QVector>
+#include <atomic>
+#include "usbcomm.h"
+
+class QTimer;
+
+/* 投递统计 */
+struct UsbDeliveryStats
+{
+    UsbDeliveryStats():pushed(0),dropped(0),wakeups(0),batches(0),maxBatchSize(0){}
+
+    quint64 pushed;//进入队列的结果数
+    quint64 dropped;//队列满时丢弃的结果数
+    quint64 wakeups;//向使用者线程投递的唤醒次数
+    quint64 batches;//交出的批次数
+    quint64 maxBatchSize;//最大的批次
+};
+
+class UsbDeliveryQueue : public QObject
+{
+    Q_OBJECT
+public:
+    //capacity:队列容量(向上取整为2的幂)  frameIntervalMs:两次交出的最小间隔，0表示唤醒后立即交出
+    explicit UsbDeliveryQueue(int capacity=1024,int frameIntervalMs=0,QObject *parent = 0);
+
+    bool push(const UsbTransferResult &result);//生产者线程:放入一个结果，队列满时返回false
+    int takeAll(QVector<UsbTransferResult> &results);//使用者线程:取出全部结果追加到results，返回取出的数量
+    int capacity() const{return ring.size();}
+    UsbDeliveryStats getStats() const;
+
+signals:
+    void resultsReady(const QVector<UsbTransferResult> &results);//一批结果(在使用者线程中发射)
+
+private slots:
+    void wakeup();//使用者线程收到唤醒
+    void drain();//取走全部结果并交出
+
+private:
+    QVector<UsbTransferResult> ring;//环形队列的槽位(预先分配)
+    UsbTransferResult *ringData;//槽位数组(避免在生产者线程中调用QVector的非const接口)
+    quint32 mask;
+    std::atomic<quint32> head;//使用者的读索引
+    std::atomic<quint32> tail;//生产者的写索引
+    std::atomic<bool> wakeupPending;//已投递唤醒，使用者尚未取走数据
+    int frameIntervalMs;
+    qint64 lastDrainNs;//上次交出的时间点
+    QTimer *frameTimer;//帧间隔未到时延迟交出
+    QVector<UsbTransferResult> batch;//交出的批次(重复使用，避免每批申请内存)
+
+    std::atomic<quint64> pushed;
+    std::atomic<quint64> dropped;
+    std::atomic<quint64> wakeups;
+    std::atomic<quint64> batches;
+    std::atomic<quint64> maxBatchSize;
+};
+
+#endif // USBDELIVERYQUEUE_H
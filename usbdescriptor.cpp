@@ -0,0 +1,357 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   解析后的设备描述符树(配置->接口->备用设置->端点)
+ */
+#include "usbdescriptor.h"
+
+/*
+ *@brief:   每个服务间隔最多传输的字节数
+ *@date:    2026.10.18
+ *@return:  int:字节数，超高速端点优先使用伴随描述符的wBytesPerInterval
+ */
+int UsbEndpointInfo::bytesPerInterval() const
+{
+    if(ssBytesPerInterval > 0)
+    {
+        return ssBytesPerInterval;
+    }
+    return maxPacketSize*transactions*(maxBurst+1)*(mult+1);
+}
+/*
+ *@brief:   周期端点(等时/中断)保留的总线带宽
+ * 服务间隔:全速/低速等时端点为2^(bInterval-1)帧，中断端点为bInterval帧(1帧=1ms)；
+ * 高速及以上的周期端点均为2^(bInterval-1)微帧(1微帧=125us)。
+ *@date:    2026.10.18
+ *@param:   speed:设备的连接速度，详见enum libusb_speed{}
+ *@return:  qint64:字节/秒，批量和控制端点不保留带宽，返回0
+ */
+qint64 UsbEndpointInfo::bytesPerSecond(int speed) const
+{
+    if(transferType != LIBUSB_TRANSFER_TYPE_ISOCHRONOUS && transferType != LIBUSB_TRANSFER_TYPE_INTERRUPT)
+    {
+        return 0;
+    }
+    int exponent = qBound(1,(int)interval,16)-1;
+    qint64 intervalUs;
+    if(speed == LIBUSB_SPEED_LOW || speed == LIBUSB_SPEED_FULL)
+    {
+        intervalUs = (transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS)?(Q_INT64_C(1000)<<exponent):
+                                                                         1000*qMax((int)interval,1);
+    }
+    else
+    {
+        intervalUs = Q_INT64_C(125)<<exponent;
+    }
+    return bytesPerInterval()*Q_INT64_C(1000000)/intervalUs;
+}
+/*
+ *@brief:   备用设置保留的总线带宽(所有周期端点之和)
+ *@date:    2026.10.18
+ *@param:   speed:设备的连接速度，详见enum libusb_speed{}
+ *@return:  qint64:字节/秒
+ */
+qint64 UsbAltSettingInfo::bytesPerSecond(int speed) const
+{
+    qint64 total = 0;
+    for(int i=0;i<endpointList.size();i++)
+    {
+        total += endpointList.at(i).bytesPerSecond(speed);
+    }
+    return total;
+}
+/*
+ *@brief:   获取当前激活的备用设置
+ *@date:    2026.10.18
+ *@return:  UsbAltSettingInfo:备用设置，不存在时为NULL
+ */
+const UsbAltSettingInfo *UsbInterfaceInfo::activeAltSetting() const
+{
+    for(int i=0;i<altSettingList.size();i++)
+    {
+        if(altSettingList.at(i).alternateSetting == currentAltSetting)
+        {
+            return &altSettingList.at(i);
+        }
+    }
+    return NULL;
+}
+/*
+ *@brief:   获取接口
+ *@date:    2026.10.18
+ *@param:   interfaceNumber:接口号
+ *@return:  UsbInterfaceInfo:接口，不存在时为NULL
+ */
+const UsbInterfaceInfo *UsbConfigInfo::interfaceInfo(int interfaceNumber) const
+{
+    for(int i=0;i<interfaceList.size();i++)
+    {
+        if(interfaceList.at(i).interfaceNumber == interfaceNumber)
+        {
+            return &interfaceList.at(i);
+        }
+    }
+    return NULL;
+}
+/*
+ *@brief:   按接口类查找接口
+ *@date:    2026.10.18
+ *@param:   interfaceClass:接口类
+ *@param:   interfaceSubClass:接口子类，-1表示不限制
+ *@param:   interfaceProtocol:接口协议，-1表示不限制
+ *@return:  int:首个匹配的接口号，-1表示没有
+ */
+int UsbConfigInfo::findInterface(int interfaceClass, int interfaceSubClass, int interfaceProtocol) const
+{
+    for(int i=0;i<interfaceList.size();i++)
+    {
+        const UsbAltSettingInfo *altSetting = interfaceList.at(i).activeAltSetting();
+        if(altSetting != NULL && altSetting->interfaceClass == interfaceClass &&
+                (interfaceSubClass == -1 || altSetting->interfaceSubClass == interfaceSubClass) &&
+                (interfaceProtocol == -1 || altSetting->interfaceProtocol == interfaceProtocol))
+        {
+            return interfaceList.at(i).interfaceNumber;
+        }
+    }
+    return -1;
+}
+/*
+ *@brief:   获取端点(各接口当前激活的备用设置中)
+ *@date:    2026.10.18
+ *@param:   address:端点地址
+ *@return:  UsbEndpointInfo:端点，不存在时为NULL
+ */
+const UsbEndpointInfo *UsbConfigInfo::endpointInfo(quint8 address) const
+{
+    for(int i=0;i<interfaceList.size();i++)
+    {
+        const UsbAltSettingInfo *altSetting = interfaceList.at(i).activeAltSetting();
+        if(altSetting == NULL)
+        {
+            continue;
+        }
+        for(int j=0;j<altSetting->endpointList.size();j++)
+        {
+            if(altSetting->endpointList.at(j).address == address)
+            {
+                return &altSetting->endpointList.at(j);
+            }
+        }
+    }
+    return NULL;
+}
+/*
+ *@brief:   按角色查找端点，例如首个批量IN端点、CDC数据接口的批量OUT端点
+ *@date:    2026.10.18
+ *@param:   transferType:传输类型，详见enum libusb_transfer_type{}
+ *@param:   direction:方向，LIBUSB_ENDPOINT_IN或LIBUSB_ENDPOINT_OUT
+ *@param:   interfaceClass:接口类，-1表示不限制
+ *@param:   interfaceSubClass:接口子类，-1表示不限制
+ *@param:   interfaceProtocol:接口协议，-1表示不限制
+ *@return:  int:首个匹配的端点地址，-1表示没有
+ */
+int UsbConfigInfo::findEndpoint(quint8 transferType, quint8 direction, int interfaceClass,
+                                int interfaceSubClass, int interfaceProtocol) const
+{
+    for(int i=0;i<interfaceList.size();i++)
+    {
+        const UsbAltSettingInfo *altSetting = interfaceList.at(i).activeAltSetting();
+        if(altSetting == NULL ||
+                (interfaceClass != -1 && altSetting->interfaceClass != interfaceClass) ||
+                (interfaceSubClass != -1 && altSetting->interfaceSubClass != interfaceSubClass) ||
+                (interfaceProtocol != -1 && altSetting->interfaceProtocol != interfaceProtocol))
+        {
+            continue;
+        }
+        for(int j=0;j<altSetting->endpointList.size();j++)
+        {
+            const UsbEndpointInfo &endpoint = altSetting->endpointList.at(j);
+            if(endpoint.transferType == transferType &&
+                    (endpoint.address & LIBUSB_ENDPOINT_DIR_MASK) == (direction & LIBUSB_ENDPOINT_DIR_MASK))
+            {
+                return endpoint.address;
+            }
+        }
+    }
+    return -1;
+}
+/*
+ *@brief:   更新接口当前激活的备用设置
+ *@date:    2026.10.18
+ *@param:   interfaceNumber:接口号
+ *@param:   alternateSetting:备用设置号
+ *@return:  bool:true=成功 false=接口或备用设置不存在
+ */
+bool UsbConfigInfo::setAltSetting(int interfaceNumber, int alternateSetting)
+{
+    for(int i=0;i<interfaceList.size();i++)
+    {
+        UsbInterfaceInfo &usbInterface = interfaceList[i];
+        if(usbInterface.interfaceNumber != interfaceNumber)
+        {
+            continue;
+        }
+        for(int j=0;j<usbInterface.altSettingList.size();j++)
+        {
+            if(usbInterface.altSettingList.at(j).alternateSetting == alternateSetting)
+            {
+                usbInterface.currentAltSetting = alternateSetting;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+/*
+ *@brief:   解析libusb的配置描述符
+ *@date:    2026.10.18
+ *@param:   descriptor:配置描述符(调用者负责释放)
+ *@return:  UsbConfigInfo:描述符树，各接口的当前备用设置为0
+ */
+UsbConfigInfo UsbConfigInfo::fromDescriptor(const libusb_config_descriptor *descriptor)
+{
+    UsbConfigInfo config;
+    config.configurationValue = descriptor->bConfigurationValue;
+    config.attributes = descriptor->bmAttributes;
+    config.maxPower = descriptor->MaxPower;
+    for(int i=0;i<(int)descriptor->bNumInterfaces;i++)
+    {
+        const libusb_interface *usbInterface = &descriptor->interface[i];
+        UsbInterfaceInfo interfaceInfo;
+        for(int j=0;j<usbInterface->num_altsetting;j++)
+        {
+            const libusb_interface_descriptor *interfaceDesc = &usbInterface->altsetting[j];
+            interfaceInfo.interfaceNumber = interfaceDesc->bInterfaceNumber;
+            UsbAltSettingInfo altSetting;
+            altSetting.alternateSetting = interfaceDesc->bAlternateSetting;
+            altSetting.interfaceClass = interfaceDesc->bInterfaceClass;
+            altSetting.interfaceSubClass = interfaceDesc->bInterfaceSubClass;
+            altSetting.interfaceProtocol = interfaceDesc->bInterfaceProtocol;
+            for(int k=0;k<(int)interfaceDesc->bNumEndpoints;k++)
+            {
+                const libusb_endpoint_descriptor *endpointDesc = &interfaceDesc->endpoint[k];
+                UsbEndpointInfo endpoint;
+                endpoint.address = endpointDesc->bEndpointAddress;
+                endpoint.attributes = endpointDesc->bmAttributes;
+                endpoint.transferType = endpointDesc->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK;
+                endpoint.maxPacketSize = endpointDesc->wMaxPacketSize & 0x07FF;
+                endpoint.transactions = ((endpointDesc->wMaxPacketSize >> 11) & 0x03)+1;
+                endpoint.interval = endpointDesc->bInterval;
+                //超高速端点的伴随描述符(在extra中，非超高速设备没有)
+                libusb_ss_endpoint_companion_descriptor *companionDesc = NULL;
+                if(libusb_get_ss_endpoint_companion_descriptor(NULL,endpointDesc,&companionDesc) == LIBUSB_SUCCESS)
+                {
+                    endpoint.maxBurst = companionDesc->bMaxBurst;
+                    if(endpoint.transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS)
+                    {
+                        endpoint.mult = companionDesc->bmAttributes & 0x03;
+                    }
+                    if(endpoint.transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS ||
+                            endpoint.transferType == LIBUSB_TRANSFER_TYPE_INTERRUPT)
+                    {
+                        endpoint.ssBytesPerInterval = companionDesc->wBytesPerInterval;
+                    }
+                    libusb_free_ss_endpoint_companion_descriptor(companionDesc);
+                }
+                altSetting.endpointList.append(endpoint);
+            }
+            interfaceInfo.altSettingList.append(altSetting);
+        }
+        config.interfaceList.append(interfaceInfo);
+    }
+    return config;
+}
+/*
+ *@brief:   解析原始的配置描述符
+ * 数据为GET_DESCRIPTOR(CONFIGURATION)返回的wTotalLength字节(例如sysfs的descriptors文件中的一段)，
+ * 依次包含配置、接口、端点以及类相关的描述符，类相关的描述符被忽略。
+ *@date:    2026.10.18
+ *@param:   data:配置描述符及其后的所有描述符
+ *@return:  UsbConfigInfo:描述符树，数据不完整时只包含已解析的部分
+ */
+UsbConfigInfo UsbConfigInfo::fromRawDescriptor(const QByteArray &data)
+{
+    UsbConfigInfo config;
+    const quint8 *bytes = reinterpret_cast<const quint8 *>(data.constData());
+    int interfaceIndex = -1;//当前接口在列表中的索引(其最后一个备用设置为当前备用设置)
+    bool hasEndpoint = false;//当前备用设置的最后一个端点可以关联其后的超高速伴随描述符
+    for(int offset=0;offset+2<=data.size();)
+    {
+        int length = bytes[offset];
+        int type = bytes[offset+1];
+        if(length < 2 || offset+length > data.size())
+        {
+            break;//描述符长度错误
+        }
+        const quint8 *desc = bytes+offset;
+        if(type == LIBUSB_DT_CONFIG && length >= LIBUSB_DT_CONFIG_SIZE)
+        {
+            config.configurationValue = desc[5];
+            config.attributes = desc[7];
+            config.maxPower = desc[8];
+        }
+        else if(type == LIBUSB_DT_INTERFACE && length >= LIBUSB_DT_INTERFACE_SIZE)
+        {
+            interfaceIndex = -1;
+            for(int i=0;i<config.interfaceList.size();i++)
+            {
+                if(config.interfaceList.at(i).interfaceNumber == desc[2])
+                {
+                    interfaceIndex = i;
+                    break;
+                }
+            }
+            if(interfaceIndex == -1)
+            {
+                UsbInterfaceInfo interfaceInfo;
+                interfaceInfo.interfaceNumber = desc[2];
+                config.interfaceList.append(interfaceInfo);
+                interfaceIndex = config.interfaceList.size()-1;
+            }
+            UsbAltSettingInfo altSettingInfo;
+            altSettingInfo.alternateSetting = desc[3];
+            altSettingInfo.interfaceClass = desc[5];
+            altSettingInfo.interfaceSubClass = desc[6];
+            altSettingInfo.interfaceProtocol = desc[7];
+            config.interfaceList[interfaceIndex].altSettingList.append(altSettingInfo);
+            hasEndpoint = false;
+        }
+        else if(type == LIBUSB_DT_ENDPOINT && length >= LIBUSB_DT_ENDPOINT_SIZE && interfaceIndex != -1)
+        {
+            quint16 maxPacketSize = desc[4]|(desc[5]<<8);
+            UsbEndpointInfo endpointInfo;
+            endpointInfo.address = desc[2];
+            endpointInfo.attributes = desc[3];
+            endpointInfo.transferType = desc[3] & LIBUSB_TRANSFER_TYPE_MASK;
+            endpointInfo.maxPacketSize = maxPacketSize & 0x07FF;
+            endpointInfo.transactions = ((maxPacketSize >> 11) & 0x03)+1;
+            endpointInfo.interval = desc[6];
+            config.interfaceList[interfaceIndex].altSettingList.last().endpointList.append(endpointInfo);
+            hasEndpoint = true;
+        }
+        else if(type == LIBUSB_DT_SS_ENDPOINT_COMPANION && length >= LIBUSB_DT_SS_ENDPOINT_COMPANION_SIZE &&
+                hasEndpoint)
+        {
+            UsbEndpointInfo &endpoint = config.interfaceList[interfaceIndex].altSettingList.last().endpointList.last();
+            endpoint.maxBurst = desc[2];
+            if(endpoint.transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS)
+            {
+                endpoint.mult = desc[3] & 0x03;
+            }
+            if(endpoint.transferType == LIBUSB_TRANSFER_TYPE_ISOCHRONOUS ||
+                    endpoint.transferType == LIBUSB_TRANSFER_TYPE_INTERRUPT)
+            {
+                endpoint.ssBytesPerInterval = desc[4]|(desc[5]<<8);
+            }
+            hasEndpoint = false;
+        }
+        offset += length;
+    }
+    return config;
+}
@@ -0,0 +1,88 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   解析后的设备描述符树(配置->接口->备用设置->端点)
+ *
+ *UsbComm在打开设备时通过后端解析一次当前配置，之后按句柄缓存，切换配置/备用设置时同步更新，
+ *查询端点的最大包长、轮询间隔以及按类型/接口类查找端点都不再访问libusb的描述符接口。
+ */
+#ifndef USBDESCRIPTOR_H
+#define USBDESCRIPTOR_H
+
+#include <QList>
+#include <QByteArray>
+#include "libusb-1.0/include/libusb.h"
+
+/* 端点信息 */
+struct UsbEndpointInfo
+{
+    UsbEndpointInfo():address(0),attributes(0),transferType(0),maxPacketSize(0),transactions(1),
+        interval(0),maxBurst(0),mult(0),ssBytesPerInterval(0){}
+    int bytesPerInterval() const;//每个服务间隔最多传输的字节数(等时/中断端点的带宽)
+    qint64 bytesPerSecond(int speed) const;//周期端点保留的总线带宽(字节/秒)，批量和控制端点为0
+
+    quint8 address;//端点地址
+    quint8 attributes;//bmAttributes原始值(等时端点包含同步类型和用途)
+    quint8 transferType;//传输类型，详见enum libusb_transfer_type{}
+    int maxPacketSize;//最大包长(wMaxPacketSize bit0~10)
+    int transactions;//高速高带宽端点每个微帧的事务数(wMaxPacketSize bit11~12加1)
+    quint8 interval;//bInterval原始值，单位与连接速度有关
+    int maxBurst;//超高速端点的突发包数减1(SuperSpeed伴随描述符)
+    int mult;//超高速等时端点的突发次数减1(SuperSpeed伴随描述符)
+    int ssBytesPerInterval;//超高速周期端点每个服务间隔的字节数(SuperSpeed伴随描述符)，0表示没有
+};
+
+/* 接口的备用设置 */
+struct UsbAltSettingInfo
+{
+    UsbAltSettingInfo():alternateSetting(0),interfaceClass(0),interfaceSubClass(0),interfaceProtocol(0){}
+    qint64 bytesPerSecond(int speed) const;//所有端点保留的总线带宽(字节/秒)
+
+    quint8 alternateSetting;//备用设置号
+    quint8 interfaceClass;//接口类
+    quint8 interfaceSubClass;//接口子类
+    quint8 interfaceProtocol;//接口协议
+    QList<UsbEndpointInfo> endpointList;//端点列表
+};
+
+/* 接口 */
+struct UsbInterfaceInfo
+{
+    UsbInterfaceInfo():interfaceNumber(0),currentAltSetting(0){}
+    const UsbAltSettingInfo *activeAltSetting() const;//当前激活的备用设置
+
+    quint8 interfaceNumber;//接口号
+    int currentAltSetting;//当前激活的备用设置号
+    QList<UsbAltSettingInfo> altSettingList;//备用设置列表
+};
+
+/* 配置 */
+struct UsbConfigInfo
+{
+    UsbConfigInfo():configurationValue(0),attributes(0),maxPower(0){}
+    bool isValid() const{return !interfaceList.isEmpty();}
+
+    /*查询(只查找各接口当前激活的备用设置，interfaceClass等参数为-1表示不限制)*/
+    const UsbInterfaceInfo *interfaceInfo(int interfaceNumber) const;
+    int findInterface(int interfaceClass,int interfaceSubClass=-1,int interfaceProtocol=-1) const;//返回接口号，-1表示没有
+    const UsbEndpointInfo *endpointInfo(quint8 address) const;
+    int findEndpoint(quint8 transferType,quint8 direction,int interfaceClass=-1,int interfaceSubClass=-1,
+                     int interfaceProtocol=-1) const;//返回首个匹配的端点地址，-1表示没有
+    bool setAltSetting(int interfaceNumber,int alternateSetting);//更新接口当前激活的备用设置
+
+    static UsbConfigInfo fromDescriptor(const libusb_config_descriptor *descriptor);//解析libusb的配置描述符
+    static UsbConfigInfo fromRawDescriptor(const QByteArray &data);//解析原始的配置描述符(包含其后的接口、端点描述符)
+
+    quint8 configurationValue;//配置值
+    quint8 attributes;//bmAttributes原始值
+    int maxPower;//最大电流(bMaxPower原始值)
+    QList<UsbInterfaceInfo> interfaceList;//接口列表
+};
+
+#endif // USBDESCRIPTOR_H
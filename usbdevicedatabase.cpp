@@ -0,0 +1,333 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   基于sysfs的快速设备枚举及描述符缓存(Linux)
+ */
+#include "usbdevicedatabase.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QtConcurrent>
+#include <algorithm>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   sysfsPath:sysfs中USB设备的目录
+ */
+UsbDeviceDatabase::UsbDeviceDatabase(const QString &sysfsPath)
+    :sysfsPath(sysfsPath),dirty(true),hotplugTracked(false)
+{
+}
+/*
+ *@brief:   sysfs是否可用
+ *@date:    2026.10.18
+ *@return:  bool:true=可用  false=不可用(非Linux平台或未挂载sysfs)
+ */
+bool UsbDeviceDatabase::isAvailable() const
+{
+    return QFileInfo(sysfsPath).isDir();
+}
+/*
+ *@brief:   标记缓存失效，下一次查询时刷新(可在任意线程调用，例如热插拔回调中)
+ *@date:    2026.10.18
+ */
+void UsbDeviceDatabase::invalidate()
+{
+    dirty.store(true);
+}
+/*
+ *@brief:   设置是否有不限条件的热插拔监测
+ * 没有热插拔监测时无法得知设备变化，每次查询都会检查目录列表和设备地址；有热插拔监测时缓存只在失效后刷新。
+ *@date:    2026.10.18
+ *@param:   tracked:true=有  false=没有
+ */
+void UsbDeviceDatabase::setHotplugTracked(bool tracked)
+{
+    hotplugTracked.store(tracked);
+    dirty.store(true);//开始监测之前的变化未被记录
+}
+/*
+ *@brief:   获取设备记录
+ *@date:    2026.10.18
+ *@return:  QList<UsbDeviceRecord>:按sysfs目录名排序的设备记录
+ */
+QList<UsbDeviceRecord> UsbDeviceDatabase::getDeviceList()
+{
+    QMutexLocker locker(&mutex);
+    if(dirty.load() || !hotplugTracked.load())
+    {
+        refresh();
+    }
+    QList<QString> nameList = recordHash.keys();
+    std::sort(nameList.begin(),nameList.end());
+    QList<UsbDeviceRecord> recordList;
+    for(int i=0;i<nameList.size();i++)
+    {
+        recordList.append(recordHash.value(nameList.at(i)));
+    }
+    return recordList;
+}
+/*
+ *@brief:   是否接入了指定vpid的设备
+ *@date:    2026.10.18
+ *@param:   vpidMap:<厂商id,产品id>表
+ *@return:  bool:true=有  false=没有
+ */
+bool UsbDeviceDatabase::containsDevice(const QMultiMap<quint16, quint16> &vpidMap)
+{
+    QList<UsbDeviceRecord> recordList = getDeviceList();
+    for(int i=0;i<recordList.size();i++)
+    {
+        const UsbDeviceInfo &info = recordList.at(i).info;
+        if(vpidMap.contains(info.vendorId,info.productId))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+/*
+ *@brief:   导出所有设备记录
+ *@date:    2026.10.18
+ *@return:  QJsonArray:每个元素为recordToJson()的结果
+ */
+QJsonArray UsbDeviceDatabase::toJson()
+{
+    QJsonArray deviceArray;
+    QList<UsbDeviceRecord> recordList = getDeviceList();
+    for(int i=0;i<recordList.size();i++)
+    {
+        deviceArray.append(recordToJson(recordList.at(i)));
+    }
+    return deviceArray;
+}
+/*
+ *@brief:   设备记录转换为JSON
+ *@date:    2026.10.18
+ *@param:   record:设备记录
+ *@return:  QJsonObject:设备信息及当前配置的描述符树，id类字段为十六进制字符串
+ */
+QJsonObject UsbDeviceDatabase::recordToJson(const UsbDeviceRecord &record)
+{
+    static const char *transferTypeNames[] = {"control","isochronous","bulk","interrupt"};
+    const UsbDeviceInfo &info = record.info;
+    QJsonObject device;
+    if(!record.sysfsName.isEmpty())
+    {
+        device.insert("sysfsName",record.sysfsName);
+    }
+    device.insert("bus",(int)info.busNumber);
+    device.insert("address",(int)info.deviceAddress);
+    device.insert("port",(int)info.portNumber);
+    QJsonArray portArray;
+    for(int i=0;i<record.info.portPath.size();i++)
+    {
+        portArray.append((int)record.info.portPath.at(i));
+    }
+    device.insert("portPath",portArray);
+    device.insert("speed",info.speed);
+    device.insert("vendorId",QString("0x%1").arg(info.vendorId,4,16,QChar('0')));
+    device.insert("productId",QString("0x%1").arg(info.productId,4,16,QChar('0')));
+    device.insert("deviceClass",QString("0x%1").arg(info.deviceClass,2,16,QChar('0')));
+    device.insert("bcdUSB",QString("0x%1").arg(record.bcdUSB,4,16,QChar('0')));
+    device.insert("bcdDevice",QString("0x%1").arg(record.bcdDevice,4,16,QChar('0')));
+    device.insert("manufacturer",record.manufacturer);
+    device.insert("product",record.product);
+    device.insert("serial",record.serial);
+
+    const UsbConfigInfo &config = record.config;
+    QJsonObject configObject;
+    configObject.insert("configurationValue",(int)config.configurationValue);
+    configObject.insert("attributes",QString("0x%1").arg(config.attributes,2,16,QChar('0')));
+    configObject.insert("maxPower",config.maxPower);
+    QJsonArray interfaceArray;
+    for(int i=0;i<config.interfaceList.size();i++)
+    {
+        const UsbInterfaceInfo &interfaceInfo = config.interfaceList.at(i);
+        QJsonObject interfaceObject;
+        interfaceObject.insert("interfaceNumber",(int)interfaceInfo.interfaceNumber);
+        QJsonArray altSettingArray;
+        for(int j=0;j<interfaceInfo.altSettingList.size();j++)
+        {
+            const UsbAltSettingInfo &altSetting = interfaceInfo.altSettingList.at(j);
+            QJsonObject altSettingObject;
+            altSettingObject.insert("alternateSetting",(int)altSetting.alternateSetting);
+            altSettingObject.insert("interfaceClass",QString("0x%1").arg(altSetting.interfaceClass,2,16,QChar('0')));
+            altSettingObject.insert("interfaceSubClass",(int)altSetting.interfaceSubClass);
+            altSettingObject.insert("interfaceProtocol",(int)altSetting.interfaceProtocol);
+            QJsonArray endpointArray;
+            for(int k=0;k<altSetting.endpointList.size();k++)
+            {
+                const UsbEndpointInfo &endpoint = altSetting.endpointList.at(k);
+                QJsonObject endpointObject;
+                endpointObject.insert("address",QString("0x%1").arg(endpoint.address,2,16,QChar('0')));
+                endpointObject.insert("transferType",transferTypeNames[endpoint.transferType & 0x03]);
+                endpointObject.insert("maxPacketSize",endpoint.maxPacketSize);
+                endpointObject.insert("transactions",endpoint.transactions);
+                endpointObject.insert("interval",(int)endpoint.interval);
+                endpointArray.append(endpointObject);
+            }
+            altSettingObject.insert("endpoints",endpointArray);
+            altSettingArray.append(altSettingObject);
+        }
+        interfaceObject.insert("altSettings",altSettingArray);
+        interfaceArray.append(interfaceObject);
+    }
+    configObject.insert("interfaces",interfaceArray);
+    device.insert("configuration",configObject);
+    return device;
+}
+/*
+ *@brief:   增量刷新
+ * 已缓存的设备只读取devnum判断是否为同一次枚举(设备重新接入后地址会变化)，新设备在线程池中并行解析。
+ *@date:    2026.10.18
+ */
+void UsbDeviceDatabase::refresh()
+{
+    dirty.store(false);//先清除标记，刷新期间的热插拔会使下一次查询再次刷新
+    QStringList entryList = QDir(sysfsPath).entryList(QDir::Dirs|QDir::NoDotAndDotDot);
+    QSet<QString> nameSet;
+    QStringList parseList;//需要解析的设备目录
+    for(int i=0;i<entryList.size();i++)
+    {
+        const QString &name = entryList.at(i);
+        if(name.contains(QChar(':')))
+        {
+            continue;//接口目录(例如1-1.2:1.0)
+        }
+        nameSet.insert(name);
+        QString devicePath = sysfsPath+"/"+name;
+        QHash<QString,UsbDeviceRecord>::const_iterator it = recordHash.constFind(name);
+        if(it != recordHash.constEnd() &&
+                readAttribute(devicePath,"devnum").trimmed().toInt() == it.value().info.deviceAddress)
+        {
+            continue;
+        }
+        parseList.append(devicePath);
+    }
+    //移除已拔出的设备
+    QList<QString> cachedList = recordHash.keys();
+    for(int i=0;i<cachedList.size();i++)
+    {
+        if(!nameSet.contains(cachedList.at(i)))
+        {
+            recordHash.remove(cachedList.at(i));
+        }
+    }
+    if(parseList.isEmpty())
+    {
+        return;
+    }
+    QList<UsbDeviceRecord> recordList =
+            QtConcurrent::blockingMapped<QList<UsbDeviceRecord> >(parseList,&UsbDeviceDatabase::readRecord);
+    for(int i=0;i<recordList.size();i++)
+    {
+        if(!recordList.at(i).sysfsName.isEmpty())
+        {
+            recordHash.insert(recordList.at(i).sysfsName,recordList.at(i));
+        }
+    }
+}
+/*
+ *@brief:   解析一个设备目录
+ * descriptors文件依次为设备描述符和所有配置的描述符(内核在枚举时缓存，读取不访问设备)。
+ *@date:    2026.10.18
+ *@param:   devicePath:设备目录
+ *@return:  UsbDeviceRecord:设备记录，解析失败时sysfsName为空
+ */
+UsbDeviceRecord UsbDeviceDatabase::readRecord(const QString &devicePath)
+{
+    UsbDeviceRecord record;
+    QByteArray descriptors = readAttribute(devicePath,"descriptors");
+    const quint8 *bytes = reinterpret_cast<const quint8 *>(descriptors.constData());
+    if(descriptors.size() < LIBUSB_DT_DEVICE_SIZE || bytes[1] != LIBUSB_DT_DEVICE)
+    {
+        return record;
+    }
+    record.bcdUSB = bytes[2]|(bytes[3]<<8);
+    record.info.deviceClass = bytes[4];
+    record.info.vendorId = bytes[8]|(bytes[9]<<8);
+    record.info.productId = bytes[10]|(bytes[11]<<8);
+    record.bcdDevice = bytes[12]|(bytes[13]<<8);
+
+    record.sysfsName = devicePath.section('/',-1);
+    record.info.busNumber = readAttribute(devicePath,"busnum").trimmed().toInt();
+    record.info.deviceAddress = readAttribute(devicePath,"devnum").trimmed().toInt();
+    //端口路径:目录名"总线-端口.端口..."，根集线器为"usb总线"
+    int index = record.sysfsName.indexOf('-');
+    if(index != -1)
+    {
+        QStringList portList = record.sysfsName.mid(index+1).split('.');
+        for(int i=0;i<portList.size();i++)
+        {
+            record.info.portPath.append(portList.at(i).toInt());
+        }
+        record.info.portNumber = record.info.portPath.last();
+    }
+    QByteArray speed = readAttribute(devicePath,"speed").trimmed();//Mbps
+    if(speed == "1.5")
+    {
+        record.info.speed = LIBUSB_SPEED_LOW;
+    }
+    else if(speed == "12")
+    {
+        record.info.speed = LIBUSB_SPEED_FULL;
+    }
+    else if(speed == "480")
+    {
+        record.info.speed = LIBUSB_SPEED_HIGH;
+    }
+    else if(speed == "5000")
+    {
+        record.info.speed = LIBUSB_SPEED_SUPER;
+    }
+    else if(speed.toInt() >= 10000)//10000(Gen 2x1)、20000(Gen 2x2)
+    {
+        record.info.speed = USB_SPEED_SUPER_PLUS;
+    }
+    record.manufacturer = QString::fromUtf8(readAttribute(devicePath,"manufacturer").trimmed());
+    record.product = QString::fromUtf8(readAttribute(devicePath,"product").trimmed());
+    record.serial = QString::fromUtf8(readAttribute(devicePath,"serial").trimmed());
+
+    //当前配置(设备未配置时为空)
+    int activeConfig = readAttribute(devicePath,"bConfigurationValue").trimmed().toInt();
+    for(int offset=LIBUSB_DT_DEVICE_SIZE;activeConfig > 0 && offset+LIBUSB_DT_CONFIG_SIZE<=descriptors.size();)
+    {
+        int totalLength = bytes[offset+2]|(bytes[offset+3]<<8);
+        if(bytes[offset+1] != LIBUSB_DT_CONFIG || totalLength < LIBUSB_DT_CONFIG_SIZE)
+        {
+            break;
+        }
+        if(bytes[offset+5] == activeConfig)
+        {
+            record.config = UsbConfigInfo::fromRawDescriptor(descriptors.mid(offset,totalLength));
+            break;
+        }
+        offset += totalLength;
+    }
+    return record;
+}
+/*
+ *@brief:   读取设备目录下的属性文件
+ *@date:    2026.10.18
+ *@param:   devicePath:设备目录
+ *@param:   name:属性名
+ *@return:  QByteArray:文件内容，不存在时为空
+ */
+QByteArray UsbDeviceDatabase::readAttribute(const QString &devicePath, const QString &name)
+{
+    QFile file(devicePath+"/"+name);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return QByteArray();
+    }
+    return file.readAll();
+}
@@ -0,0 +1,59 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   基于sysfs的快速设备枚举及描述符缓存(Linux)
+ *
+ *libusb_get_device_list()枚举时需要逐个设备读取描述符，在集线器层级较多的设备上冷启动耗时可达数百毫秒。
+ *该类直接读取/sys/bus/usb/devices下内核已经缓存的属性和描述符(不访问设备)，新出现的设备并行解析，
+ *结果按sysfs目录名缓存，之后的查询只检查目录列表和设备地址，设备未变化时不重复解析。
+ *由UsbLibusbBackend持有，热插拔事件到达时标记缓存失效；注册了不限条件的热插拔监测之后，缓存未失效的
+ *查询直接返回，不再访问sysfs。
+ *非Linux平台或sysfs不可用时isAvailable()返回false，使用者退回到libusb的枚举。
+ */
+#ifndef USBDEVICEDATABASE_H
+#define USBDEVICEDATABASE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMultiMap>
+#include <QMutex>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <atomic>
+#include "usbbackend.h"
+
+class UsbDeviceDatabase
+{
+public:
+    explicit UsbDeviceDatabase(const QString &sysfsPath = "/sys/bus/usb/devices");
+
+    bool isAvailable() const;//sysfs是否可用
+    void invalidate();//标记缓存失效(热插拔时调用，可在任意线程)
+    void setHotplugTracked(bool tracked);//是否有不限条件的热插拔监测(有时缓存未失效的查询不访问sysfs)
+
+    QList<UsbDeviceRecord> getDeviceList();//获取设备记录(缓存失效时增量刷新)
+    bool containsDevice(const QMultiMap<quint16,quint16> &vpidMap);//是否接入了指定vpid的设备
+    QJsonArray toJson();//导出所有设备记录
+
+    static QJsonObject recordToJson(const UsbDeviceRecord &record);
+
+private:
+    void refresh();//增量刷新(调用前需加锁)
+    static UsbDeviceRecord readRecord(const QString &devicePath);//解析一个设备目录(在线程池中执行)
+    static QByteArray readAttribute(const QString &devicePath,const QString &name);
+
+    QString sysfsPath;
+    QMutex mutex;
+    QHash<QString,UsbDeviceRecord> recordHash;//sysfs目录名对应的设备记录
+    std::atomic<bool> dirty;//缓存失效
+    std::atomic<bool> hotplugTracked;
+};
+
+#endif // USBDEVICEDATABASE_H
@@ -0,0 +1,314 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB全双工通信通道
+ */
+#include "usbduplexchannel.h"
+#include <QMetaObject>
+#include <QDebug>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   usbComm:设备所属的UsbComm对象
+ *@param:   deviceHandle:设备句柄(对应接口需已声明)
+ *@param:   inEndpoint:IN端点地址
+ *@param:   outEndpoint:OUT端点地址
+ *@param:   parent:父对象
+ */
+UsbDuplexChannel::UsbDuplexChannel(UsbComm *usbComm, libusb_device_handle *deviceHandle,
+                                   quint8 inEndpoint, quint8 outEndpoint, QObject *parent)
+    :QObject(parent)
+{
+    this->usbComm = usbComm;
+    this->deviceHandle = deviceHandle;
+    this->inEndpoint = inEndpoint;
+    this->outEndpoint = outEndpoint;
+    inTransferSize = 512;
+    inTransferCount = 2;
+    pollInterval = 100;
+    outMaxInFlight = 2;
+    outTimeout = 0;
+    deliveryQueue = NULL;
+    running = false;
+    activeInCount = 0;
+    activeOutCount = 0;
+    queuedWriteBytes = 0;
+}
+
+UsbDuplexChannel::~UsbDuplexChannel()
+{
+    stop();
+}
+/*
+ *@brief:   设置IN方向参数(需在start之前设置)
+ *@date:    2026.10.18
+ *@param:   transferSize:单次传输大小，建议为端点最大包长的整数倍
+ *@param:   transferCount:同时挂起的传输数量
+ *@param:   pollInterval:轮询间隔，即每个传输的超时时间，单位ms
+ */
+void UsbDuplexChannel::setInConfig(int transferSize, int transferCount, quint32 pollInterval)
+{
+    inTransferSize = qMax(transferSize,1);
+    inTransferCount = qMax(transferCount,1);
+    this->pollInterval = pollInterval;
+}
+/*
+ *@brief:   设置OUT方向参数
+ *@date:    2026.10.18
+ *@param:   maxInFlight:同时挂起的最大传输数量，1表示严格按顺序一个接一个发送
+ *@param:   timeout:单次传输超时时间，单位ms， 0 无限制
+ */
+void UsbDuplexChannel::setOutConfig(int maxInFlight, quint32 timeout)
+{
+    QMutexLocker locker(&queueMutex);
+    outMaxInFlight = qMax(maxInFlight,1);
+    outTimeout = timeout;
+}
+/*
+ *@brief:   设置批量投递(需在start之前设置)
+ * 启用后IN方向接收到的结果放入无锁队列，通道所在线程每批只被唤醒一次，一次取走全部数据并发射
+ * dataBatchReceived()信号，不再发射dataReceived()。通道对象需位于接收数据的线程(通常为GUI线程)。
+ *@date:    2026.10.18
+ *@param:   enable:true=启用  false=恢复逐包的dataReceived()信号
+ *@param:   capacity:队列容量，队列满时新到的数据被丢弃(计入统计)
+ *@param:   frameIntervalMs:两批之间的最小间隔，例如按界面刷新周期合并，0表示唤醒后立即送达
+ */
+void UsbDuplexChannel::setBatchDelivery(bool enable, int capacity, int frameIntervalMs)
+{
+    if(running)
+    {
+        qDebug()<<"UsbDuplexChannel:setBatchDelivery() must be called before start().";
+        return;
+    }
+    if(deliveryQueue != NULL)
+    {
+        delete deliveryQueue;
+        deliveryQueue = NULL;
+    }
+    if(enable)
+    {
+        deliveryQueue = new UsbDeliveryQueue(capacity,frameIntervalMs,this);
+        connect(deliveryQueue,&UsbDeliveryQueue::resultsReady,this,&UsbDuplexChannel::dataBatchReceived);
+    }
+}
+/*
+ *@brief:   获取批量投递的统计
+ *@date:    2026.10.18
+ *@return:  UsbDeliveryStats:统计，未启用批量投递时为空
+ */
+UsbDeliveryStats UsbDuplexChannel::getDeliveryStats() const
+{
+    return (deliveryQueue != NULL)?deliveryQueue->getStats():UsbDeliveryStats();
+}
+/*
+ *@brief:   启动通道，IN方向开始挂起传输
+ *@date:    2026.10.18
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbDuplexChannel::start()
+{
+    if(running)
+    {
+        return true;
+    }
+    running = true;
+    if(inEndpoint & LIBUSB_ENDPOINT_IN)
+    {
+        submitInTransfers();
+        QMutexLocker locker(&queueMutex);
+        if(activeInCount == 0)
+        {
+            running = false;
+            return false;
+        }
+    }
+    return true;
+}
+/*
+ *@brief:   停止通道，取消两个方向所有挂起的传输，未发送的数据被丢弃
+ *@date:    2026.10.18
+ */
+void UsbDuplexChannel::stop()
+{
+    if(!running)
+    {
+        return;
+    }
+    running = false;
+    queueMutex.lock();
+    writeQueue.clear();
+    queueMutex.unlock();
+    usbComm->cancelTransfers(deviceHandle,inEndpoint);
+    usbComm->cancelTransfers(deviceHandle,outEndpoint);
+    QMutexLocker locker(&queueMutex);
+    queuedWriteBytes = 0;
+}
+/*
+ *@brief:   写数据，进入发送队列后立即返回，写出后发射bytesWritten()信号
+ *@date:    2026.10.18
+ *@param:   data:待写数据
+ *@return:  bool:true=已进入发送队列  false=通道未启动或提交失败
+ */
+bool UsbDuplexChannel::write(const QByteArray &data)
+{
+    if(!running || data.isEmpty())
+    {
+        return false;
+    }
+    QMutexLocker locker(&queueMutex);
+    writeQueue.enqueue(data);
+    queuedWriteBytes += data.size();
+    return submitOutTransfers();
+}
+/*
+ *@brief:   获取发送队列中以及正在发送的数据长度
+ *@date:    2026.10.18
+ *@return:  qint64:待写出数据长度
+ */
+qint64 UsbDuplexChannel::pendingWriteBytes() const
+{
+    QMutexLocker locker(&queueMutex);
+    return queuedWriteBytes;
+}
+/*
+ *@brief:   IN端点STALL后清除halt并重新挂起传输
+ *@date:    2026.10.18
+ */
+void UsbDuplexChannel::recoverInEndpoint()
+{
+    if(!running)
+    {
+        return;
+    }
+    usbComm->clearUsbHalt(deviceHandle,inEndpoint);
+    submitInTransfers();
+}
+/*
+ *@brief:   IN方向流式传输回调(在后端的事件线程中执行)
+ *@date:    2026.10.18
+ *@param:   result:传输结果
+ *@return:  bool:true=重新提交  false=停止该传输
+ */
+bool UsbDuplexChannel::inCallback(const UsbTransferResult &result)
+{
+    bool transferOk = (result.status == LIBUSB_TRANSFER_COMPLETED ||
+                       result.status == LIBUSB_TRANSFER_TIMED_OUT);//超时即轮询间隔到达，可能带有部分数据
+    if(transferOk && result.actualLength > 0 && deliveryQueue != NULL)
+    {
+        deliveryQueue->push(result);//队列满时丢弃，计入统计
+    }
+    else if(transferOk && result.actualLength > 0)
+    {
+        //零拷贝接收的data不持有池化buffer，信号可能跨线程排队，此时传递独立的数据
+        emit dataReceived(result.buffer.isNull()?result.data:QByteArray(result.data.constData(),result.data.size()));
+    }
+    if(transferOk && running)
+    {
+        return true;
+    }
+
+    queueMutex.lock();
+    activeInCount--;
+    bool allStopped = (activeInCount == 0);
+    queueMutex.unlock();
+    if(!running || result.status == LIBUSB_TRANSFER_CANCELLED)
+    {
+        return false;
+    }
+    if(result.status == LIBUSB_TRANSFER_STALL)
+    {
+        //回调中不能调用阻塞的清除操作，等所有传输都结束后回到UsbComm所在线程处理
+        if(allStopped)
+        {
+            QMetaObject::invokeMethod(this,"recoverInEndpoint",Qt::QueuedConnection);
+        }
+        return false;
+    }
+    emit errorOccurred(inEndpoint,result.status);
+    return false;
+}
+/*
+ *@brief:   OUT方向传输回调(在后端的事件线程中执行)，并从发送队列中提交下一个传输
+ *@date:    2026.10.18
+ *@param:   result:传输结果
+ *@param:   length:该传输提交的数据长度
+ */
+void UsbDuplexChannel::outCallback(const UsbTransferResult &result, int length)
+{
+    queueMutex.lock();
+    activeOutCount--;
+    queuedWriteBytes -= length;
+    bool submitOk = running?submitOutTransfers():true;
+    bool queueEmpty = (queuedWriteBytes == 0);
+    queueMutex.unlock();
+
+    if(result.actualLength > 0)
+    {
+        emit bytesWritten(result.actualLength);
+    }
+    if(result.status != LIBUSB_TRANSFER_COMPLETED && result.status != LIBUSB_TRANSFER_CANCELLED)
+    {
+        emit errorOccurred(outEndpoint,result.status);
+    }
+    if(!submitOk)
+    {
+        emit errorOccurred(outEndpoint,LIBUSB_TRANSFER_ERROR);
+    }
+    if(queueEmpty && running)
+    {
+        emit writeQueueEmpty();
+    }
+}
+/*
+ *@brief:   补充提交IN方向的流式传输，直到达到设定数量
+ *@date:    2026.10.18
+ */
+void UsbDuplexChannel::submitInTransfers()
+{
+    QMutexLocker locker(&queueMutex);
+    while(running && activeInCount < inTransferCount)
+    {
+        activeInCount++;
+        locker.unlock();
+        bool ok = usbComm->submitStreamTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,inEndpoint,
+                                                inTransferSize,pollInterval,
+                                                [this](const UsbTransferResult &result){return inCallback(result);});
+        locker.relock();
+        if(!ok)
+        {
+            activeInCount--;
+            break;
+        }
+    }
+}
+/*
+ *@brief:   从发送队列中提交OUT传输，直到达到最大挂起数量(调用前需对queueMutex加锁)
+ *@date:    2026.10.18
+ *@return:  bool:true=成功  false=有传输提交失败(对应数据被丢弃)
+ */
+bool UsbDuplexChannel::submitOutTransfers()
+{
+    bool allOk = true;
+    while(activeOutCount < outMaxInFlight && !writeQueue.isEmpty())
+    {
+        QByteArray data = writeQueue.dequeue();
+        int length = data.size();
+        activeOutCount++;
+        bool ok = usbComm->submitTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,outEndpoint,data,length,outTimeout,
+                                          [this,length](const UsbTransferResult &result){outCallback(result,length);});
+        if(!ok)
+        {
+            activeOutCount--;
+            queuedWriteBytes -= length;
+            allOk = false;
+        }
+    }
+    return allOk;
+}
@@ -0,0 +1,89 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB全双工通信通道
+ *
+ *同步的bulkTransfer()在一个线程中只能串行收发，例如打印机长时间发送打印数据时，无法及时读取IN端点上的
+ *状态(缺纸等)。该类在同一个设备句柄的一对IN/OUT端点上建立全双工通道，两个方向各自维护独立的挂起队列，
+ *共用UsbComm的事件线程:
+ *IN方向始终挂起若干个流式传输，超时时间即轮询间隔，无论OUT方向是否繁忙，状态数据最迟在一个轮询间隔内到达；
+ *OUT方向的写数据进入发送队列，最多同时挂起maxInFlight个传输，完成后直接在事件线程中提交下一个，不经过调用线程。
+ *高包率的设备可以启用批量投递(setBatchDelivery())，接收到的数据经UsbDeliveryQueue交给通道所在线程，
+ *每批只唤醒一次，通过dataBatchReceived()信号整批送达，代替逐包的dataReceived()信号。
+ */
+#ifndef USBDUPLEXCHANNEL_H
+#define USBDUPLEXCHANNEL_H
+
+#include <QObject>
+#include <QQueue>
+#include <QByteArray>
+#include <QMutex>
+#include "usbcomm.h"
+#include "usbdeliveryqueue.h"
+
+class UsbDuplexChannel : public QObject
+{
+    Q_OBJECT
+public:
+    UsbDuplexChannel(UsbComm *usbComm,libusb_device_handle *deviceHandle,
+                     quint8 inEndpoint,quint8 outEndpoint,QObject *parent = 0);
+    ~UsbDuplexChannel();
+
+    //设置IN方向参数(需在start之前设置):单次传输大小、同时挂起的传输数量、轮询间隔(ms)
+    void setInConfig(int transferSize=512,int transferCount=2,quint32 pollInterval=100);
+    //设置OUT方向参数:同时挂起的最大传输数量、单次传输超时时间(ms，0 无限制)
+    void setOutConfig(int maxInFlight=2,quint32 timeout=0);
+    //设置批量投递(需在start之前设置，通道需位于接收数据的线程):队列容量、两批之间的最小间隔(ms)
+    void setBatchDelivery(bool enable,int capacity=1024,int frameIntervalMs=0);
+    UsbDeliveryStats getDeliveryStats() const;//批量投递的统计(未启用时为空)
+
+    bool start();//启动通道(IN方向开始挂起传输)
+    void stop();//停止通道，取消两个方向所有挂起的传输，未发送的数据被丢弃
+    bool isRunning() const{return running;}
+
+    bool write(const QByteArray &data);//写数据(进入发送队列，立即返回)
+    qint64 pendingWriteBytes() const;//发送队列中以及正在发送的数据长度
+
+signals:
+    void dataReceived(const QByteArray &data);//IN方向接收到数据(零拷贝接收时为拷贝出的独立数据，可以任意保留)
+    //IN方向接收到的一批数据(启用批量投递时代替dataReceived)，零拷贝接收时结果持有池化buffer，不拷贝数据
+    void dataBatchReceived(const QVector<UsbTransferResult> &results);
+    void bytesWritten(qint64 bytes);//OUT方向数据已写出
+    void writeQueueEmpty();//发送队列已清空(所有数据均已写出)
+    void errorOccurred(int endpoint,int status);//传输出错，status详见enum libusb_transfer_status{}
+
+private slots:
+    void recoverInEndpoint();//IN端点STALL后清除halt并重新挂起传输(在UsbComm所在线程执行)
+
+private:
+    bool inCallback(const UsbTransferResult &result);//IN方向流式传输回调(事件线程)
+    void outCallback(const UsbTransferResult &result,int length);//OUT方向传输回调(事件线程)
+    void submitInTransfers();//补充提交IN方向的流式传输
+    bool submitOutTransfers();//从发送队列中提交OUT传输，直到达到最大挂起数量(调用前需对queueMutex加锁)
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 inEndpoint;
+    quint8 outEndpoint;
+    int inTransferSize;
+    int inTransferCount;
+    quint32 pollInterval;
+    int outMaxInFlight;
+    quint32 outTimeout;
+    UsbDeliveryQueue *deliveryQueue;//批量投递队列，未启用时为NULL
+
+    volatile bool running;
+    mutable QMutex queueMutex;//两个方向挂起计数和发送队列的互斥锁(事件线程与调用线程共同访问)
+    int activeInCount;//IN方向挂起的传输数量
+    int activeOutCount;//OUT方向挂起的传输数量
+    QQueue<QByteArray> writeQueue;//发送队列
+    qint64 queuedWriteBytes;//发送队列及正在发送的数据长度
+};
+
+#endif // USBDUPLEXCHANNEL_H
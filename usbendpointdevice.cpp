@@ -0,0 +1,473 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB端点的QIODevice封装
+ */
+#include "usbendpointdevice.h"
+#include <QMetaObject>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <string.h>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   usbComm:设备所属的UsbComm对象
+ *@param:   deviceHandle:设备句柄(对应接口需已声明)
+ *@param:   inEndpoint:IN端点地址，只写时可传0
+ *@param:   outEndpoint:OUT端点地址，只读时可传0
+ *@param:   parent:父对象
+ */
+UsbEndpointDevice::UsbEndpointDevice(UsbComm *usbComm, libusb_device_handle *deviceHandle,
+                                     quint8 inEndpoint, quint8 outEndpoint, QObject *parent)
+    :QIODevice(parent)
+{
+    this->usbComm = usbComm;
+    this->deviceHandle = deviceHandle;
+    this->inEndpoint = inEndpoint;
+    this->outEndpoint = outEndpoint;
+    transferSize = 16384;
+    transferCount = 4;
+    bufferSize = 0;
+    readTimeout = 100;
+    writeTimeout = 0;
+    ringHead = 0;
+    ringSize = 0;
+    activeReadCount = 0;
+    readNotifyPending = false;
+    readStopped = true;
+    pendingWriteBytes = 0;
+}
+
+UsbEndpointDevice::~UsbEndpointDevice()
+{
+    close();
+}
+/*
+ *@brief:   设置预读参数(需在open之前设置)
+ *@date:    2026.10.18
+ *@param:   transferSize:IN端点单次传输大小，建议为端点最大包长的整数倍
+ *@param:   transferCount:IN端点同时挂起的传输数量
+ *@param:   bufferSize:环形缓冲区容量，0表示自动(transferSize*transferCount*4)，不能小于transferSize*transferCount
+ */
+void UsbEndpointDevice::setReadAheadConfig(int transferSize, int transferCount, int bufferSize)
+{
+    if(isOpen())
+    {
+        qDebug()<<"UsbEndpointDevice::setReadAheadConfig must be called before open";
+        return;
+    }
+    this->transferSize = qMax(transferSize,1);
+    this->transferCount = qMax(transferCount,1);
+    this->bufferSize = bufferSize;
+}
+/*
+ *@brief:   打开设备，可读模式下开始在IN端点上预读
+ *@date:    2026.10.18
+ *@param:   mode:打开模式，内部会附加QIODevice::Unbuffered，避免与内部环形缓冲区重复缓存
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbEndpointDevice::open(QIODevice::OpenMode mode)
+{
+    if(isOpen())
+    {
+        return false;
+    }
+    if(((mode & QIODevice::ReadOnly) && !(inEndpoint & LIBUSB_ENDPOINT_IN)) ||
+            ((mode & QIODevice::WriteOnly) && (outEndpoint & LIBUSB_ENDPOINT_IN)))
+    {
+        setErrorString("endpoint direction does not match open mode");
+        return false;
+    }
+    int minBufferSize = transferSize*transferCount;
+    int capacity = (bufferSize == 0)?minBufferSize*4:qMax(bufferSize,minBufferSize);
+    {
+        QMutexLocker locker(&ringMutex);
+        ringBuffer.resize(capacity);
+        ringHead = 0;
+        ringSize = 0;
+        activeReadCount = 0;
+        readNotifyPending = false;
+        readStopped = !(mode & QIODevice::ReadOnly);
+        pendingWriteBytes = 0;
+    }
+    QIODevice::open(mode | QIODevice::Unbuffered);
+    if(mode & QIODevice::ReadOnly)
+    {
+        submitReadTransfers();
+        if(activeReadCount == 0)
+        {
+            setErrorString("submit read transfer failed");
+            QIODevice::close();
+            return false;
+        }
+    }
+    return true;
+}
+/*
+ *@brief:   关闭设备，取消所有挂起的传输(未写出的数据会被丢弃)
+ *@date:    2026.10.18
+ */
+void UsbEndpointDevice::close()
+{
+    if(!isOpen())
+    {
+        return;
+    }
+    ringMutex.lock();
+    readStopped = true;//流式传输回调返回false，不再重新提交
+    ringMutex.unlock();
+    if(openMode() & QIODevice::ReadOnly)
+    {
+        usbComm->cancelTransfers(deviceHandle,inEndpoint);
+    }
+    if(openMode() & QIODevice::WriteOnly)
+    {
+        usbComm->cancelTransfers(deviceHandle,outEndpoint);
+    }
+    QIODevice::close();
+    QMutexLocker locker(&ringMutex);
+    ringHead = 0;
+    ringSize = 0;
+    pendingWriteBytes = 0;
+}
+/*
+ *@brief:   获取可读数据长度
+ *@date:    2026.10.18
+ *@return:  qint64:可读数据长度
+ */
+qint64 UsbEndpointDevice::bytesAvailable() const
+{
+    QMutexLocker locker(&ringMutex);
+    return ringSize + QIODevice::bytesAvailable();
+}
+/*
+ *@brief:   获取已提交但尚未写出的数据长度
+ *@date:    2026.10.18
+ *@return:  qint64:待写出数据长度
+ */
+qint64 UsbEndpointDevice::bytesToWrite() const
+{
+    QMutexLocker locker(&ringMutex);
+    return pendingWriteBytes;
+}
+/*
+ *@brief:   判断是否可以读取一行数据
+ *@date:    2026.10.18
+ *@return:  bool:true=缓冲区中有完整的一行
+ */
+bool UsbEndpointDevice::canReadLine() const
+{
+    QMutexLocker locker(&ringMutex);
+    return ringIndexOf('\n') != -1 || QIODevice::canReadLine();
+}
+/*
+ *@brief:   阻塞等待新数据到达
+ *@date:    2026.10.18
+ *@param:   msecs:超时时间，单位ms，-1表示一直等待
+ *@return:  bool:true=有数据可读  false=超时或读端点已停止
+ */
+bool UsbEndpointDevice::waitForReadyRead(int msecs)
+{
+    QMutexLocker locker(&ringMutex);
+    QElapsedTimer timer;
+    timer.start();
+    while(ringSize == 0)
+    {
+        if(readStopped)
+        {
+            return false;
+        }
+        qint64 remain = (msecs < 0)?1000:msecs-timer.elapsed();
+        if(remain <= 0)
+        {
+            return false;
+        }
+        readCond.wait(&ringMutex,(unsigned long)remain);
+    }
+    locker.unlock();
+    emit readyRead();
+    return true;
+}
+/*
+ *@brief:   阻塞等待写传输完成
+ *@date:    2026.10.18
+ *@param:   msecs:超时时间，单位ms，-1表示一直等待
+ *@return:  bool:true=所有数据已写出  false=超时
+ */
+bool UsbEndpointDevice::waitForBytesWritten(int msecs)
+{
+    QMutexLocker locker(&ringMutex);
+    QElapsedTimer timer;
+    timer.start();
+    while(pendingWriteBytes > 0)
+    {
+        qint64 remain = (msecs < 0)?1000:msecs-timer.elapsed();
+        if(remain <= 0)
+        {
+            return false;
+        }
+        writeCond.wait(&ringMutex,(unsigned long)remain);
+    }
+    return true;
+}
+/*
+ *@brief:   从环形缓冲区读取数据(不会阻塞在总线上)
+ *@date:    2026.10.18
+ *@param:   data:数据接收buffer
+ *@param:   maxSize:最大读取长度
+ *@return:  qint64:实际读取长度，读端点已停止且无数据时返回-1
+ */
+qint64 UsbEndpointDevice::readData(char *data, qint64 maxSize)
+{
+    ringMutex.lock();
+    int len = ringRead(data,(int)qMin(maxSize,(qint64)ringSize));
+    bool stopped = readStopped;
+    ringMutex.unlock();
+    //缓冲区空间释放后补充提交因空间不足而暂停的预读传输
+    if(!stopped)
+    {
+        submitReadTransfers();
+    }
+    if(len == 0 && stopped)
+    {
+        return -1;
+    }
+    return len;
+}
+/*
+ *@brief:   从环形缓冲区读取一行数据(包括'\n')
+ *@date:    2026.10.18
+ *@param:   data:数据接收buffer
+ *@param:   maxSize:最大读取长度(QIODevice已预留结尾'\0'的位置)
+ *@return:  qint64:实际读取长度
+ */
+qint64 UsbEndpointDevice::readLineData(char *data, qint64 maxSize)
+{
+    ringMutex.lock();
+    int index = ringIndexOf('\n');
+    int len = (index == -1)?ringSize:index+1;
+    len = ringRead(data,(int)qMin(maxSize,(qint64)len));
+    bool stopped = readStopped;
+    ringMutex.unlock();
+    if(!stopped)
+    {
+        submitReadTransfers();
+    }
+    return len;
+}
+/*
+ *@brief:   提交写数据，立即返回，写出完成后发射bytesWritten()信号
+ *@date:    2026.10.18
+ *@param:   data:待写数据
+ *@param:   len:待写数据长度
+ *@return:  qint64:提交的数据长度，-1表示提交失败
+ */
+qint64 UsbEndpointDevice::writeData(const char *data, qint64 len)
+{
+    if(len <= 0)
+    {
+        return 0;
+    }
+    ringMutex.lock();
+    pendingWriteBytes += len;
+    ringMutex.unlock();
+    bool ok = usbComm->submitTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,outEndpoint,
+                                      QByteArray(data,(int)len),(int)len,writeTimeout,
+                                      [this,len](const UsbTransferResult &result)
+    {
+        ringMutex.lock();
+        pendingWriteBytes -= len;
+        writeCond.wakeAll();
+        ringMutex.unlock();
+        if(!result.isCompleted())
+        {
+            qDebug()<<"UsbEndpointDevice write error, status:"<<result.status;
+        }
+        if(result.actualLength > 0)
+        {
+            QMetaObject::invokeMethod(this,"notifyBytesWritten",Qt::QueuedConnection,
+                                      Q_ARG(qint64,(qint64)result.actualLength));
+        }
+    });
+    if(!ok)
+    {
+        QMutexLocker locker(&ringMutex);
+        pendingWriteBytes -= len;
+        setErrorString("submit write transfer failed");
+        return -1;
+    }
+    return len;
+}
+/*
+ *@brief:   通知有新数据可读
+ *@date:    2026.10.18
+ */
+void UsbEndpointDevice::notifyReadyRead()
+{
+    ringMutex.lock();
+    readNotifyPending = false;
+    bool hasData = (ringSize > 0);
+    ringMutex.unlock();
+    if(hasData)
+    {
+        emit readyRead();
+    }
+}
+/*
+ *@brief:   通知数据已写出
+ *@date:    2026.10.18
+ *@param:   bytes:写出的数据长度
+ */
+void UsbEndpointDevice::notifyBytesWritten(qint64 bytes)
+{
+    emit bytesWritten(bytes);
+}
+/*
+ *@brief:   通知读端点出错，所有预读传输均已停止
+ *@date:    2026.10.18
+ *@param:   status:传输状态，详见enum libusb_transfer_status{}
+ */
+void UsbEndpointDevice::notifyReadError(int status)
+{
+    setErrorString(QString("read transfer error, status:%1").arg(status));
+    emit readChannelFinished();
+}
+/*
+ *@brief:   IN端点流式传输回调(在后端的事件线程中执行)
+ * 将接收到的数据写入环形缓冲区，并根据缓冲区剩余空间决定是否重新提交，保证所有挂起的传输完成后都不会溢出。
+ *@date:    2026.10.18
+ *@param:   result:传输结果
+ *@return:  bool:true=重新提交  false=停止该传输
+ */
+bool UsbEndpointDevice::readCallback(const UsbTransferResult &result)
+{
+    QMutexLocker locker(&ringMutex);
+    bool transferOk = (result.status == LIBUSB_TRANSFER_COMPLETED ||
+                       result.status == LIBUSB_TRANSFER_TIMED_OUT);//超时可能带有部分数据
+    if(transferOk && result.actualLength > 0)
+    {
+        ringWrite(result.data.constData(),result.actualLength);
+        readCond.wakeAll();
+        if(!readNotifyPending)
+        {
+            readNotifyPending = true;
+            QMetaObject::invokeMethod(this,"notifyReadyRead",Qt::QueuedConnection);
+        }
+    }
+    //剩余空间需要容纳包括本传输在内所有挂起传输的最大数据量，否则暂停本传输，等待读取后再补充
+    bool resubmit = transferOk && !readStopped &&
+            (ringBuffer.size()-ringSize) >= activeReadCount*transferSize;
+    if(!resubmit)
+    {
+        activeReadCount--;
+        if(!transferOk && result.status != LIBUSB_TRANSFER_CANCELLED && !readStopped)
+        {
+            readStopped = true;
+            readCond.wakeAll();
+            QMetaObject::invokeMethod(this,"notifyReadError",Qt::QueuedConnection,Q_ARG(int,result.status));
+        }
+    }
+    return resubmit;
+}
+/*
+ *@brief:   补充提交IN端点的流式传输，直到达到设定数量或缓冲区空间不足
+ *@date:    2026.10.18
+ */
+void UsbEndpointDevice::submitReadTransfers()
+{
+    QMutexLocker locker(&ringMutex);
+    while(!readStopped && activeReadCount < transferCount &&
+          (ringBuffer.size()-ringSize) >= (activeReadCount+1)*transferSize)
+    {
+        activeReadCount++;
+        locker.unlock();
+        bool ok = usbComm->submitStreamTransfer(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,inEndpoint,
+                                                transferSize,readTimeout,
+                                                [this](const UsbTransferResult &result){return readCallback(result);});
+        locker.relock();
+        if(!ok)
+        {
+            activeReadCount--;
+            break;
+        }
+    }
+}
+/*
+ *@brief:   向环形缓冲区写入数据(调用前需对ringMutex加锁，空间由调用方保证)
+ *@date:    2026.10.18
+ *@param:   data:待写数据
+ *@param:   len:待写数据长度
+ */
+void UsbEndpointDevice::ringWrite(const char *data, int len)
+{
+    int capacity = ringBuffer.size();
+    if(len > capacity-ringSize)
+    {
+        qDebug()<<"UsbEndpointDevice ring buffer overflow, drop"<<len-(capacity-ringSize)<<"bytes";
+        len = capacity-ringSize;
+    }
+    int tail = (ringHead+ringSize)%capacity;
+    int firstLen = qMin(len,capacity-tail);
+    memcpy(ringBuffer.data()+tail,data,firstLen);
+    memcpy(ringBuffer.data(),data+firstLen,len-firstLen);
+    ringSize += len;
+}
+/*
+ *@brief:   从环形缓冲区读取数据(调用前需对ringMutex加锁)
+ *@date:    2026.10.18
+ *@param:   data:数据接收buffer
+ *@param:   maxLen:最大读取长度
+ *@return:  int:实际读取长度
+ */
+int UsbEndpointDevice::ringRead(char *data, int maxLen)
+{
+    int capacity = ringBuffer.size();
+    int len = qMin(maxLen,ringSize);
+    if(len <= 0)
+    {
+        return 0;
+    }
+    int firstLen = qMin(len,capacity-ringHead);
+    memcpy(data,ringBuffer.constData()+ringHead,firstLen);
+    memcpy(data+firstLen,ringBuffer.constData(),len-firstLen);
+    ringHead = (ringHead+len)%capacity;
+    ringSize -= len;
+    if(ringSize == 0)
+    {
+        ringHead = 0;//缓冲区为空时复位，尽量让后续数据连续存放
+    }
+    return len;
+}
+/*
+ *@brief:   在环形缓冲区的可读数据中查找字符(调用前需对ringMutex加锁)
+ *@date:    2026.10.18
+ *@param:   c:要查找的字符
+ *@return:  int:相对可读数据起始位置的偏移，-1表示未找到
+ */
+int UsbEndpointDevice::ringIndexOf(char c) const
+{
+    if(ringSize == 0)
+    {
+        return -1;
+    }
+    int capacity = ringBuffer.size();
+    int firstLen = qMin(ringSize,capacity-ringHead);
+    const char *p = (const char *)memchr(ringBuffer.constData()+ringHead,c,firstLen);
+    if(p != NULL)
+    {
+        return p-(ringBuffer.constData()+ringHead);
+    }
+    p = (const char *)memchr(ringBuffer.constData(),c,ringSize-firstLen);
+    if(p != NULL)
+    {
+        return firstLen+(p-ringBuffer.constData());
+    }
+    return -1;
+}
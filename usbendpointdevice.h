@@ -0,0 +1,89 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB端点的QIODevice封装
+ *
+ *该类将已声明接口的一对IN/OUT端点封装成QIODevice，方便直接配合QDataStream、QTextStream等Qt的流式接口使用。
+ *打开后内部会在IN端点上始终挂起若干个流式传输(预读)，接收到的数据在事件线程中写入内部环形缓冲区，所以
+ *read()只从缓冲区取数据，永远不会阻塞在总线上；write()提交异步传输后立即返回，完成后发射bytesWritten()信号。
+ *注:该类对象需要与其使用的UsbComm对象位于同一线程，并且在UsbComm关闭设备之前关闭。
+ */
+#ifndef USBENDPOINTDEVICE_H
+#define USBENDPOINTDEVICE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include "usbcomm.h"
+
+class UsbEndpointDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    UsbEndpointDevice(UsbComm *usbComm,libusb_device_handle *deviceHandle,
+                      quint8 inEndpoint,quint8 outEndpoint,QObject *parent = 0);
+    ~UsbEndpointDevice();
+
+    //设置预读参数(需在open之前设置):单次传输大小、同时挂起的传输数量、环形缓冲区容量(0表示自动)
+    void setReadAheadConfig(int transferSize=16384,int transferCount=4,int bufferSize=0);
+    //设置传输超时时间，单位ms，IN方向超时后会自动重新提交(即轮询间隔)
+    void setReadTimeout(quint32 timeout){readTimeout = timeout;}
+    void setWriteTimeout(quint32 timeout){writeTimeout = timeout;}
+
+    virtual bool open(OpenMode mode);
+    virtual void close();
+    virtual bool isSequential() const{return true;}
+    virtual qint64 bytesAvailable() const;
+    virtual qint64 bytesToWrite() const;
+    virtual bool canReadLine() const;
+    virtual bool waitForReadyRead(int msecs);
+    virtual bool waitForBytesWritten(int msecs);
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxSize);
+    virtual qint64 readLineData(char *data, qint64 maxSize);
+    virtual qint64 writeData(const char *data, qint64 len);
+
+private slots:
+    void notifyReadyRead();//通知有新数据可读(由事件线程队列调用)
+    void notifyBytesWritten(qint64 bytes);//通知数据已写出(由事件线程队列调用)
+    void notifyReadError(int status);//通知读端点出错(由事件线程队列调用)
+
+private:
+    bool readCallback(const UsbTransferResult &result);//IN端点流式传输回调(事件线程)
+    void submitReadTransfers();//补充提交IN端点的流式传输，直到达到设定数量或缓冲区空间不足
+    //环形缓冲区操作(调用前需对ringMutex加锁)
+    void ringWrite(const char *data,int len);
+    int ringRead(char *data,int maxLen);
+    int ringIndexOf(char c) const;
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 inEndpoint;//IN端点地址
+    quint8 outEndpoint;//OUT端点地址
+    int transferSize;//IN端点单次传输大小
+    int transferCount;//IN端点同时挂起的传输数量
+    int bufferSize;//环形缓冲区容量
+    quint32 readTimeout;
+    quint32 writeTimeout;
+
+    QByteArray ringBuffer;//环形缓冲区
+    int ringHead;//可读数据起始位置
+    int ringSize;//可读数据长度
+    int activeReadCount;//IN端点当前挂起的流式传输数量
+    bool readNotifyPending;//是否已有待处理的readyRead通知(合并通知，避免每包一次)
+    bool readStopped;//读端点已停止(关闭或出错)
+    qint64 pendingWriteBytes;//已提交但尚未完成的写数据长度
+    mutable QMutex ringMutex;//环形缓冲区及计数的互斥锁(事件线程与调用线程共同访问)
+    QWaitCondition readCond;//有新数据到达
+    QWaitCondition writeCond;//有写传输完成
+};
+
+#endif // USBENDPOINTDEVICE_H
@@ -0,0 +1,117 @@
+/****************************************************************************
+*
+* Copyright (C) 2021-2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2021.03.18
+ *@update:  2026.10.18
+ *@brief:   USB事件处理组件
+ */
+#include "usbeventhandler.h"
+#include "usbtrace.h"
+#include "usbmetrics.h"
+#include <QDebug>
+
+/*
+ *@brief:   构造函数
+ *@date:    2021.03.18
+ *@param:   context:表示libusb的一个会话
+ *@parent:  parent:父对象
+ */
+UsbEventHandler::UsbEventHandler(libusb_context *context, QObject *parent)
+    :QThread(parent)
+{
+    this->context = context;
+    this->stopped = false;
+    this->busyPoll = NULL;
+}
+/*
+ *@brief:   子线程运行
+ *@date:    2021.03.18
+ *@update:  2026.10.18
+ */
+void UsbEventHandler::run()
+{
+    //超时时间 100ms
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;
+
+    //绑定CPU、设置实时调度，减少线程迁移和抢占带来的延迟抖动
+    UsbRealtime::applyThreadConfig(threadConfig);
+
+    bool spinAllowed = true;//上一次忙轮询未命中时先阻塞等待一次，避免一直占用CPU
+    while(!this->stopped && context != NULL)
+    {
+        /* 处理挂起的事件，非阻塞，超时即返回
+         * 最开始使用的是libusb_handle_events()阻塞操作，但该阻塞会导致线程无法正常结束，
+         * 调用terminate()强制结束后执行wait操作会卡死，怀疑是该阻塞操作会陷入内核态，导
+         * 致在用户态下强制终止线程失败。
+         * 注:如果有挂起的热插拔事件或者异步传输完成事件，注册的回调函数会在该线程内被调用。
+         */
+        if(libusb_try_lock_events(context) == 0)//获得事件锁，成为事件处理者
+        {
+            //其他线程正在关闭设备时需要让出事件锁
+            if(libusb_event_handling_ok(context))
+            {
+                if(spinAllowed && busyPoll != NULL && busyPoll->isActive())
+                {
+                    spinAllowed = spinEvents();
+                }
+                else
+                {
+                    USB_TRACE(EventLoopBegin,context,0,0,0);
+                    int err = libusb_handle_events_locked(context,&tv);
+                    USB_TRACE(EventLoopEnd,context,0,0,err);
+                    Q_UNUSED(err)
+                    spinAllowed = true;
+                }
+            }
+            libusb_unlock_events(context);
+        }
+        else//其他线程正在处理事件，作为等待者等待其处理完一轮事件(或超时)后再尝试
+        {
+            libusb_lock_event_waiters(context);
+            if(libusb_event_handler_active(context))
+            {
+                libusb_wait_for_event(context,&tv);
+            }
+            libusb_unlock_event_waiters(context);
+        }
+    }
+}
+/*
+ *@brief:   忙轮询:以零超时反复处理事件，直到需要忙轮询的传输全部完成或超过轮询窗口
+ * 忙轮询期间不释放事件锁，libusb在每个传输完成时唤醒等待者，同步传输的调用线程不受影响。
+ *@date:    2026.10.18
+ *@return:  bool:true=命中(窗口内全部完成)  false=未命中(超过窗口或需要让出事件锁)
+ */
+bool UsbEventHandler::spinEvents()
+{
+    struct timeval zero;
+    zero.tv_sec = 0;
+    zero.tv_usec = 0;
+    qint64 startTime = UsbMetrics::nowNs();
+    qint64 endTime = startTime+busyPoll->getWindowNs();
+    bool hit = false;
+    UsbBusyPoll::setSpinning(true);
+    while(!this->stopped && libusb_event_handling_ok(context))
+    {
+        libusb_handle_events_locked(context,&zero);
+        if(!busyPoll->isActive())
+        {
+            hit = true;
+            break;
+        }
+        if(UsbMetrics::nowNs() >= endTime)
+        {
+            break;
+        }
+    }
+    UsbBusyPoll::setSpinning(false);
+    busyPoll->record(UsbMetrics::nowNs()-startTime,hit);
+    return hit;
+}
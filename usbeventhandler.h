@@ -0,0 +1,56 @@
+/****************************************************************************
+*
+* Copyright (C) 2021-2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2021.03.18
+ *@update:  2026.10.18
+ *@brief:   USB事件处理组件
+ *
+ *该类原先定义在usbmonitor.h中，仅配合UsbMonitor的热插拔监测使用。自从UsbComm支持异步传输之后，
+ *异步传输的完成回调同样需要事件轮询才能被触发，所以将其单独提取出来，供UsbComm和UsbMonitor共用。
+ *事件处理遵循libusb的多线程协议(libusb_try_lock_events/libusb_wait_for_event)，同一个会话可以有多个
+ *事件线程，也可以与其他线程中的同步传输共存:同一时刻只有获得事件锁的线程处理事件，其余线程作为等待者，
+ *在处理者释放事件锁(例如因为关闭设备让出)后接管。回调的并行执行由UsbComm的完成工作线程实现。
+ */
+#ifndef USBEVENTHANDLER_H
+#define USBEVENTHANDLER_H
+
+#include <QThread>
+#include "libusb-1.0/include/libusb.h"
+#include "usbrealtime.h"
+#include "usbbusypoll.h"
+
+/* USB事件处理类
+ * 该类继承自QThread，重写run()方法，在子线程中轮询处理挂起的事件(USB设备的热插拔事件以及
+ * 异步传输的完成事件)，进而触发相应的回调函数。目前该类是配合UsbMonitor的热插拔监测接口和
+ * UsbComm的异步传输接口使用，相关处理已经封装在接口内，其他地方无需使用。*/
+class UsbEventHandler : public QThread
+{
+    Q_OBJECT
+public:
+    UsbEventHandler(libusb_context *context, QObject *parent = 0);
+    //设置控制线程结束的标记变量状态
+    void setStopped(bool stopped){this->stopped = stopped;}
+    //设置线程的实时配置(绑定CPU、实时调度)，在线程启动时生效(仅Linux)
+    void setThreadConfig(const UsbThreadConfig &config){this->threadConfig = config;}
+    //设置会话的忙轮询状态(NULL表示不使用忙轮询)，需在线程启动之前调用
+    void setBusyPoll(UsbBusyPoll *busyPoll){this->busyPoll = busyPoll;}
+
+protected:
+    virtual void run();
+
+private:
+    bool spinEvents();//忙轮询处理事件(调用前需持有事件锁)
+
+private:
+    libusb_context *context;//表示libusb的一个会话，由构造函参传递
+    volatile bool stopped;//标记变量，控制线程结束
+    UsbThreadConfig threadConfig;//线程的实时配置
+    UsbBusyPoll *busyPoll;//会话的忙轮询状态
+};
+
+#endif // USBEVENTHANDLER_H
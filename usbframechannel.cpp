@@ -0,0 +1,393 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB请求/应答协议的帧封装组件
+ */
+#include "usbframechannel.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <string.h>
+#include <algorithm>
+
+/*
+ *@brief:   检查帧格式是否有效
+ * 同步字位于帧头起始，长度字段位于同步字之后且不超出帧头，长度字段为1/2/4字节，CRC为0/2/4字节。
+ *@date:    2026.10.18
+ *@return:  bool:true=有效  false=无效
+ */
+bool UsbFrameFormat::isValid() const
+{
+    if(headerSize <= 0 || maxPayloadSize < 0)
+    {
+        return false;
+    }
+    if(lengthSize != 1 && lengthSize != 2 && lengthSize != 4)
+    {
+        return false;
+    }
+    if(crcSize != 0 && crcSize != 2 && crcSize != 4)
+    {
+        return false;
+    }
+    if(magic.size() > headerSize || lengthOffset < magic.size() || lengthOffset+lengthSize > headerSize)
+    {
+        return false;
+    }
+    return true;
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   format:帧格式，无效时输出调试信息，之后的解析和编码都会被拒绝
+ */
+UsbFrameCodec::UsbFrameCodec(const UsbFrameFormat &format)
+{
+    frameFormat = format;
+    valid = format.isValid();
+    if(!valid)
+    {
+        qDebug()<<"UsbFrameCodec error: invalid frame format, headerSize:"<<format.headerSize
+               <<"magic:"<<format.magic.size()<<"length:"<<format.lengthOffset<<format.lengthSize
+              <<"crc:"<<format.crcSize<<"maxPayload:"<<format.maxPayloadSize;
+    }
+    crcErrorCount = 0;
+    discardedBytes = 0;
+}
+/*
+ *@brief:   解析帧
+ * 有同步字时先定位同步字，之前的数据视为无效数据丢弃；长度超出范围或CRC校验错误时只丢弃1个字节，
+ * 从下一个字节开始重新寻找同步字，避免把有效帧一起丢掉。帧格式无效时不解析，全部数据作为无效数据丢弃。
+ *@date:    2026.10.18
+ *@param:   data:待解析数据
+ *@param:   size:待解析数据长度
+ *@param:   frame:解析得到的帧视图(指向data)
+ *@return:  int:大于0表示解析出一帧(返回帧长度)，0表示数据不足，小于0表示需要丢弃的无效数据长度(取反)
+ */
+int UsbFrameCodec::parse(const quint8 *data, int size, UsbFrameView &frame)
+{
+    if(!valid)
+    {
+        discardedBytes += size;
+        return -size;
+    }
+    int magicSize = frameFormat.magic.size();
+    if(magicSize > 0)
+    {
+        if(size < magicSize)
+        {
+            return 0;
+        }
+        const quint8 *magic = (const quint8 *)frameFormat.magic.constData();
+        const quint8 *found = std::search(data,data+size,magic,magic+magicSize);//memmem()在MSVC上不可用
+        if(found == data+size)
+        {
+            //同步字可能只接收到一部分，保留最后magicSize-1个字节
+            int discard = size-(magicSize-1);
+            discardedBytes += discard;
+            return -discard;
+        }
+        if(found != data)
+        {
+            discardedBytes += found-data;
+            return -(int)(found-data);
+        }
+    }
+    if(size < frameFormat.headerSize)
+    {
+        return 0;
+    }
+    qint64 payloadSize = readField(data+frameFormat.lengthOffset,frameFormat.lengthSize);
+    if(frameFormat.lengthIncludesHeader)
+    {
+        payloadSize -= frameOverhead();
+    }
+    if(payloadSize < 0 || payloadSize > frameFormat.maxPayloadSize)
+    {
+        discardedBytes++;
+        return -1;
+    }
+    int frameSize = frameOverhead()+(int)payloadSize;
+    if(size < frameSize)
+    {
+        return 0;
+    }
+    if(frameFormat.crcSize > 0)
+    {
+        int crcOffset = frameFormat.headerSize+(int)payloadSize;
+        quint32 crc = (frameFormat.crcSize == 2)?crc16(data,crcOffset):crc32(data,crcOffset);
+        if(crc != readField(data+crcOffset,frameFormat.crcSize))
+        {
+            crcErrorCount++;
+            discardedBytes++;
+            return -1;
+        }
+    }
+    frame.header = data;
+    frame.payload = data+frameFormat.headerSize;
+    frame.payloadSize = (int)payloadSize;
+    frame.frameSize = frameSize;
+    return frameSize;
+}
+/*
+ *@brief:   编码帧
+ *@date:    2026.10.18
+ *@param:   header:帧头模板(headerSize字节，可为NULL)，同步字和长度字段会被覆盖
+ *@param:   payload:负载
+ *@param:   payloadSize:负载长度
+ *@param:   out:输出buffer
+ *@param:   outSize:输出buffer长度
+ *@return:  int:帧长度，小于0表示出错(帧格式无效时返回LIBUSB_ERROR_INVALID_PARAM)
+ */
+int UsbFrameCodec::encode(const quint8 *header, const quint8 *payload, int payloadSize,
+                          quint8 *out, int outSize) const
+{
+    if(!valid)
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    int frameSize = frameOverhead()+payloadSize;
+    if(payloadSize < 0 || payloadSize > frameFormat.maxPayloadSize || frameSize > outSize)
+    {
+        return LIBUSB_ERROR_OVERFLOW;
+    }
+    if(header != NULL)
+    {
+        memcpy(out,header,frameFormat.headerSize);
+    }
+    else
+    {
+        memset(out,0,frameFormat.headerSize);
+    }
+    memcpy(out,frameFormat.magic.constData(),frameFormat.magic.size());
+    writeField(out+frameFormat.lengthOffset,frameFormat.lengthSize,
+               frameFormat.lengthIncludesHeader?frameSize:payloadSize);
+    memcpy(out+frameFormat.headerSize,payload,payloadSize);
+    if(frameFormat.crcSize > 0)
+    {
+        int crcOffset = frameFormat.headerSize+payloadSize;
+        quint32 crc = (frameFormat.crcSize == 2)?crc16(out,crcOffset):crc32(out,crcOffset);
+        writeField(out+crcOffset,frameFormat.crcSize,crc);
+    }
+    return frameSize;
+}
+/*
+ *@brief:   CRC16-CCITT(查表法)
+ *@date:    2026.10.18
+ *@param:   data:数据
+ *@param:   length:数据长度
+ *@param:   crc:初值，分段计算时传入上一段的结果
+ *@return:  quint16:CRC值
+ */
+quint16 UsbFrameCodec::crc16(const quint8 *data, int length, quint16 crc)
+{
+    //C++11保证局部静态变量的初始化是线程安全的，首次调用时生成CRC表
+    static quint16 table[256];
+    static const bool initOnce = [](){
+        for(int i=0;i<256;i++)
+        {
+            quint16 value = (quint16)(i<<8);
+            for(int j=0;j<8;j++)
+            {
+                value = (value & 0x8000)?(quint16)((value<<1)^0x1021):(quint16)(value<<1);
+            }
+            table[i] = value;
+        }
+        return true;
+    }();
+    Q_UNUSED(initOnce)
+    for(int i=0;i<length;i++)
+    {
+        crc = (quint16)((crc<<8)^table[((crc>>8)^data[i])&0xFF]);
+    }
+    return crc;
+}
+/*
+ *@brief:   CRC32(IEEE 802.3，查表法)
+ *@date:    2026.10.18
+ *@param:   data:数据
+ *@param:   length:数据长度
+ *@param:   crc:初值，分段计算时传入上一段的结果
+ *@return:  quint32:CRC值
+ */
+quint32 UsbFrameCodec::crc32(const quint8 *data, int length, quint32 crc)
+{
+    static quint32 table[256];
+    static const bool initOnce = [](){
+        for(quint32 i=0;i<256;i++)
+        {
+            quint32 value = i;
+            for(int j=0;j<8;j++)
+            {
+                value = (value & 1)?((value>>1)^0xEDB88320):(value>>1);
+            }
+            table[i] = value;
+        }
+        return true;
+    }();
+    Q_UNUSED(initOnce)
+    crc = ~crc;
+    for(int i=0;i<length;i++)
+    {
+        crc = (crc>>8)^table[(crc^data[i])&0xFF];
+    }
+    return ~crc;
+}
+/*
+ *@brief:   按字节序读取字段
+ *@date:    2026.10.18
+ *@param:   data:字段起始地址
+ *@param:   size:字段字节数(1~4)
+ *@return:  quint32:字段值
+ */
+quint32 UsbFrameCodec::readField(const quint8 *data, int size) const
+{
+    quint32 value = 0;
+    for(int i=0;i<size;i++)
+    {
+        int index = frameFormat.bigEndian?i:size-1-i;
+        value = (value<<8)|data[index];
+    }
+    return value;
+}
+/*
+ *@brief:   按字节序写入字段
+ *@date:    2026.10.18
+ *@param:   data:字段起始地址
+ *@param:   size:字段字节数(1~4)
+ *@param:   value:字段值
+ */
+void UsbFrameCodec::writeField(quint8 *data, int size, quint32 value) const
+{
+    for(int i=0;i<size;i++)
+    {
+        int index = frameFormat.bigEndian?size-1-i:i;
+        data[index] = (quint8)(value>>(8*i));
+    }
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   usbComm:设备所属的UsbComm对象
+ *@param:   deviceHandle:设备句柄(对应接口需已声明)
+ *@param:   inEndpoint:IN端点地址
+ *@param:   outEndpoint:OUT端点地址
+ *@param:   format:帧格式(无效时收发都返回LIBUSB_ERROR_INVALID_PARAM)
+ *@param:   bufferSize:接收缓冲区容量，至少要能容纳一个最大帧
+ *@param:   transferSize:单次接收传输长度，建议为端点最大包长的整数倍
+ */
+UsbFrameChannel::UsbFrameChannel(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 inEndpoint,
+                                 quint8 outEndpoint, const UsbFrameFormat &format, int bufferSize, int transferSize)
+    :frameCodec(format),
+      streamReader(usbComm,deviceHandle,inEndpoint,
+                   qMax(bufferSize,format.headerSize+format.maxPayloadSize+format.crcSize+transferSize),transferSize)
+{
+    this->usbComm = usbComm;
+    this->deviceHandle = deviceHandle;
+    this->outEndpoint = outEndpoint;
+    if(frameCodec.isValid())
+    {
+        txBuffer.resize(frameCodec.frameOverhead()+format.maxPayloadSize);
+    }
+    pendingConsume = 0;
+}
+/*
+ *@brief:   发送一帧
+ *@date:    2026.10.18
+ *@param:   header:帧头模板(headerSize字节，可为NULL)，同步字和长度字段由内部填充
+ *@param:   payload:负载
+ *@param:   payloadSize:负载长度
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:发送的字节数(即帧长度)  小于0表示出错，超时只发出部分帧时返回LIBUSB_ERROR_TIMEOUT(对端的帧同步已被打乱)
+ */
+int UsbFrameChannel::sendFrame(const quint8 *header, const quint8 *payload, int payloadSize, quint32 timeout)
+{
+    int frameSize = frameCodec.encode(header,payload,payloadSize,(quint8 *)txBuffer.data(),txBuffer.size());
+    if(frameSize < 0)
+    {
+        return frameSize;
+    }
+    int ret = usbComm->bulkTransfer(deviceHandle,outEndpoint,(quint8 *)txBuffer.data(),frameSize,timeout);
+    if(ret >= 0 && ret < frameSize)
+    {
+        //bulkTransfer()超时时返回已发送的字节数，不完整的帧不能视为成功
+        qDebug()<<"UsbFrameChannel sendFrame error: partial frame sent:"<<ret<<"of"<<frameSize;
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+    return ret;
+}
+/*
+ *@brief:   接收一帧
+ * 缓冲区中已有完整帧时直接返回，不会发起传输；一次传输接收到的多个帧会在后续调用中依次返回。
+ *@date:    2026.10.18
+ *@param:   frame:接收到的帧视图，指向内部接收缓冲区，在下一次调用readFrame()之前有效
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:负载长度  小于0表示出错，超时返回LIBUSB_ERROR_TIMEOUT
+ */
+int UsbFrameChannel::readFrame(UsbFrameView &frame, quint32 timeout)
+{
+    if(!frameCodec.isValid())
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    //上一帧的视图到这里才失效
+    streamReader.consume(pendingConsume);
+    pendingConsume = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    while(true)
+    {
+        int ret = frameCodec.parse(streamReader.peek(),streamReader.bufferedSize(),frame);
+        if(ret > 0)
+        {
+            pendingConsume = ret;
+            return frame.payloadSize;
+        }
+        if(ret < 0)
+        {
+            streamReader.consume(-ret);
+            continue;
+        }
+        quint32 remain = 0;
+        if(timeout != 0)
+        {
+            qint64 elapsed = timer.elapsed();
+            if(elapsed >= (qint64)timeout)
+            {
+                return LIBUSB_ERROR_TIMEOUT;
+            }
+            remain = timeout-(quint32)elapsed;
+        }
+        ret = streamReader.fill(remain);
+        if(ret < 0)
+        {
+            return ret;
+        }
+    }
+}
+/*
+ *@brief:   发送请求并等待应答帧
+ *@date:    2026.10.18
+ *@param:   header/payload/payloadSize:请求帧，同sendFrame()
+ *@param:   response:应答帧视图，同readFrame()
+ *@param:   timeout:发送和等待应答各自的超时时间，单位ms， 0 无限制
+ *@return:  int:应答负载长度  小于0表示出错
+ */
+int UsbFrameChannel::request(const quint8 *header, const quint8 *payload, int payloadSize,
+                             UsbFrameView &response, quint32 timeout)
+{
+    int ret = sendFrame(header,payload,payloadSize,timeout);
+    if(ret < 0)
+    {
+        return ret;
+    }
+    return readFrame(response,timeout);
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB请求/应答协议的帧封装组件
+ *
+ *面向"帧头+负载(+可选CRC)"格式的命令通道，由两个类组成:
+ *UsbFrameCodec负责帧的编码与解析，不涉及传输，既可以配合UsbFrameChannel使用，也可以单独用来解析
+ *其他途径(例如UsbEndpointDevice)接收的数据。
+ *UsbFrameChannel在UsbStreamReader的接收缓冲区之上按帧收发。解析得到的帧(UsbFrameView)只是指向接收
+ *缓冲区的视图，不拷贝数据；一次批量传输中包含的多个帧依次解析，只移动读指针，不会移动数据。
+ */
+#ifndef USBFRAMECHANNEL_H
+#define USBFRAMECHANNEL_H
+
+#include <QByteArray>
+#include "usbcomm.h"
+#include "usbstreamreader.h"
+
+/* 帧格式
+ * 帧结构:[帧头(headerSize字节，包含同步字和长度字段)][负载][CRC(crcSize字节)]
+ * CRC覆盖帧头和负载，按长度字段相同的字节序存放。*/
+struct UsbFrameFormat
+{
+    UsbFrameFormat():lengthOffset(0),lengthSize(2),bigEndian(false),headerSize(2),
+        lengthIncludesHeader(false),crcSize(0),maxPayloadSize(4096){}
+    bool isValid() const;//同步字和长度字段都在帧头之内且互不重叠，长度字段和CRC的字节数受支持
+
+    QByteArray magic;//帧头起始的同步字，为空表示不使用同步字
+    int lengthOffset;//长度字段在帧头中的偏移
+    int lengthSize;//长度字段的字节数，支持1/2/4
+    bool bigEndian;//长度字段及CRC是否为大端字节序
+    int headerSize;//帧头总长度
+    bool lengthIncludesHeader;//长度字段是否表示整帧长度(帧头+负载+CRC)，否则只表示负载长度
+    int crcSize;//CRC字节数，0=无  2=CRC16-CCITT(多项式0x1021,初值0xFFFF)  4=CRC32(IEEE 802.3)
+    int maxPayloadSize;//负载最大长度，超过则视为无效帧
+};
+
+/* 帧视图，指向接收缓冲区，不拥有数据 */
+struct UsbFrameView
+{
+    UsbFrameView():header(NULL),payload(NULL),payloadSize(0),frameSize(0){}
+
+    const quint8 *header;//帧头起始地址
+    const quint8 *payload;//负载起始地址
+    int payloadSize;//负载长度
+    int frameSize;//整帧长度
+};
+
+/* 帧编解码类 */
+class UsbFrameCodec
+{
+public:
+    explicit UsbFrameCodec(const UsbFrameFormat &format = UsbFrameFormat());
+
+    const UsbFrameFormat &format() const{return frameFormat;}
+    bool isValid() const{return valid;}//帧格式是否有效，无效时不解析、不编码
+    int frameOverhead() const{return frameFormat.headerSize+frameFormat.crcSize;}//帧头和CRC的总长度
+
+    //解析帧:大于0表示解析出一帧(返回帧长度)，0表示数据不足，小于0表示需要丢弃的无效数据长度(取反)
+    int parse(const quint8 *data,int size,UsbFrameView &frame);
+    //编码帧:将帧头模板和负载写入out，填充同步字、长度和CRC，返回帧长度，小于0表示出错
+    int encode(const quint8 *header,const quint8 *payload,int payloadSize,quint8 *out,int outSize) const;
+
+    quint64 getCrcErrorCount() const{return crcErrorCount;}//CRC校验错误的帧数
+    quint64 getDiscardedBytes() const{return discardedBytes;}//为重新同步丢弃的字节数
+
+    static quint16 crc16(const quint8 *data,int length,quint16 crc=0xFFFF);//CRC16-CCITT
+    static quint32 crc32(const quint8 *data,int length,quint32 crc=0);//CRC32(IEEE 802.3)
+
+private:
+    quint32 readField(const quint8 *data,int size) const;//按字节序读取字段
+    void writeField(quint8 *data,int size,quint32 value) const;//按字节序写入字段
+
+    UsbFrameFormat frameFormat;
+    bool valid;
+    quint64 crcErrorCount;
+    quint64 discardedBytes;
+};
+
+/* 帧通道类
+ * 在一对IN/OUT端点上按帧收发，接收部分基于UsbStreamReader，发送部分使用预先申请的发送缓冲区，收发过程
+ * 都不会申请内存。*/
+class UsbFrameChannel
+{
+public:
+    UsbFrameChannel(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 inEndpoint,quint8 outEndpoint,
+                    const UsbFrameFormat &format,int bufferSize=65536,int transferSize=16384);
+
+    //发送一帧，header为帧头模板(可为NULL，同步字和长度字段由内部填充)，返回发送的字节数，小于0表示出错(包括只发出部分帧)
+    int sendFrame(const quint8 *header,const quint8 *payload,int payloadSize,quint32 timeout);
+    //接收一帧，frame在下一次调用readFrame之前有效，返回负载长度，小于0表示出错
+    int readFrame(UsbFrameView &frame,quint32 timeout);
+    //发送请求并等待应答帧
+    int request(const quint8 *header,const quint8 *payload,int payloadSize,UsbFrameView &response,quint32 timeout);
+
+    UsbFrameCodec &codec(){return frameCodec;}
+    UsbStreamReader &reader(){return streamReader;}
+
+private:
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 outEndpoint;//OUT端点地址
+    UsbFrameCodec frameCodec;
+    UsbStreamReader streamReader;//接收缓冲区
+    QByteArray txBuffer;//发送缓冲区，按最大帧长度预先申请
+    int pendingConsume;//上一次返回的帧长度，下一次读取时才从接收缓冲区中丢弃，保证视图有效
+};
+
+#endif // USBFRAMECHANNEL_H
@@ -0,0 +1,186 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   轮询方式的热插拔监测(后端不支持热插拔时使用)
+ */
+#include "usbhotplugpoller.h"
+#include "usbdevicedatabase.h"
+#include "usbmetrics.h"
+#include <QTimer>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   backend:传输后端，由调用者管理
+ *@param:   parent:父对象
+ */
+UsbHotplugPoller::UsbHotplugPoller(UsbBackend *backend, QObject *parent)
+    :QObject(parent)
+{
+    this->backend = backend;
+    nextHotplugHandle = 1;
+    lastPollCost = 0;
+    totalPollCost = 0;
+    pollCount = 0;
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(HOTPLUG_POLL_INTERVAL);
+    connect(pollTimer,&QTimer::timeout,this,&UsbHotplugPoller::poll);
+}
+/*
+ *@brief:   设置轮询周期
+ * 周期越短插拔事件的延迟越小，开销也越大(开销约为单次轮询耗时/周期)。
+ *@date:    2026.10.18
+ *@param:   msec:轮询周期(ms)
+ */
+void UsbHotplugPoller::setPollInterval(int msec)
+{
+    pollTimer->setInterval(qMax(msec,1));
+}
+
+int UsbHotplugPoller::getPollInterval() const
+{
+    return pollTimer->interval();
+}
+/*
+ *@brief:   注册热插拔回调
+ * 第一次注册时获取基准快照(已接入的设备不产生插入事件，与libusb不带ENUMERATE标志的行为一致)并启动定时器。
+ *@date:    2026.10.18
+ *@param:   deviceClass/vendorId/productId:匹配条件，LIBUSB_HOTPLUG_MATCH_ANY表示任意
+ *@param:   callback:热插拔回调(在该对象所在的线程中执行)
+ *@param:   hotplugHandle:返回的热插拔句柄
+ *@return:  int:libusb_error
+ */
+int UsbHotplugPoller::registerHotplug(int deviceClass, int vendorId, int productId, UsbHotplugCallback callback,
+                                      libusb_hotplug_callback_handle *hotplugHandle)
+{
+    HotplugEntry entry;
+    entry.deviceClass = deviceClass;
+    entry.vendorId = vendorId;
+    entry.productId = productId;
+    entry.callback = callback;
+    if(hotplugMap.isEmpty())
+    {
+        snapshotHash = takeSnapshot();
+        pollTimer->start();
+    }
+    libusb_hotplug_callback_handle handle = nextHotplugHandle++;
+    hotplugMap.insert(handle,entry);
+    if(hotplugHandle)
+    {
+        *hotplugHandle = handle;
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   注销热插拔回调，没有回调时停止轮询
+ *@date:    2026.10.18
+ *@param:   hotplugHandle:热插拔句柄
+ */
+void UsbHotplugPoller::deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle)
+{
+    hotplugMap.remove(hotplugHandle);
+    if(hotplugMap.isEmpty())
+    {
+        pollTimer->stop();
+        snapshotHash.clear();
+    }
+}
+/*
+ *@brief:   执行一次轮询
+ * 先比较快照得到拔出和插入的设备，再依次执行回调(回调中可以注销)。
+ *@date:    2026.10.18
+ */
+void UsbHotplugPoller::poll()
+{
+    qint64 startTime = UsbMetrics::nowNs();
+    QHash<QString,UsbDeviceRecord> currentHash = takeSnapshot();
+    QList<UsbDeviceRecord> leftList;
+    QList<UsbDeviceRecord> arrivedList;
+    QHash<QString,UsbDeviceRecord>::const_iterator it;
+    for(it=snapshotHash.constBegin();it!=snapshotHash.constEnd();++it)
+    {
+        if(!currentHash.contains(it.key()))
+        {
+            leftList.append(it.value());
+        }
+    }
+    for(it=currentHash.constBegin();it!=currentHash.constEnd();++it)
+    {
+        if(!snapshotHash.contains(it.key()))
+        {
+            arrivedList.append(it.value());
+        }
+    }
+    snapshotHash = currentHash;
+    lastPollCost = UsbMetrics::nowNs()-startTime;
+    totalPollCost += lastPollCost;
+    pollCount++;
+
+    for(int i=0;i<leftList.size()+arrivedList.size();i++)
+    {
+        bool isAttached = (i >= leftList.size());
+        const UsbDeviceRecord &record = isAttached?arrivedList.at(i-leftList.size()):leftList.at(i);
+        QList<libusb_hotplug_callback_handle> handleList = hotplugMap.keys();
+        for(int j=0;j<handleList.size();j++)
+        {
+            QMap<libusb_hotplug_callback_handle,HotplugEntry>::const_iterator entryIt =
+                    hotplugMap.constFind(handleList.at(j));
+            if(entryIt != hotplugMap.constEnd() && isMatched(entryIt.value(),record.info))
+            {
+                UsbHotplugCallback callback = entryIt.value().callback;
+                callback(isAttached,record);
+            }
+        }
+    }
+}
+/*
+ *@brief:   获取当前的总线快照
+ * 快照跨越多次枚举保存，设备信息中的device置为NULL。sysfs来源的记录包含描述符树，拔出事件沿用插入时的记录；
+ * 后端枚举来源的记录只包含设备信息。
+ *@date:    2026.10.18
+ *@return:  QHash<QString,UsbDeviceRecord>:键为"sysfs目录名@地址"或"总线-地址-端口"
+ */
+QHash<QString,UsbDeviceRecord> UsbHotplugPoller::takeSnapshot()
+{
+    QHash<QString,UsbDeviceRecord> hash;
+    UsbDeviceDatabase *database = backend->getDeviceDatabase();
+    if(database && database->isAvailable())
+    {
+        QList<UsbDeviceRecord> recordList = database->getDeviceList();
+        for(int i=0;i<recordList.size();i++)
+        {
+            const UsbDeviceRecord &record = recordList.at(i);
+            hash.insert(QString("%1@%2").arg(record.sysfsName).arg(record.info.deviceAddress),record);
+        }
+        return hash;
+    }
+    QList<UsbDeviceInfo> infoList = backend->getDeviceList();
+    for(int i=0;i<infoList.size();i++)
+    {
+        UsbDeviceRecord record;
+        record.info = infoList.at(i);
+        record.info.device = NULL;
+        hash.insert(QString("%1-%2-%3").arg(record.info.busNumber).arg(record.info.deviceAddress)
+                    .arg(record.info.portNumber),record);
+    }
+    return hash;
+}
+/*
+ *@brief:   设备是否满足注册的匹配条件
+ *@date:    2026.10.18
+ *@param:   entry:注册的热插拔回调
+ *@param:   info:设备信息
+ *@return:  bool:true=满足  false=不满足
+ */
+bool UsbHotplugPoller::isMatched(const HotplugEntry &entry, const UsbDeviceInfo &info)
+{
+    return (entry.deviceClass == LIBUSB_HOTPLUG_MATCH_ANY || entry.deviceClass == info.deviceClass) &&
+            (entry.vendorId == LIBUSB_HOTPLUG_MATCH_ANY || entry.vendorId == info.vendorId) &&
+            (entry.productId == LIBUSB_HOTPLUG_MATCH_ANY || entry.productId == info.productId);
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   轮询方式的热插拔监测(后端不支持热插拔时使用)
+ *
+ *部分嵌入式平台编译的libusb没有热插拔能力(LIBUSB_CAP_HAS_HOTPLUG)，该类周期性地对总线做一次快照，
+ *与上一次的快照比较，得到插入和拔出的设备，回调格式与UsbBackend::registerHotplug()相同。
+ *快照只以总线号、设备地址和端口(sysfs目录名)作为键:后端提供sysfs设备数据库时，未变化的设备只读取目录列表和
+ *devnum，只有新设备才解析描述符；否则退回到后端的枚举接口。
+ *定时器在该对象所在的线程中运行，注册、注销和回调也都在该线程中执行，每次轮询的耗时可通过getLastPollCost()等接口获取。
+ */
+#ifndef USBHOTPLUGPOLLER_H
+#define USBHOTPLUGPOLLER_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include "usbbackend.h"
+
+#define HOTPLUG_POLL_INTERVAL   500 //默认轮询周期(ms)
+
+class QTimer;
+
+class UsbHotplugPoller : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UsbHotplugPoller(UsbBackend *backend,QObject *parent = 0);
+
+    void setPollInterval(int msec);//设置轮询周期(ms)
+    int getPollInterval() const;
+
+    //注册/注销热插拔回调，参数与UsbBackend::registerHotplug()相同
+    int registerHotplug(int deviceClass,int vendorId,int productId,UsbHotplugCallback callback,
+                        libusb_hotplug_callback_handle *hotplugHandle);
+    void deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle);
+
+    /*轮询开销统计(ns)*/
+    qint64 getLastPollCost() const{return lastPollCost;}//最近一次轮询的耗时
+    qint64 getTotalPollCost() const{return totalPollCost;}//累计耗时
+    quint64 getPollCount() const{return pollCount;}//累计轮询次数
+
+public slots:
+    void poll();//执行一次轮询，比较快照并执行回调
+
+private:
+    /* 注册的热插拔回调 */
+    struct HotplugEntry
+    {
+        int deviceClass;
+        int vendorId;
+        int productId;
+        UsbHotplugCallback callback;
+    };
+
+    QHash<QString,UsbDeviceRecord> takeSnapshot();//获取当前的总线快照(键为总线、地址和端口)
+    static bool isMatched(const HotplugEntry &entry,const UsbDeviceInfo &info);
+
+    UsbBackend *backend;
+    QTimer *pollTimer;
+    QMap<libusb_hotplug_callback_handle,HotplugEntry> hotplugMap;
+    libusb_hotplug_callback_handle nextHotplugHandle;
+    QHash<QString,UsbDeviceRecord> snapshotHash;//上一次的快照
+
+    qint64 lastPollCost;
+    qint64 totalPollCost;
+    quint64 pollCount;
+};
+
+#endif // USBHOTPLUGPOLLER_H
@@ -0,0 +1,657 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   基于libusb的传输后端
+ */
+#include "usblibusbbackend.h"
+#include "usbeventhandler.h"
+#include <QStringList>
+#include <QDebug>
+
+/*
+ *@brief:   构造函数，负责对libusb进行初始化
+ *@date:    2026.10.18
+ */
+UsbLibusbBackend::UsbLibusbBackend()
+{
+    context = NULL;
+    eventThreadCount = 1;
+    deviceList = NULL;
+    //libusb初始化
+    int err = libusb_init(&context);
+    if(err != LIBUSB_SUCCESS)
+    {
+        qDebug()<<"libusb_init error:"<<libusb_error_name(err);
+    }
+    //设置日志输出等级
+    libusb_set_debug(context,LIBUSB_LOG_LEVEL_WARNING);//旧版本
+    //libusb_set_option(context,LIBUSB_OPTION_LOG_LEVEL,LIBUSB_LOG_LEVEL_WARNING);//新版本
+}
+/*
+ *@brief:   析构函数，停止事件线程并释放libusb资源(设备需已全部关闭)
+ *@date:    2026.10.18
+ */
+UsbLibusbBackend::~UsbLibusbBackend()
+{
+    QList<libusb_hotplug_callback_handle> hotplugHandleList = hotplugHash.keys();
+    for(int i=0;i<hotplugHandleList.size();i++)
+    {
+        deregisterHotplug(hotplugHandleList.at(i));
+    }
+    for(int i=0;i<eventHandlerList.size();i++)//停止事件处理线程
+    {
+        eventHandlerList.at(i)->setStopped(true);
+    }
+    for(int i=0;i<eventHandlerList.size();i++)
+    {
+        eventHandlerList.at(i)->wait();//等待线程结束
+        delete eventHandlerList.at(i);
+    }
+    if(deviceList != NULL)
+    {
+        libusb_free_device_list(deviceList,1);
+    }
+    libusb_exit(context);//libusb退出
+}
+/*
+ *@brief:   枚举当前接入的设备
+ * 枚举结果中的device(libusb_device *)由该对象持有引用，在下一次枚举之前一直有效。
+ *@date:    2026.10.18
+ *@return:  QList<UsbDeviceInfo>:设备信息列表
+ */
+QList<UsbDeviceInfo> UsbLibusbBackend::getDeviceList()
+{
+    QList<UsbDeviceInfo> infoList;
+    QMutexLocker locker(&mutex);
+    if(deviceList != NULL)
+    {
+        libusb_free_device_list(deviceList,1);//释放上一次的设备列表(解引用)
+        deviceList = NULL;
+    }
+    ssize_t count = libusb_get_device_list(context,&deviceList);//获取设备列表
+    if(count < 0)
+    {
+        qDebug()<<"libusb_get_device_list error:"<<libusb_error_name((int)count);
+        deviceList = NULL;
+        return infoList;
+    }
+    for(int i=0;i<count;i++)
+    {
+        UsbDeviceInfo info = deviceInfo(deviceList[i]);
+        if(info.device != NULL)
+        {
+            infoList.append(info);
+        }
+    }
+    return infoList;
+}
+/*
+ *@brief:   打印USB设备详细信息
+ *@date:    2021.03.15
+ *@update:  2026.10.18
+ *@param:   info:设备信息(需为最近一次枚举的结果)
+ */
+void UsbLibusbBackend::printDeviceInfo(const UsbDeviceInfo &info)
+{
+    libusb_device *usbDevice = static_cast<libusb_device *>(info.device);
+    /*设备描述符层级:
+     *设备(device)->配置(configuration)->接口(interface)->备用设置(altsetting)->端点(endpoint)*/
+
+    /*设备(device)*/
+    libusb_device_descriptor deviceDesc;
+    int err = libusb_get_device_descriptor(usbDevice, &deviceDesc);
+    if(err != LIBUSB_SUCCESS)
+    {
+        qDebug()<<"libusb_get_device_descriptor error:"<<libusb_error_name(err);
+        return;
+    }
+//    if(!(deviceDesc.idVendor == 0x04b4 && deviceDesc.idProduct == 0x00f1))
+//    {
+//        return;
+//    }
+    qDebug()<<"***************************************";
+    qDebug()<<"Bus: "<<(int)libusb_get_bus_number(usbDevice);//设备所在总线
+    qDebug()<<"Device Address: "<<(int)libusb_get_device_address(usbDevice);//设备在总线上的地址
+    qDebug()<<"Device Port: "<<(int)libusb_get_port_number(usbDevice);//设备端口号
+    QStringList portPathList;
+    for(int i=0;i<info.portPath.size();i++)
+    {
+        portPathList.append(QString::number(info.portPath.at(i)));
+    }
+    qDebug()<<"Device Port Path: "<<portPathList.join(".");//从根集线器开始的端口路径
+    qDebug()<<"Device Speed: "<<(int)libusb_get_device_speed(usbDevice);//设备连接速度，详见enum libusb_speed{}
+    qDebug()<<"Device Class: "<<QString("0x%1").arg((int)deviceDesc.bDeviceClass,2,16,QChar('0'));//设备类
+    qDebug()<<"VendorID: "<<QString("0x%1").arg((int)deviceDesc.idVendor,4,16,QChar('0'));//设备厂商id
+    qDebug()<<"ProductID: "<<QString("0x%1").arg((int)deviceDesc.idProduct,4,16,QChar('0'));//设备产品id
+    qDebug()<<"Number of configurations: "<<(int)deviceDesc.bNumConfigurations;//设备的配置数
+    /*配置(configuration)*/
+    for(int i=0;i<(int)deviceDesc.bNumConfigurations;i++)
+    {
+        qDebug()<<"Configuration index:"<<i;
+        libusb_config_descriptor *configDesc;
+        libusb_get_config_descriptor(usbDevice,i,&configDesc);
+        qDebug()<<"Configuration Value: "<<(int)configDesc->bConfigurationValue;
+        qDebug()<<"Number of interfaces: "<<(int)configDesc->bNumInterfaces;
+        /*接口(interface)*/
+        for(int j=0; j<(int)configDesc->bNumInterfaces;j++)
+        {
+            qDebug()<<"\tInterface index:"<<j;
+            const libusb_interface *usbInterface;
+            usbInterface = &configDesc->interface[j];
+            qDebug()<<"\tNumber of alternate settings: "<<usbInterface->num_altsetting;
+            /*备用设置(altsetting)*/
+            for(int k=0; k<usbInterface->num_altsetting; k++)
+            {
+                qDebug()<<"\t\tAltsetting index:"<<k;
+                const libusb_interface_descriptor *interfaceDesc;
+                interfaceDesc = &usbInterface->altsetting[k];
+                qDebug()<<"\t\tInterface Class: "<<
+                          QString("0x%1").arg((int)interfaceDesc->bInterfaceClass,2,16,QChar('0'));//接口类
+                qDebug()<<"\t\tInterface Number: "<<(int)interfaceDesc->bInterfaceNumber;
+                qDebug()<<"\t\tAlternate settings: "<<(int)interfaceDesc->bAlternateSetting;
+                qDebug()<<"\t\tNumber of endpoints: "<<(int)interfaceDesc->bNumEndpoints;
+                /*端点(endpoint)*/
+                for(int m=0; m<(int)interfaceDesc->bNumEndpoints; m++)
+                {
+                    qDebug()<<"\t\t\tEndpoint index:"<<m;
+                    const libusb_endpoint_descriptor *endpointDesc;
+                    endpointDesc = &interfaceDesc->endpoint[m];
+                    qDebug()<<"\t\t\tEP address: "<<
+                              QString("0x%1").arg((int)endpointDesc->bEndpointAddress,2,16,QChar('0'));
+                    qDebug()<<"\t\t\tEP transfer type:"<<
+                              (endpointDesc->bmAttributes&0x03);//端点传输类型，详见enum libusb_transfer_type{}
+                }
+            }
+        }
+        libusb_free_config_descriptor(configDesc);//释放配置描述符空间
+    }
+    qDebug()<<"***************************************"<<endl;
+}
+/*
+ *@brief:   打开设备
+ *@date:    2026.10.18
+ *@param:   info:设备信息(需为最近一次枚举的结果)
+ *@param:   deviceHandle:返回的设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::openDevice(const UsbDeviceInfo &info, libusb_device_handle **deviceHandle)
+{
+    return libusb_open(static_cast<libusb_device *>(info.device),deviceHandle);
+}
+/*
+ *@brief:   按总线号和地址打开设备
+ * 只比较libusb_device中的总线号和地址，不读取任何描述符(getDeviceList()需要逐个读取设备描述符和端口路径)。
+ *@date:    2026.10.18
+ *@param:   info:设备信息(只使用总线号和地址，例如设备数据库中的记录)
+ *@param:   deviceHandle:返回的设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::openDeviceByAddress(const UsbDeviceInfo &info, libusb_device_handle **deviceHandle)
+{
+    libusb_device **deviceList = NULL;
+    ssize_t count = libusb_get_device_list(context,&deviceList);
+    if(count < 0)
+    {
+        return (int)count;
+    }
+    int err = LIBUSB_ERROR_NO_DEVICE;
+    for(ssize_t i=0;i<count;i++)
+    {
+        if(libusb_get_bus_number(deviceList[i]) == info.busNumber &&
+                libusb_get_device_address(deviceList[i]) == info.deviceAddress)
+        {
+            err = libusb_open(deviceList[i],deviceHandle);
+            break;
+        }
+    }
+    libusb_free_device_list(deviceList,1);
+    return err;
+}
+/*
+ *@brief:   关闭设备
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ */
+void UsbLibusbBackend::closeDevice(libusb_device_handle *deviceHandle)
+{
+    libusb_close(deviceHandle);
+}
+/*
+ *@brief:   获取打开设备的信息
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbDeviceInfo:设备信息
+ */
+UsbDeviceInfo UsbLibusbBackend::getDeviceInfo(libusb_device_handle *deviceHandle)
+{
+    return deviceInfo(libusb_get_device(deviceHandle));
+}
+/*
+ *@brief:   解析当前配置的描述符树
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   config:返回的描述符树
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::getConfigInfo(libusb_device_handle *deviceHandle, UsbConfigInfo *config)
+{
+    libusb_config_descriptor *configDesc = NULL;
+    int err = libusb_get_active_config_descriptor(libusb_get_device(deviceHandle),&configDesc);
+    if(err != LIBUSB_SUCCESS)
+    {
+        return err;
+    }
+    *config = UsbConfigInfo::fromDescriptor(configDesc);
+    libusb_free_config_descriptor(configDesc);
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   激活设备配置
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   bConfigurationValue:配置号
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::setConfiguration(libusb_device_handle *deviceHandle, int bConfigurationValue)
+{
+    return libusb_set_configuration(deviceHandle,bConfigurationValue);
+}
+/*
+ *@brief:   声明接口，接口的内核驱动激活时先卸载
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::claimInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    //确保指定接口的内核驱动程序未激活，否则将无法声明该接口
+    if(libusb_kernel_driver_active(deviceHandle, interfaceNumber) == 1)
+    {
+        qDebug()<<"Kernel driver active for interface"<<interfaceNumber;
+        //卸载指定接口的内核驱动
+        int err = libusb_detach_kernel_driver(deviceHandle,interfaceNumber);
+        if(err != LIBUSB_SUCCESS)
+        {
+            qDebug()<<"libusb_detach_kernel_driver error:"<<libusb_error_name(err);
+            return err;
+        }
+    }
+    //声明接口(该接口是一个单纯的逻辑操作,不会通过总线发送任何请求)
+    return libusb_claim_interface(deviceHandle, interfaceNumber);
+}
+/*
+ *@brief:   释放接口
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::releaseInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    return libusb_release_interface(deviceHandle,interfaceNumber);
+}
+/*
+ *@brief:   激活接口备用设置
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@param:   bAlternateSetting:备用设置
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::setInterfaceAltSetting(libusb_device_handle *deviceHandle, int interfaceNumber,
+                                             int bAlternateSetting)
+{
+    return libusb_set_interface_alt_setting(deviceHandle,interfaceNumber,bAlternateSetting);
+}
+/*
+ *@brief:   重置设备
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::resetDevice(libusb_device_handle *deviceHandle)
+{
+    return libusb_reset_device(deviceHandle);
+}
+/*
+ *@brief:   清除端点的halt/stall状态
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::clearHalt(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    return libusb_clear_halt(deviceHandle,endpoint);
+}
+/*
+ *@brief:   同步传输
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   transferType:传输类型，LIBUSB_TRANSFER_TYPE_BULK/INTERRUPT/CONTROL
+ *@param:   endpoint:端点，控制传输忽略
+ *@param:   data:数据buffer(控制传输包含8字节的setup包)
+ *@param:   length:buffer长度
+ *@param:   actualLength:真实传输的字节数(控制传输不包含setup包)
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::syncTransfer(libusb_device_handle *deviceHandle, quint8 transferType, quint8 endpoint,
+                                   quint8 *data, int length, int *actualLength, quint32 timeout)
+{
+    switch(transferType)
+    {
+    case LIBUSB_TRANSFER_TYPE_BULK:
+        return libusb_bulk_transfer(deviceHandle,endpoint,data,length,actualLength,timeout);
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        return libusb_interrupt_transfer(deviceHandle,endpoint,data,length,actualLength,timeout);
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+    {
+        if(length < (int)LIBUSB_CONTROL_SETUP_SIZE)
+        {
+            return LIBUSB_ERROR_INVALID_PARAM;
+        }
+        libusb_control_setup *setup = (libusb_control_setup *)data;
+        int err = libusb_control_transfer(deviceHandle,setup->bmRequestType,setup->bRequest,
+                                          libusb_le16_to_cpu(setup->wValue),libusb_le16_to_cpu(setup->wIndex),
+                                          data+LIBUSB_CONTROL_SETUP_SIZE,
+                                          (quint16)(length-LIBUSB_CONTROL_SETUP_SIZE),timeout);
+        if(actualLength)
+        {
+            *actualLength = (err >= 0)?err:0;
+        }
+        return (err >= 0)?LIBUSB_SUCCESS:err;
+    }
+    default:
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+}
+/*
+ *@brief:   提交异步传输，首次提交时启动事件线程
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::submitTransfer(libusb_transfer *transfer)
+{
+    startEventHandler();
+    return libusb_submit_transfer(transfer);
+}
+/*
+ *@brief:   取消异步传输
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::cancelTransfer(libusb_transfer *transfer)
+{
+    return libusb_cancel_transfer(transfer);
+}
+/*
+ *@brief:   当前平台的libusb库是否支持热插拔监测
+ *@date:    2026.10.18
+ *@return:  bool:true=支持  false=不支持
+ */
+bool UsbLibusbBackend::hasHotplug()
+{
+    return libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG);
+}
+/*
+ *@brief:   注册热插拔回调
+ *@date:    2026.10.18
+ *@param:   deviceClass:监测的设备类，LIBUSB_HOTPLUG_MATCH_ANY表示任意
+ *@param:   vendorId:监测的设备厂商id，LIBUSB_HOTPLUG_MATCH_ANY表示任意
+ *@param:   productId:监测的设备产品id，LIBUSB_HOTPLUG_MATCH_ANY表示任意
+ *@param:   callback:热插拔回调(在事件线程中执行)
+ *@param:   hotplugHandle:返回的热插拔句柄
+ *@return:  int:libusb_error
+ */
+int UsbLibusbBackend::registerHotplug(int deviceClass, int vendorId, int productId, UsbHotplugCallback callback,
+                                      libusb_hotplug_callback_handle *hotplugHandle)
+{
+    //设备变化时先标记设备数据库失效，再执行用户回调
+    UsbDeviceDatabase *database = &deviceDatabase;
+    HotplugEntry *entry = new HotplugEntry;
+    entry->backend = this;
+    entry->callback = [database,callback](bool isAttached,const UsbDeviceRecord &record){
+        database->invalidate();
+        callback(isAttached,record);
+    };
+    libusb_hotplug_callback_handle tmpHotplugHandle = -1;
+    int err = libusb_hotplug_register_callback(
+                context, (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED|LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+                LIBUSB_HOTPLUG_NO_FLAGS, vendorId,productId, deviceClass,hotplugCallback,(void *)entry,
+                &tmpHotplugHandle);
+    if(err != LIBUSB_SUCCESS)
+    {
+        delete entry;
+        return err;
+    }
+    mutex.lock();
+    hotplugHash.insert(tmpHotplugHandle,entry);
+    if(deviceClass == LIBUSB_HOTPLUG_MATCH_ANY && vendorId == LIBUSB_HOTPLUG_MATCH_ANY &&
+            productId == LIBUSB_HOTPLUG_MATCH_ANY)
+    {
+        wildcardHotplugSet.insert(tmpHotplugHandle);
+        deviceDatabase.setHotplugTracked(true);
+    }
+    mutex.unlock();
+    if(hotplugHandle)
+    {
+        *hotplugHandle = tmpHotplugHandle;
+    }
+    //回调函数需要经过轮询事件处理才可以被触发执行
+    startEventHandler();
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   注销热插拔回调
+ * libusb在持有内部锁的情况下调用热插拔回调，注销返回后回调不会再被执行，可以直接释放回调对象。
+ *@date:    2026.10.18
+ *@param:   hotplugHandle:热插拔句柄
+ */
+void UsbLibusbBackend::deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle)
+{
+    mutex.lock();
+    HotplugEntry *entry = hotplugHash.take(hotplugHandle);
+    if(wildcardHotplugSet.remove(hotplugHandle) && wildcardHotplugSet.isEmpty())
+    {
+        deviceDatabase.setHotplugTracked(false);
+    }
+    mutex.unlock();
+    if(entry)
+    {
+        libusb_hotplug_deregister_callback(context,hotplugHandle);
+        delete entry;
+    }
+    QMutexLocker locker(&mutex);
+    if(hotplugHash.isEmpty())//没有热插拔回调时释放所有快照
+    {
+        clearHotplugRecords(false);
+    }
+}
+/*
+ *@brief:   从libusb设备获取设备信息
+ *@date:    2026.10.18
+ *@param:   device:libusb设备
+ *@return:  UsbDeviceInfo:设备信息，获取描述符失败时device为NULL
+ */
+UsbDeviceInfo UsbLibusbBackend::deviceInfo(libusb_device *device)
+{
+    UsbDeviceInfo info;
+    if(device == NULL)
+    {
+        return info;
+    }
+    //总线、地址和端口路径在libusb枚举时已经获取，描述符读取失败时也可以上报
+    info.busNumber = libusb_get_bus_number(device);
+    info.deviceAddress = libusb_get_device_address(device);
+    info.portNumber = libusb_get_port_number(device);
+    uint8_t portNumbers[7];//USB 3.0规定最多7层
+    int depth = libusb_get_port_numbers(device,portNumbers,sizeof(portNumbers));
+    for(int i=0;i<depth;i++)
+    {
+        info.portPath.append(portNumbers[i]);
+    }
+    libusb_device_descriptor deviceDesc;
+    if(libusb_get_device_descriptor(device,&deviceDesc) != LIBUSB_SUCCESS)
+    {
+        return info;
+    }
+    info.vendorId = deviceDesc.idVendor;
+    info.productId = deviceDesc.idProduct;
+    info.deviceClass = deviceDesc.bDeviceClass;
+    info.speed = libusb_get_device_speed(device);
+    info.device = device;
+    return info;
+}
+/*
+ *@brief:   从libusb缓存的描述符生成设备记录
+ * 设备描述符和配置描述符由libusb在枚举时缓存(Linux下来自sysfs/usbfs)，不会产生总线上的请求，
+ * 字符串描述符需要访问设备，不包含在内。
+ *@date:    2026.10.18
+ *@param:   device:libusb设备
+ *@return:  UsbDeviceRecord:设备记录，当前配置无法获取时config为空
+ */
+UsbDeviceRecord UsbLibusbBackend::deviceRecord(libusb_device *device)
+{
+    UsbDeviceRecord record;
+    record.info = deviceInfo(device);
+    libusb_device_descriptor deviceDesc;
+    if(record.info.device == NULL || libusb_get_device_descriptor(device,&deviceDesc) != LIBUSB_SUCCESS)
+    {
+        return record;
+    }
+    record.bcdUSB = deviceDesc.bcdUSB;
+    record.bcdDevice = deviceDesc.bcdDevice;
+    libusb_config_descriptor *configDesc = NULL;
+    if(libusb_get_active_config_descriptor(device,&configDesc) == LIBUSB_SUCCESS)
+    {
+        record.config = UsbConfigInfo::fromDescriptor(configDesc);
+        libusb_free_config_descriptor(configDesc);
+    }
+    return record;
+}
+/*
+ *@brief:   获取热插拔设备的记录(在事件线程中执行)
+ * 同一事件的多个回调共用一份快照；插入时生成的快照一直保留到设备拔出，拔出事件沿用该快照
+ * (此时设备已经断开，无法再读取当前配置)。拔出设备的快照在下一次插入事件时释放，
+ * 此时上一个事件的所有回调都已经执行完成。
+ *@date:    2026.10.18
+ *@param:   device:热插拔的设备
+ *@param:   isAttached:true=插入  false=拔出
+ *@return:  UsbDeviceRecord:设备记录
+ */
+UsbDeviceRecord UsbLibusbBackend::hotplugRecord(libusb_device *device, bool isAttached)
+{
+    QMutexLocker locker(&mutex);
+    if(isAttached)
+    {
+        clearHotplugRecords(true);
+    }
+    QHash<libusb_device *,HotplugRecord>::iterator it = hotplugRecordHash.find(device);
+    if(it != hotplugRecordHash.end())
+    {
+        it.value().isAttached = isAttached;
+        return it.value().record;
+    }
+    HotplugRecord hotplugRecord;
+    hotplugRecord.record = deviceRecord(device);
+    hotplugRecord.isAttached = isAttached;
+    libusb_ref_device(device);//持有引用，保证快照释放之前设备地址不会被新设备复用
+    hotplugRecordHash.insert(device,hotplugRecord);
+    return hotplugRecord.record;
+}
+/*
+ *@brief:   释放热插拔设备的快照(调用前需加锁)
+ *@date:    2026.10.18
+ *@param:   departedOnly:true=只释放已拔出设备的快照  false=全部释放
+ */
+void UsbLibusbBackend::clearHotplugRecords(bool departedOnly)
+{
+    QHash<libusb_device *,HotplugRecord>::iterator it = hotplugRecordHash.begin();
+    while(it != hotplugRecordHash.end())
+    {
+        if(departedOnly && it.value().isAttached)
+        {
+            ++it;
+            continue;
+        }
+        libusb_unref_device(it.key());
+        it = hotplugRecordHash.erase(it);
+    }
+}
+/*
+ *@brief:   设置事件线程数(需在首次提交传输或注册热插拔之前调用)
+ * 多个事件线程按libusb的事件锁协议协作，同一时刻只有一个线程处理事件，其余线程在其让出事件锁时接管；
+ * 回调的并行执行请使用UsbComm::setCompletionWorkerCount()。
+ *@date:    2026.10.18
+ *@param:   count:事件线程数，默认1
+ */
+void UsbLibusbBackend::setEventThreadCount(int count)
+{
+    QMutexLocker locker(&mutex);
+    eventThreadCount = qMax(count,1);
+}
+/*
+ *@brief:   设置事件线程的实时配置(需在首次提交传输或注册热插拔之前调用，仅Linux)
+ * 多个事件线程使用相同的配置，绑定CPU时都绑定到同一个CPU。
+ *@date:    2026.10.18
+ *@param:   config:实时配置(绑定的CPU、SCHED_FIFO优先级)
+ */
+void UsbLibusbBackend::setEventThreadConfig(const UsbThreadConfig &config)
+{
+    QMutexLocker locker(&mutex);
+    eventThreadConfig = config;
+}
+/*
+ *@brief:   按需启动事件线程(可以在任意线程调用)
+ *@date:    2026.10.18
+ */
+void UsbLibusbBackend::startEventHandler()
+{
+    QMutexLocker locker(&mutex);
+    while(eventHandlerList.size() < eventThreadCount)
+    {
+        UsbEventHandler *eventHandler = new UsbEventHandler(context);
+        eventHandler->setObjectName(QString("UsbEventHandler%1").arg(eventHandlerList.size()));
+        eventHandler->setThreadConfig(eventThreadConfig);
+        eventHandler->setBusyPoll(&busyPoll);
+        eventHandlerList.append(eventHandler);
+    }
+    for(int i=0;i<eventHandlerList.size();i++)
+    {
+        if(!eventHandlerList.at(i)->isRunning())
+        {
+            eventHandlerList.at(i)->setStopped(false);
+            eventHandlerList.at(i)->start();
+        }
+    }
+}
+/*
+ *@brief:   热插拔回调函数(在UsbEventHandler子线程中执行)
+ *@date:    2026.10.18
+ *@param:   ctx:表示libusb的一个会话
+ *@param:   device:热插拔的设备
+ *@param:   event:热插拔的事件
+ *@param:   user_data:注册时传递的HotplugEntry对象
+ *@return:  int:当返回值为1时，则会撤销注册(deregistered)
+ */
+int UsbLibusbBackend::hotplugCallback(libusb_context *ctx, libusb_device *device,
+                                      libusb_hotplug_event event, void *user_data)
+{
+    Q_UNUSED(ctx)
+    HotplugEntry *entry = static_cast<HotplugEntry *>(user_data);
+    bool isAttached = (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED);
+    //描述符获取失败时仍然上报总线、地址和端口路径
+    UsbDeviceRecord record = entry->backend->hotplugRecord(device,isAttached);
+    entry->callback(isAttached,record);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   基于libusb的传输后端
+ *
+ *每个对象对应一个libusb会话(context)，异步传输和热插拔共用UsbEventHandler事件线程(默认一个，
+ *可通过setEventThreadCount()设置)，在首次提交传输或注册热插拔时启动(可以在任意线程)，对象析构时停止。
+ */
+#ifndef USBLIBUSBBACKEND_H
+#define USBLIBUSBBACKEND_H
+
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include "usbbackend.h"
+#include "usbdevicedatabase.h"
+#include "usbrealtime.h"
+#include "usbbusypoll.h"
+
+class UsbEventHandler;
+
+class UsbLibusbBackend : public UsbBackend
+{
+public:
+    UsbLibusbBackend();
+    virtual ~UsbLibusbBackend();
+
+    libusb_context *getContext() const{return context;}
+    void setEventThreadCount(int count);//设置事件线程数(需在启动之前调用)
+    void setEventThreadConfig(const UsbThreadConfig &config);//设置事件线程的实时配置(需在启动之前调用)
+    void startEventHandler();//按需启动事件线程(提交传输和注册热插拔时自动调用)
+
+    virtual QList<UsbDeviceInfo> getDeviceList();
+    virtual void printDeviceInfo(const UsbDeviceInfo &info);
+    virtual int openDevice(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle);
+    virtual void closeDevice(libusb_device_handle *deviceHandle);
+    virtual UsbDeviceInfo getDeviceInfo(libusb_device_handle *deviceHandle);
+    virtual int getConfigInfo(libusb_device_handle *deviceHandle,UsbConfigInfo *config);
+
+    virtual int setConfiguration(libusb_device_handle *deviceHandle,int bConfigurationValue);
+    virtual int claimInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    virtual int releaseInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    virtual int setInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,int bAlternateSetting);
+    virtual int resetDevice(libusb_device_handle *deviceHandle);
+    virtual int clearHalt(libusb_device_handle *deviceHandle,quint8 endpoint);
+
+    virtual int syncTransfer(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                             quint8 *data,int length,int *actualLength,quint32 timeout);
+    virtual int submitTransfer(libusb_transfer *transfer);
+    virtual int cancelTransfer(libusb_transfer *transfer);
+
+    virtual bool hasHotplug();
+    virtual int registerHotplug(int deviceClass,int vendorId,int productId,UsbHotplugCallback callback,
+                                libusb_hotplug_callback_handle *hotplugHandle);
+    virtual void deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle);
+
+    virtual UsbDeviceDatabase *getDeviceDatabase(){return &deviceDatabase;}
+    virtual int openDeviceByAddress(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle);
+    virtual UsbBusyPoll *getBusyPoll(libusb_device_handle *deviceHandle){Q_UNUSED(deviceHandle) return &busyPoll;}
+
+private:
+    /* 注册的热插拔回调(作为libusb回调的user_data) */
+    struct HotplugEntry
+    {
+        UsbLibusbBackend *backend;
+        UsbHotplugCallback callback;
+    };
+    /* 热插拔设备的描述符快照(持有设备引用) */
+    struct HotplugRecord
+    {
+        UsbDeviceRecord record;
+        bool isAttached;
+    };
+
+    static UsbDeviceInfo deviceInfo(libusb_device *device);//从libusb设备获取设备信息
+    static UsbDeviceRecord deviceRecord(libusb_device *device);//从libusb缓存的描述符生成设备记录
+    UsbDeviceRecord hotplugRecord(libusb_device *device,bool isAttached);//获取热插拔设备的记录
+    void clearHotplugRecords(bool departedOnly);//释放热插拔设备的快照
+    //热插拔回调函数(在事件线程中执行)
+    static int LIBUSB_CALL hotplugCallback(libusb_context *ctx,libusb_device *device,
+                                           libusb_hotplug_event event,void *user_data);
+
+    libusb_context *context;//表示libusb的一个会话，由libusb_init创建
+    int eventThreadCount;//事件线程数
+    UsbThreadConfig eventThreadConfig;//事件线程的实时配置
+    UsbBusyPoll busyPoll;//事件线程的忙轮询状态
+    QList<UsbEventHandler *> eventHandlerList;//事件处理线程
+    libusb_device **deviceList;//最近一次枚举的设备列表(持有设备的引用)
+    QMutex mutex;
+    QHash<libusb_hotplug_callback_handle,HotplugEntry *> hotplugHash;//注册的热插拔回调
+    QHash<libusb_device *,HotplugRecord> hotplugRecordHash;//热插拔设备的快照(同一事件的多个回调共用，拔出时沿用插入时的快照)
+    QSet<libusb_hotplug_callback_handle> wildcardHotplugSet;//不限条件的热插拔回调(可以覆盖所有设备的变化)
+    UsbDeviceDatabase deviceDatabase;//sysfs设备数据库，热插拔时失效
+};
+
+#endif // USBLIBUSBBACKEND_H
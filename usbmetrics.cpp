@@ -0,0 +1,474 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输统计组件
+ */
+#include "usbmetrics.h"
+#include <QtAlgorithms>
+#include <chrono>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ */
+UsbLatencyHistogram::UsbLatencyHistogram()
+{
+    reset();
+}
+/*
+ *@brief:   记录一个值
+ *@date:    2026.10.18
+ *@param:   value:记录值(us)
+ */
+void UsbLatencyHistogram::record(quint64 value)
+{
+    if(value >= (Q_UINT64_C(1)<<MaxValueBits))
+    {
+        value = (Q_UINT64_C(1)<<MaxValueBits)-1;
+    }
+    buckets[slotIndex(value)].fetch_add(1,std::memory_order_relaxed);
+    count.fetch_add(1,std::memory_order_relaxed);
+    sum.fetch_add(value,std::memory_order_relaxed);
+    quint64 current = max.load(std::memory_order_relaxed);
+    while(value > current && !max.compare_exchange_weak(current,value,std::memory_order_relaxed))
+    {
+    }
+}
+/*
+ *@brief:   清零
+ *@date:    2026.10.18
+ */
+void UsbLatencyHistogram::reset()
+{
+    for(int i=0;i<SlotCount;i++)
+    {
+        buckets[i].store(0,std::memory_order_relaxed);
+    }
+    count.store(0,std::memory_order_relaxed);
+    sum.store(0,std::memory_order_relaxed);
+    max.store(0,std::memory_order_relaxed);
+}
+/*
+ *@brief:   值对应的桶索引
+ * [0,16)直接作为索引；[16<<(n-1),16<<n)为第n组，组内按最高位之后的4位分为16个子桶。
+ *@date:    2026.10.18
+ *@param:   value:记录值(小于2^MaxValueBits)
+ *@return:  int:桶索引
+ */
+int UsbLatencyHistogram::slotIndex(quint64 value)
+{
+    if(value < (quint64)SubBucketCount)
+    {
+        return (int)value;
+    }
+    int msb = 63-(int)qCountLeadingZeroBits(value);
+    int group = msb-SubBucketBits+1;
+    int sub = (int)(value>>(msb-SubBucketBits)) & (SubBucketCount-1);
+    return group*SubBucketCount+sub;
+}
+/*
+ *@brief:   桶的下界(包含)
+ *@date:    2026.10.18
+ *@param:   index:桶索引
+ *@return:  quint64:下界
+ */
+quint64 UsbLatencyHistogram::slotLowerBound(int index)
+{
+    if(index < SubBucketCount)
+    {
+        return (quint64)index;
+    }
+    int group = index/SubBucketCount;
+    int sub = index%SubBucketCount;
+    return (quint64)(SubBucketCount+sub)<<(group-1);
+}
+/*
+ *@brief:   桶的上界(包含)
+ *@date:    2026.10.18
+ *@param:   index:桶索引
+ *@return:  quint64:上界
+ */
+quint64 UsbLatencyHistogram::slotUpperBound(int index)
+{
+    if(index < SubBucketCount)
+    {
+        return (quint64)index;
+    }
+    int group = index/SubBucketCount;
+    return slotLowerBound(index)+(Q_UINT64_C(1)<<(group-1))-1;
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ */
+UsbEndpointMetricsSnapshot::UsbEndpointMetricsSnapshot()
+{
+    endpoint = 0;
+    transfers = 0;
+    bytes = 0;
+    shortTransfers = 0;
+    for(int i=0;i<StatusCount;i++)
+    {
+        statusCounts[i] = 0;
+    }
+    latencyCount = 0;
+    latencySum = 0;
+    latencyMax = 0;
+}
+/*
+ *@brief:   延迟百分位数
+ * 返回百分位所在桶的上界(不超过最大值)，误差不超过桶宽度。
+ *@date:    2026.10.18
+ *@param:   percent:百分位(0~100)
+ *@return:  quint64:延迟(us)
+ */
+quint64 UsbEndpointMetricsSnapshot::latencyPercentile(double percent) const
+{
+    if(latencyCount == 0)
+    {
+        return 0;
+    }
+    percent = qBound(0.0,percent,100.0);
+    quint64 target = (quint64)(latencyCount*percent/100.0+0.5);
+    target = qMax(target,(quint64)1);
+    quint64 accumulated = 0;
+    for(int i=0;i<latencySlots.size();i++)
+    {
+        accumulated += latencySlots.at(i);
+        if(accumulated >= target)
+        {
+            return qMin(UsbLatencyHistogram::slotUpperBound(i),latencyMax);
+        }
+    }
+    return latencyMax;
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ */
+UsbEndpointMetrics::UsbEndpointMetrics(quint8 endpoint)
+{
+    this->endpoint = endpoint;
+    reset();
+}
+/*
+ *@brief:   记录一次传输
+ *@date:    2026.10.18
+ *@param:   status:传输状态 详见enum libusb_transfer_status{}
+ *@param:   requested:请求长度
+ *@param:   actual:实际传输长度
+ *@param:   latencyNs:传输耗时(ns)
+ */
+void UsbEndpointMetrics::record(int status, int requested, int actual, qint64 latencyNs)
+{
+    transfers.fetch_add(1,std::memory_order_relaxed);
+    if(actual > 0)
+    {
+        bytes.fetch_add((quint64)actual,std::memory_order_relaxed);
+    }
+    if(status == LIBUSB_TRANSFER_COMPLETED && actual < requested)
+    {
+        shortTransfers.fetch_add(1,std::memory_order_relaxed);
+    }
+    if(status >= 0 && status < UsbEndpointMetricsSnapshot::StatusCount)
+    {
+        statusCounts[status].fetch_add(1,std::memory_order_relaxed);
+    }
+    latency.record(latencyNs > 0?(quint64)latencyNs/1000:0);
+}
+/*
+ *@brief:   获取快照
+ *@date:    2026.10.18
+ *@return:  UsbEndpointMetricsSnapshot:快照
+ */
+UsbEndpointMetricsSnapshot UsbEndpointMetrics::snapshot() const
+{
+    UsbEndpointMetricsSnapshot snapshot;
+    snapshot.endpoint = endpoint;
+    snapshot.transfers = transfers.load(std::memory_order_relaxed);
+    snapshot.bytes = bytes.load(std::memory_order_relaxed);
+    snapshot.shortTransfers = shortTransfers.load(std::memory_order_relaxed);
+    for(int i=0;i<UsbEndpointMetricsSnapshot::StatusCount;i++)
+    {
+        snapshot.statusCounts[i] = statusCounts[i].load(std::memory_order_relaxed);
+    }
+    //只保留到最后一个非空桶，减少快照的拷贝量
+    int lastSlot = -1;
+    for(int i=UsbLatencyHistogram::SlotCount-1;i>=0;i--)
+    {
+        if(latency.getSlotCount(i) != 0)
+        {
+            lastSlot = i;
+            break;
+        }
+    }
+    snapshot.latencySlots.resize(lastSlot+1);
+    snapshot.latencyCount = 0;
+    for(int i=0;i<=lastSlot;i++)
+    {
+        snapshot.latencySlots[i] = latency.getSlotCount(i);
+        snapshot.latencyCount += snapshot.latencySlots[i];
+    }
+    //各桶之和作为总数，保证与直方图自洽(与record并发时count可能略有差异)
+    snapshot.latencySum = latency.getSum();
+    snapshot.latencyMax = latency.getMax();
+    return snapshot;
+}
+/*
+ *@brief:   清零
+ *@date:    2026.10.18
+ */
+void UsbEndpointMetrics::reset()
+{
+    transfers.store(0,std::memory_order_relaxed);
+    bytes.store(0,std::memory_order_relaxed);
+    shortTransfers.store(0,std::memory_order_relaxed);
+    for(int i=0;i<UsbEndpointMetricsSnapshot::StatusCount;i++)
+    {
+        statusCounts[i].store(0,std::memory_order_relaxed);
+    }
+    latency.reset();
+}
+
+/*
+ *@brief:   构造函数(设备标识信息由后端提供，统计对象本身不访问设备)
+ *@date:    2026.10.18
+ *@param:   vendorId:厂商id
+ *@param:   productId:产品id
+ *@param:   busNumber:总线号
+ *@param:   deviceAddress:设备地址
+ */
+UsbDeviceMetrics::UsbDeviceMetrics(quint16 vendorId, quint16 productId, quint8 busNumber, quint8 deviceAddress)
+{
+    this->vendorId = vendorId;
+    this->productId = productId;
+    this->busNumber = busNumber;
+    this->deviceAddress = deviceAddress;
+    for(int i=0;i<32;i++)
+    {
+        endpoints[i].store(NULL,std::memory_order_relaxed);
+    }
+}
+/*
+ *@brief:   析构函数
+ *@date:    2026.10.18
+ */
+UsbDeviceMetrics::~UsbDeviceMetrics()
+{
+    for(int i=0;i<32;i++)
+    {
+        delete endpoints[i].load(std::memory_order_relaxed);
+    }
+}
+/*
+ *@brief:   记录一次传输
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ *@param:   status:传输状态 详见enum libusb_transfer_status{}
+ *@param:   requested:请求长度
+ *@param:   actual:实际传输长度
+ *@param:   latencyNs:传输耗时(ns)
+ */
+void UsbDeviceMetrics::record(quint8 endpoint, int status, int requested, int actual, qint64 latencyNs)
+{
+    endpointMetrics(endpoint)->record(status,requested,actual,latencyNs);
+}
+/*
+ *@brief:   获取快照
+ *@date:    2026.10.18
+ *@return:  UsbDeviceMetricsSnapshot:快照
+ */
+UsbDeviceMetricsSnapshot UsbDeviceMetrics::snapshot() const
+{
+    UsbDeviceMetricsSnapshot snapshot;
+    snapshot.vendorId = vendorId;
+    snapshot.productId = productId;
+    snapshot.busNumber = busNumber;
+    snapshot.deviceAddress = deviceAddress;
+    for(int i=0;i<32;i++)
+    {
+        UsbEndpointMetrics *metrics = endpoints[i].load(std::memory_order_acquire);
+        if(metrics)
+        {
+            snapshot.endpoints.append(metrics->snapshot());
+        }
+    }
+    return snapshot;
+}
+/*
+ *@brief:   清零
+ *@date:    2026.10.18
+ */
+void UsbDeviceMetrics::reset()
+{
+    for(int i=0;i<32;i++)
+    {
+        UsbEndpointMetrics *metrics = endpoints[i].load(std::memory_order_acquire);
+        if(metrics)
+        {
+            metrics->reset();
+        }
+    }
+}
+/*
+ *@brief:   获取端点的统计对象，不存在时无锁创建
+ * 多个线程同时创建时只有一个能写入，其余的删除自己创建的对象并使用已写入的对象。
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ *@return:  UsbEndpointMetrics*:统计对象
+ */
+UsbEndpointMetrics *UsbDeviceMetrics::endpointMetrics(quint8 endpoint)
+{
+    std::atomic<UsbEndpointMetrics *> &slot = endpoints[endpointIndex(endpoint)];
+    UsbEndpointMetrics *metrics = slot.load(std::memory_order_acquire);
+    if(metrics)
+    {
+        return metrics;
+    }
+    UsbEndpointMetrics *created = new UsbEndpointMetrics(endpoint);
+    if(slot.compare_exchange_strong(metrics,created,std::memory_order_acq_rel))
+    {
+        return created;
+    }
+    delete created;
+    return metrics;
+}
+
+/*
+ *@brief:   单调时钟
+ *@date:    2026.10.18
+ *@return:  qint64:时间戳(ns)
+ */
+qint64 UsbMetrics::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+/*
+ *@brief:   将同步传输的返回值映射为传输状态
+ *@date:    2026.10.18
+ *@param:   error:libusb_error(大于等于0视为成功)
+ *@return:  int:传输状态 详见enum libusb_transfer_status{}
+ */
+int UsbMetrics::statusFromError(int error)
+{
+    if(error >= 0)
+    {
+        return LIBUSB_TRANSFER_COMPLETED;
+    }
+    switch(error)
+    {
+    case LIBUSB_ERROR_TIMEOUT:
+        return LIBUSB_TRANSFER_TIMED_OUT;
+    case LIBUSB_ERROR_PIPE:
+        return LIBUSB_TRANSFER_STALL;
+    case LIBUSB_ERROR_NO_DEVICE:
+        return LIBUSB_TRANSFER_NO_DEVICE;
+    case LIBUSB_ERROR_OVERFLOW:
+        return LIBUSB_TRANSFER_OVERFLOW;
+    case LIBUSB_ERROR_INTERRUPTED:
+        return LIBUSB_TRANSFER_CANCELLED;
+    default:
+        return LIBUSB_TRANSFER_ERROR;
+    }
+}
+/*
+ *@brief:   传输状态名称
+ *@date:    2026.10.18
+ *@param:   status:传输状态 详见enum libusb_transfer_status{}
+ *@return:  const char*:名称
+ */
+const char *UsbMetrics::statusName(int status)
+{
+    switch(status)
+    {
+    case LIBUSB_TRANSFER_COMPLETED:
+        return "completed";
+    case LIBUSB_TRANSFER_ERROR:
+        return "error";
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        return "timed_out";
+    case LIBUSB_TRANSFER_CANCELLED:
+        return "cancelled";
+    case LIBUSB_TRANSFER_STALL:
+        return "stall";
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        return "no_device";
+    case LIBUSB_TRANSFER_OVERFLOW:
+        return "overflow";
+    default:
+        return "unknown";
+    }
+}
+/*
+ *@brief:   将统计快照转换为Prometheus文本格式(text/plain; version=0.0.4)
+ * 延迟直方图按2的幂(1us~2^36us)输出累计桶，单位转换为秒。
+ *@date:    2026.10.18
+ *@param:   snapshotList:设备统计快照列表
+ *@return:  QByteArray:Prometheus文本
+ */
+QByteArray UsbMetrics::toPrometheusText(const QList<UsbDeviceMetricsSnapshot> &snapshotList)
+{
+    QByteArray transfersText("# HELP usbcomm_transfers_total Completed USB transfers, including failed ones.\n"
+                             "# TYPE usbcomm_transfers_total counter\n");
+    QByteArray bytesText("# HELP usbcomm_transfer_bytes_total Bytes transferred.\n"
+                         "# TYPE usbcomm_transfer_bytes_total counter\n");
+    QByteArray shortText("# HELP usbcomm_short_transfers_total Transfers completed with less data than requested.\n"
+                         "# TYPE usbcomm_short_transfers_total counter\n");
+    QByteArray statusText("# HELP usbcomm_transfer_status_total Transfers by completion status.\n"
+                          "# TYPE usbcomm_transfer_status_total counter\n");
+    QByteArray latencyText("# HELP usbcomm_transfer_latency_seconds Transfer latency from submit to completion.\n"
+                           "# TYPE usbcomm_transfer_latency_seconds histogram\n");
+    for(int i=0;i<snapshotList.size();i++)
+    {
+        const UsbDeviceMetricsSnapshot &device = snapshotList.at(i);
+        for(int j=0;j<device.endpoints.size();j++)
+        {
+            const UsbEndpointMetricsSnapshot &ep = device.endpoints.at(j);
+            QByteArray labels = QByteArray("bus=\"")+QByteArray::number(device.busNumber)
+                    +"\",address=\""+QByteArray::number(device.deviceAddress)
+                    +"\",vid=\""+QByteArray::number(device.vendorId,16).rightJustified(4,'0')
+                    +"\",pid=\""+QByteArray::number(device.productId,16).rightJustified(4,'0')
+                    +"\",endpoint=\"0x"+QByteArray::number(ep.endpoint,16).rightJustified(2,'0')+"\"";
+            transfersText += "usbcomm_transfers_total{"+labels+"} "+QByteArray::number(ep.transfers)+"\n";
+            bytesText += "usbcomm_transfer_bytes_total{"+labels+"} "+QByteArray::number(ep.bytes)+"\n";
+            shortText += "usbcomm_short_transfers_total{"+labels+"} "+QByteArray::number(ep.shortTransfers)+"\n";
+            for(int k=0;k<UsbEndpointMetricsSnapshot::StatusCount;k++)
+            {
+                statusText += "usbcomm_transfer_status_total{"+labels+",status=\""+statusName(k)+"\"} "
+                        +QByteArray::number(ep.statusCounts[k])+"\n";
+            }
+            //Prometheus的le为小于等于，每组(2的幂区间)最后一个子桶的上界(2的幂减1，包含)与桶边界正好对齐，
+            //以其作为le(us)，累计上界<=le的子桶即为精确的计数
+            quint64 accumulated = 0;
+            int slot = 0;
+            for(int bits=0;bits<=UsbLatencyHistogram::MaxValueBits;bits++)
+            {
+                quint64 bound = (Q_UINT64_C(1)<<bits)-1;
+                while(slot < ep.latencySlots.size() && UsbLatencyHistogram::slotUpperBound(slot) <= bound)
+                {
+                    accumulated += ep.latencySlots.at(slot);
+                    slot++;
+                }
+                latencyText += "usbcomm_transfer_latency_seconds_bucket{"+labels+",le=\""
+                        +QByteArray::number(bound/1e6,'g',12)+"\"} "+QByteArray::number(accumulated)+"\n";
+            }
+            latencyText += "usbcomm_transfer_latency_seconds_bucket{"+labels+",le=\"+Inf\"} "
+                    +QByteArray::number(ep.latencyCount)+"\n";
+            latencyText += "usbcomm_transfer_latency_seconds_sum{"+labels+"} "
+                    +QByteArray::number(ep.latencySum/1e6,'g',12)+"\n";
+            latencyText += "usbcomm_transfer_latency_seconds_count{"+labels+"} "
+                    +QByteArray::number(ep.latencyCount)+"\n";
+        }
+    }
+    return transfersText+bytesText+shortText+statusText+latencyText;
+}
@@ -0,0 +1,145 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输统计组件
+ *
+ *按设备、端点统计传输次数、字节数、短包次数、各传输状态(超时、STALL等)次数以及传输延迟直方图。
+ *所有计数都是无锁的原子变量(relaxed)，每次传输只增加几次原子加法和两次时钟读取，可以在生产环境中常开。
+ *通过UsbComm::getMetricsSnapshot()获取快照，或者通过UsbComm::getMetricsPrometheusText()获取Prometheus文本格式。
+ */
+#ifndef USBMETRICS_H
+#define USBMETRICS_H
+
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <atomic>
+#include "libusb-1.0/include/libusb.h"
+
+/* 延迟直方图
+ * HDR风格的对数-线性分桶:[0,16)每个值一个桶，之后每个2的幂区间等分为16个子桶，相对误差不超过1/16。
+ * 单位为微秒，最大可记录2^36us(约19小时)，超出的按最大值记录。*/
+class UsbLatencyHistogram
+{
+public:
+    enum
+    {
+        SubBucketBits = 4,
+        SubBucketCount = 1<<SubBucketBits,
+        MaxValueBits = 36,
+        SlotCount = (MaxValueBits-SubBucketBits+1)*SubBucketCount
+    };
+    UsbLatencyHistogram();
+
+    void record(quint64 value);//记录一个值(无锁)
+    void reset();//清零(与record并发时结果不保证精确)
+
+    quint64 getCount() const{return count.load(std::memory_order_relaxed);}
+    quint64 getSum() const{return sum.load(std::memory_order_relaxed);}
+    quint64 getMax() const{return max.load(std::memory_order_relaxed);}
+    quint64 getSlotCount(int index) const{return buckets[index].load(std::memory_order_relaxed);}
+
+    static int slotIndex(quint64 value);//值对应的桶索引
+    static quint64 slotLowerBound(int index);//桶的下界(包含)
+    static quint64 slotUpperBound(int index);//桶的上界(包含)
+
+private:
+    std::atomic<quint64> buckets[SlotCount];
+    std::atomic<quint64> count;
+    std::atomic<quint64> sum;
+    std::atomic<quint64> max;
+};
+
+/* 端点统计快照 */
+struct UsbEndpointMetricsSnapshot
+{
+    enum {StatusCount = LIBUSB_TRANSFER_OVERFLOW+1};//libusb_transfer_status的数量
+
+    UsbEndpointMetricsSnapshot();
+    quint64 latencyPercentile(double percent) const;//延迟百分位数(us)，例如latencyPercentile(99.0)
+
+    quint8 endpoint;//端点地址
+    quint64 transfers;//完成的传输次数(包括出错)
+    quint64 bytes;//传输的字节数
+    quint64 shortTransfers;//短包次数(实际长度小于请求长度)
+    quint64 statusCounts[StatusCount];//各传输状态的次数，索引为enum libusb_transfer_status{}
+    QVector<quint64> latencySlots;//延迟直方图各桶的计数，桶的范围见UsbLatencyHistogram
+    quint64 latencyCount;
+    quint64 latencySum;//us
+    quint64 latencyMax;//us
+};
+
+/* 设备统计快照 */
+struct UsbDeviceMetricsSnapshot
+{
+    UsbDeviceMetricsSnapshot():vendorId(0),productId(0),busNumber(0),deviceAddress(0){}
+
+    quint16 vendorId;
+    quint16 productId;
+    quint8 busNumber;
+    quint8 deviceAddress;
+    QList<UsbEndpointMetricsSnapshot> endpoints;//有过传输的端点
+};
+
+/* 端点统计 */
+class UsbEndpointMetrics
+{
+public:
+    explicit UsbEndpointMetrics(quint8 endpoint);
+
+    //记录一次传输:status为libusb_transfer_status，requested为请求长度，latencyNs为传输耗时
+    void record(int status,int requested,int actual,qint64 latencyNs);
+    UsbEndpointMetricsSnapshot snapshot() const;
+    void reset();
+
+private:
+    quint8 endpoint;
+    std::atomic<quint64> transfers;
+    std::atomic<quint64> bytes;
+    std::atomic<quint64> shortTransfers;
+    std::atomic<quint64> statusCounts[UsbEndpointMetricsSnapshot::StatusCount];
+    UsbLatencyHistogram latency;
+};
+
+/* 设备统计，每个端点的统计对象在首次传输时无锁创建 */
+class UsbDeviceMetrics
+{
+public:
+    UsbDeviceMetrics(quint16 vendorId,quint16 productId,quint8 busNumber,quint8 deviceAddress);
+    ~UsbDeviceMetrics();
+
+    quint8 getBusNumber() const{return busNumber;}
+    quint8 getDeviceAddress() const{return deviceAddress;}
+
+    void record(quint8 endpoint,int status,int requested,int actual,qint64 latencyNs);
+    UsbDeviceMetricsSnapshot snapshot() const;
+    void reset();
+
+private:
+    static int endpointIndex(quint8 endpoint){return (endpoint & 0x0F)|((endpoint & 0x80)>>3);}
+    UsbEndpointMetrics *endpointMetrics(quint8 endpoint);
+
+    quint16 vendorId;
+    quint16 productId;
+    quint8 busNumber;
+    quint8 deviceAddress;
+    std::atomic<UsbEndpointMetrics *> endpoints[32];//索引:bit0~3端点号，bit4方向
+};
+
+/* 统计相关的辅助方法 */
+class UsbMetrics
+{
+public:
+    static qint64 nowNs();//单调时钟，单位ns
+    static int statusFromError(int error);//将同步传输的libusb_error映射为libusb_transfer_status
+    static const char *statusName(int status);//传输状态名称(Prometheus标签使用)
+    static QByteArray toPrometheusText(const QList<UsbDeviceMetricsSnapshot> &snapshotList);
+};
+
+#endif // USBMETRICS_H
@@ -1,15 +1,16 @@
 /****************************************************************************
 *
-* Copyright (C) 2021-2025 MiaoQingrui. All rights reserved.
+* Copyright (C) 2021-2026 MiaoQingrui. All rights reserved.
 * Author: 缪庆瑞 <justdoit_mqr@163.com>
 *
 ****************************************************************************/
 /*
  *@author:  缪庆瑞
  *@date:    2021.03.15
- *@update:  2025.06.06
+ *@update:  2026.10.18
  *@brief:   USB插拔状态监测组件
- *内部通过调用libusb的热插拔相关的api接口实现
+ *内部通过传输后端(UsbBackend)的热插拔接口实现，默认使用libusb的热插拔api；后端不支持热插拔时
+ *退回到UsbHotplugPoller周期性比较总线快照(周期可通过setPollInterval()设置)
  *备注：libusb库V1.0.23之前的版本，在热插拔回调监测时存在一个bug,会报错提示“libusb: error [udev_hotplug_event]
  *ignoring udev action bind”,可以通过升级版本解决该问题
  */
@@ -17,12 +18,11 @@
 #define USBMONITOR_H
 
 #include <QObject>
-#include <QThread>
 #include <QList>
-#include "libusb-1.0/include/libusb.h"
+#include "usbbackend.h"
 
+class UsbHotplugPoller;
 
-class UsbEventHandler;
 /* USB热插拔监测类
  * 该类可以用来定义成"全局"(有较长的生命周期)对象，实现对指定的usb设备进行热插拔监测。*/
 class UsbMonitor : public QObject
@@ -30,6 +30,7 @@ class UsbMonitor : public QObject
     Q_OBJECT
 public:
     UsbMonitor(QObject *parent = 0);
+    explicit UsbMonitor(UsbBackend *backend,QObject *parent = 0);//使用指定的传输后端(不转移所有权)
     ~UsbMonitor();
 
     //注册热插拔监测服务
@@ -40,38 +41,27 @@ public:
     //注销热插拔监测服务
     void deregisterHotplugMonitorService(libusb_hotplug_callback_handle *hotplugHandle = nullptr);
 
+    /*轮询监测(后端不支持热插拔时使用)*/
+    bool isPolling() const{return poller != NULL;}//是否使用轮询方式监测
+    void setPollInterval(int msec);//设置轮询周期(ms)
+    UsbHotplugPoller *getPoller() const{return poller;}//轮询监测对象(可获取轮询开销)，未使用时为NULL
+
 signals:
     void deviceHotplugSig(bool isAttached,int vendorId,int productId,int port);//设备插拔信号
+    //设备插拔信号(完整信息:总线、地址、端口路径、速度、设备类及描述符快照)，与deviceHotplugSig同时发出
+    void deviceHotplugEventSig(bool isAttached,const UsbDeviceRecord &record);
 
 private:
     //热插拔回调函数
-    static int LIBUSB_CALL hotplugCallback(libusb_context *ctx,libusb_device *device,
-                                           libusb_hotplug_event event,void *user_data);
+    void hotplugCallback(bool isAttached,const UsbDeviceRecord &record);
+    void deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle);
 
-    libusb_context *context;//表示libusb的一个会话，由libusb_init创建
+    UsbBackend *backend;//传输后端
+    bool ownBackend;//后端是否由该对象创建(析构时释放)
+    UsbHotplugPoller *poller;//轮询监测(后端不支持热插拔时创建)
+    int pollInterval;//轮询周期(ms)
     QList<libusb_hotplug_callback_handle> hotplugHandleList;//注册的热插拔回调句柄列表
-    UsbEventHandler *hotplugEventHandler;//热插拔事件处理对象
-
-};
 
-/* USB事件处理类
- * 该类继承自QThread，重写run()方法，在子线程中轮询处理挂起的事件(主要是USB设备的
- * 热插拔事件)，进而触发热插拔的回调函数。目前该类单纯是配合UsbMonitor的热插拔监测
- * 接口使用，相关处理已经封装在接口内，其他地方无需使用。*/
-class UsbEventHandler : public QThread
-{
-    Q_OBJECT
-public:
-    UsbEventHandler(libusb_context *context, QObject *parent = 0);
-    //设置控制线程结束的标记变量状态
-    void setStopped(bool stopped){this->stopped = stopped;}
-
-protected:
-    virtual void run();
-
-private:
-    libusb_context *context;//表示libusb的一个会话，由构造函参传递
-    volatile bool stopped;//标记变量，控制线程结束
 };
 
 #endif // USBMONITOR_H
@@ -0,0 +1,417 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输抓包组件
+ */
+#include "usbpcapwriter.h"
+#include <QDebug>
+#include <chrono>
+#include <errno.h>
+#include <string.h>
+
+namespace
+{
+/* pcap文件头 */
+struct PcapFileHeader
+{
+    quint32 magic;
+    quint16 versionMajor;
+    quint16 versionMinor;
+    qint32 thisZone;
+    quint32 sigFigs;
+    quint32 snapLength;
+    quint32 linkType;
+};
+/* pcap包头 */
+struct PcapPacketHeader
+{
+    quint32 tsSec;
+    quint32 tsUsec;
+    quint32 inclLength;
+    quint32 origLength;
+};
+/* usbmon包头(与内核的struct usbmon_packet一致，主机字节序) */
+struct UsbmonPacketHeader
+{
+    quint64 id;//URB标识
+    quint8 type;//'S'提交  'C'完成  'E'出错
+    quint8 transferType;//0=ISO  1=中断  2=控制  3=批量
+    quint8 endpoint;//端点地址(包含方向位)
+    quint8 deviceAddress;
+    quint16 busNumber;
+    char flagSetup;//0表示setup有效，'-'表示无setup
+    char flagData;//0表示包含数据，'<'或'>'表示无数据
+    qint64 tsSec;
+    qint32 tsUsec;
+    qint32 status;//-errno，提交时为-EINPROGRESS
+    quint32 length;//传输长度(提交时为请求长度，完成时为实际长度)
+    quint32 capturedLength;//包中保存的数据长度
+    quint8 setup[8];
+    qint32 interval;
+    qint32 startFrame;
+    quint32 transferFlags;
+    quint32 isoDescCount;
+};
+Q_STATIC_ASSERT(sizeof(UsbmonPacketHeader) == 64);
+
+const quint32 LinkTypeUsbLinuxMmapped = 220;
+
+//libusb传输类型转换为usbmon传输类型
+quint8 usbmonTransferType(quint8 transferType)
+{
+    switch(transferType)
+    {
+    case LIBUSB_TRANSFER_TYPE_ISOCHRONOUS:
+        return 0;
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        return 1;
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+        return 2;
+    default:
+        return 3;
+    }
+}
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   parent:父对象
+ */
+UsbPcapWriter::UsbPcapWriter(QObject *parent)
+    :QThread(parent),capturing(false),droppedPackets(0)
+{
+    snapLength = 65535;
+    bufferCapacity = 0;
+    stopped = true;
+}
+/*
+ *@brief:   析构函数
+ *@date:    2026.10.18
+ */
+UsbPcapWriter::~UsbPcapWriter()
+{
+    close();
+}
+/*
+ *@brief:   开始抓包，写入pcap文件头并启动写线程
+ *@date:    2026.10.18
+ *@param:   fileName:pcap文件路径
+ *@param:   snapLength:每个包最多保存的数据长度(不含64字节usbmon包头)
+ *@param:   bufferSize:内存缓冲区大小，写线程来不及写入时缓冲区满会丢包
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbPcapWriter::open(const QString &fileName, int snapLength, int bufferSize)
+{
+    close();
+    file.setFileName(fileName);
+    if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+    {
+        qDebug()<<"UsbPcapWriter open error:"<<file.errorString();
+        return false;
+    }
+    this->snapLength = qMax(snapLength,0);//先限制范围，文件头的snaplen由限制后的值得到
+    PcapFileHeader header;
+    header.magic = 0xa1b2c3d4;
+    header.versionMajor = 2;
+    header.versionMinor = 4;
+    header.thisZone = 0;
+    header.sigFigs = 0;
+    header.snapLength = (quint32)(this->snapLength+sizeof(UsbmonPacketHeader));
+    header.linkType = LinkTypeUsbLinuxMmapped;
+    file.write((const char *)&header,sizeof(header));
+
+    bufferCapacity = qMax(bufferSize,65536);
+    //预留容量后resize(0)不会释放内存，两个缓冲区交换使用，抓包过程中不再申请内存
+    bufferMutex.lock();
+    activeBuffer.reserve(bufferCapacity);
+    activeBuffer.resize(0);
+    flushBuffer.reserve(bufferCapacity);
+    flushBuffer.resize(0);
+    bufferMutex.unlock();
+    droppedPackets.store(0,std::memory_order_relaxed);
+
+    stopped = false;
+    start();
+    capturing.store(true,std::memory_order_relaxed);
+    return true;
+}
+/*
+ *@brief:   停止抓包
+ *@date:    2026.10.18
+ */
+void UsbPcapWriter::close()
+{
+    if(!file.isOpen())
+    {
+        return;
+    }
+    capturing.store(false,std::memory_order_relaxed);
+    bufferMutex.lock();
+    stopped = true;
+    bufferCond.wakeAll();
+    bufferMutex.unlock();
+    wait();
+    //写线程结束后，将剩余的数据写入文件(停止前刚通过isCapturing()判断的传输线程可能仍在追加，需要加锁)
+    bufferMutex.lock();
+    file.write(activeBuffer);
+    activeBuffer.resize(0);
+    bufferMutex.unlock();
+    file.close();
+    if(droppedPackets.load(std::memory_order_relaxed) > 0)
+    {
+        qDebug()<<"UsbPcapWriter dropped packets:"<<droppedPackets.load(std::memory_order_relaxed);
+    }
+}
+/*
+ *@brief:   记录异步传输
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   busNumber:总线号
+ *@param:   deviceAddress:设备地址
+ *@param:   event:'S'提交  'C'完成  'E'提交出错
+ *@param:   error:提交出错时的libusb_error
+ */
+void UsbPcapWriter::captureTransfer(libusb_transfer *transfer, quint8 busNumber, quint8 deviceAddress,
+                                    char event, int error)
+{
+    if(!isCapturing())
+    {
+        return;
+    }
+    const quint8 *setup = NULL;
+    const quint8 *data = transfer->buffer;
+    quint8 endpoint = transfer->endpoint;
+    int length = (event == 'C')?transfer->actual_length:transfer->length;
+    if(transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL)
+    {
+        libusb_control_setup *controlSetup = libusb_control_transfer_get_setup(transfer);
+        endpoint = (endpoint & 0x7F)|(controlSetup->bmRequestType & LIBUSB_ENDPOINT_IN);
+        data += LIBUSB_CONTROL_SETUP_SIZE;
+        if(event != 'C')
+        {
+            setup = transfer->buffer;
+            length = libusb_le16_to_cpu(controlSetup->wLength);
+        }
+    }
+    //提交时只有OUT方向有数据，完成时只有IN方向有数据
+    bool isIn = (endpoint & LIBUSB_ENDPOINT_IN);
+    bool hasData = (event == 'S')?!isIn:(event == 'C' && isIn);
+    int status = 0;
+    if(event == 'S')
+    {
+        status = -EINPROGRESS;
+    }
+    else if(event == 'C')
+    {
+        status = errnoFromStatus(transfer->status);
+    }
+    else
+    {
+        status = errnoFromError(error);
+        hasData = false;
+    }
+    writePacket((quint64)(quintptr)transfer,event,transfer->type,endpoint,busNumber,deviceAddress,
+                setup,status,length,hasData?data:NULL,hasData?length:0);
+}
+/*
+ *@brief:   记录同步批量传输
+ *@date:    2026.10.18
+ *@param:   busNumber:总线号
+ *@param:   deviceAddress:设备地址
+ *@param:   id:传输标识，提交与完成需相同，传输期间唯一
+ *@param:   complete:false=提交  true=完成
+ *@param:   endpoint:端点地址
+ *@param:   data:传输数据
+ *@param:   length:提交时为请求长度，完成时为实际长度
+ *@param:   error:完成时的libusb_error
+ */
+void UsbPcapWriter::captureSync(quint8 busNumber, quint8 deviceAddress, quint64 id, bool complete,
+                                quint8 endpoint, const quint8 *data, int length, int error)
+{
+    if(!isCapturing())
+    {
+        return;
+    }
+    bool isIn = (endpoint & LIBUSB_ENDPOINT_IN);
+    bool hasData = complete?isIn:!isIn;
+    int status = complete?errnoFromError(error):-EINPROGRESS;
+    writePacket(id,complete?'C':'S',LIBUSB_TRANSFER_TYPE_BULK,endpoint,busNumber,deviceAddress,
+                NULL,status,length,hasData?data:NULL,hasData?length:0);
+}
+/*
+ *@brief:   libusb_transfer_status转换为usbmon的状态
+ *@date:    2026.10.18
+ *@param:   status:传输状态 详见enum libusb_transfer_status{}
+ *@return:  int:-errno
+ */
+int UsbPcapWriter::errnoFromStatus(int status)
+{
+    switch(status)
+    {
+    case LIBUSB_TRANSFER_COMPLETED:
+        return 0;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        return -ETIMEDOUT;
+    case LIBUSB_TRANSFER_CANCELLED:
+        return -ENOENT;
+    case LIBUSB_TRANSFER_STALL:
+        return -EPIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        return -ESHUTDOWN;
+    case LIBUSB_TRANSFER_OVERFLOW:
+        return -EOVERFLOW;
+    default:
+        return -EPROTO;
+    }
+}
+/*
+ *@brief:   libusb_error转换为usbmon的状态
+ *@date:    2026.10.18
+ *@param:   error:libusb_error(大于等于0视为成功)
+ *@return:  int:-errno
+ */
+int UsbPcapWriter::errnoFromError(int error)
+{
+    if(error >= 0)
+    {
+        return 0;
+    }
+    switch(error)
+    {
+    case LIBUSB_ERROR_IO:
+        return -EIO;
+    case LIBUSB_ERROR_INVALID_PARAM:
+        return -EINVAL;
+    case LIBUSB_ERROR_ACCESS:
+        return -EACCES;
+    case LIBUSB_ERROR_NO_DEVICE:
+        return -ENODEV;
+    case LIBUSB_ERROR_NOT_FOUND:
+        return -ENOENT;
+    case LIBUSB_ERROR_BUSY:
+        return -EBUSY;
+    case LIBUSB_ERROR_TIMEOUT:
+        return -ETIMEDOUT;
+    case LIBUSB_ERROR_OVERFLOW:
+        return -EOVERFLOW;
+    case LIBUSB_ERROR_PIPE:
+        return -EPIPE;
+    case LIBUSB_ERROR_INTERRUPTED:
+        return -EINTR;
+    case LIBUSB_ERROR_NO_MEM:
+        return -ENOMEM;
+    case LIBUSB_ERROR_NOT_SUPPORTED:
+        return -ENOSYS;
+    default:
+        return -EPROTO;
+    }
+}
+/*
+ *@brief:   写线程:定时或缓冲区数据较多时与flushBuffer交换，在锁外写入文件
+ *@date:    2026.10.18
+ */
+void UsbPcapWriter::run()
+{
+    while(true)
+    {
+        bufferMutex.lock();
+        //缓冲区数据达到1/4容量时被唤醒，否则每100ms写入一次，减少小块写入和唤醒次数
+        if(!stopped && activeBuffer.size() < bufferCapacity/4)
+        {
+            bufferCond.wait(&bufferMutex,100);
+        }
+        if(stopped)//剩余数据由close()写入
+        {
+            bufferMutex.unlock();
+            break;
+        }
+        if(activeBuffer.isEmpty())
+        {
+            bufferMutex.unlock();
+            continue;
+        }
+        activeBuffer.swap(flushBuffer);
+        bufferMutex.unlock();
+
+        if(file.write(flushBuffer) != flushBuffer.size())
+        {
+            qDebug()<<"UsbPcapWriter write error:"<<file.errorString();
+        }
+        file.flush();
+        flushBuffer.resize(0);
+    }
+}
+/*
+ *@brief:   写入一个包到内存缓冲区
+ *@date:    2026.10.18
+ *@param:   id:传输标识
+ *@param:   event:'S'/'C'/'E'
+ *@param:   transferType:libusb传输类型
+ *@param:   endpoint:端点地址(包含方向位)
+ *@param:   busNumber:总线号
+ *@param:   deviceAddress:设备地址
+ *@param:   setup:控制传输的setup包(8字节)，其他为NULL
+ *@param:   status:-errno
+ *@param:   length:传输长度
+ *@param:   data:数据，无数据时为NULL
+ *@param:   dataLength:数据长度
+ */
+void UsbPcapWriter::writePacket(quint64 id, char event, quint8 transferType, quint8 endpoint,
+                                quint8 busNumber, quint8 deviceAddress, const quint8 *setup, int status,
+                                int length, const quint8 *data, int dataLength)
+{
+    qint64 now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    int capturedLength = qMin(qMax(dataLength,0),snapLength);
+
+    UsbmonPacketHeader usbmon;
+    memset(&usbmon,0,sizeof(usbmon));
+    usbmon.id = id;
+    usbmon.type = (quint8)event;
+    usbmon.transferType = usbmonTransferType(transferType);
+    usbmon.endpoint = endpoint;
+    usbmon.deviceAddress = deviceAddress;
+    usbmon.busNumber = busNumber;
+    usbmon.flagSetup = setup?0:'-';
+    usbmon.flagData = data?0:((endpoint & LIBUSB_ENDPOINT_IN)?'<':'>');
+    usbmon.tsSec = now/1000000;
+    usbmon.tsUsec = (qint32)(now%1000000);
+    usbmon.status = status;
+    usbmon.length = (quint32)qMax(length,0);
+    usbmon.capturedLength = (quint32)capturedLength;
+    if(setup)
+    {
+        memcpy(usbmon.setup,setup,8);
+    }
+
+    PcapPacketHeader packet;
+    packet.tsSec = (quint32)usbmon.tsSec;
+    packet.tsUsec = (quint32)usbmon.tsUsec;
+    packet.inclLength = (quint32)(sizeof(usbmon)+capturedLength);
+    packet.origLength = (quint32)(sizeof(usbmon)+qMax(dataLength,0));
+
+    int packetSize = (int)(sizeof(packet)+sizeof(usbmon))+capturedLength;
+    QMutexLocker locker(&bufferMutex);
+    if(activeBuffer.size()+packetSize > bufferCapacity)
+    {
+        droppedPackets.fetch_add(1,std::memory_order_relaxed);
+        return;
+    }
+    activeBuffer.append((const char *)&packet,sizeof(packet));
+    activeBuffer.append((const char *)&usbmon,sizeof(usbmon));
+    if(capturedLength > 0)
+    {
+        activeBuffer.append((const char *)data,capturedLength);
+    }
+    if(activeBuffer.size() >= bufferCapacity/4 && activeBuffer.size()-packetSize < bufferCapacity/4)
+    {
+        bufferCond.wakeOne();
+    }
+}
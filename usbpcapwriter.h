@@ -0,0 +1,70 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输抓包组件
+ *
+ *将经过UsbComm的每个传输按usbmon的格式(LINKTYPE_USB_LINUX_MMAPPED，每个包64字节头)写入pcap文件，
+ *可以直接用Wireshark分析，不需要root权限访问usbmon。
+ *抓包数据先追加到内存缓冲区(只有一次拷贝，不涉及文件IO)，由独立的写线程批量写入文件，对传输线程的影响
+ *很小。缓冲区满时丢弃新的包并计数，不会阻塞传输。
+ */
+#ifndef USBPCAPWRITER_H
+#define USBPCAPWRITER_H
+
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <atomic>
+#include "libusb-1.0/include/libusb.h"
+
+class UsbPcapWriter : public QThread
+{
+    Q_OBJECT
+public:
+    explicit UsbPcapWriter(QObject *parent = 0);
+    ~UsbPcapWriter();
+
+    //开始抓包:snapLength为每个包最多保存的数据长度，bufferSize为内存缓冲区大小
+    bool open(const QString &fileName,int snapLength=65535,int bufferSize=4*1024*1024);
+    void close();//停止抓包，将缓冲区中的数据全部写入文件
+    bool isCapturing() const{return capturing.load(std::memory_order_relaxed);}
+    quint64 getDroppedPackets() const{return droppedPackets.load(std::memory_order_relaxed);}//缓冲区满丢弃的包数
+
+    //记录异步传输:event='S'提交  'C'完成  'E'提交出错(error为libusb_error)
+    void captureTransfer(libusb_transfer *transfer,quint8 busNumber,quint8 deviceAddress,char event,int error=0);
+    //记录同步批量传输:id在传输期间唯一即可，complete=false为提交，true为完成(error为libusb_error)
+    void captureSync(quint8 busNumber,quint8 deviceAddress,quint64 id,bool complete,quint8 endpoint,
+                     const quint8 *data,int length,int error);
+
+    static int errnoFromStatus(int status);//libusb_transfer_status转换为usbmon的状态(-errno)
+    static int errnoFromError(int error);//libusb_error转换为usbmon的状态(-errno)
+
+protected:
+    virtual void run();
+
+private:
+    //写入一个包(usbmon包头+数据)到内存缓冲区
+    void writePacket(quint64 id,char event,quint8 transferType,quint8 endpoint,quint8 busNumber,quint8 deviceAddress,
+                     const quint8 *setup,int status,int length,const quint8 *data,int dataLength);
+
+    QFile file;
+    int snapLength;
+    int bufferCapacity;
+    QMutex bufferMutex;
+    QWaitCondition bufferCond;
+    QByteArray activeBuffer;//传输线程追加数据的缓冲区
+    QByteArray flushBuffer;//写线程写入文件的缓冲区(与activeBuffer交换)
+    volatile bool stopped;
+    std::atomic<bool> capturing;
+    std::atomic<quint64> droppedPackets;
+};
+
+#endif // USBPCAPWRITER_H
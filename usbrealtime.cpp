@@ -0,0 +1,122 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   事件线程和工作线程的实时配置(Linux)
+ */
+#include "usbrealtime.h"
+#include <QDebug>
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define REALTIME_STACK_PREFAULT (64*1024) //实时线程预先触发缺页的栈空间
+
+/*
+ *@brief:   对当前线程应用实时配置(在线程开始运行时调用)
+ *@date:    2026.10.18
+ *@param:   config:实时配置
+ *@return:  bool:true=成功(或没有需要设置的项)  false=设置失败(例如没有权限)
+ */
+bool UsbRealtime::applyThreadConfig(const UsbThreadConfig &config)
+{
+#ifdef Q_OS_LINUX
+    bool ok = true;
+    if(config.cpu >= 0)//绑定CPU，避免线程迁移带来的缓存失效
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(config.cpu,&cpuSet);
+        int err = pthread_setaffinity_np(pthread_self(),sizeof(cpuSet),&cpuSet);
+        if(err != 0)
+        {
+            qDebug()<<"pthread_setaffinity_np error:"<<strerror(err)<<"cpu:"<<config.cpu;
+            ok = false;
+        }
+    }
+    if(config.priority > 0)
+    {
+        sched_param param;
+        memset(&param,0,sizeof(param));
+        param.sched_priority = qBound(sched_get_priority_min(SCHED_FIFO),config.priority,
+                                      sched_get_priority_max(SCHED_FIFO));
+        int err = pthread_setschedparam(pthread_self(),SCHED_FIFO,&param);
+        if(err != 0)
+        {
+            qDebug()<<"pthread_setschedparam error:"<<strerror(err)<<"priority:"<<config.priority;
+            ok = false;
+        }
+        //预先触发栈空间的缺页，避免实时线程运行过程中栈增长产生缺页(通过volatile逐页写入，编译器不能省略)
+        volatile unsigned char stack[REALTIME_STACK_PREFAULT];
+        long pageSize = sysconf(_SC_PAGESIZE);
+        for(long i=0;i<REALTIME_STACK_PREFAULT;i+=pageSize)
+        {
+            stack[i] = 0;
+        }
+        stack[REALTIME_STACK_PREFAULT-1] = 0;
+        Q_UNUSED(stack)
+    }
+    return ok;
+#else
+    return (config.cpu < 0 && config.priority <= 0);
+#endif
+}
+/*
+ *@brief:   锁定进程内存
+ * mlockall(MCL_FUTURE)之后新映射的内存在映射时即被锁定并触发缺页。传输buffer的预先缺页由
+ * UsbBufferPool::reserve()完成(预留的内存块一直由缓冲池持有，与线程所用的malloc arena无关)。
+ * tuneMalloc=true时额外关闭malloc的内存归还和大块内存的mmap分配，并申请、逐页写入一块堆内存后释放，
+ * 使之后的普通堆申请复用这块已映射的内存。注意:mallopt()修改的是整个进程的分配器行为，调用后不可恢复，
+ * 而且预先缺页只覆盖调用线程所用的arena，其他线程从各自的arena申请时仍可能产生缺页。
+ * 需要在创建传输之前调用一次，需要CAP_IPC_LOCK或足够的RLIMIT_MEMLOCK。
+ *@date:    2026.10.18
+ *@param:   prefaultBytes:预先触发缺页的堆内存大小(只在tuneMalloc=true时使用)，默认64MB
+ *@param:   tuneMalloc:是否修改进程全局的malloc参数并预先触发堆内存缺页，默认不修改
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbRealtime::lockMemory(qint64 prefaultBytes, bool tuneMalloc)
+{
+#ifdef Q_OS_LINUX
+    if(tuneMalloc)
+    {
+        mallopt(M_TRIM_THRESHOLD,-1);//释放的内存不归还给系统
+        mallopt(M_MMAP_MAX,0);//大块内存也从堆中分配
+    }
+    if(mlockall(MCL_CURRENT|MCL_FUTURE) != 0)
+    {
+        qDebug()<<"mlockall error:"<<strerror(errno);
+        return false;
+    }
+    if(tuneMalloc && prefaultBytes > 0)
+    {
+        char *buffer = static_cast<char *>(malloc(prefaultBytes));
+        if(buffer == NULL)
+        {
+            qDebug()<<"lockMemory: malloc failed, size:"<<prefaultBytes;
+            return false;
+        }
+        volatile char *bytes = buffer;//通过volatile写入，避免编译器省略申请、写入和释放
+        long pageSize = sysconf(_SC_PAGESIZE);
+        for(qint64 i=0;i<prefaultBytes;i+=pageSize)
+        {
+            bytes[i] = 0;
+        }
+        free(buffer);
+    }
+    return true;
+#else
+    Q_UNUSED(prefaultBytes)
+    Q_UNUSED(tuneMalloc)
+    return false;
+#endif
+}
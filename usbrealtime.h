@@ -0,0 +1,42 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   事件线程和工作线程的实时配置(Linux)
+ *
+ *默认调度策略下事件线程可能被其他线程抢占，线程在CPU间迁移会使缓存失效，传输buffer首次访问时的缺页
+ *也会带来毫秒级的抖动。对完成延迟有严格要求(例如相机触发)时可以:
+ *1.为事件线程和完成工作线程绑定CPU，并使用SCHED_FIFO实时调度(需要CAP_SYS_NICE或root权限)；
+ *2.启动时调用lockMemory()锁定进程内存，并通过UsbBufferPool::reserve()按传输大小预留已触发缺页的buffer，
+ *  之后申请的传输buffer直接复用这些内存块，不再产生缺页。
+ *非Linux平台上各接口返回false，不影响正常使用。
+ */
+#ifndef USBREALTIME_H
+#define USBREALTIME_H
+
+#include <QtGlobal>
+
+/* 线程实时配置 */
+struct UsbThreadConfig
+{
+    UsbThreadConfig():cpu(-1),priority(0){}
+
+    int cpu;//绑定的CPU，-1表示不绑定
+    int priority;//SCHED_FIFO优先级(1~99)，0表示使用默认的调度策略
+};
+
+class UsbRealtime
+{
+public:
+    static bool applyThreadConfig(const UsbThreadConfig &config);//对当前线程应用实时配置
+    //锁定进程内存(mlockall)。tuneMalloc=true时还会修改malloc参数(释放的内存不归还系统、大块内存不使用mmap)
+    //并预先触发prefaultBytes堆内存的缺页，该修改作用于整个进程且不可恢复，只在应用自己决定时使用
+    static bool lockMemory(qint64 prefaultBytes = 64*1024*1024,bool tuneMalloc = false);
+};
+
+#endif // USBREALTIME_H
@@ -0,0 +1,629 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB流量回放设备
+ */
+#include "usbreplaydevice.h"
+#include "usbmetrics.h"
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+namespace
+{
+/* 解析后的usbmon事件 */
+struct UsbmonEvent
+{
+    qint64 time;//抓包时间(ns)
+    quint64 id;//URB标识
+    char type;//'S'提交  'C'完成  'E'出错
+    quint8 transferType;//0=ISO  1=中断  2=控制  3=批量
+    quint8 endpoint;
+    quint8 deviceAddress;
+    quint16 busNumber;
+    bool hasSetup;
+    int status;//-errno
+    int length;
+    QByteArray setup;
+    QByteArray data;
+};
+
+const quint32 LinkTypeUsbLinux = 189;//48字节usbmon包头
+const quint32 LinkTypeUsbLinuxMmapped = 220;//64字节usbmon包头
+
+quint16 swap16(quint16 value)
+{
+    return (quint16)((value>>8)|(value<<8));
+}
+quint32 swap32(quint32 value)
+{
+    return ((value>>24) & 0xFF)|((value>>8) & 0xFF00)|((value<<8) & 0xFF0000)|(value<<24);
+}
+quint64 swap64(quint64 value)
+{
+    return ((quint64)swap32((quint32)value)<<32)|swap32((quint32)(value>>32));
+}
+//从抓包数据中读取整数，swapped表示抓包主机与本机字节序不同
+quint16 read16(const char *p,bool swapped)
+{
+    quint16 value;
+    memcpy(&value,p,sizeof(value));
+    return swapped?swap16(value):value;
+}
+quint32 read32(const char *p,bool swapped)
+{
+    quint32 value;
+    memcpy(&value,p,sizeof(value));
+    return swapped?swap32(value):value;
+}
+quint64 read64(const char *p,bool swapped)
+{
+    quint64 value;
+    memcpy(&value,p,sizeof(value));
+    return swapped?swap64(value):value;
+}
+
+//usbmon的状态(-errno)转换为libusb_transfer_status
+int statusFromErrno(int status)
+{
+    switch(-status)
+    {
+    case 0:
+    case EREMOTEIO://短包(URB_SHORT_NOT_OK)
+        return LIBUSB_TRANSFER_COMPLETED;
+    case ETIMEDOUT:
+        return LIBUSB_TRANSFER_TIMED_OUT;
+    case ENOENT:
+    case ECONNRESET:
+        return LIBUSB_TRANSFER_CANCELLED;
+    case EPIPE:
+        return LIBUSB_TRANSFER_STALL;
+    case ESHUTDOWN:
+    case ENODEV:
+        return LIBUSB_TRANSFER_NO_DEVICE;
+    case EOVERFLOW:
+        return LIBUSB_TRANSFER_OVERFLOW;
+    default:
+        return LIBUSB_TRANSFER_ERROR;
+    }
+}
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   parent:父对象
+ */
+UsbReplayDevice::UsbReplayDevice(QObject *parent)
+    :UsbVirtualDevice(parent)
+{
+    timingMode = AsRecorded;
+    speedFactor = 1.0;
+    loop = false;
+    captureDuration = 1000000;
+    startTime = 0;
+    controlCursor = 0;
+    inPackets = 0;
+    outMatched = 0;
+    outMismatched = 0;
+    outUnexpected = 0;
+}
+/*
+ *@brief:   加载抓包文件(需在打开设备之前调用)
+ * 支持LINKTYPE_USB_LINUX(189)和LINKTYPE_USB_LINUX_MMAPPED(220)两种usbmon格式的pcap文件，微秒/纳秒时间戳
+ * 及两种字节序，不支持pcapng(可用editcap -F pcap转换)。抓包中包含设备描述符请求时会自动设置设备的vid/pid，
+ * 否则需要通过setDeviceInfo()设置。
+ *@date:    2026.10.18
+ *@param:   fileName:pcap文件路径
+ *@param:   busNumber:回放设备的总线号，-1表示自动选择
+ *@param:   deviceAddress:回放设备的地址，-1表示自动选择
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbReplayDevice::loadCapture(const QString &fileName, int busNumber, int deviceAddress)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug()<<"UsbReplayDevice open error:"<<file.errorString();
+        return false;
+    }
+    QByteArray content = file.readAll();
+    file.close();
+    if(content.size() < 24)
+    {
+        qDebug()<<"UsbReplayDevice: invalid pcap file";
+        return false;
+    }
+    /*pcap文件头*/
+    const char *p = content.constData();
+    bool swapped = false;
+    bool nanosecond = false;
+    switch(read32(p,false))
+    {
+    case 0xa1b2c3d4:
+        break;
+    case 0xd4c3b2a1:
+        swapped = true;
+        break;
+    case 0xa1b23c4d:
+        nanosecond = true;
+        break;
+    case 0x4d3cb2a1:
+        swapped = true;
+        nanosecond = true;
+        break;
+    default:
+        qDebug()<<"UsbReplayDevice: unsupported file format (only pcap is supported)";
+        return false;
+    }
+    quint32 linkType = read32(p+20,swapped) & 0xFFFF;
+    int usbmonSize = 0;
+    if(linkType == LinkTypeUsbLinuxMmapped)
+    {
+        usbmonSize = 64;
+    }
+    else if(linkType == LinkTypeUsbLinux)
+    {
+        usbmonSize = 48;
+    }
+    else
+    {
+        qDebug()<<"UsbReplayDevice: unsupported link type"<<linkType;
+        return false;
+    }
+    /*逐个解析包(usbmon包头与抓包主机的字节序一致，与pcap文件头相同)*/
+    QVector<UsbmonEvent> eventList;
+    int offset = 24;
+    while(offset+16 <= content.size())
+    {
+        qint64 tsSec = read32(p+offset,swapped);
+        qint64 tsFraction = read32(p+offset+4,swapped);
+        int inclLength = (int)read32(p+offset+8,swapped);
+        offset += 16;
+        if(inclLength < 0 || offset+inclLength > content.size())
+        {
+            qDebug()<<"UsbReplayDevice: truncated packet, ignore the rest";
+            break;
+        }
+        if(inclLength >= usbmonSize)
+        {
+            const char *usbmon = p+offset;
+            UsbmonEvent event;
+            event.time = tsSec*1000000000+(nanosecond?tsFraction:tsFraction*1000);
+            event.id = read64(usbmon,swapped);
+            event.type = usbmon[8];
+            event.transferType = (quint8)usbmon[9];
+            event.endpoint = (quint8)usbmon[10];
+            event.deviceAddress = (quint8)usbmon[11];
+            event.busNumber = read16(usbmon+12,swapped);
+            event.hasSetup = (usbmon[14] == 0);
+            event.status = (qint32)read32(usbmon+28,swapped);
+            event.length = (int)read32(usbmon+32,swapped);
+            int capturedLength = qMin((int)read32(usbmon+36,swapped),inclLength-usbmonSize);
+            event.setup = QByteArray(usbmon+40,8);
+            event.data = QByteArray(usbmon+usbmonSize,qMax(capturedLength,0));
+            eventList.append(event);
+        }
+        offset += inclLength;
+    }
+    /*选择回放的设备*/
+    if(busNumber < 0 || deviceAddress < 0)
+    {
+        for(int i=0;i<eventList.size();i++)
+        {
+            const UsbmonEvent &event = eventList.at(i);
+            if(event.transferType == 1 || event.transferType == 3)
+            {
+                busNumber = event.busNumber;
+                deviceAddress = event.deviceAddress;
+                break;
+            }
+        }
+        if(busNumber < 0 || deviceAddress < 0)
+        {
+            qDebug()<<"UsbReplayDevice: no bulk/interrupt transfer in capture";
+            return false;
+        }
+    }
+    /*按端点整理记录:提交与完成按URB标识配对*/
+    QHash<quint8,ReplayEndpoint> newEndpointHash;
+    QList<ReplayControl> newControlList;
+    QHash<quint64,UsbmonEvent> submitHash;
+    qint64 firstTime = -1;
+    qint64 lastTime = 0;
+    for(int i=0;i<eventList.size();i++)
+    {
+        const UsbmonEvent &event = eventList.at(i);
+        if(event.busNumber != busNumber || event.deviceAddress != deviceAddress)
+        {
+            continue;
+        }
+        if(firstTime < 0)
+        {
+            firstTime = event.time;
+        }
+        lastTime = event.time;
+        if(event.type == 'S')
+        {
+            submitHash.insert(event.id,event);
+            continue;
+        }
+        bool hasSubmit = submitHash.contains(event.id);
+        UsbmonEvent submit = submitHash.take(event.id);
+        if(event.type != 'C')//提交出错的传输没有到达设备
+        {
+            continue;
+        }
+        ReplayPacket packet;
+        packet.offset = event.time-firstTime;
+        packet.latency = hasSubmit?event.time-submit.time:0;
+        packet.status = statusFromErrno(event.status);
+        packet.length = event.length;
+        if(event.transferType == 2)//控制传输
+        {
+            if(!hasSubmit || !submit.hasSetup)
+            {
+                continue;
+            }
+            ReplayControl control;
+            control.setup = submit.setup;
+            if((quint8)submit.setup.at(0) & LIBUSB_ENDPOINT_IN)
+            {
+                packet.data = event.data;
+            }
+            else
+            {
+                packet.data = submit.data;
+                packet.length = submit.length;
+            }
+            control.packet = packet;
+            newControlList.append(control);
+        }
+        else if(event.transferType == 1 || event.transferType == 3)//中断/批量传输
+        {
+            if(event.endpoint & LIBUSB_ENDPOINT_IN)
+            {
+                //记录时应用层的超时/取消不属于设备行为，只保留其中收到的数据
+                if(packet.status == LIBUSB_TRANSFER_TIMED_OUT || packet.status == LIBUSB_TRANSFER_CANCELLED)
+                {
+                    if(event.data.isEmpty())
+                    {
+                        continue;
+                    }
+                    packet.status = LIBUSB_TRANSFER_COMPLETED;
+                }
+                packet.data = event.data;
+            }
+            else
+            {
+                if(!hasSubmit || packet.status == LIBUSB_TRANSFER_CANCELLED)
+                {
+                    continue;
+                }
+                packet.data = submit.data;
+                packet.length = submit.length;
+            }
+            newEndpointHash[event.endpoint].packets.append(packet);
+        }
+    }
+    if(newEndpointHash.isEmpty() && newControlList.isEmpty())
+    {
+        qDebug()<<"UsbReplayDevice: no transfer of device"<<busNumber<<":"<<deviceAddress;
+        return false;
+    }
+    /*设备描述符请求(GET_DESCRIPTOR DEVICE)的应答中包含vid/pid*/
+    quint16 vendorId = getVendorId();
+    quint16 productId = getProductId();
+    for(int i=0;i<newControlList.size();i++)
+    {
+        const QByteArray &setup = newControlList.at(i).setup;
+        const QByteArray &data = newControlList.at(i).packet.data;
+        if((quint8)setup.at(0) == 0x80 && setup.at(1) == LIBUSB_REQUEST_GET_DESCRIPTOR &&
+                setup.at(3) == LIBUSB_DT_DEVICE && data.size() >= 12)
+        {
+            vendorId = (quint8)data.at(8)|((quint8)data.at(9)<<8);
+            productId = (quint8)data.at(10)|((quint8)data.at(11)<<8);
+            break;
+        }
+    }
+    setDeviceInfo(vendorId,productId,(quint8)busNumber,(quint8)deviceAddress,getPortNumber());
+
+    replayMutex.lock();
+    endpointHash = newEndpointHash;
+    controlList = newControlList;
+    captureDuration = qMax(lastTime-firstTime,(qint64)1000000);
+    replayMutex.unlock();
+    rewind();
+    return true;
+}
+/*
+ *@brief:   设置回放时序(应在回放开始前设置，或设置后调用rewind())
+ *@date:    2026.10.18
+ *@param:   mode:时序模式
+ *@param:   speedFactor:倍速(AsRecorded模式有效)，例如10表示以10倍的速率回放
+ */
+void UsbReplayDevice::setTimingMode(TimingMode mode, double speedFactor)
+{
+    QMutexLocker locker(&replayMutex);
+    timingMode = mode;
+    this->speedFactor = (speedFactor > 0)?speedFactor:1.0;
+}
+/*
+ *@brief:   设置是否循环回放，开启后回放结束的端点会从头继续
+ *@date:    2026.10.18
+ *@param:   loop:true=循环  false=不循环
+ */
+void UsbReplayDevice::setLoop(bool loop)
+{
+    replayMutex.lock();
+    this->loop = loop;
+    QList<quint8> endpointList = endpointHash.keys();
+    replayMutex.unlock();
+    for(int i=0;i<endpointList.size();i++)
+    {
+        notifyDataAvailable(endpointList.at(i));
+    }
+}
+/*
+ *@brief:   从头开始回放，回放统计同时清零
+ *@date:    2026.10.18
+ */
+void UsbReplayDevice::rewind()
+{
+    replayMutex.lock();
+    QHash<quint8,ReplayEndpoint>::iterator it = endpointHash.begin();
+    for(;it != endpointHash.end();++it)
+    {
+        it.value().cursor = 0;
+        it.value().loopCount = 0;
+    }
+    controlCursor = 0;
+    startTime = 0;
+    inPackets = 0;
+    outMatched = 0;
+    outMismatched = 0;
+    outUnexpected = 0;
+    QList<quint8> endpointList = endpointHash.keys();
+    replayMutex.unlock();
+    //之前因为没有数据而挂起的传输重新处理
+    for(int i=0;i<endpointList.size();i++)
+    {
+        notifyDataAvailable(endpointList.at(i));
+    }
+}
+/*
+ *@brief:   抓包中出现的端点
+ *@date:    2026.10.18
+ *@return:  QList<quint8>:端点地址列表(不含控制端点)
+ */
+QList<quint8> UsbReplayDevice::getEndpoints() const
+{
+    QMutexLocker locker(&replayMutex);
+    QList<quint8> endpointList = endpointHash.keys();
+    std::sort(endpointList.begin(),endpointList.end());
+    return endpointList;
+}
+/*
+ *@brief:   已回放的IN包数
+ *@date:    2026.10.18
+ *@return:  quint64:包数
+ */
+quint64 UsbReplayDevice::getInPackets() const
+{
+    QMutexLocker locker(&replayMutex);
+    return inPackets;
+}
+/*
+ *@brief:   与记录一致的OUT包数
+ *@date:    2026.10.18
+ *@return:  quint64:包数
+ */
+quint64 UsbReplayDevice::getOutMatched() const
+{
+    QMutexLocker locker(&replayMutex);
+    return outMatched;
+}
+/*
+ *@brief:   与记录不一致的OUT包数
+ *@date:    2026.10.18
+ *@return:  quint64:包数
+ */
+quint64 UsbReplayDevice::getOutMismatched() const
+{
+    QMutexLocker locker(&replayMutex);
+    return outMismatched;
+}
+/*
+ *@brief:   记录之外的OUT包数(端点没有记录，或不循环时记录已回放完)
+ *@date:    2026.10.18
+ *@return:  quint64:包数
+ */
+quint64 UsbReplayDevice::getOutUnexpected() const
+{
+    QMutexLocker locker(&replayMutex);
+    return outUnexpected;
+}
+/*
+ *@brief:   处理一次传输
+ * IN方向:按顺序取下一个记录的包，AsRecorded模式下完成时间为回放开始时间+记录的偏移/倍速(处理不及时的
+ * 包立即完成)，超过传输的超时时间点或记录已回放完时挂起；OUT方向:与下一个记录的包比较，按记录的延迟完成。
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   deadline:超时时间点，0表示无限制
+ *@param:   completeTime:完成的时间点
+ *@return:  int:传输状态或TransferPending
+ */
+int UsbReplayDevice::processTransfer(libusb_transfer *transfer, qint64 deadline, qint64 &completeTime)
+{
+    QMutexLocker locker(&replayMutex);
+    qint64 now = UsbMetrics::nowNs();
+    if(startTime == 0)
+    {
+        startTime = now;
+    }
+    if(transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL)
+    {
+        return processControl(transfer,now,completeTime);
+    }
+
+    QHash<quint8,ReplayEndpoint>::iterator it = endpointHash.find(transfer->endpoint);
+    if(transfer->endpoint & LIBUSB_ENDPOINT_IN)
+    {
+        if(it == endpointHash.end())
+        {
+            return TransferPending;
+        }
+        ReplayEndpoint &endpoint = it.value();
+        if(endpoint.cursor >= endpoint.packets.size())
+        {
+            if(!loop || endpoint.packets.isEmpty())
+            {
+                return TransferPending;
+            }
+            endpoint.cursor = 0;
+            endpoint.loopCount++;
+        }
+        const ReplayPacket &packet = endpoint.packets.at(endpoint.cursor);
+        completeTime = now;
+        if(timingMode == AsRecorded)
+        {
+            completeTime = qMax(now,startTime+scaled(endpoint.loopCount*captureDuration+packet.offset));
+            if(deadline != 0 && completeTime > deadline)
+            {
+                return TransferPending;
+            }
+        }
+        endpoint.cursor++;
+        inPackets++;
+        int length = qMin(packet.data.size(),transfer->length);
+        memcpy(transfer->buffer,packet.data.constData(),length);
+        transfer->actual_length = length;
+        if(packet.data.size() > transfer->length)
+        {
+            return LIBUSB_TRANSFER_OVERFLOW;
+        }
+        return packet.status;
+    }
+
+    completeTime = now;
+    transfer->actual_length = transfer->length;
+    if(it == endpointHash.end() || it.value().packets.isEmpty() ||
+            (it.value().cursor >= it.value().packets.size() && !loop))
+    {
+        outUnexpected++;
+        return LIBUSB_TRANSFER_COMPLETED;
+    }
+    ReplayEndpoint &endpoint = it.value();
+    if(endpoint.cursor >= endpoint.packets.size())
+    {
+        endpoint.cursor = 0;
+        endpoint.loopCount++;
+    }
+    const ReplayPacket &packet = endpoint.packets.at(endpoint.cursor);
+    endpoint.cursor++;
+    if(comparePayload(packet,transfer->buffer,transfer->length))
+    {
+        outMatched++;
+    }
+    else
+    {
+        outMismatched++;
+        if(outMismatched == 1)//只打印第一次，之后只计数
+        {
+            qDebug()<<"UsbReplayDevice OUT payload mismatch, endpoint:"<<transfer->endpoint
+                   <<"packet:"<<endpoint.cursor-1;
+        }
+    }
+    completeTime = now+scaled(packet.latency);
+    if(packet.status != LIBUSB_TRANSFER_COMPLETED)
+    {
+        transfer->actual_length = 0;
+    }
+    return packet.status;
+}
+/*
+ *@brief:   处理控制传输:按setup包匹配记录的应答(相同的请求按记录的顺序依次应答)，没有记录的请求返回STALL
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   now:当前时间点
+ *@param:   completeTime:完成的时间点
+ *@return:  int:传输状态
+ */
+int UsbReplayDevice::processControl(libusb_transfer *transfer, qint64 now, qint64 &completeTime)
+{
+    completeTime = now;
+    transfer->actual_length = 0;
+    if(transfer->length < (int)LIBUSB_CONTROL_SETUP_SIZE)
+    {
+        return LIBUSB_TRANSFER_ERROR;
+    }
+    QByteArray setup((const char *)transfer->buffer,LIBUSB_CONTROL_SETUP_SIZE);
+    int count = controlList.size();
+    for(int i=0;i<count;i++)
+    {
+        int index = (controlCursor+i)%count;
+        if(controlList.at(index).setup != setup)
+        {
+            continue;
+        }
+        controlCursor = index+1;
+        const ReplayPacket &packet = controlList.at(index).packet;
+        completeTime = now+scaled(packet.latency);
+        if(packet.status != LIBUSB_TRANSFER_COMPLETED)
+        {
+            return packet.status;
+        }
+        int dataLength = transfer->length-(int)LIBUSB_CONTROL_SETUP_SIZE;
+        if((quint8)setup.at(0) & LIBUSB_ENDPOINT_IN)
+        {
+            int length = qMin(packet.data.size(),dataLength);
+            memcpy(transfer->buffer+LIBUSB_CONTROL_SETUP_SIZE,packet.data.constData(),length);
+            transfer->actual_length = length;
+        }
+        else
+        {
+            transfer->actual_length = dataLength;
+        }
+        return LIBUSB_TRANSFER_COMPLETED;
+    }
+    return LIBUSB_TRANSFER_STALL;
+}
+/*
+ *@brief:   比较OUT数据与记录(记录的数据可能被抓包长度截断，只比较记录的部分)
+ *@date:    2026.10.18
+ *@param:   packet:记录的包
+ *@param:   data:发送的数据
+ *@param:   length:发送的长度
+ *@return:  bool:true=一致  false=不一致
+ */
+bool UsbReplayDevice::comparePayload(const ReplayPacket &packet, const quint8 *data, int length)
+{
+    if(packet.length != length)
+    {
+        return false;
+    }
+    int compareLength = qMin(packet.data.size(),length);
+    return memcmp(packet.data.constData(),data,compareLength) == 0;
+}
+/*
+ *@brief:   按倍速缩放记录的时间，MaxSpeed模式为0
+ *@date:    2026.10.18
+ *@param:   duration:记录的时间(ns)
+ *@return:  qint64:回放的时间(ns)
+ */
+qint64 UsbReplayDevice::scaled(qint64 duration) const
+{
+    if(timingMode == MaxSpeed)
+    {
+        return 0;
+    }
+    return (qint64)(duration/speedFactor);
+}
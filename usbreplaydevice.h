@@ -0,0 +1,98 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB流量回放设备
+ *
+ *加载usbmon格式的pcap抓包文件(UsbComm::startCapture()、Wireshark或tcpdump -i usbmonX抓取)，作为虚拟设备
+ *通过UsbComm::openVirtualDevice()打开，在没有USB硬件的环境中回放设备的行为:
+ *1.IN端点按抓包中的顺序返回记录的数据，完成时间可以按记录的时间间隔(支持倍速)或以最快速度返回；
+ *2.OUT端点按顺序与记录的数据比较并计数，完成延迟与记录一致；
+ *3.控制传输按setup包匹配记录的应答，没有记录的请求返回STALL。
+ *开启循环回放后可以持续产生负载，配合倍速用于数据处理流程的压力测试。
+ */
+#ifndef USBREPLAYDEVICE_H
+#define USBREPLAYDEVICE_H
+
+#include "usbvirtualdevice.h"
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+
+class UsbReplayDevice : public UsbVirtualDevice
+{
+    Q_OBJECT
+public:
+    enum TimingMode
+    {
+        AsRecorded,//按记录的时间间隔回放(除以倍速)
+        MaxSpeed//忽略记录的时间，数据立即返回
+    };
+
+    explicit UsbReplayDevice(QObject *parent = 0);
+
+    //加载抓包文件，busNumber/deviceAddress为-1时选择第一个有批量/中断传输的设备
+    bool loadCapture(const QString &fileName,int busNumber=-1,int deviceAddress=-1);
+    void setTimingMode(TimingMode mode,double speedFactor=1.0);//设置回放时序及倍速
+    void setLoop(bool loop);//数据回放结束后是否从头循环
+    void rewind();//从头开始回放
+
+    QList<quint8> getEndpoints() const;//抓包中出现的端点(不含控制端点)
+    quint64 getInPackets() const;//已回放的IN包数
+    quint64 getOutMatched() const;//与记录一致的OUT包数
+    quint64 getOutMismatched() const;//与记录不一致的OUT包数
+    quint64 getOutUnexpected() const;//记录之外(已回放完)的OUT包数
+
+protected:
+    virtual int processTransfer(libusb_transfer *transfer,qint64 deadline,qint64 &completeTime);
+
+private:
+    /* 一个记录的传输 */
+    struct ReplayPacket
+    {
+        qint64 offset;//完成时间相对抓包开始的偏移(ns)
+        qint64 latency;//提交到完成的时间(ns)
+        int status;//完成状态，详见enum libusb_transfer_status{}
+        int length;//OUT方向的原始长度(data可能被截断)
+        QByteArray data;//IN方向为返回的数据，OUT方向为期望的数据
+    };
+    /* 一个端点的记录及回放位置 */
+    struct ReplayEndpoint
+    {
+        ReplayEndpoint():cursor(0),loopCount(0){}
+        QVector<ReplayPacket> packets;
+        int cursor;//下一个回放的包
+        int loopCount;//已循环的次数
+    };
+    /* 一个记录的控制传输 */
+    struct ReplayControl
+    {
+        QByteArray setup;//8字节setup包
+        ReplayPacket packet;
+    };
+
+    int processControl(libusb_transfer *transfer,qint64 now,qint64 &completeTime);
+    bool comparePayload(const ReplayPacket &packet,const quint8 *data,int length);
+    qint64 scaled(qint64 duration) const;//按倍速缩放时间
+
+    mutable QMutex replayMutex;//回放状态互斥锁(processTransfer在传输线程中调用)
+    TimingMode timingMode;
+    double speedFactor;
+    bool loop;
+    qint64 captureDuration;//抓包的时长(ns)，循环回放时作为每一轮的时间间隔
+    qint64 startTime;//回放开始的时间点(首次传输时确定)
+    QHash<quint8,ReplayEndpoint> endpointHash;//端点对应的记录
+    QList<ReplayControl> controlList;//记录的控制传输
+    int controlCursor;//下一次从该位置开始匹配控制传输(相同的请求按记录的顺序应答)
+    quint64 inPackets;
+    quint64 outMatched;
+    quint64 outMismatched;
+    quint64 outUnexpected;
+};
+
+#endif // USBREPLAYDEVICE_H
@@ -0,0 +1,155 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   按总线分片的libusb传输后端
+ */
+#include "usbshardedbackend.h"
+
+/*
+ *@brief:   构造函数，默认按总线号分片
+ *@date:    2026.10.18
+ */
+UsbShardedBackend::UsbShardedBackend()
+{
+    shardFunction = [](const UsbDeviceInfo &info){return (int)info.busNumber;};
+}
+/*
+ *@brief:   析构函数，停止所有分片的事件线程并释放其会话
+ *@date:    2026.10.18
+ */
+UsbShardedBackend::~UsbShardedBackend()
+{
+    QMap<int,UsbLibusbBackend *>::const_iterator it = shardMap.constBegin();
+    for(;it != shardMap.constEnd();++it)
+    {
+        delete it.value();
+    }
+}
+/*
+ *@brief:   设置分片函数(需在打开设备之前调用)
+ * 例如按设备组分片:[](const UsbDeviceInfo &info){return info.productId == 0x1234?0:1;}
+ *@date:    2026.10.18
+ *@param:   function:分片函数
+ */
+void UsbShardedBackend::setShardFunction(UsbShardFunction function)
+{
+    QMutexLocker locker(&shardMutex);
+    shardFunction = function;
+}
+/*
+ *@brief:   设置分片事件线程的实时配置(需在该分片创建之前，即首次打开属于该分片的设备之前调用)
+ *@date:    2026.10.18
+ *@param:   shard:分片号
+ *@param:   config:实时配置(绑定的CPU、SCHED_FIFO优先级)
+ */
+void UsbShardedBackend::setShardThreadConfig(int shard, const UsbThreadConfig &config)
+{
+    QMutexLocker locker(&shardMutex);
+    shardConfigMap.insert(shard,config);
+}
+/*
+ *@brief:   获取已创建的分片
+ *@date:    2026.10.18
+ *@return:  QList<int>:分片号列表
+ */
+QList<int> UsbShardedBackend::getShardList()
+{
+    QMutexLocker locker(&shardMutex);
+    return shardMap.keys();
+}
+/*
+ *@brief:   获取设备句柄所属的分片
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  int:分片号，-1表示不属于任何分片
+ */
+int UsbShardedBackend::getShard(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&shardMutex);
+    return handleShardHash.value(deviceHandle,-1);
+}
+/*
+ *@brief:   在设备所属分片的会话中打开设备
+ *@date:    2026.10.18
+ *@param:   info:设备信息(主会话最近一次枚举的结果)
+ *@param:   deviceHandle:返回的设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbShardedBackend::openDevice(const UsbDeviceInfo &info, libusb_device_handle **deviceHandle)
+{
+    shardMutex.lock();
+    int shard = shardFunction(info);
+    shardMutex.unlock();
+    UsbLibusbBackend *backend = shardBackend(shard);
+    //分片会话中的libusb_device与主会话不同，按总线号和地址找到同一个设备
+    int err = backend->openDeviceByAddress(info,deviceHandle);
+    if(err == LIBUSB_SUCCESS)
+    {
+        QMutexLocker locker(&shardMutex);
+        handleShardHash.insert(*deviceHandle,shard);
+    }
+    return err;
+}
+/*
+ *@brief:   关闭设备
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ */
+void UsbShardedBackend::closeDevice(libusb_device_handle *deviceHandle)
+{
+    shardMutex.lock();
+    handleShardHash.remove(deviceHandle);
+    shardMutex.unlock();
+    UsbLibusbBackend::closeDevice(deviceHandle);
+}
+/*
+ *@brief:   提交异步传输
+ * 分片的事件线程在创建分片时已经启动，这里直接提交，不启动主会话的事件线程。
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  int:libusb_error
+ */
+int UsbShardedBackend::submitTransfer(libusb_transfer *transfer)
+{
+    return libusb_submit_transfer(transfer);
+}
+/*
+ *@brief:   获取设备所属分片的忙轮询状态(由该分片的事件线程处理其完成事件)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbBusyPoll:忙轮询状态，不属于任何分片时使用主会话的
+ */
+UsbBusyPoll *UsbShardedBackend::getBusyPoll(libusb_device_handle *deviceHandle)
+{
+    QMutexLocker locker(&shardMutex);
+    if(!handleShardHash.contains(deviceHandle))
+    {
+        return UsbLibusbBackend::getBusyPoll(deviceHandle);
+    }
+    return shardMap.value(handleShardHash.value(deviceHandle))->getBusyPoll(deviceHandle);
+}
+/*
+ *@brief:   获取分片，不存在时创建会话并启动其事件线程
+ *@date:    2026.10.18
+ *@param:   shard:分片号
+ *@return:  UsbLibusbBackend:分片的后端
+ */
+UsbLibusbBackend *UsbShardedBackend::shardBackend(int shard)
+{
+    QMutexLocker locker(&shardMutex);
+    UsbLibusbBackend *backend = shardMap.value(shard);
+    if(backend == NULL)
+    {
+        backend = new UsbLibusbBackend();
+        backend->setEventThreadConfig(shardConfigMap.value(shard));
+        backend->startEventHandler();
+        shardMap.insert(shard,backend);
+    }
+    return backend;
+}
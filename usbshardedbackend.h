@@ -0,0 +1,56 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   按总线分片的libusb传输后端
+ *
+ *UsbLibusbBackend只有一个libusb会话，所有总线上的传输完成事件都经过同一个事件线程的同一组poll描述符。
+ *该后端为每个分片(默认每条USB总线，即每个主机控制器)创建独立的libusb会话和事件线程，事件线程可以绑定到
+ *不同的CPU(并可使用实时调度)，吞吐随主机控制器数量扩展。
+ *枚举、热插拔和sysfs设备数据库使用自身(主会话)，打开设备时按分片函数选择分片，在分片的会话中找到同一设备
+ *(总线号和地址相同)后打开；之后的操作都基于设备句柄，libusb按句柄所属的会话处理，无需再路由。
+ *UsbComm、UsbMonitor的用法不变，构造时传入该后端即可。
+ */
+#ifndef USBSHARDEDBACKEND_H
+#define USBSHARDEDBACKEND_H
+
+#include <QMap>
+#include "usblibusbbackend.h"
+
+//分片函数，返回设备所属的分片号(例如总线号或自定义的设备组)
+typedef std::function<int(const UsbDeviceInfo &info)> UsbShardFunction;
+
+class UsbShardedBackend : public UsbLibusbBackend
+{
+public:
+    UsbShardedBackend();
+    virtual ~UsbShardedBackend();//设备需已全部关闭
+
+    void setShardFunction(UsbShardFunction function);//设置分片函数(默认按总线号)，需在打开设备之前调用
+    void setShardThreadConfig(int shard,const UsbThreadConfig &config);//设置分片事件线程的实时配置，需在该分片创建之前调用
+    QList<int> getShardList();//已创建的分片
+    int getShard(libusb_device_handle *deviceHandle);//设备句柄所属的分片，-1表示不属于任何分片
+
+    virtual int openDevice(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle);
+    virtual int openDeviceByAddress(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle)
+    {return openDevice(info,deviceHandle);}//分片中的设备本来就按总线号和地址打开
+    virtual void closeDevice(libusb_device_handle *deviceHandle);
+    virtual int submitTransfer(libusb_transfer *transfer);
+    virtual UsbBusyPoll *getBusyPoll(libusb_device_handle *deviceHandle);
+
+private:
+    UsbLibusbBackend *shardBackend(int shard);//获取分片(按需创建并启动事件线程)
+
+    QMutex shardMutex;
+    UsbShardFunction shardFunction;
+    QMap<int,UsbLibusbBackend *> shardMap;//分片号对应的后端
+    QMap<int,UsbThreadConfig> shardConfigMap;//分片号对应事件线程的实时配置
+    QHash<libusb_device_handle *,int> handleShardHash;//设备句柄对应的分片号
+};
+
+#endif // USBSHARDEDBACKEND_H
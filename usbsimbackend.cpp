@@ -0,0 +1,351 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   进程内模拟传输后端
+ */
+#include "usbsimbackend.h"
+#include "usbvirtualdevice.h"
+#include <QDebug>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ */
+UsbSimBackend::UsbSimBackend()
+    :hotplugMutex(QMutex::Recursive)
+{
+    nextAddress = 1;
+    nextHotplugHandle = 1;
+}
+/*
+ *@brief:   析构函数
+ *@date:    2026.10.18
+ */
+UsbSimBackend::~UsbSimBackend()
+{
+}
+/*
+ *@brief:   接入设备，调用匹配的热插拔回调(在当前线程中)
+ *@date:    2026.10.18
+ *@param:   device:虚拟设备
+ */
+void UsbSimBackend::plugDevice(UsbVirtualDevice *device)
+{
+    if(device == NULL)
+    {
+        return;
+    }
+    mutex.lock();
+    if(deviceList.contains(device))
+    {
+        mutex.unlock();
+        return;
+    }
+    if(device->getDeviceAddress() == 0)
+    {
+        device->setDeviceInfo(device->getVendorId(),device->getProductId(),
+                              (device->getBusNumber() == 0)?1:device->getBusNumber(),
+                              nextAddress,device->getPortNumber());
+        nextAddress = (nextAddress >= 127)?1:nextAddress+1;
+    }
+    device->setAttached(true);
+    deviceList.append(device);
+    mutex.unlock();
+    notifyHotplug(true,device);
+}
+/*
+ *@brief:   拔出设备，挂起的传输以LIBUSB_TRANSFER_NO_DEVICE完成，之后的传输返回LIBUSB_ERROR_NO_DEVICE
+ *@date:    2026.10.18
+ *@param:   device:虚拟设备
+ */
+void UsbSimBackend::unplugDevice(UsbVirtualDevice *device)
+{
+    mutex.lock();
+    bool removed = deviceList.removeAll(device) > 0;
+    mutex.unlock();
+    if(removed)
+    {
+        device->setAttached(false);
+        notifyHotplug(false,device);
+    }
+}
+/*
+ *@brief:   获取接入的设备
+ *@date:    2026.10.18
+ *@return:  QList<UsbVirtualDevice *>:设备列表
+ */
+QList<UsbVirtualDevice *> UsbSimBackend::getAttachedDevices()
+{
+    QMutexLocker locker(&mutex);
+    return deviceList;
+}
+/*
+ *@brief:   枚举接入的设备
+ *@date:    2026.10.18
+ *@return:  QList<UsbDeviceInfo>:设备信息列表
+ */
+QList<UsbDeviceInfo> UsbSimBackend::getDeviceList()
+{
+    QList<UsbDeviceInfo> infoList;
+    QMutexLocker locker(&mutex);
+    for(int i=0;i<deviceList.size();i++)
+    {
+        infoList.append(deviceInfo(deviceList.at(i)));
+    }
+    return infoList;
+}
+/*
+ *@brief:   打印设备信息
+ *@date:    2026.10.18
+ *@param:   info:设备信息
+ */
+void UsbSimBackend::printDeviceInfo(const UsbDeviceInfo &info)
+{
+    qDebug()<<"***************************************";
+    qDebug()<<"Simulated device";
+    qDebug()<<"Bus: "<<(int)info.busNumber;
+    qDebug()<<"Device Address: "<<(int)info.deviceAddress;
+    qDebug()<<"Device Port: "<<(int)info.portNumber;
+    qDebug()<<"Device Speed: "<<info.speed;
+    qDebug()<<"Device Class: "<<QString("0x%1").arg((int)info.deviceClass,2,16,QChar('0'));
+    qDebug()<<"VendorID: "<<QString("0x%1").arg((int)info.vendorId,4,16,QChar('0'));
+    qDebug()<<"ProductID: "<<QString("0x%1").arg((int)info.productId,4,16,QChar('0'));
+    qDebug()<<"***************************************";
+}
+/*
+ *@brief:   打开设备
+ *@date:    2026.10.18
+ *@param:   info:设备信息
+ *@param:   deviceHandle:返回的设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::openDevice(const UsbDeviceInfo &info, libusb_device_handle **deviceHandle)
+{
+    UsbVirtualDevice *device = static_cast<UsbVirtualDevice *>(info.device);
+    QMutexLocker locker(&mutex);
+    if(!deviceList.contains(device))
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    *deviceHandle = reinterpret_cast<libusb_device_handle *>(device);
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   关闭设备(挂起的传输已由UsbComm取消，无需处理)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ */
+void UsbSimBackend::closeDevice(libusb_device_handle *deviceHandle)
+{
+    Q_UNUSED(deviceHandle)
+}
+/*
+ *@brief:   获取打开设备的信息
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbDeviceInfo:设备信息
+ */
+UsbDeviceInfo UsbSimBackend::getDeviceInfo(libusb_device_handle *deviceHandle)
+{
+    return deviceInfo(virtualDevice(deviceHandle));
+}
+/*
+ *@brief:   获取设备的描述符树
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::getConfigInfo(libusb_device_handle *deviceHandle, UsbConfigInfo *config)
+{
+    return virtualDevice(deviceHandle)->getConfigInfo(config);
+}
+/*
+ *@brief:   激活设备配置
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::setConfiguration(libusb_device_handle *deviceHandle, int bConfigurationValue)
+{
+    Q_UNUSED(bConfigurationValue)
+    return virtualDevice(deviceHandle)->isAttached()?LIBUSB_SUCCESS:LIBUSB_ERROR_NO_DEVICE;
+}
+/*
+ *@brief:   声明接口
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::claimInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    Q_UNUSED(interfaceNumber)
+    return virtualDevice(deviceHandle)->isAttached()?LIBUSB_SUCCESS:LIBUSB_ERROR_NO_DEVICE;
+}
+/*
+ *@brief:   释放接口
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::releaseInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    Q_UNUSED(interfaceNumber)
+    return virtualDevice(deviceHandle)->isAttached()?LIBUSB_SUCCESS:LIBUSB_ERROR_NO_DEVICE;
+}
+/*
+ *@brief:   激活接口备用设置
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::setInterfaceAltSetting(libusb_device_handle *deviceHandle, int interfaceNumber,
+                                          int bAlternateSetting)
+{
+    Q_UNUSED(interfaceNumber)
+    Q_UNUSED(bAlternateSetting)
+    return virtualDevice(deviceHandle)->isAttached()?LIBUSB_SUCCESS:LIBUSB_ERROR_NO_DEVICE;
+}
+/*
+ *@brief:   重置设备
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::resetDevice(libusb_device_handle *deviceHandle)
+{
+    return virtualDevice(deviceHandle)->resetDevice();
+}
+/*
+ *@brief:   清除端点的halt/stall状态
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::clearHalt(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    return virtualDevice(deviceHandle)->clearHalt(endpoint);
+}
+/*
+ *@brief:   同步传输
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::syncTransfer(libusb_device_handle *deviceHandle, quint8 transferType, quint8 endpoint,
+                                quint8 *data, int length, int *actualLength, quint32 timeout)
+{
+    return virtualDevice(deviceHandle)->transfer(transferType,endpoint,data,length,actualLength,timeout);
+}
+/*
+ *@brief:   提交异步传输，完成后在设备的完成线程中调用回调
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::submitTransfer(libusb_transfer *transfer)
+{
+    return virtualDevice(transfer->dev_handle)->submitTransfer(transfer);
+}
+/*
+ *@brief:   取消异步传输
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::cancelTransfer(libusb_transfer *transfer)
+{
+    return virtualDevice(transfer->dev_handle)->cancelTransfer(transfer);
+}
+/*
+ *@brief:   是否支持热插拔监测
+ *@date:    2026.10.18
+ *@return:  bool:始终支持
+ */
+bool UsbSimBackend::hasHotplug()
+{
+    return true;
+}
+/*
+ *@brief:   注册热插拔回调(回调在调用plugDevice()/unplugDevice()的线程中执行)
+ *@date:    2026.10.18
+ *@param:   deviceClass/vendorId/productId:匹配条件，LIBUSB_HOTPLUG_MATCH_ANY表示任意
+ *@param:   callback:热插拔回调
+ *@param:   hotplugHandle:返回的热插拔句柄
+ *@return:  int:libusb_error
+ */
+int UsbSimBackend::registerHotplug(int deviceClass, int vendorId, int productId, UsbHotplugCallback callback,
+                                   libusb_hotplug_callback_handle *hotplugHandle)
+{
+    HotplugEntry entry;
+    entry.deviceClass = deviceClass;
+    entry.vendorId = vendorId;
+    entry.productId = productId;
+    entry.callback = callback;
+    QMutexLocker locker(&hotplugMutex);
+    libusb_hotplug_callback_handle handle = nextHotplugHandle++;
+    hotplugMap.insert(handle,entry);
+    if(hotplugHandle)
+    {
+        *hotplugHandle = handle;
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   注销热插拔回调，返回后回调不会再被执行
+ *@date:    2026.10.18
+ *@param:   hotplugHandle:热插拔句柄
+ */
+void UsbSimBackend::deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle)
+{
+    QMutexLocker locker(&hotplugMutex);
+    hotplugMap.remove(hotplugHandle);
+}
+/*
+ *@brief:   获取虚拟设备的信息
+ *@date:    2026.10.18
+ *@param:   device:虚拟设备
+ *@return:  UsbDeviceInfo:设备信息
+ */
+UsbDeviceInfo UsbSimBackend::deviceInfo(UsbVirtualDevice *device)
+{
+    UsbDeviceInfo info;
+    info.vendorId = device->getVendorId();
+    info.productId = device->getProductId();
+    info.deviceClass = device->getDeviceClass();
+    info.busNumber = device->getBusNumber();
+    info.deviceAddress = device->getDeviceAddress();
+    info.portNumber = device->getPortNumber();
+    if(info.portNumber != 0)//模拟设备直接接在根集线器上
+    {
+        info.portPath.append(info.portNumber);
+    }
+    info.speed = device->getDeviceSpeed();
+    info.device = device;
+    return info;
+}
+/*
+ *@brief:   调用匹配的热插拔回调
+ *@date:    2026.10.18
+ *@param:   isAttached:true=接入  false=拔出
+ *@param:   device:虚拟设备
+ */
+void UsbSimBackend::notifyHotplug(bool isAttached, UsbVirtualDevice *device)
+{
+    UsbDeviceRecord record;
+    record.info = deviceInfo(device);
+    device->getConfigInfo(&record.config);//不支持时config为空
+    const UsbDeviceInfo &info = record.info;
+    //持有锁调用回调，保证注销返回后回调不会再被执行(与libusb的行为一致)
+    QMutexLocker locker(&hotplugMutex);
+    QList<libusb_hotplug_callback_handle> handleList = hotplugMap.keys();
+    for(int i=0;i<handleList.size();i++)
+    {
+        if(!hotplugMap.contains(handleList.at(i)))//在之前的回调中被注销
+        {
+            continue;
+        }
+        HotplugEntry entry = hotplugMap.value(handleList.at(i));
+        if((entry.deviceClass == LIBUSB_HOTPLUG_MATCH_ANY || entry.deviceClass == info.deviceClass) &&
+                (entry.vendorId == LIBUSB_HOTPLUG_MATCH_ANY || entry.vendorId == info.vendorId) &&
+                (entry.productId == LIBUSB_HOTPLUG_MATCH_ANY || entry.productId == info.productId))
+        {
+            entry.callback(isAttached,record);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   进程内模拟传输后端
+ *
+ *模拟一条USB总线，挂载UsbVirtualDevice(UsbSimDevice、UsbReplayDevice或自定义子类)。设备的枚举、打开、传输
+ *和热插拔都在进程内完成，不依赖内核和硬件，传输时序由设备对象决定，结果可复现。
+ *使用方法:创建后端并插入设备，然后作为参数构造UsbComm和UsbMonitor，之后的用法与真实设备完全相同。
+ */
+#ifndef USBSIMBACKEND_H
+#define USBSIMBACKEND_H
+
+#include <QMutex>
+#include <QMap>
+#include "usbbackend.h"
+
+class UsbVirtualDevice;
+
+class UsbSimBackend : public UsbBackend
+{
+public:
+    UsbSimBackend();
+    virtual ~UsbSimBackend();
+
+    /*模拟总线(设备对象由调用者管理，需在拔出之后再释放)*/
+    void plugDevice(UsbVirtualDevice *device);//接入设备，设备地址为0时自动分配
+    void unplugDevice(UsbVirtualDevice *device);//拔出设备，挂起的传输以LIBUSB_TRANSFER_NO_DEVICE完成
+    QList<UsbVirtualDevice *> getAttachedDevices();
+
+    virtual QList<UsbDeviceInfo> getDeviceList();
+    virtual void printDeviceInfo(const UsbDeviceInfo &info);
+    virtual int openDevice(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle);
+    virtual void closeDevice(libusb_device_handle *deviceHandle);
+    virtual UsbDeviceInfo getDeviceInfo(libusb_device_handle *deviceHandle);
+    virtual int getConfigInfo(libusb_device_handle *deviceHandle,UsbConfigInfo *config);
+
+    virtual int setConfiguration(libusb_device_handle *deviceHandle,int bConfigurationValue);
+    virtual int claimInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    virtual int releaseInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    virtual int setInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,int bAlternateSetting);
+    virtual int resetDevice(libusb_device_handle *deviceHandle);
+    virtual int clearHalt(libusb_device_handle *deviceHandle,quint8 endpoint);
+
+    virtual int syncTransfer(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                             quint8 *data,int length,int *actualLength,quint32 timeout);
+    virtual int submitTransfer(libusb_transfer *transfer);
+    virtual int cancelTransfer(libusb_transfer *transfer);
+
+    virtual bool hasHotplug();
+    virtual int registerHotplug(int deviceClass,int vendorId,int productId,UsbHotplugCallback callback,
+                                libusb_hotplug_callback_handle *hotplugHandle);
+    virtual void deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle);
+
+private:
+    /* 注册的热插拔回调 */
+    struct HotplugEntry
+    {
+        int deviceClass;
+        int vendorId;
+        int productId;
+        UsbHotplugCallback callback;
+    };
+    //模拟设备的句柄即设备对象的地址
+    static UsbVirtualDevice *virtualDevice(libusb_device_handle *deviceHandle)
+    {return reinterpret_cast<UsbVirtualDevice *>(deviceHandle);}
+    static UsbDeviceInfo deviceInfo(UsbVirtualDevice *device);
+    void notifyHotplug(bool isAttached,UsbVirtualDevice *device);//调用匹配的热插拔回调
+
+    QMutex mutex;//设备列表互斥锁
+    QList<UsbVirtualDevice *> deviceList;//接入的设备
+    quint8 nextAddress;//下一个自动分配的设备地址
+    QMutex hotplugMutex;//热插拔回调互斥锁(递归锁，回调期间注销也不会死锁)
+    QMap<libusb_hotplug_callback_handle,HotplugEntry> hotplugMap;
+    libusb_hotplug_callback_handle nextHotplugHandle;
+};
+
+#endif // USBSIMBACKEND_H
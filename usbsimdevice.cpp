@@ -0,0 +1,449 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   可配置的模拟USB设备
+ */
+#include "usbsimdevice.h"
+#include "usbmetrics.h"
+#include <QDebug>
+#include <string.h>
+#include <algorithm>
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   parent:父对象
+ */
+UsbSimDevice::UsbSimDevice(QObject *parent)
+    :UsbVirtualDevice(parent)
+{
+    bandwidth = 0;
+    latency = 0;
+    jitter = 0;
+    randomState = 0x12345678;
+    busFreeTime = 0;
+}
+/*
+ *@brief:   添加端点
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址(包含方向位)
+ *@param:   transferType:传输类型，LIBUSB_TRANSFER_TYPE_BULK/INTERRUPT
+ *@param:   maxPacketSize:最大包长，IN传输的长度不是其整数倍且数据超出时返回LIBUSB_TRANSFER_OVERFLOW
+ */
+void UsbSimDevice::addEndpoint(quint8 endpoint, int transferType, int maxPacketSize)
+{
+    QMutexLocker locker(&simMutex);
+    SimEndpoint &simEndpoint = endpointHash[endpoint];
+    simEndpoint.transferType = transferType;
+    simEndpoint.maxPacketSize = qMax(maxPacketSize,1);
+}
+/*
+ *@brief:   设置IN端点为数据源
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址(IN方向)
+ *@param:   source:true=始终有数据  false=只返回上报或回环的数据
+ */
+void UsbSimDevice::setSourceEndpoint(quint8 endpoint, bool source)
+{
+    simMutex.lock();
+    endpointHash[endpoint].source = source;
+    simMutex.unlock();
+    notifyDataAvailable(endpoint);
+}
+/*
+ *@brief:   设置回环:OUT端点的数据在其传输完成后从IN端点返回
+ *@date:    2026.10.18
+ *@param:   outEndpoint:OUT端点
+ *@param:   inEndpoint:IN端点，0表示取消回环
+ */
+void UsbSimDevice::setLoopback(quint8 outEndpoint, quint8 inEndpoint)
+{
+    QMutexLocker locker(&simMutex);
+    endpointHash[outEndpoint].loopbackEndpoint = inEndpoint;
+    if(inEndpoint != 0)
+    {
+        endpointHash[inEndpoint];
+    }
+}
+/*
+ *@brief:   设备主动上报数据，IN传输按顺序读取(数据大于传输长度时剩余部分留给下一个传输)
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址(IN方向)
+ *@param:   data:数据
+ */
+void UsbSimDevice::pushInData(quint8 endpoint, const QByteArray &data)
+{
+    SimMessage message;
+    message.data = data;
+    message.readyTime = UsbMetrics::nowNs();
+    simMutex.lock();
+    endpointHash[endpoint].messageList.append(message);
+    simMutex.unlock();
+    notifyDataAvailable(endpoint);
+}
+/*
+ *@brief:   设置总线带宽
+ *@date:    2026.10.18
+ *@param:   bytesPerSecond:每秒字节数，0表示不限制
+ */
+void UsbSimDevice::setBandwidth(qint64 bytesPerSecond)
+{
+    QMutexLocker locker(&simMutex);
+    bandwidth = qMax(bytesPerSecond,(qint64)0);
+}
+/*
+ *@brief:   设置传输延迟
+ *@date:    2026.10.18
+ *@param:   latencyNs:固定延迟(ns)
+ *@param:   jitterNs:随机抖动的最大值(ns)，每个传输在[0,jitterNs)内均匀分布
+ */
+void UsbSimDevice::setLatency(qint64 latencyNs, qint64 jitterNs)
+{
+    QMutexLocker locker(&simMutex);
+    latency = qMax(latencyNs,(qint64)0);
+    jitter = qMax(jitterNs,(qint64)0);
+}
+/*
+ *@brief:   设置随机数种子(抖动和按概率的错误注入使用)
+ *@date:    2026.10.18
+ *@param:   seed:种子，0会被替换为默认值
+ */
+void UsbSimDevice::setSeed(quint32 seed)
+{
+    QMutexLocker locker(&simMutex);
+    randomState = (seed != 0)?seed:0x12345678;
+}
+/*
+ *@brief:   注入错误:端点接下来的count个传输以status完成
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ *@param:   status:传输状态，例如LIBUSB_TRANSFER_STALL/TIMED_OUT/ERROR
+ *@param:   count:次数
+ */
+void UsbSimDevice::injectError(quint8 endpoint, int status, int count)
+{
+    QMutexLocker locker(&simMutex);
+    SimEndpoint &simEndpoint = endpointHash[endpoint];
+    simEndpoint.errorStatus = status;
+    simEndpoint.errorCount = qMax(count,0);
+}
+/*
+ *@brief:   按概率注入错误
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ *@param:   status:传输状态
+ *@param:   rate:概率[0,1]，0表示关闭
+ */
+void UsbSimDevice::setErrorRate(quint8 endpoint, int status, double rate)
+{
+    QMutexLocker locker(&simMutex);
+    SimEndpoint &simEndpoint = endpointHash[endpoint];
+    simEndpoint.errorRateStatus = status;
+    simEndpoint.errorRate = qBound(0.0,rate,1.0);
+}
+/*
+ *@brief:   端点已传输的字节数
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ *@return:  quint64:字节数
+ */
+quint64 UsbSimDevice::getTransferredBytes(quint8 endpoint) const
+{
+    QMutexLocker locker(&simMutex);
+    return endpointHash.value(endpoint).transferredBytes;
+}
+/*
+ *@brief:   清除端点的halt状态
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ *@return:  int:libusb_error
+ */
+int UsbSimDevice::clearHalt(quint8 endpoint)
+{
+    simMutex.lock();
+    QHash<quint8,SimEndpoint>::iterator it = endpointHash.find(endpoint);
+    if(it != endpointHash.end())
+    {
+        it.value().halted = false;
+    }
+    simMutex.unlock();
+    return UsbVirtualDevice::clearHalt(endpoint);
+}
+/*
+ *@brief:   重置设备:清除所有端点的halt状态和待上报的数据
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbSimDevice::resetDevice()
+{
+    simMutex.lock();
+    QHash<quint8,SimEndpoint>::iterator it = endpointHash.begin();
+    for(;it != endpointHash.end();++it)
+    {
+        it.value().halted = false;
+        it.value().messageList.clear();
+    }
+    busFreeTime = 0;
+    simMutex.unlock();
+    return UsbVirtualDevice::resetDevice();
+}
+/*
+ *@brief:   获取描述符树(由addEndpoint()的配置生成，所有端点位于厂商自定义类的接口0)
+ *@date:    2026.10.18
+ *@param:   config:返回的描述符树
+ *@return:  int:libusb_error
+ */
+int UsbSimDevice::getConfigInfo(UsbConfigInfo *config)
+{
+    QMutexLocker locker(&simMutex);
+    UsbAltSettingInfo altSetting;
+    altSetting.interfaceClass = LIBUSB_CLASS_VENDOR_SPEC;
+    QList<quint8> endpointList = endpointHash.keys();
+    std::sort(endpointList.begin(),endpointList.end());
+    for(int i=0;i<endpointList.size();i++)
+    {
+        const SimEndpoint &simEndpoint = endpointHash[endpointList.at(i)];
+        UsbEndpointInfo endpoint;
+        endpoint.address = endpointList.at(i);
+        endpoint.attributes = simEndpoint.transferType;
+        endpoint.transferType = simEndpoint.transferType;
+        endpoint.maxPacketSize = simEndpoint.maxPacketSize;
+        endpoint.interval = (simEndpoint.transferType == LIBUSB_TRANSFER_TYPE_INTERRUPT)?1:0;
+        altSetting.endpointList.append(endpoint);
+    }
+    UsbInterfaceInfo interfaceInfo;
+    interfaceInfo.altSettingList.append(altSetting);
+    *config = UsbConfigInfo();
+    config->configurationValue = 1;
+    config->interfaceList.append(interfaceInfo);
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   处理一次传输
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   deadline:超时时间点，0表示无限制
+ *@param:   completeTime:完成的时间点
+ *@return:  int:传输状态或TransferPending
+ */
+int UsbSimDevice::processTransfer(libusb_transfer *transfer, qint64 deadline, qint64 &completeTime)
+{
+    QMutexLocker locker(&simMutex);
+    qint64 now = UsbMetrics::nowNs();
+    if(transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL)
+    {
+        return processControl(transfer,now,completeTime);
+    }
+    completeTime = now;
+    transfer->actual_length = 0;
+    QHash<quint8,SimEndpoint>::iterator it = endpointHash.find(transfer->endpoint);
+    if(it == endpointHash.end())//端点不存在
+    {
+        return LIBUSB_TRANSFER_ERROR;
+    }
+    SimEndpoint &simEndpoint = it.value();
+    bool isIn = (transfer->endpoint & LIBUSB_ENDPOINT_IN);
+    //非数据源的IN端点没有数据时挂起(不消耗注入的错误)
+    if(isIn && !simEndpoint.source && simEndpoint.messageList.isEmpty() && !simEndpoint.halted)
+    {
+        return TransferPending;
+    }
+    if(simEndpoint.halted)
+    {
+        completeTime = now+completionDelay();
+        return LIBUSB_TRANSFER_STALL;
+    }
+    int error = takeError(simEndpoint);
+    if(error != LIBUSB_TRANSFER_COMPLETED)
+    {
+        if(error == LIBUSB_TRANSFER_STALL)
+        {
+            simEndpoint.halted = true;
+        }
+        completeTime = now+completionDelay();
+        return error;
+    }
+
+    if(isIn)
+    {
+        int status = LIBUSB_TRANSFER_COMPLETED;
+        int length = transfer->length;
+        qint64 readyTime = now;
+        if(!simEndpoint.source)
+        {
+            const SimMessage &message = simEndpoint.messageList.first();
+            readyTime = qMax(now,message.readyTime);
+            length = qMin(message.data.size(),transfer->length);
+            //数据超出传输长度且传输长度不是最大包长的整数倍，最后一个包溢出
+            if(message.data.size() > transfer->length && transfer->length%simEndpoint.maxPacketSize != 0)
+            {
+                status = LIBUSB_TRANSFER_OVERFLOW;
+            }
+        }
+        completeTime = busTime(readyTime,length,false)+latency;
+        if(deadline != 0 && completeTime > deadline)//超时之前数据无法就绪
+        {
+            return TransferPending;
+        }
+        completeTime = busTime(readyTime,length,true)+completionDelay();
+        if(simEndpoint.source)
+        {
+            memset(transfer->buffer,simEndpoint.sourceCounter++,length);
+        }
+        else
+        {
+            SimMessage &message = simEndpoint.messageList.first();
+            memcpy(transfer->buffer,message.data.constData(),length);
+            if(status == LIBUSB_TRANSFER_OVERFLOW || length == message.data.size())
+            {
+                simEndpoint.messageList.removeFirst();
+            }
+            else
+            {
+                message.data.remove(0,length);
+            }
+        }
+        transfer->actual_length = length;
+        simEndpoint.transferredBytes += length;
+        return status;
+    }
+
+    completeTime = busTime(now,transfer->length,true)+completionDelay();
+    transfer->actual_length = transfer->length;
+    simEndpoint.transferredBytes += transfer->length;
+    if(simEndpoint.loopbackEndpoint != 0)
+    {
+        SimMessage message;
+        message.data = QByteArray((const char *)transfer->buffer,transfer->length);
+        message.readyTime = completeTime;
+        endpointHash[simEndpoint.loopbackEndpoint].messageList.append(message);
+        markDataAvailable(simEndpoint.loopbackEndpoint);
+    }
+    return LIBUSB_TRANSFER_COMPLETED;
+}
+/*
+ *@brief:   处理控制传输:GET_DESCRIPTOR(设备描述符)返回由设备信息生成的描述符，GET_STATUS返回0，
+ * 其他IN方向的请求返回STALL，OUT方向的请求直接完成
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   now:当前时间点
+ *@param:   completeTime:完成的时间点
+ *@return:  int:传输状态
+ */
+int UsbSimDevice::processControl(libusb_transfer *transfer, qint64 now, qint64 &completeTime)
+{
+    completeTime = now;
+    transfer->actual_length = 0;
+    if(transfer->length < (int)LIBUSB_CONTROL_SETUP_SIZE)
+    {
+        return LIBUSB_TRANSFER_ERROR;
+    }
+    libusb_control_setup *setup = libusb_control_transfer_get_setup(transfer);
+    int dataLength = transfer->length-(int)LIBUSB_CONTROL_SETUP_SIZE;
+    quint8 *data = transfer->buffer+LIBUSB_CONTROL_SETUP_SIZE;
+    completeTime = busTime(now,dataLength,true)+completionDelay();
+    if(!(setup->bmRequestType & LIBUSB_ENDPOINT_IN))
+    {
+        transfer->actual_length = dataLength;
+        return LIBUSB_TRANSFER_COMPLETED;
+    }
+    QByteArray response;
+    if(setup->bRequest == LIBUSB_REQUEST_GET_DESCRIPTOR &&
+            (libusb_le16_to_cpu(setup->wValue)>>8) == LIBUSB_DT_DEVICE)
+    {
+        libusb_device_descriptor desc;
+        memset(&desc,0,sizeof(desc));
+        desc.bLength = LIBUSB_DT_DEVICE_SIZE;
+        desc.bDescriptorType = LIBUSB_DT_DEVICE;
+        desc.bcdUSB = libusb_cpu_to_le16((getDeviceSpeed() >= LIBUSB_SPEED_SUPER)?0x0300:0x0200);
+        desc.bDeviceClass = getDeviceClass();
+        desc.bMaxPacketSize0 = 64;
+        desc.idVendor = libusb_cpu_to_le16(getVendorId());
+        desc.idProduct = libusb_cpu_to_le16(getProductId());
+        desc.bNumConfigurations = 1;
+        response = QByteArray((const char *)&desc,LIBUSB_DT_DEVICE_SIZE);
+    }
+    else if(setup->bRequest == LIBUSB_REQUEST_GET_STATUS)
+    {
+        response = QByteArray(2,0);
+    }
+    else
+    {
+        return LIBUSB_TRANSFER_STALL;
+    }
+    int length = qMin(response.size(),dataLength);
+    memcpy(data,response.constData(),length);
+    transfer->actual_length = length;
+    return LIBUSB_TRANSFER_COMPLETED;
+}
+/*
+ *@brief:   取出本次传输注入的错误(先按次数，再按概率)
+ *@date:    2026.10.18
+ *@param:   endpoint:端点
+ *@return:  int:传输状态，没有注入错误时为LIBUSB_TRANSFER_COMPLETED
+ */
+int UsbSimDevice::takeError(SimEndpoint &endpoint)
+{
+    if(endpoint.errorCount > 0)
+    {
+        endpoint.errorCount--;
+        return endpoint.errorStatus;
+    }
+    if(endpoint.errorRate > 0 && nextRandom() < endpoint.errorRate*4294967296.0)
+    {
+        return endpoint.errorRateStatus;
+    }
+    return LIBUSB_TRANSFER_COMPLETED;
+}
+/*
+ *@brief:   计算占用总线传输length字节结束的时间点，传输按处理顺序依次占用总线
+ *@date:    2026.10.18
+ *@param:   startTime:最早开始的时间点
+ *@param:   length:字节数
+ *@param:   commit:true=占用总线  false=只计算
+ *@return:  qint64:结束的时间点
+ */
+qint64 UsbSimDevice::busTime(qint64 startTime, int length, bool commit)
+{
+    if(bandwidth <= 0)
+    {
+        return startTime;
+    }
+    qint64 endTime = qMax(startTime,busFreeTime)+(qint64)length*1000000000/bandwidth;
+    if(commit)
+    {
+        busFreeTime = endTime;
+    }
+    return endTime;
+}
+/*
+ *@brief:   传输完成的延迟
+ *@date:    2026.10.18
+ *@return:  qint64:固定延迟+[0,jitter)的随机抖动(ns)
+ */
+qint64 UsbSimDevice::completionDelay()
+{
+    if(jitter <= 0)
+    {
+        return latency;
+    }
+    return latency+(qint64)(nextRandom()%(quint64)jitter);
+}
+/*
+ *@brief:   伪随机数(xorshift32)
+ *@date:    2026.10.18
+ *@return:  quint32:随机数
+ */
+quint32 UsbSimDevice::nextRandom()
+{
+    randomState ^= randomState<<13;
+    randomState ^= randomState>>17;
+    randomState ^= randomState<<5;
+    return randomState;
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   可配置的模拟USB设备
+ *
+ *配合UsbSimBackend使用(也可以通过UsbComm::openVirtualDevice()直接打开)，用于没有硬件时的功能测试和性能测量:
+ *1.端点:IN端点可以配置为数据源(始终有数据，用于吞吐测试)，或者接收pushInData()上报的数据、OUT端点回环的数据；
+ *  OUT端点默认丢弃数据，只统计字节数。
+ *2.链路:所有端点共享总线带宽，传输按提交顺序占用总线，完成时间=占用总线结束+固定延迟+随机抖动。
+ *3.错误注入:指定端点接下来的若干传输或按概率以指定状态完成，STALL会使端点保持halt直到clearHalt。
+ *随机数使用固定种子，相同的配置和传输序列得到相同的结果。
+ */
+#ifndef USBSIMDEVICE_H
+#define USBSIMDEVICE_H
+
+#include "usbvirtualdevice.h"
+#include <QByteArray>
+
+class UsbSimDevice : public UsbVirtualDevice
+{
+    Q_OBJECT
+public:
+    explicit UsbSimDevice(QObject *parent = 0);
+
+    /*端点配置*/
+    void addEndpoint(quint8 endpoint,int transferType=LIBUSB_TRANSFER_TYPE_BULK,int maxPacketSize=512);
+    void setSourceEndpoint(quint8 endpoint,bool source=true);//IN端点始终有数据，每个传输填满请求长度
+    void setLoopback(quint8 outEndpoint,quint8 inEndpoint);//OUT端点收到的数据从IN端点返回
+    void pushInData(quint8 endpoint,const QByteArray &data);//设备主动上报数据(一次上报对应一个短包结束的传输)
+
+    /*链路特性*/
+    void setBandwidth(qint64 bytesPerSecond);//总线带宽，所有端点共享，0表示不限制
+    void setLatency(qint64 latencyNs,qint64 jitterNs=0);//每个传输的固定延迟及随机抖动的最大值
+    void setSeed(quint32 seed);//随机数种子
+
+    /*错误注入(status为enum libusb_transfer_status{})*/
+    void injectError(quint8 endpoint,int status,int count=1);//端点接下来的count个传输以status完成
+    void setErrorRate(quint8 endpoint,int status,double rate);//端点的每个传输以rate的概率以status完成
+
+    /*统计*/
+    quint64 getTransferredBytes(quint8 endpoint) const;//端点已传输的字节数
+
+    virtual int clearHalt(quint8 endpoint);
+    virtual int resetDevice();
+    virtual int getConfigInfo(UsbConfigInfo *config);
+
+protected:
+    virtual int processTransfer(libusb_transfer *transfer,qint64 deadline,qint64 &completeTime);
+
+private:
+    /* 待上报的数据 */
+    struct SimMessage
+    {
+        QByteArray data;
+        qint64 readyTime;//数据就绪的时间点
+    };
+    /* 端点的配置和状态 */
+    struct SimEndpoint
+    {
+        SimEndpoint():transferType(LIBUSB_TRANSFER_TYPE_BULK),maxPacketSize(512),source(false),
+            loopbackEndpoint(0),halted(false),errorStatus(LIBUSB_TRANSFER_COMPLETED),errorCount(0),
+            errorRateStatus(LIBUSB_TRANSFER_COMPLETED),errorRate(0),transferredBytes(0),sourceCounter(0){}
+
+        int transferType;
+        int maxPacketSize;
+        bool source;//IN端点始终有数据
+        quint8 loopbackEndpoint;//OUT端点回环的IN端点，0表示不回环
+        bool halted;//STALL之后处于halt状态
+        int errorStatus;//注入的错误
+        int errorCount;//注入的错误剩余次数
+        int errorRateStatus;//按概率注入的错误
+        double errorRate;
+        quint64 transferredBytes;
+        quint8 sourceCounter;//数据源每个传输的填充值(依次递增，便于校验)
+        QList<SimMessage> messageList;//待上报的数据
+    };
+
+    int processControl(libusb_transfer *transfer,qint64 now,qint64 &completeTime);
+    int takeError(SimEndpoint &endpoint);//取出本次传输注入的错误，没有时返回LIBUSB_TRANSFER_COMPLETED
+    qint64 busTime(qint64 startTime,int length,bool commit);//占用总线传输length字节结束的时间点
+    qint64 completionDelay();//固定延迟+随机抖动
+    quint32 nextRandom();
+
+    mutable QMutex simMutex;//模拟状态互斥锁(processTransfer在传输线程中调用)
+    QHash<quint8,SimEndpoint> endpointHash;
+    qint64 bandwidth;
+    qint64 latency;
+    qint64 jitter;
+    quint32 randomState;
+    qint64 busFreeTime;//总线空闲的时间点
+};
+
+#endif // USBSIMDEVICE_H
@@ -0,0 +1,308 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB端点的缓冲读取组件
+ */
+#include "usbstreamreader.h"
+#include <QtEndian>
+#include <string.h>
+#include <algorithm>
+
+/*
+ *@brief:   构造函数，一次性申请接收缓冲区
+ *@date:    2026.10.18
+ *@param:   usbComm:设备所属的UsbComm对象
+ *@param:   deviceHandle:设备句柄(对应接口需已声明)
+ *@param:   endpoint:IN端点地址
+ *@param:   bufferSize:接收缓冲区容量，同时也是单次可读取的最大长度
+ *@param:   transferSize:单次传输长度，建议为端点最大包长的整数倍，否则设备发送的数据包可能溢出
+ */
+UsbStreamReader::UsbStreamReader(UsbComm *usbComm, libusb_device_handle *deviceHandle, quint8 endpoint,
+                                 int bufferSize, int transferSize)
+{
+    this->usbComm = usbComm;
+    this->deviceHandle = deviceHandle;
+    this->endpoint = endpoint;
+    transferLength = qMax(transferSize,1);
+    buffer.resize(qMax(bufferSize,transferLength));
+    readPos = 0;
+    writePos = 0;
+}
+/*
+ *@brief:   读取固定长度的数据
+ *@date:    2026.10.18
+ *@param:   data:数据接收buffer，内存空间要在外部申请好
+ *@param:   length:读取长度，不能超过缓冲区容量
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:读取的字节数(等于length)  小于0表示出错
+ */
+int UsbStreamReader::readExactly(quint8 *data, int length, quint32 timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int err = ensureBuffered(length,timeout,timer);
+    if(err < 0)
+    {
+        return err;
+    }
+    memcpy(data,peek(),length);
+    consume(length);
+    return length;
+}
+/*
+ *@brief:   读取数据直到分隔符
+ *@date:    2026.10.18
+ *@param:   data:数据接收buffer，内存空间要在外部申请好
+ *@param:   maxLength:data可接收的最大长度
+ *@param:   delimiter:分隔符
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:读取的字节数(包含分隔符)  小于0表示出错，maxLength内找不到分隔符返回LIBUSB_ERROR_OVERFLOW
+ */
+int UsbStreamReader::readUntil(quint8 *data, int maxLength, quint8 delimiter, quint32 timeout)
+{
+    return readUntilPattern(data,maxLength,&delimiter,1,timeout);
+}
+/*
+ *@brief:   读取数据直到模式串
+ *@date:    2026.10.18
+ *@param:   data:数据接收buffer，内存空间要在外部申请好
+ *@param:   maxLength:data可接收的最大长度
+ *@param:   pattern:模式串(例如"\r\n")
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:读取的字节数(包含模式串)  小于0表示出错，maxLength内找不到模式串返回LIBUSB_ERROR_OVERFLOW
+ */
+int UsbStreamReader::readUntil(quint8 *data, int maxLength, const QByteArray &pattern, quint32 timeout)
+{
+    if(pattern.isEmpty())
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    return readUntilPattern(data,maxLength,(const quint8 *)pattern.constData(),pattern.size(),timeout);
+}
+/*
+ *@brief:   读取长度前缀帧(前缀表示其后负载的长度，不包含前缀本身)
+ *@date:    2026.10.18
+ *@param:   data:负载接收buffer，内存空间要在外部申请好
+ *@param:   maxLength:data可接收的最大长度
+ *@param:   prefixSize:长度前缀的字节数，支持1/2/4
+ *@param:   bigEndian:长度前缀是否为大端字节序
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:负载长度  小于0表示出错，负载超过maxLength返回LIBUSB_ERROR_OVERFLOW(数据保留在缓冲区中)
+ */
+int UsbStreamReader::readLengthPrefixed(quint8 *data, int maxLength, int prefixSize, bool bigEndian, quint32 timeout)
+{
+    if(prefixSize != 1 && prefixSize != 2 && prefixSize != 4)
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    int err = ensureBuffered(prefixSize,timeout,timer);
+    if(err < 0)
+    {
+        return err;
+    }
+    quint32 payloadLength = 0;
+    const quint8 *prefix = peek();
+    switch(prefixSize)
+    {
+    case 1:
+        payloadLength = prefix[0];
+        break;
+    case 2:
+        payloadLength = bigEndian?qFromBigEndian<quint16>(prefix):qFromLittleEndian<quint16>(prefix);
+        break;
+    default:
+        payloadLength = bigEndian?qFromBigEndian<quint32>(prefix):qFromLittleEndian<quint32>(prefix);
+        break;
+    }
+    if(payloadLength > (quint32)maxLength || payloadLength > (quint32)(capacity()-prefixSize))
+    {
+        return LIBUSB_ERROR_OVERFLOW;
+    }
+    err = ensureBuffered(prefixSize+payloadLength,timeout,timer);
+    if(err < 0)
+    {
+        return err;
+    }
+    memcpy(data,peek()+prefixSize,payloadLength);
+    consume(prefixSize+payloadLength);
+    return payloadLength;
+}
+/*
+ *@brief:   从端点接收一次数据追加到缓冲区
+ * 缓冲区尾部空间不足一次传输长度时，将未读数据移动到缓冲区头部(只移动未读部分，通常很少)。
+ *@date:    2026.10.18
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:接收的字节数(超时可能为0)  小于0表示出错，缓冲区已满返回LIBUSB_ERROR_OVERFLOW
+ */
+int UsbStreamReader::fill(quint32 timeout)
+{
+    if(capacity()-writePos < transferLength)
+    {
+        int size = bufferedSize();
+        if(readPos > 0)
+        {
+            memmove(buffer.data(),buffer.constData()+readPos,size);
+        }
+        readPos = 0;
+        writePos = size;
+        if(capacity()-writePos < transferLength)
+        {
+            return LIBUSB_ERROR_OVERFLOW;
+        }
+    }
+    int ret = usbComm->bulkTransfer(deviceHandle,endpoint,(quint8 *)buffer.data()+writePos,
+                                    transferLength,timeout);
+    if(ret > 0)
+    {
+        writePos += ret;
+    }
+    return ret;
+}
+/*
+ *@brief:   丢弃缓冲区头部指定长度的数据
+ *@date:    2026.10.18
+ *@param:   length:丢弃的长度
+ */
+void UsbStreamReader::consume(int length)
+{
+    readPos += qBound(0,length,bufferedSize());
+    if(readPos == writePos)//缓冲区为空时复位，避免不必要的数据移动
+    {
+        readPos = 0;
+        writePos = 0;
+    }
+}
+/*
+ *@brief:   清空缓冲区
+ *@date:    2026.10.18
+ */
+void UsbStreamReader::clear()
+{
+    readPos = 0;
+    writePos = 0;
+}
+/*
+ *@brief:   确保缓冲区中至少有length字节的数据
+ *@date:    2026.10.18
+ *@param:   length:需要的数据长度
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@param:   timer:读取开始时启动的计时器
+ *@return:  int:0=成功  小于0表示出错
+ */
+int UsbStreamReader::ensureBuffered(int length, quint32 timeout, const QElapsedTimer &timer)
+{
+    if(length > capacity())
+    {
+        return LIBUSB_ERROR_OVERFLOW;
+    }
+    while(bufferedSize() < length)
+    {
+        qint64 remain = remainTimeout(timeout,timer);
+        if(remain < 0)
+        {
+            return LIBUSB_ERROR_TIMEOUT;
+        }
+        int ret = fill((quint32)remain);
+        if(ret < 0)
+        {
+            return ret;
+        }
+    }
+    return 0;
+}
+/*
+ *@brief:   读取数据直到模式串(分隔符即长度为1的模式串)
+ *@date:    2026.10.18
+ *@param:   pattern:模式串
+ *@param:   patternLength:模式串长度
+ *@param:   其余参数同readUntil()
+ *@return:  int:读取的字节数(包含模式串)  小于0表示出错
+ */
+int UsbStreamReader::readUntilPattern(quint8 *data, int maxLength, const quint8 *pattern,
+                                      int patternLength, quint32 timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int scanPos = 0;//已扫描过的位置(相对未读数据起始)，新数据到达后只扫描新增部分
+    while(true)
+    {
+        int index = findPattern(pattern,patternLength,scanPos);
+        if(index >= 0)
+        {
+            int length = index+patternLength;
+            if(length > maxLength)
+            {
+                return LIBUSB_ERROR_OVERFLOW;
+            }
+            memcpy(data,peek(),length);
+            consume(length);
+            return length;
+        }
+        if(bufferedSize() >= maxLength)
+        {
+            return LIBUSB_ERROR_OVERFLOW;
+        }
+        qint64 remain = remainTimeout(timeout,timer);
+        if(remain < 0)
+        {
+            return LIBUSB_ERROR_TIMEOUT;
+        }
+        int ret = fill((quint32)remain);
+        if(ret < 0)
+        {
+            return ret;
+        }
+    }
+}
+/*
+ *@brief:   在缓冲数据中从scanPos开始查找模式串
+ *@date:    2026.10.18
+ *@param:   pattern:模式串
+ *@param:   patternLength:模式串长度
+ *@param:   scanPos:起始扫描位置(相对未读数据起始)，未找到时更新为下次需要开始扫描的位置
+ *@return:  int:模式串起始位置(相对未读数据起始)，-1表示未找到
+ */
+int UsbStreamReader::findPattern(const quint8 *pattern, int patternLength, int &scanPos) const
+{
+    const quint8 *base = peek();
+    int size = bufferedSize();
+    if(size-scanPos >= patternLength)
+    {
+        //memmem()是GNU/BSD扩展(MSVC没有)，多字节模式串使用std::search
+        const quint8 *end = base+size;
+        const quint8 *found = (patternLength == 1)?
+                    (const quint8 *)memchr(base+scanPos,pattern[0],size-scanPos):
+                    std::search(base+scanPos,end,pattern,pattern+patternLength);
+        if(found != NULL && found != end)
+        {
+            return found-base;
+        }
+    }
+    //模式串可能跨越新旧数据的边界，保留最后patternLength-1个字节下次重新扫描
+    scanPos = qMax(0,size-patternLength+1);
+    return -1;
+}
+/*
+ *@brief:   计算剩余超时时间
+ *@date:    2026.10.18
+ *@param:   timeout:总超时时间，单位ms， 0 无限制
+ *@param:   timer:读取开始时启动的计时器
+ *@return:  qint64:剩余超时时间，0表示无限制，-1表示已超时
+ */
+qint64 UsbStreamReader::remainTimeout(quint32 timeout, const QElapsedTimer &timer) const
+{
+    if(timeout == 0)
+    {
+        return 0;
+    }
+    qint64 remain = (qint64)timeout-timer.elapsed();
+    return (remain > 0)?remain:-1;
+}
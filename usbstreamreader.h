@@ -0,0 +1,63 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB端点的缓冲读取组件
+ *
+ *UsbComm::bulkTransfer()返回的是超时之前到达的任意长度数据，调用方需要自己拼接。该类在指定IN端点之上维护
+ *一个持久的接收缓冲区(构造时一次性申请，之后不再重新分配)，提供按固定长度、按分隔符/模式串以及按长度前缀
+ *读取的方法，多余的数据保留在缓冲区中供下次读取。单字节分隔符使用memchr(glibc中为SIMD实现)查找，
+ *多字节模式串使用std::search查找，并且只扫描新到达的数据，不会重复扫描。
+ *所有读取方法的返回值与bulkTransfer()保持一致:大于等于0表示读取的字节数，小于0表示出错(libusb_error)，
+ *超时返回LIBUSB_ERROR_TIMEOUT，此时已接收的数据仍保留在缓冲区中，不会丢失。
+ */
+#ifndef USBSTREAMREADER_H
+#define USBSTREAMREADER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include "usbcomm.h"
+
+class UsbStreamReader
+{
+public:
+    UsbStreamReader(UsbComm *usbComm,libusb_device_handle *deviceHandle,quint8 endpoint,
+                    int bufferSize=65536,int transferSize=16384);
+
+    /*缓冲读取(timeout为整个读取过程的超时时间，单位ms，0 无限制)*/
+    int readExactly(quint8 *data,int length,quint32 timeout);//读取固定长度
+    int readUntil(quint8 *data,int maxLength,quint8 delimiter,quint32 timeout);//读取到分隔符(包含分隔符)
+    int readUntil(quint8 *data,int maxLength,const QByteArray &pattern,quint32 timeout);//读取到模式串(包含模式串)
+    int readLengthPrefixed(quint8 *data,int maxLength,int prefixSize,bool bigEndian,quint32 timeout);//读取长度前缀帧(不含前缀)
+
+    /*缓冲区直接访问(零拷贝)，peek返回的指针在下一次fill或读取之前有效*/
+    int fill(quint32 timeout);//从端点接收一次数据追加到缓冲区，返回接收的字节数
+    const quint8 *peek() const{return (const quint8 *)buffer.constData()+readPos;}//缓冲数据起始地址
+    int bufferedSize() const{return writePos-readPos;}//缓冲数据长度
+    void consume(int length);//丢弃缓冲区头部指定长度的数据
+    void clear();//清空缓冲区
+
+    int capacity() const{return buffer.size();}
+    int transferSize() const{return transferLength;}
+
+private:
+    int ensureBuffered(int length,quint32 timeout,const QElapsedTimer &timer);//确保缓冲区中至少有length字节
+    int readUntilPattern(quint8 *data,int maxLength,const quint8 *pattern,int patternLength,quint32 timeout);
+    int findPattern(const quint8 *pattern,int patternLength,int &scanPos) const;//从scanPos开始查找模式串
+    qint64 remainTimeout(quint32 timeout,const QElapsedTimer &timer) const;//计算剩余超时时间
+
+    UsbComm *usbComm;
+    libusb_device_handle *deviceHandle;
+    quint8 endpoint;//IN端点地址
+    int transferLength;//单次传输长度，建议为端点最大包长的整数倍
+    QByteArray buffer;//持久接收缓冲区
+    int readPos;//未读数据起始位置
+    int writePos;//未读数据结束位置
+};
+
+#endif // USBSTREAMREADER_H
@@ -0,0 +1,335 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输跟踪组件
+ */
+#include "usbtrace.h"
+#include "usbmetrics.h"
+#include <QThread>
+#include <QMutex>
+#include <QList>
+#include <QFile>
+#include <QDebug>
+
+namespace
+{
+//各线程的缓冲区在线程结束后仍然登记(线程结束后的事件同样需要导出)，同时进入空闲链表供新线程复用，
+//缓冲区数量不超过同时存在的跟踪线程数，程序退出时由系统回收
+QMutex &ringListMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+QList<UsbTraceRing *> &ringList()
+{
+    static QList<UsbTraceRing *> list;
+    return list;
+}
+QList<UsbTraceRing *> &freeRingList()
+{
+    static QList<UsbTraceRing *> list;
+    return list;
+}
+std::atomic<bool> traceEnabled(true);
+std::atomic<qint64> traceStartTime(0);//clear()之后只导出该时间之后的事件
+
+//Chrome trace中显示的端点名称，例如"0x81 IN"
+QByteArray endpointName(quint8 endpoint)
+{
+    return "0x"+QByteArray::number(endpoint,16).rightJustified(2,'0')+
+            ((endpoint & LIBUSB_ENDPOINT_IN)?" IN":" OUT");
+}
+}
+
+/* 线程结束时归还该线程的缓冲区 */
+struct UsbTraceRingOwner
+{
+    UsbTraceRingOwner():ring(NULL){}
+    ~UsbTraceRingOwner()
+    {
+        if(ring != NULL)
+        {
+            UsbTrace::releaseRing(ring);
+        }
+    }
+
+    UsbTraceRing *ring;
+};
+
+static thread_local UsbTraceRingOwner ringOwner;
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   threadIndex:缓冲区序号(导出时作为tid)
+ *@param:   threadName:线程名称
+ */
+UsbTraceRing::UsbTraceRing(int threadIndex, const QByteArray &threadName)
+    :head(0)
+{
+    this->threadIndex = threadIndex;
+    this->threadName = threadName;
+    startTime = 0;
+}
+/*
+ *@brief:   追加事件(只能在所属线程调用)
+ *@date:    2026.10.18
+ *@param:   event:事件
+ */
+void UsbTraceRing::append(const UsbTraceEvent &event)
+{
+    quint64 index = head.load(std::memory_order_relaxed);
+    ring[index & (Capacity-1)] = event;
+    head.store(index+1,std::memory_order_release);
+}
+/*
+ *@brief:   由新线程复用(在登记表的锁内调用)
+ * 只修改名称和起始时间，之前的事件保留在缓冲区中被逐渐覆盖，导出时按起始时间过滤。
+ *@date:    2026.10.18
+ *@param:   threadName:新线程的名称
+ *@param:   startTime:新线程开始使用的时间
+ */
+void UsbTraceRing::reuse(const QByteArray &threadName, qint64 startTime)
+{
+    this->threadName = threadName;
+    this->startTime = startTime;
+}
+/*
+ *@brief:   读取事件
+ * 读取过程中所属线程可能仍在写入，读取结束后根据最新的写入位置丢弃可能已被覆盖的事件。
+ *@date:    2026.10.18
+ *@param:   since:起始时间戳(ns)
+ *@return:  QVector<UsbTraceEvent>:按时间先后排列的事件
+ */
+QVector<UsbTraceEvent> UsbTraceRing::events(qint64 since) const
+{
+    quint64 end = head.load(std::memory_order_acquire);
+    quint64 begin = (end > (quint64)Capacity)?end-Capacity:0;
+    QVector<UsbTraceEvent> eventList;
+    eventList.reserve((int)(end-begin));
+    for(quint64 i=begin;i<end;i++)
+    {
+        eventList.append(ring[i & (Capacity-1)]);
+    }
+    quint64 newHead = head.load(std::memory_order_acquire);
+    int overwritten = (newHead > begin+Capacity)?(int)qMin(newHead-begin-Capacity,(quint64)eventList.size()):0;
+    eventList.remove(0,overwritten);
+    int skip = 0;
+    while(skip < eventList.size() && eventList.at(skip).timestamp < since)
+    {
+        skip++;
+    }
+    eventList.remove(0,skip);
+    return eventList;
+}
+
+/*
+ *@brief:   设置运行时开关
+ *@date:    2026.10.18
+ *@param:   enabled:true=记录  false=不记录
+ */
+void UsbTrace::setEnabled(bool enabled)
+{
+    traceEnabled.store(enabled,std::memory_order_relaxed);
+}
+/*
+ *@brief:   运行时开关状态
+ *@date:    2026.10.18
+ *@return:  bool:true=记录  false=不记录
+ */
+bool UsbTrace::isEnabled()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+/*
+ *@brief:   记录事件(通常通过USB_TRACE宏调用)
+ *@date:    2026.10.18
+ *@param:   type:事件类型，详见enum UsbTraceEvent::Type{}
+ *@param:   id:事件标识
+ *@param:   endpoint:端点地址
+ *@param:   length:传输长度
+ *@param:   status:传输状态或返回值
+ */
+void UsbTrace::record(quint8 type, quint64 id, quint8 endpoint, qint32 length, qint16 status)
+{
+    if(!traceEnabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    UsbTraceEvent event;
+    event.timestamp = UsbMetrics::nowNs();
+    event.id = id;
+    event.length = length;
+    event.status = status;
+    event.type = type;
+    event.endpoint = endpoint;
+    threadRing()->append(event);
+}
+/*
+ *@brief:   清空已记录的事件
+ *@date:    2026.10.18
+ */
+void UsbTrace::clear()
+{
+    traceStartTime.store(UsbMetrics::nowNs(),std::memory_order_relaxed);
+}
+/*
+ *@brief:   导出为Chrome trace JSON(Trace Event Format)
+ * 同步传输和事件循环为所在线程上的持续事件(B/E)，异步传输为以libusb_transfer指针为id的异步事件(b/e)，
+ * 取消和热插拔为瞬时事件。时间单位为us，保留3位小数(即ns精度)。
+ *@date:    2026.10.18
+ *@return:  QByteArray:JSON文本
+ */
+QByteArray UsbTrace::toChromeTraceJson()
+{
+    //名称和起始时间在复用时会被修改，在锁内取出
+    QList<UsbTraceRing *> rings;
+    QList<QByteArray> nameList;
+    QList<qint64> startTimeList;
+    ringListMutex().lock();
+    rings = ringList();
+    for(int i=0;i<rings.size();i++)
+    {
+        nameList.append(rings.at(i)->getThreadName());
+        startTimeList.append(rings.at(i)->getStartTime());
+    }
+    ringListMutex().unlock();
+
+    qint64 since = traceStartTime.load(std::memory_order_relaxed);
+    QByteArray json("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for(int i=0;i<rings.size();i++)
+    {
+        UsbTraceRing *ring = rings.at(i);
+        QByteArray tid = QByteArray::number(ring->getThreadIndex());
+        QByteArray common = ",\"pid\":1,\"tid\":"+tid;
+        json += QByteArray(first?"":",\n")+"{\"name\":\"thread_name\",\"ph\":\"M\""+common+
+                ",\"args\":{\"name\":\""+nameList.at(i)+"\"}}";
+        first = false;
+
+        QVector<UsbTraceEvent> eventList = ring->events(qMax(since,startTimeList.at(i)));
+        for(int j=0;j<eventList.size();j++)
+        {
+            const UsbTraceEvent &event = eventList.at(j);
+            QByteArray ts = ",\"ts\":"+QByteArray::number(event.timestamp/1000.0,'f',3);
+            QByteArray id = ",\"id\":\"0x"+QByteArray::number(event.id,16)+"\"";
+            QByteArray args = ",\"args\":{\"length\":"+QByteArray::number(event.length)+
+                    ",\"status\":"+QByteArray::number(event.status)+"}";
+            QByteArray line;
+            switch(event.type)
+            {
+            case UsbTraceEvent::Submit:
+                line = "{\"name\":\"urb "+endpointName(event.endpoint)+"\",\"cat\":\"urb\",\"ph\":\"b\""+
+                        ts+common+id+args+"}";
+                break;
+            case UsbTraceEvent::Complete:
+                line = "{\"name\":\"urb "+endpointName(event.endpoint)+"\",\"cat\":\"urb\",\"ph\":\"e\""+
+                        ts+common+id+args+"}";
+                break;
+            case UsbTraceEvent::Cancel:
+                line = "{\"name\":\"cancel "+endpointName(event.endpoint)+"\",\"cat\":\"urb\",\"ph\":\"i\",\"s\":\"t\""+
+                        ts+common+id+args+"}";
+                break;
+            case UsbTraceEvent::SyncBegin:
+                line = "{\"name\":\"bulkTransfer "+endpointName(event.endpoint)+"\",\"cat\":\"sync\",\"ph\":\"B\""+
+                        ts+common+args+"}";
+                break;
+            case UsbTraceEvent::SyncEnd:
+                line = "{\"name\":\"bulkTransfer "+endpointName(event.endpoint)+"\",\"cat\":\"sync\",\"ph\":\"E\""+
+                        ts+common+args+"}";
+                break;
+            case UsbTraceEvent::EventLoopBegin:
+                line = "{\"name\":\"handle_events\",\"cat\":\"event\",\"ph\":\"B\""+ts+common+"}";
+                break;
+            case UsbTraceEvent::EventLoopEnd:
+                line = "{\"name\":\"handle_events\",\"cat\":\"event\",\"ph\":\"E\""+ts+common+"}";
+                break;
+            case UsbTraceEvent::Hotplug:
+                line = QByteArray("{\"name\":\"")+
+                        ((event.status == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)?"hotplug arrived":"hotplug left")+
+                        "\",\"cat\":\"hotplug\",\"ph\":\"i\",\"s\":\"g\""+ts+common+
+                        ",\"args\":{\"vid\":\""+QByteArray::number((event.id>>16) & 0xFFFF,16).rightJustified(4,'0')+
+                        "\",\"pid\":\""+QByteArray::number(event.id & 0xFFFF,16).rightJustified(4,'0')+
+                        "\",\"port\":"+QByteArray::number(event.endpoint)+"}}";
+                break;
+            default:
+                continue;
+            }
+            json += ",\n"+line;
+        }
+    }
+    json += "\n]}\n";
+    return json;
+}
+/*
+ *@brief:   导出Chrome trace JSON到文件
+ *@date:    2026.10.18
+ *@param:   fileName:文件路径
+ *@return:  bool:true=成功  false=失败
+ */
+bool UsbTrace::exportChromeTrace(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+    {
+        qDebug()<<"exportChromeTrace open error:"<<file.errorString();
+        return false;
+    }
+    QByteArray json = toChromeTraceJson();
+    if(file.write(json) != json.size())
+    {
+        qDebug()<<"exportChromeTrace write error:"<<file.errorString();
+        return false;
+    }
+    return true;
+}
+/*
+ *@brief:   获取当前线程的缓冲区，首次调用时复用空闲的缓冲区或创建并登记(之后不再加锁)
+ *@date:    2026.10.18
+ *@return:  UsbTraceRing*:缓冲区
+ */
+UsbTraceRing *UsbTrace::threadRing()
+{
+    UsbTraceRing *ring = ringOwner.ring;
+    if(ring == NULL)
+    {
+        QMutexLocker locker(&ringListMutex());
+        QByteArray name = QThread::currentThread()->objectName().toUtf8();
+        if(!freeRingList().isEmpty())
+        {
+            ring = freeRingList().takeLast();
+            if(name.isEmpty())
+            {
+                name = "thread "+QByteArray::number(ring->getThreadIndex());
+            }
+            ring->reuse(name,UsbMetrics::nowNs());
+        }
+        else
+        {
+            if(name.isEmpty())
+            {
+                name = "thread "+QByteArray::number(ringList().size()+1);
+            }
+            ring = new UsbTraceRing(ringList().size()+1,name);
+            ringList().append(ring);
+        }
+        ringOwner.ring = ring;
+    }
+    return ring;
+}
+/*
+ *@brief:   线程结束时归还缓冲区(仍然保持登记，事件在被复用之前可以导出)
+ *@date:    2026.10.18
+ *@param:   ring:缓冲区
+ */
+void UsbTrace::releaseRing(UsbTraceRing *ring)
+{
+    QMutexLocker locker(&ringListMutex());
+    freeRingList().append(ring);
+}
@@ -0,0 +1,100 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   USB传输跟踪组件
+ *
+ *用于分析丢帧等时序问题:记录传输提交、完成、取消、事件循环唤醒以及热插拔事件，时间戳精确到ns，
+ *可以导出为Chrome trace JSON格式，在chrome://tracing或Perfetto(ui.perfetto.dev)中查看时间线。
+ *每个线程拥有独立的环形缓冲区，记录时只有一次结构体写入和一次原子存储，不加锁、不申请内存，
+ *缓冲区写满后覆盖最旧的事件。线程结束时缓冲区归还空闲链表(其中的事件在被复用之前仍可导出)，
+ *之后新建的线程复用该缓冲区，频繁创建和结束的线程不会累积缓冲区。
+ *跟踪点通过USB_TRACE宏插入，只有在.pro中定义USBCOMM_TRACE时才会编译进来，默认不产生任何开销。
+ */
+#ifndef USBTRACE_H
+#define USBTRACE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <atomic>
+
+/* 跟踪事件(32字节) */
+struct UsbTraceEvent
+{
+    enum Type
+    {
+        Submit = 0,//提交异步传输
+        Complete,//异步传输完成
+        Cancel,//取消异步传输
+        SyncBegin,//同步传输开始
+        SyncEnd,//同步传输结束
+        EventLoopBegin,//事件循环开始处理事件
+        EventLoopEnd,//事件循环处理结束
+        Hotplug//热插拔
+    };
+
+    qint64 timestamp;//单调时钟，单位ns
+    quint64 id;//异步传输为libusb_transfer指针，同步传输为设备句柄，热插拔为(vid<<16)|pid
+    qint32 length;//传输长度(提交时为请求长度，完成时为实际长度)
+    qint16 status;//传输状态或返回值，热插拔为libusb_hotplug_event
+    quint8 type;//事件类型，详见enum Type{}
+    quint8 endpoint;//端点地址，热插拔为端口号
+};
+
+/* 单个线程的跟踪环形缓冲区，只能由所属线程写入，可以由任意线程读取 */
+class UsbTraceRing
+{
+public:
+    enum {Capacity = 16384};//缓冲区事件数量(2的幂)，每个线程占用512KB
+
+    UsbTraceRing(int threadIndex,const QByteArray &threadName);
+
+    void append(const UsbTraceEvent &event);//追加事件(只能在所属线程调用)
+    QVector<UsbTraceEvent> events(qint64 since) const;//读取时间戳不早于since的事件
+
+    int getThreadIndex() const{return threadIndex;}
+    //以下接口需在缓冲区登记表的锁内调用
+    QByteArray getThreadName() const{return threadName;}
+    qint64 getStartTime() const{return startTime;}
+    void reuse(const QByteArray &threadName,qint64 startTime);//由新线程复用，之前的事件不再导出
+
+private:
+    UsbTraceEvent ring[Capacity];
+    std::atomic<quint64> head;//已写入的事件总数
+    int threadIndex;//缓冲区序号(导出时作为tid，复用时不变)
+    QByteArray threadName;
+    qint64 startTime;//当前所属线程开始使用的时间
+};
+
+/* 跟踪接口 */
+class UsbTrace
+{
+public:
+    static void setEnabled(bool enabled);//运行时开关(默认开启)，只有定义了USBCOMM_TRACE时才有意义
+    static bool isEnabled();
+    static void record(quint8 type,quint64 id,quint8 endpoint,qint32 length,qint16 status);//记录事件
+    static void clear();//清空已记录的事件(只是移动起始时间，不会修改各线程的缓冲区)
+
+    static QByteArray toChromeTraceJson();//导出为Chrome trace JSON
+    static bool exportChromeTrace(const QString &fileName);//导出到文件
+
+private:
+    friend struct UsbTraceRingOwner;
+    static UsbTraceRing *threadRing();//获取当前线程的缓冲区，首次调用时复用空闲的或创建
+    static void releaseRing(UsbTraceRing *ring);//线程结束时归还缓冲区
+};
+
+#ifdef USBCOMM_TRACE
+#define USB_TRACE(type,id,endpoint,length,status) \
+    UsbTrace::record(UsbTraceEvent::type,(quint64)(quintptr)(id),(quint8)(endpoint),(qint32)(length),(qint16)(status))
+#else
+#define USB_TRACE(type,id,endpoint,length,status) ((void)0)
+#endif
+
+#endif // USBTRACE_H
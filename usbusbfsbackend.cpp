@@ -0,0 +1,860 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   直接访问Linux usbfs的传输后端
+ */
+#include "usbusbfsbackend.h"
+#include "usbmetrics.h"
+#include <QDebug>
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/usbdevice_fs.h>
+#endif
+
+#define USBFS_MAX_EVENTS 16 //每次epoll_wait最多返回的事件数
+#define USBFS_MAX_BULK_URB_LENGTH 16384 //不支持分散/聚集的内核中单个批量URB的最大长度
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   backend:所属的后端
+ *@param:   parent:父对象
+ */
+UsbUsbfsEventThread::UsbUsbfsEventThread(UsbUsbfsBackend *backend, QObject *parent)
+    :QThread(parent)
+{
+    this->backend = backend;
+}
+/*
+ *@brief:   子线程运行
+ *@date:    2026.10.18
+ */
+void UsbUsbfsEventThread::run()
+{
+    backend->eventLoop();
+}
+
+#ifdef Q_OS_LINUX
+
+/* 挂起的URB，结束后放回空闲链表复用 */
+struct UsbUsbfsBackend::UsbfsUrb
+{
+    UsbfsDevice *device;
+    libusb_transfer *transfer;
+    UsbfsUrb *prev;//设备挂起链表(空闲时next为空闲链表)
+    UsbfsUrb *next;
+    qint64 deadline;//截止时间(ns)，0表示没有超时
+    bool timedOut;//因超时被取消
+    usbdevfs_urb urb;//提交给内核的URB(usercontext为该对象本身，不使用等时包，放在最后)
+};
+
+/*
+ *@brief:   构造函数，创建epoll实例并启动事件线程
+ *@date:    2026.10.18
+ */
+UsbUsbfsBackend::UsbUsbfsBackend()
+{
+    stopped = false;
+    nextDeviceId = 1;
+    freeUrbList = NULL;
+    reapBatchCount = 0;
+    reapUrbCount = 0;
+    eventThread = NULL;
+    wakeFd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd < 0 || wakeFd < 0)
+    {
+        qDebug()<<"UsbUsbfsBackend: epoll/eventfd error:"<<strerror(errno);
+        if(epollFd >= 0)
+        {
+            close(epollFd);
+            epollFd = -1;
+        }
+        return;
+    }
+    epoll_event event;
+    memset(&event,0,sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = 0;//0表示唤醒事件，设备标识从1开始
+    epoll_ctl(epollFd,EPOLL_CTL_ADD,wakeFd,&event);
+    eventThread = new UsbUsbfsEventThread(this);
+    eventThread->setObjectName("UsbUsbfsEventThread");
+    eventThread->start();
+}
+/*
+ *@brief:   析构函数，停止事件线程
+ *@date:    2026.10.18
+ */
+UsbUsbfsBackend::~UsbUsbfsBackend()
+{
+    if(eventThread != NULL)
+    {
+        stopped = true;
+        wakeEventThread();
+        eventThread->wait();
+        delete eventThread;
+    }
+    if(epollFd >= 0)
+    {
+        close(epollFd);
+    }
+    if(wakeFd >= 0)
+    {
+        close(wakeFd);
+    }
+    while(freeUrbList != NULL)
+    {
+        UsbfsUrb *urb = freeUrbList;
+        freeUrbList = urb->next;
+        delete urb;
+    }
+}
+/*
+ *@brief:   枚举当前接入的设备(sysfs设备数据库)
+ *@date:    2026.10.18
+ *@return:  QList<UsbDeviceInfo>:设备信息列表，info.device为NULL(按总线号和地址打开)
+ */
+QList<UsbDeviceInfo> UsbUsbfsBackend::getDeviceList()
+{
+    QList<UsbDeviceInfo> infoList;
+    QList<UsbDeviceRecord> recordList = deviceDatabase.getDeviceList();
+    for(int i=0;i<recordList.size();i++)
+    {
+        infoList.append(recordList.at(i).info);
+    }
+    return infoList;
+}
+/*
+ *@brief:   打印设备信息
+ *@date:    2026.10.18
+ *@param:   info:设备信息
+ */
+void UsbUsbfsBackend::printDeviceInfo(const UsbDeviceInfo &info)
+{
+    QStringList portPathList;
+    for(int i=0;i<info.portPath.size();i++)
+    {
+        portPathList.append(QString::number(info.portPath.at(i)));
+    }
+    qDebug()<<"***************************************";
+    qDebug()<<"usbfs device";
+    qDebug()<<"Bus: "<<(int)info.busNumber;
+    qDebug()<<"Device Address: "<<(int)info.deviceAddress;
+    qDebug()<<"Device Port Path: "<<portPathList.join(".");
+    qDebug()<<"Device Speed: "<<info.speed;
+    qDebug()<<"Device Class: "<<QString("0x%1").arg((int)info.deviceClass,2,16,QChar('0'));
+    qDebug()<<"VendorID: "<<QString("0x%1").arg((int)info.vendorId,4,16,QChar('0'));
+    qDebug()<<"ProductID: "<<QString("0x%1").arg((int)info.productId,4,16,QChar('0'));
+    qDebug()<<"***************************************";
+}
+/*
+ *@brief:   打开设备(/dev/bus/usb/BBB/DDD)，并加入事件线程的epoll
+ *@date:    2026.10.18
+ *@param:   info:设备信息(按总线号和地址打开)
+ *@param:   deviceHandle:返回的设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::openDevice(const UsbDeviceInfo &info, libusb_device_handle **deviceHandle)
+{
+    if(!isAvailable())
+    {
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    QByteArray path = QString("/dev/bus/usb/%1/%2").arg((int)info.busNumber,3,10,QChar('0'))
+            .arg((int)info.deviceAddress,3,10,QChar('0')).toLocal8Bit();
+    int fd = open(path.constData(),O_RDWR|O_CLOEXEC);
+    if(fd < 0)
+    {
+        int err = errno;
+        qDebug()<<"UsbUsbfsBackend: open"<<path<<"error:"<<strerror(err);
+        return (err == EACCES || err == EPERM)?LIBUSB_ERROR_ACCESS:errorFromErrno(err);
+    }
+    UsbfsDevice *device = new UsbfsDevice;
+    device->fd = fd;
+    device->info = info;
+    device->disconnected = false;
+    device->pendingList = NULL;
+    device->caps = 0;
+    if(ioctl(fd,USBDEVFS_GET_CAPABILITIES,&device->caps) != 0)
+    {
+        device->caps = 0;//早期内核不支持该请求，按没有任何能力处理
+    }
+    //读取设备文件得到内核缓存的设备描述符和所有配置描述符
+    char buffer[4096];
+    int size = 0;
+    while((size = read(fd,buffer,sizeof(buffer))) > 0)
+    {
+        device->descriptors.append(buffer,size);
+    }
+
+    QMutexLocker locker(&mutex);
+    device->id = nextDeviceId++;
+    epoll_event event;
+    memset(&event,0,sizeof(event));
+    event.events = EPOLLOUT;//有已完成的URB时可写，拔出时为EPOLLERR|EPOLLHUP
+    event.data.u64 = device->id;
+    if(epoll_ctl(epollFd,EPOLL_CTL_ADD,fd,&event) != 0)
+    {
+        int err = errno;
+        qDebug()<<"UsbUsbfsBackend: epoll_ctl error:"<<strerror(err);
+        close(fd);
+        delete device;
+        return errorFromErrno(err);
+    }
+    deviceHash.insert(device->id,device);
+    *deviceHandle = reinterpret_cast<libusb_device_handle *>(device);
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   关闭设备
+ * 挂起的传输一般已由UsbComm取消并结束，取消超时时仍可能有URB挂起:关闭文件描述符后内核丢弃这些URB，
+ * 不会再被取出，这里将其移出截止时间表并放回空闲链表(不再调用回调)，避免之后访问已释放的设备。
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ */
+void UsbUsbfsBackend::closeDevice(libusb_device_handle *deviceHandle)
+{
+    UsbfsDevice *device = usbfsDevice(deviceHandle);
+    QMutexLocker locker(&mutex);
+    deviceHash.remove(device->id);
+    epoll_ctl(epollFd,EPOLL_CTL_DEL,device->fd,NULL);
+    close(device->fd);//内核会丢弃仍未完成的URB
+    while(device->pendingList != NULL)
+    {
+        UsbfsUrb *urb = device->pendingList;
+        device->pendingList = urb->next;
+        if(urb->deadline != 0)
+        {
+            deadlineMap.remove(urb->deadline,urb);
+        }
+        urb->next = freeUrbList;
+        freeUrbList = urb;
+    }
+    delete device;
+}
+/*
+ *@brief:   获取打开设备的信息
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  UsbDeviceInfo:设备信息
+ */
+UsbDeviceInfo UsbUsbfsBackend::getDeviceInfo(libusb_device_handle *deviceHandle)
+{
+    return usbfsDevice(deviceHandle)->info;
+}
+/*
+ *@brief:   解析当前配置的描述符树(GET_CONFIGURATION请求获取当前配置值，描述符使用打开时读取的缓存)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   config:返回的描述符树
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::getConfigInfo(libusb_device_handle *deviceHandle, UsbConfigInfo *config)
+{
+    UsbfsDevice *device = usbfsDevice(deviceHandle);
+    quint8 configValue = 0;
+    usbdevfs_ctrltransfer control;
+    memset(&control,0,sizeof(control));
+    control.bRequestType = LIBUSB_ENDPOINT_IN|LIBUSB_REQUEST_TYPE_STANDARD|LIBUSB_RECIPIENT_DEVICE;
+    control.bRequest = LIBUSB_REQUEST_GET_CONFIGURATION;
+    control.wLength = 1;
+    control.timeout = 1000;
+    control.data = &configValue;
+    if(ioctl(device->fd,USBDEVFS_CONTROL,&control) != 1)
+    {
+        return errorFromErrno(errno);
+    }
+    const QByteArray &descriptors = device->descriptors;
+    const quint8 *bytes = reinterpret_cast<const quint8 *>(descriptors.constData());
+    for(int offset=LIBUSB_DT_DEVICE_SIZE;offset+LIBUSB_DT_CONFIG_SIZE<=descriptors.size();)
+    {
+        int totalLength = bytes[offset+2]|(bytes[offset+3]<<8);
+        if(bytes[offset+1] != LIBUSB_DT_CONFIG || totalLength < LIBUSB_DT_CONFIG_SIZE)
+        {
+            break;
+        }
+        if(bytes[offset+5] == configValue)
+        {
+            *config = UsbConfigInfo::fromRawDescriptor(descriptors.mid(offset,totalLength));
+            return LIBUSB_SUCCESS;
+        }
+        offset += totalLength;
+    }
+    return LIBUSB_ERROR_NOT_FOUND;
+}
+/*
+ *@brief:   激活设备配置
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   bConfigurationValue:配置号
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::setConfiguration(libusb_device_handle *deviceHandle, int bConfigurationValue)
+{
+    unsigned int value = bConfigurationValue;
+    if(ioctl(usbfsDevice(deviceHandle)->fd,USBDEVFS_SETCONFIGURATION,&value) != 0)
+    {
+        return errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   声明接口，接口绑定了其他内核驱动时先卸载
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::claimInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    int fd = usbfsDevice(deviceHandle)->fd;
+    usbdevfs_getdriver getDriver;
+    memset(&getDriver,0,sizeof(getDriver));
+    getDriver.interface = interfaceNumber;
+    if(ioctl(fd,USBDEVFS_GETDRIVER,&getDriver) == 0 && strcmp(getDriver.driver,"usbfs") != 0)
+    {
+        qDebug()<<"Kernel driver active for interface"<<interfaceNumber<<getDriver.driver;
+        usbdevfs_ioctl command;
+        memset(&command,0,sizeof(command));
+        command.ifno = interfaceNumber;
+        command.ioctl_code = USBDEVFS_DISCONNECT;
+        if(ioctl(fd,USBDEVFS_IOCTL,&command) != 0)
+        {
+            int err = errorFromErrno(errno);
+            qDebug()<<"USBDEVFS_DISCONNECT error:"<<libusb_error_name(err);
+            return err;
+        }
+    }
+    unsigned int value = interfaceNumber;
+    if(ioctl(fd,USBDEVFS_CLAIMINTERFACE,&value) != 0)
+    {
+        return (errno == EBUSY)?LIBUSB_ERROR_BUSY:errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   释放接口
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::releaseInterface(libusb_device_handle *deviceHandle, int interfaceNumber)
+{
+    unsigned int value = interfaceNumber;
+    if(ioctl(usbfsDevice(deviceHandle)->fd,USBDEVFS_RELEASEINTERFACE,&value) != 0)
+    {
+        return errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   激活接口备用设置
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   interfaceNumber:接口号
+ *@param:   bAlternateSetting:备用设置
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::setInterfaceAltSetting(libusb_device_handle *deviceHandle, int interfaceNumber,
+                                            int bAlternateSetting)
+{
+    usbdevfs_setinterface setInterface;
+    setInterface.interface = interfaceNumber;
+    setInterface.altsetting = bAlternateSetting;
+    if(ioctl(usbfsDevice(deviceHandle)->fd,USBDEVFS_SETINTERFACE,&setInterface) != 0)
+    {
+        return errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   重置设备
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::resetDevice(libusb_device_handle *deviceHandle)
+{
+    if(ioctl(usbfsDevice(deviceHandle)->fd,USBDEVFS_RESET,NULL) != 0)
+    {
+        return errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   清除端点的halt/stall状态
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   endpoint:端点
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::clearHalt(libusb_device_handle *deviceHandle, quint8 endpoint)
+{
+    unsigned int value = endpoint;
+    if(ioctl(usbfsDevice(deviceHandle)->fd,USBDEVFS_CLEAR_HALT,&value) != 0)
+    {
+        return errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   同步传输(USBDEVFS_BULK/USBDEVFS_CONTROL，在调用线程中阻塞，不经过事件线程)
+ *@date:    2026.10.18
+ *@param:   deviceHandle:设备句柄
+ *@param:   transferType:传输类型，LIBUSB_TRANSFER_TYPE_BULK/INTERRUPT/CONTROL
+ *@param:   endpoint:端点，控制传输忽略
+ *@param:   data:数据buffer(控制传输包含8字节的setup包)
+ *@param:   length:buffer长度
+ *@param:   actualLength:真实传输的字节数(控制传输不包含setup包)
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::syncTransfer(libusb_device_handle *deviceHandle, quint8 transferType, quint8 endpoint,
+                                  quint8 *data, int length, int *actualLength, quint32 timeout)
+{
+    int fd = usbfsDevice(deviceHandle)->fd;
+    int ret = -1;
+    switch(transferType)
+    {
+    case LIBUSB_TRANSFER_TYPE_BULK:
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT://usbfs按端点类型处理，中断端点同样使用USBDEVFS_BULK
+    {
+        usbdevfs_bulktransfer bulk;
+        memset(&bulk,0,sizeof(bulk));
+        bulk.ep = endpoint;
+        bulk.len = length;
+        bulk.timeout = timeout;
+        bulk.data = data;
+        ret = ioctl(fd,USBDEVFS_BULK,&bulk);
+        break;
+    }
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+    {
+        if(length < (int)LIBUSB_CONTROL_SETUP_SIZE)
+        {
+            return LIBUSB_ERROR_INVALID_PARAM;
+        }
+        libusb_control_setup *setup = reinterpret_cast<libusb_control_setup *>(data);
+        usbdevfs_ctrltransfer control;
+        memset(&control,0,sizeof(control));
+        control.bRequestType = setup->bmRequestType;
+        control.bRequest = setup->bRequest;
+        control.wValue = libusb_le16_to_cpu(setup->wValue);
+        control.wIndex = libusb_le16_to_cpu(setup->wIndex);
+        control.wLength = qMin((int)libusb_le16_to_cpu(setup->wLength),length-(int)LIBUSB_CONTROL_SETUP_SIZE);
+        control.timeout = timeout;
+        control.data = data+LIBUSB_CONTROL_SETUP_SIZE;
+        ret = ioctl(fd,USBDEVFS_CONTROL,&control);
+        break;
+    }
+    default:
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    if(ret < 0)
+    {
+        *actualLength = 0;
+        return errorFromErrno(errno);
+    }
+    *actualLength = ret;
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   提交异步传输(USBDEVFS_SUBMITURB)，完成后在事件线程中调用transfer->callback
+ *@date:    2026.10.18
+ *@param:   transfer:传输(批量、中断或控制)
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::submitTransfer(libusb_transfer *transfer)
+{
+    unsigned char urbType;
+    switch(transfer->type)
+    {
+    case LIBUSB_TRANSFER_TYPE_BULK:
+        urbType = USBDEVFS_URB_TYPE_BULK;
+        break;
+    case LIBUSB_TRANSFER_TYPE_INTERRUPT:
+        urbType = USBDEVFS_URB_TYPE_INTERRUPT;
+        break;
+    case LIBUSB_TRANSFER_TYPE_CONTROL:
+        urbType = USBDEVFS_URB_TYPE_CONTROL;
+        break;
+    default:
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    UsbfsDevice *device = usbfsDevice(transfer->dev_handle);
+    //不支持分散/聚集(也没有去掉包长限制)的内核中批量URB不能超过16KB，该后端不拆分传输
+    if(urbType == USBDEVFS_URB_TYPE_BULK && transfer->length > USBFS_MAX_BULK_URB_LENGTH &&
+            !(device->caps & (USBDEVFS_CAP_BULK_SCATTER_GATHER|USBDEVFS_CAP_NO_PACKET_SIZE_LIM)))
+    {
+        qDebug()<<"UsbUsbfsBackend submitTransfer error: bulk transfer too large for this kernel:"<<transfer->length;
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+    qint64 deadline = (transfer->timeout > 0)?UsbMetrics::nowNs()+(qint64)transfer->timeout*1000000:0;
+
+    QMutexLocker locker(&mutex);
+    if(device->disconnected)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    //优先复用空闲链表中的URB，稳定运行后提交不再申请内存
+    UsbfsUrb *urb = freeUrbList;
+    if(urb != NULL)
+    {
+        freeUrbList = urb->next;
+    }
+    else
+    {
+        urb = new UsbfsUrb;
+    }
+    memset(&urb->urb,0,sizeof(urb->urb));
+    urb->urb.type = urbType;
+    urb->urb.endpoint = transfer->endpoint;
+    urb->urb.buffer = transfer->buffer;
+    urb->urb.buffer_length = transfer->length;
+    urb->urb.usercontext = urb;
+    urb->device = device;
+    urb->transfer = transfer;
+    urb->deadline = deadline;
+    urb->timedOut = false;
+    if(ioctl(device->fd,USBDEVFS_SUBMITURB,&urb->urb) != 0)
+    {
+        int err = errno;
+        urb->next = freeUrbList;
+        freeUrbList = urb;
+        return errorFromErrno(err);
+    }
+    urb->prev = NULL;
+    urb->next = device->pendingList;
+    if(device->pendingList != NULL)
+    {
+        device->pendingList->prev = urb;
+    }
+    device->pendingList = urb;
+    if(urb->deadline != 0)
+    {
+        //新的截止时间最早时唤醒事件线程，重新计算epoll_wait的超时
+        bool earliest = deadlineMap.isEmpty() || urb->deadline < deadlineMap.firstKey();
+        deadlineMap.insert(urb->deadline,urb);
+        if(earliest)
+        {
+            wakeEventThread();
+        }
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   取消异步传输(USBDEVFS_DISCARDURB)，传输以LIBUSB_TRANSFER_CANCELLED完成
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  int:libusb_error，传输已完成时返回LIBUSB_ERROR_NOT_FOUND
+ */
+int UsbUsbfsBackend::cancelTransfer(libusb_transfer *transfer)
+{
+    QMutexLocker locker(&mutex);
+    UsbfsUrb *urb = findUrb(transfer);
+    if(urb == NULL)
+    {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+    if(ioctl(urb->device->fd,USBDEVFS_DISCARDURB,&urb->urb) != 0)
+    {
+        //已经完成但还未被取出(EINVAL)，之后会正常结束
+        return (errno == EINVAL)?LIBUSB_ERROR_NOT_FOUND:errorFromErrno(errno);
+    }
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   注册热插拔回调(不支持，UsbMonitor使用轮询方式)
+ *@date:    2026.10.18
+ *@return:  int:LIBUSB_ERROR_NOT_SUPPORTED
+ */
+int UsbUsbfsBackend::registerHotplug(int deviceClass, int vendorId, int productId, UsbHotplugCallback callback,
+                                     libusb_hotplug_callback_handle *hotplugHandle)
+{
+    Q_UNUSED(deviceClass)
+    Q_UNUSED(vendorId)
+    Q_UNUSED(productId)
+    Q_UNUSED(callback)
+    Q_UNUSED(hotplugHandle)
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+}
+/*
+ *@brief:   注销热插拔回调(不支持)
+ *@date:    2026.10.18
+ */
+void UsbUsbfsBackend::deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle)
+{
+    Q_UNUSED(hotplugHandle)
+}
+/*
+ *@brief:   将errno映射为libusb_error
+ *@date:    2026.10.18
+ *@param:   err:errno
+ *@return:  int:libusb_error
+ */
+int UsbUsbfsBackend::errorFromErrno(int err)
+{
+    switch(err)
+    {
+    case ETIMEDOUT:
+        return LIBUSB_ERROR_TIMEOUT;
+    case EPIPE:
+        return LIBUSB_ERROR_PIPE;
+    case EOVERFLOW:
+        return LIBUSB_ERROR_OVERFLOW;
+    case ENODEV:
+    case ESHUTDOWN:
+        return LIBUSB_ERROR_NO_DEVICE;
+    case ENOENT:
+        return LIBUSB_ERROR_NOT_FOUND;
+    case EBUSY:
+        return LIBUSB_ERROR_BUSY;
+    case ENOMEM:
+        return LIBUSB_ERROR_NO_MEM;
+    case EINVAL:
+        return LIBUSB_ERROR_INVALID_PARAM;
+    case EACCES:
+    case EPERM:
+        return LIBUSB_ERROR_ACCESS;
+    default:
+        return LIBUSB_ERROR_IO;
+    }
+}
+/*
+ *@brief:   将URB状态映射为libusb_transfer_status
+ *@date:    2026.10.18
+ *@param:   status:URB状态(0或负的errno)
+ *@param:   timedOut:是否因超时被取消
+ *@return:  int:libusb_transfer_status
+ */
+int UsbUsbfsBackend::statusFromUrb(int status, bool timedOut)
+{
+    switch(status)
+    {
+    case 0:
+        return LIBUSB_TRANSFER_COMPLETED;
+    case -ENOENT:
+    case -ECONNRESET:
+        return timedOut?LIBUSB_TRANSFER_TIMED_OUT:LIBUSB_TRANSFER_CANCELLED;
+    case -EPIPE:
+        return LIBUSB_TRANSFER_STALL;
+    case -EOVERFLOW:
+        return LIBUSB_TRANSFER_OVERFLOW;
+    case -ENODEV:
+    case -ESHUTDOWN:
+        return LIBUSB_TRANSFER_NO_DEVICE;
+    default:
+        return LIBUSB_TRANSFER_ERROR;
+    }
+}
+/*
+ *@brief:   事件线程:epoll等待所有设备，批量取出完成的URB，处理超时
+ *@date:    2026.10.18
+ */
+void UsbUsbfsBackend::eventLoop()
+{
+    epoll_event events[USBFS_MAX_EVENTS];
+    while(!stopped)
+    {
+        int count = epoll_wait(epollFd,events,USBFS_MAX_EVENTS,nextTimeoutMs());
+        for(int i=0;i<count;i++)
+        {
+            if(events[i].data.u64 == 0)//唤醒事件，清零计数
+            {
+                eventfd_t value;
+                eventfd_read(wakeFd,&value);
+                continue;
+            }
+            reapDevice(events[i].data.u64);
+        }
+        handleTimeouts();
+    }
+}
+/*
+ *@brief:   批量取出设备已完成的URB(直到EAGAIN)，再在锁外依次调用回调
+ * 设备拔出时内核先返回剩余的URB，之后返回ENODEV，此时将设备移出epoll，仍挂起的传输以LIBUSB_TRANSFER_NO_DEVICE结束。
+ *@date:    2026.10.18
+ *@param:   id:设备标识
+ */
+void UsbUsbfsBackend::reapDevice(quint64 id)
+{
+    QList<libusb_transfer *> completedList;
+    mutex.lock();
+    UsbfsDevice *device = deviceHash.value(id);
+    if(device == NULL)//已关闭
+    {
+        mutex.unlock();
+        return;
+    }
+    while(true)
+    {
+        usbdevfs_urb *kernelUrb = NULL;
+        if(ioctl(device->fd,USBDEVFS_REAPURBNDELAY,&kernelUrb) == 0)
+        {
+            //取出的URB都是该设备挂起链表中的对象，直接由usercontext得到
+            UsbfsUrb *urb = static_cast<UsbfsUrb *>(kernelUrb->usercontext);
+            completedList.append(urb->transfer);
+            finishUrb(urb,statusFromUrb(kernelUrb->status,urb->timedOut));
+            continue;
+        }
+        if(errno == ENODEV)
+        {
+            device->disconnected = true;
+            epoll_ctl(epollFd,EPOLL_CTL_DEL,device->fd,NULL);
+            while(device->pendingList != NULL)
+            {
+                completedList.append(device->pendingList->transfer);
+                finishUrb(device->pendingList,LIBUSB_TRANSFER_NO_DEVICE);
+            }
+        }
+        break;//EAGAIN:没有更多已完成的URB
+    }
+    mutex.unlock();
+    if(completedList.isEmpty())
+    {
+        return;
+    }
+    reapBatchCount.fetch_add(1,std::memory_order_relaxed);
+    reapUrbCount.fetch_add(completedList.size(),std::memory_order_relaxed);
+    for(int i=0;i<completedList.size();i++)
+    {
+        completedList.at(i)->callback(completedList.at(i));
+    }
+}
+/*
+ *@brief:   取消超过截止时间的URB，之后以LIBUSB_TRANSFER_TIMED_OUT完成
+ *@date:    2026.10.18
+ */
+void UsbUsbfsBackend::handleTimeouts()
+{
+    QMutexLocker locker(&mutex);
+    qint64 now = UsbMetrics::nowNs();
+    while(!deadlineMap.isEmpty() && deadlineMap.firstKey() <= now)
+    {
+        UsbfsUrb *urb = deadlineMap.take(deadlineMap.firstKey());
+        urb->timedOut = true;
+        urb->deadline = 0;
+        ioctl(urb->device->fd,USBDEVFS_DISCARDURB,&urb->urb);
+    }
+}
+/*
+ *@brief:   距离最近的截止时间
+ *@date:    2026.10.18
+ *@return:  int:毫秒(向上取整)，-1表示没有截止时间(无限等待)
+ */
+int UsbUsbfsBackend::nextTimeoutMs()
+{
+    QMutexLocker locker(&mutex);
+    if(deadlineMap.isEmpty())
+    {
+        return -1;
+    }
+    qint64 remain = deadlineMap.firstKey()-UsbMetrics::nowNs();
+    return (remain <= 0)?0:(int)((remain+999999)/1000000);
+}
+/*
+ *@brief:   查找挂起传输对应的URB(调用前需加锁)
+ * 只遍历传输所属设备的挂起链表，长度为该设备同时挂起的传输数。
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  UsbfsUrb*:URB，传输不在挂起状态时返回NULL
+ */
+UsbUsbfsBackend::UsbfsUrb *UsbUsbfsBackend::findUrb(libusb_transfer *transfer)
+{
+    for(UsbfsUrb *urb = usbfsDevice(transfer->dev_handle)->pendingList;urb != NULL;urb = urb->next)
+    {
+        if(urb->transfer == transfer)
+        {
+            return urb;
+        }
+    }
+    return NULL;
+}
+/*
+ *@brief:   结束URB，填充传输的状态和实际长度，移出设备挂起链表并放回空闲链表(调用前需加锁)
+ *@date:    2026.10.18
+ *@param:   urb:URB
+ *@param:   status:libusb_transfer_status
+ */
+void UsbUsbfsBackend::finishUrb(UsbfsUrb *urb, int status)
+{
+    libusb_transfer *transfer = urb->transfer;
+    transfer->status = static_cast<libusb_transfer_status>(status);
+    transfer->actual_length = urb->urb.actual_length;
+    if(urb->deadline != 0)
+    {
+        deadlineMap.remove(urb->deadline,urb);
+    }
+    if(urb->prev != NULL)
+    {
+        urb->prev->next = urb->next;
+    }
+    else
+    {
+        urb->device->pendingList = urb->next;
+    }
+    if(urb->next != NULL)
+    {
+        urb->next->prev = urb->prev;
+    }
+    urb->next = freeUrbList;
+    freeUrbList = urb;
+}
+/*
+ *@brief:   唤醒事件线程
+ *@date:    2026.10.18
+ */
+void UsbUsbfsBackend::wakeEventThread()
+{
+    eventfd_write(wakeFd,1);
+}
+
+#else //非Linux平台不支持usbfs
+
+UsbUsbfsBackend::UsbUsbfsBackend()
+{
+    epollFd = -1;
+    wakeFd = -1;
+    eventThread = NULL;
+    stopped = true;
+    nextDeviceId = 1;
+    freeUrbList = NULL;
+    reapBatchCount = 0;
+    reapUrbCount = 0;
+}
+UsbUsbfsBackend::~UsbUsbfsBackend(){}
+QList<UsbDeviceInfo> UsbUsbfsBackend::getDeviceList(){return QList<UsbDeviceInfo>();}
+void UsbUsbfsBackend::printDeviceInfo(const UsbDeviceInfo &info){Q_UNUSED(info)}
+int UsbUsbfsBackend::openDevice(const UsbDeviceInfo &,libusb_device_handle **){return LIBUSB_ERROR_NOT_SUPPORTED;}
+void UsbUsbfsBackend::closeDevice(libusb_device_handle *){}
+UsbDeviceInfo UsbUsbfsBackend::getDeviceInfo(libusb_device_handle *){return UsbDeviceInfo();}
+int UsbUsbfsBackend::getConfigInfo(libusb_device_handle *,UsbConfigInfo *){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::setConfiguration(libusb_device_handle *,int){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::claimInterface(libusb_device_handle *,int){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::releaseInterface(libusb_device_handle *,int){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::setInterfaceAltSetting(libusb_device_handle *,int,int){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::resetDevice(libusb_device_handle *){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::clearHalt(libusb_device_handle *,quint8){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::syncTransfer(libusb_device_handle *,quint8,quint8,quint8 *,int,int *,quint32)
+{return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::submitTransfer(libusb_transfer *){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::cancelTransfer(libusb_transfer *){return LIBUSB_ERROR_NOT_SUPPORTED;}
+int UsbUsbfsBackend::registerHotplug(int,int,int,UsbHotplugCallback,libusb_hotplug_callback_handle *)
+{return LIBUSB_ERROR_NOT_SUPPORTED;}
+void UsbUsbfsBackend::deregisterHotplug(libusb_hotplug_callback_handle){}
+void UsbUsbfsBackend::eventLoop(){}
+
+#endif
@@ -0,0 +1,131 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   直接访问Linux usbfs的传输后端
+ *
+ *libusb每个传输都要经过会话级的flying_transfers锁、超时定时器维护和事件锁协议，最高速率的设备上这些开销
+ *在性能分析中明显可见。该后端绕过libusb，通过ioctl直接访问/dev/bus/usb/BBB/DDD:
+ *1.提交:每个传输直接USBDEVFS_SUBMITURB，URB从后端的空闲链表中复用(不逐次申请内存)，只加一次锁；
+ *2.完成:一个事件线程用epoll等待所有设备的文件描述符(有完成的URB时可写)，每次唤醒用USBDEVFS_REAPURBNDELAY
+ *  批量取出该设备所有已完成的URB(usercontext直接指回URB对象，不查表)，再在锁外依次调用传输回调；
+ *3.超时:usbfs的URB没有超时，事件线程按截止时间排序，epoll_wait的超时取最近的截止时间，到期后DISCARDURB。
+ *枚举使用sysfs设备数据库，不支持libusb热插拔(hasHotplug()返回false，UsbMonitor自动使用轮询方式)。
+ *UsbComm使用的libusb_transfer仍由libusb_alloc_transfer申请和填充，该后端只使用其中的字段；
+ *设备句柄即后端内部设备对象的地址，不能传给libusb函数。仅支持批量、中断和控制传输，传输不拆分为多个URB，
+ *内核不支持USBDEVFS_CAP_BULK_SCATTER_GATHER(3.6之前)时超过16KB的异步批量传输返回LIBUSB_ERROR_INVALID_PARAM。
+ *非Linux平台isAvailable()返回false，其余接口返回LIBUSB_ERROR_NOT_SUPPORTED。
+ */
+#ifndef USBUSBFSBACKEND_H
+#define USBUSBFSBACKEND_H
+
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+#include <QMultiMap>
+#include <atomic>
+#include "usbbackend.h"
+#include "usbdevicedatabase.h"
+
+class UsbUsbfsBackend;
+
+/* usbfs事件线程 */
+class UsbUsbfsEventThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit UsbUsbfsEventThread(UsbUsbfsBackend *backend,QObject *parent = 0);
+
+protected:
+    virtual void run();
+
+private:
+    UsbUsbfsBackend *backend;
+};
+
+class UsbUsbfsBackend : public UsbBackend
+{
+public:
+    UsbUsbfsBackend();
+    virtual ~UsbUsbfsBackend();//设备需已全部关闭
+
+    bool isAvailable() const{return epollFd >= 0;}//usbfs和epoll是否可用
+    //完成处理的批量统计:唤醒次数(每次唤醒批量取出一个设备的所有完成URB)和取出的URB数
+    quint64 getReapBatchCount() const{return reapBatchCount.load(std::memory_order_relaxed);}
+    quint64 getReapUrbCount() const{return reapUrbCount.load(std::memory_order_relaxed);}
+
+    virtual QList<UsbDeviceInfo> getDeviceList();
+    virtual void printDeviceInfo(const UsbDeviceInfo &info);
+    virtual int openDevice(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle);
+    virtual void closeDevice(libusb_device_handle *deviceHandle);
+    virtual UsbDeviceInfo getDeviceInfo(libusb_device_handle *deviceHandle);
+    virtual int getConfigInfo(libusb_device_handle *deviceHandle,UsbConfigInfo *config);
+
+    virtual int setConfiguration(libusb_device_handle *deviceHandle,int bConfigurationValue);
+    virtual int claimInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    virtual int releaseInterface(libusb_device_handle *deviceHandle,int interfaceNumber);
+    virtual int setInterfaceAltSetting(libusb_device_handle *deviceHandle,int interfaceNumber,int bAlternateSetting);
+    virtual int resetDevice(libusb_device_handle *deviceHandle);
+    virtual int clearHalt(libusb_device_handle *deviceHandle,quint8 endpoint);
+
+    virtual int syncTransfer(libusb_device_handle *deviceHandle,quint8 transferType,quint8 endpoint,
+                             quint8 *data,int length,int *actualLength,quint32 timeout);
+    virtual int submitTransfer(libusb_transfer *transfer);
+    virtual int cancelTransfer(libusb_transfer *transfer);
+
+    virtual bool hasHotplug(){return false;}
+    virtual int registerHotplug(int deviceClass,int vendorId,int productId,UsbHotplugCallback callback,
+                                libusb_hotplug_callback_handle *hotplugHandle);
+    virtual void deregisterHotplug(libusb_hotplug_callback_handle hotplugHandle);
+
+    virtual UsbDeviceDatabase *getDeviceDatabase(){return &deviceDatabase;}
+    virtual int openDeviceByAddress(const UsbDeviceInfo &info,libusb_device_handle **deviceHandle)
+    {return openDevice(info,deviceHandle);}//设备文件本来就按总线号和地址打开
+
+private:
+    friend class UsbUsbfsEventThread;
+    struct UsbfsUrb;
+    /* 打开的设备，设备句柄即该对象的地址 */
+    struct UsbfsDevice
+    {
+        quint64 id;//epoll中的标识(设备关闭后不会被复用)
+        int fd;
+        UsbDeviceInfo info;
+        QByteArray descriptors;//设备描述符和所有配置描述符
+        bool disconnected;//设备已拔出
+        quint32 caps;//usbfs能力(USBDEVFS_GET_CAPABILITIES)
+        UsbfsUrb *pendingList;//挂起的URB(双向链表)
+    };
+
+    static UsbfsDevice *usbfsDevice(libusb_device_handle *deviceHandle)
+    {return reinterpret_cast<UsbfsDevice *>(deviceHandle);}
+    static int errorFromErrno(int err);//将errno映射为libusb_error
+    static int statusFromUrb(int status,bool timedOut);//将URB状态映射为libusb_transfer_status
+    void eventLoop();//事件线程:epoll等待、批量取出完成的URB、处理超时
+    void reapDevice(quint64 id);//批量取出设备已完成的URB并调用回调
+    void handleTimeouts();//取消超过截止时间的URB
+    int nextTimeoutMs();//距离最近的截止时间(ms)，-1表示没有
+    UsbfsUrb *findUrb(libusb_transfer *transfer);//查找挂起传输对应的URB(调用前需加锁)
+    void finishUrb(UsbfsUrb *urb,int status);//结束URB，填充传输结果并放回空闲链表(调用前需加锁)
+    void wakeEventThread();
+
+    int epollFd;
+    int wakeFd;//eventfd，用于唤醒事件线程(停止或出现更早的截止时间)
+    UsbUsbfsEventThread *eventThread;
+    volatile bool stopped;
+    UsbDeviceDatabase deviceDatabase;
+    QMutex mutex;//保护以下成员
+    quint64 nextDeviceId;
+    QHash<quint64,UsbfsDevice *> deviceHash;//设备标识对应的设备
+    UsbfsUrb *freeUrbList;//已结束的URB，提交时复用(数量为同时挂起的最大传输数)
+    QMultiMap<qint64,UsbfsUrb *> deadlineMap;//有超时的挂起URB，按截止时间排序
+    std::atomic<quint64> reapBatchCount;
+    std::atomic<quint64> reapUrbCount;
+};
+
+#endif // USBUSBFSBACKEND_H
@@ -0,0 +1,485 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   虚拟USB设备基类
+ */
+#include "usbvirtualdevice.h"
+#include "usbmetrics.h"
+#include "usbbufferpool.h"
+#include <QDebug>
+
+namespace
+{
+/* 同步传输的等待状态 */
+struct UsbVirtualSyncState
+{
+    UsbVirtualDevice *device;
+    QMutex *mutex;
+    QWaitCondition *cond;
+    bool completed;
+};
+
+//传输状态转换为同步传输的返回值(与libusb同步接口的转换规则一致)
+int errorFromStatus(int status)
+{
+    switch(status)
+    {
+    case LIBUSB_TRANSFER_COMPLETED:
+        return LIBUSB_SUCCESS;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        return LIBUSB_ERROR_TIMEOUT;
+    case LIBUSB_TRANSFER_STALL:
+        return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_OVERFLOW:
+        return LIBUSB_ERROR_OVERFLOW;
+    case LIBUSB_TRANSFER_CANCELLED:
+        return LIBUSB_ERROR_INTERRUPTED;
+    default:
+        return LIBUSB_ERROR_IO;
+    }
+}
+}
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   parent:父对象
+ */
+UsbVirtualDevice::UsbVirtualDevice(QObject *parent)
+    :QThread(parent)
+{
+    vendorId = 0;
+    productId = 0;
+    busNumber = 0;
+    deviceAddress = 0;
+    portNumber = 0;
+    deviceClass = 0;
+    speed = LIBUSB_SPEED_HIGH;
+    attached = true;
+    stopped = false;
+}
+/*
+ *@brief:   析构函数，停止完成线程(设备需已关闭，不能有挂起的传输)
+ *@date:    2026.10.18
+ */
+UsbVirtualDevice::~UsbVirtualDevice()
+{
+    engineMutex.lock();
+    stopped = true;
+    if(!stateHash.isEmpty())
+    {
+        qDebug()<<"UsbVirtualDevice destroyed with pending transfers:"<<stateHash.size();
+    }
+    engineCond.wakeAll();
+    engineMutex.unlock();
+    wait();
+}
+/*
+ *@brief:   设置设备标识
+ *@date:    2026.10.18
+ *@param:   vendorId:厂商id
+ *@param:   productId:产品id
+ *@param:   busNumber:总线号
+ *@param:   deviceAddress:设备地址
+ *@param:   portNumber:端口号
+ */
+void UsbVirtualDevice::setDeviceInfo(quint16 vendorId, quint16 productId, quint8 busNumber,
+                                     quint8 deviceAddress, quint8 portNumber)
+{
+    this->vendorId = vendorId;
+    this->productId = productId;
+    this->busNumber = busNumber;
+    this->deviceAddress = deviceAddress;
+    this->portNumber = portNumber;
+}
+/*
+ *@brief:   同步传输，阻塞直到传输完成或超时
+ *@date:    2026.10.18
+ *@param:   transferType:传输类型，详见enum libusb_transfer_type{}
+ *@param:   endpoint:端点
+ *@param:   data:数据buffer(控制传输包含8字节的setup包)
+ *@param:   length:buffer长度
+ *@param:   actualLength:真实传输的字节数
+ *@param:   timeout:超时时间，单位ms， 0 无限制
+ *@return:  int:libusb_error
+ */
+int UsbVirtualDevice::transfer(quint8 transferType, quint8 endpoint, quint8 *data, int length,
+                               int *actualLength, quint32 timeout)
+{
+    libusb_transfer *transfer = UsbBufferPool::instance()->allocTransfer();
+    if(transfer == NULL)
+    {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    UsbVirtualSyncState state;
+    state.device = this;
+    state.mutex = &syncMutex;
+    state.cond = &syncCond;
+    state.completed = false;
+    transfer->type = transferType;
+    transfer->endpoint = endpoint;
+    transfer->buffer = data;
+    transfer->length = length;
+    transfer->timeout = timeout;
+    transfer->callback = syncTransferCallback;
+    transfer->user_data = &state;
+
+    int err = submitTransfer(transfer);
+    if(err != LIBUSB_SUCCESS)
+    {
+        UsbBufferPool::instance()->freeTransfer(transfer);
+        return err;
+    }
+    syncMutex.lock();
+    while(!state.completed)
+    {
+        syncCond.wait(&syncMutex);
+    }
+    syncMutex.unlock();
+
+    if(actualLength)
+    {
+        *actualLength = transfer->actual_length;
+    }
+    err = errorFromStatus(transfer->status);
+    UsbBufferPool::instance()->freeTransfer(transfer);
+    return err;
+}
+/*
+ *@brief:   提交异步传输
+ *@date:    2026.10.18
+ *@param:   transfer:传输(由libusb_alloc_transfer申请并填充)
+ *@return:  int:libusb_error
+ */
+int UsbVirtualDevice::submitTransfer(libusb_transfer *transfer)
+{
+    if(!isRunning())
+    {
+        start();
+    }
+    QMutexLocker locker(&engineMutex);
+    if(!attached)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+    if(stateHash.contains(transfer))
+    {
+        return LIBUSB_ERROR_BUSY;
+    }
+    transfer->actual_length = 0;
+    PendingState state;
+    state.deadline = (transfer->timeout != 0)?UsbMetrics::nowNs()+(qint64)transfer->timeout*1000000:0;
+    state.scheduled = false;
+    state.status = LIBUSB_TRANSFER_ERROR;
+    state.completeTime = 0;
+    stateHash.insert(transfer,state);
+    //先加入等待队列，保证同一端点上的传输按提交顺序处理
+    quint8 endpoint = transferEndpoint(transfer);
+    waitingHash[endpoint].append(transfer);
+    if(state.deadline != 0)
+    {
+        scheduleMap.insert(state.deadline,transfer);
+        engineCond.wakeOne();
+    }
+    processEndpoint(endpoint);
+    processRetries();
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   取消异步传输，传输随后以LIBUSB_TRANSFER_CANCELLED完成
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  int:libusb_error，传输不存在或已经在取消时返回LIBUSB_ERROR_NOT_FOUND
+ */
+int UsbVirtualDevice::cancelTransfer(libusb_transfer *transfer)
+{
+    QMutexLocker locker(&engineMutex);
+    if(!stateHash.contains(transfer))
+    {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+    PendingState state = stateHash.value(transfer);
+    if(state.scheduled && (state.status == LIBUSB_TRANSFER_CANCELLED || state.status == LIBUSB_TRANSFER_NO_DEVICE))
+    {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+    completeNow(transfer,LIBUSB_TRANSFER_CANCELLED);
+    processRetries();
+    return LIBUSB_SUCCESS;
+}
+/*
+ *@brief:   取消所有挂起的传输
+ *@date:    2026.10.18
+ */
+void UsbVirtualDevice::cancelAllTransfers()
+{
+    engineMutex.lock();
+    QList<libusb_transfer *> transferList = stateHash.keys();
+    engineMutex.unlock();
+    for(int i=0;i<transferList.size();i++)
+    {
+        cancelTransfer(transferList.at(i));
+    }
+}
+/*
+ *@brief:   设置设备是否接入
+ *@date:    2026.10.18
+ *@param:   attached:true=接入  false=拔出
+ */
+void UsbVirtualDevice::setAttached(bool attached)
+{
+    QMutexLocker locker(&engineMutex);
+    this->attached = attached;
+    if(attached)
+    {
+        return;
+    }
+    QList<libusb_transfer *> transferList = stateHash.keys();
+    for(int i=0;i<transferList.size();i++)
+    {
+        PendingState state = stateHash.value(transferList.at(i));
+        if(!(state.scheduled && (state.status == LIBUSB_TRANSFER_CANCELLED || state.status == LIBUSB_TRANSFER_NO_DEVICE)))
+        {
+            completeNow(transferList.at(i),LIBUSB_TRANSFER_NO_DEVICE);
+        }
+    }
+    retryEndpoints.clear();
+}
+/*
+ *@brief:   清除端点的halt/stall状态
+ *@date:    2026.10.18
+ *@param:   endpoint:端点
+ *@return:  int:libusb_error
+ */
+int UsbVirtualDevice::clearHalt(quint8 endpoint)
+{
+    Q_UNUSED(endpoint)
+    return attached?LIBUSB_SUCCESS:LIBUSB_ERROR_NO_DEVICE;
+}
+/*
+ *@brief:   重置设备
+ *@date:    2026.10.18
+ *@return:  int:libusb_error
+ */
+int UsbVirtualDevice::resetDevice()
+{
+    return attached?LIBUSB_SUCCESS:LIBUSB_ERROR_NOT_FOUND;
+}
+/*
+ *@brief:   获取描述符树
+ *@date:    2026.10.18
+ *@param:   config:返回的描述符树
+ *@return:  int:libusb_error
+ */
+int UsbVirtualDevice::getConfigInfo(UsbConfigInfo *config)
+{
+    Q_UNUSED(config)
+    return LIBUSB_ERROR_NOT_FOUND;
+}
+/*
+ *@brief:   通知端点有新数据，重新处理该端点上等待数据的传输
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ */
+void UsbVirtualDevice::notifyDataAvailable(quint8 endpoint)
+{
+    QMutexLocker locker(&engineMutex);
+    retryEndpoints.insert(endpoint);
+    processRetries();
+}
+/*
+ *@brief:   在processTransfer中通知端点有新数据，当前传输处理结束后重新处理该端点
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ */
+void UsbVirtualDevice::markDataAvailable(quint8 endpoint)
+{
+    retryEndpoints.insert(endpoint);
+}
+/*
+ *@brief:   完成线程:到期的传输设置状态后调用其回调(回调在锁外执行，可以在回调中重新提交)
+ * QWaitCondition的等待精度为ms，剩余时间不足2ms时改为在锁外usleep，保证微秒级的完成时间。
+ *@date:    2026.10.18
+ */
+void UsbVirtualDevice::run()
+{
+    engineMutex.lock();
+    while(!stopped)
+    {
+        if(scheduleMap.isEmpty())
+        {
+            engineCond.wait(&engineMutex);
+            continue;
+        }
+        qint64 now = UsbMetrics::nowNs();
+        qint64 remain = scheduleMap.constBegin().key()-now;
+        if(remain > 0)
+        {
+            if(remain >= 2000000)
+            {
+                engineCond.wait(&engineMutex,(unsigned long)(remain/1000000-1));
+            }
+            else
+            {
+                engineMutex.unlock();
+                QThread::usleep((unsigned long)(remain/1000));
+                engineMutex.lock();
+            }
+            continue;
+        }
+        QList<libusb_transfer *> dueList;
+        while(!scheduleMap.isEmpty() && scheduleMap.constBegin().key() <= now)
+        {
+            QMultiMap<qint64,libusb_transfer *>::iterator first = scheduleMap.begin();
+            libusb_transfer *transfer = first.value();
+            scheduleMap.erase(first);
+            PendingState state = stateHash.take(transfer);
+            if(state.scheduled)
+            {
+                transfer->status = (libusb_transfer_status)state.status;
+            }
+            else//等待数据的传输超时
+            {
+                quint8 endpoint = transferEndpoint(transfer);
+                waitingHash[endpoint].removeAll(transfer);
+                retryEndpoints.insert(endpoint);
+                transfer->status = LIBUSB_TRANSFER_TIMED_OUT;
+                transfer->actual_length = 0;
+            }
+            dueList.append(transfer);
+        }
+        processRetries();
+        engineMutex.unlock();
+        for(int i=0;i<dueList.size();i++)
+        {
+            libusb_transfer *transfer = dueList.at(i);
+            transfer->callback(transfer);
+        }
+        engineMutex.lock();
+    }
+    engineMutex.unlock();
+}
+/*
+ *@brief:   按提交顺序处理端点上等待数据的传输，遇到仍无数据的传输即停止(调用前需加锁)
+ *@date:    2026.10.18
+ *@param:   endpoint:端点地址
+ */
+void UsbVirtualDevice::processEndpoint(quint8 endpoint)
+{
+    QList<libusb_transfer *> &waitingList = waitingHash[endpoint];
+    while(!waitingList.isEmpty())
+    {
+        libusb_transfer *transfer = waitingList.first();
+        PendingState state = stateHash.value(transfer);
+        qint64 completeTime = 0;
+        int status = processTransfer(transfer,state.deadline,completeTime);
+        if(status == TransferPending)
+        {
+            break;
+        }
+        waitingList.removeFirst();
+        if(state.deadline != 0)
+        {
+            scheduleMap.remove(state.deadline,transfer);
+            if(completeTime > state.deadline)
+            {
+                status = LIBUSB_TRANSFER_TIMED_OUT;
+                completeTime = state.deadline;
+            }
+        }
+        schedule(transfer,status,completeTime);
+    }
+}
+/*
+ *@brief:   处理被通知有新数据的端点(调用前需加锁)
+ *@date:    2026.10.18
+ */
+void UsbVirtualDevice::processRetries()
+{
+    while(!retryEndpoints.isEmpty())
+    {
+        quint8 endpoint = *retryEndpoints.begin();
+        retryEndpoints.remove(endpoint);
+        processEndpoint(endpoint);
+    }
+}
+/*
+ *@brief:   安排传输的完成时间(调用前需加锁)
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   status:完成状态
+ *@param:   completeTime:完成时间点
+ */
+void UsbVirtualDevice::schedule(libusb_transfer *transfer, int status, qint64 completeTime)
+{
+    PendingState &state = stateHash[transfer];
+    state.scheduled = true;
+    state.status = status;
+    state.completeTime = completeTime;
+    bool earliest = scheduleMap.isEmpty() || completeTime < scheduleMap.constBegin().key();
+    scheduleMap.insert(completeTime,transfer);
+    if(earliest)
+    {
+        engineCond.wakeOne();
+    }
+}
+/*
+ *@brief:   立即以指定状态完成挂起的传输，IN方向已处理的数据被丢弃(调用前需加锁)
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@param:   status:完成状态
+ */
+void UsbVirtualDevice::completeNow(libusb_transfer *transfer, int status)
+{
+    PendingState state = stateHash.value(transfer);
+    if(state.scheduled)
+    {
+        scheduleMap.remove(state.completeTime,transfer);
+    }
+    else
+    {
+        quint8 endpoint = transferEndpoint(transfer);
+        waitingHash[endpoint].removeAll(transfer);
+        if(state.deadline != 0)
+        {
+            scheduleMap.remove(state.deadline,transfer);
+        }
+        retryEndpoints.insert(endpoint);
+    }
+    transfer->actual_length = 0;
+    schedule(transfer,status,UsbMetrics::nowNs());
+}
+/*
+ *@brief:   传输的端点地址，控制传输根据setup包的请求类型加上方向位
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ *@return:  quint8:端点地址
+ */
+quint8 UsbVirtualDevice::transferEndpoint(libusb_transfer *transfer)
+{
+    if(transfer->type == LIBUSB_TRANSFER_TYPE_CONTROL && transfer->length >= (int)LIBUSB_CONTROL_SETUP_SIZE)
+    {
+        return (transfer->endpoint & 0x7F)|(libusb_control_transfer_get_setup(transfer)->bmRequestType & LIBUSB_ENDPOINT_IN);
+    }
+    return transfer->endpoint;
+}
+/*
+ *@brief:   同步传输完成回调(在完成线程中执行)
+ *@date:    2026.10.18
+ *@param:   transfer:传输
+ */
+void UsbVirtualDevice::syncTransferCallback(libusb_transfer *transfer)
+{
+    UsbVirtualSyncState *state = static_cast<UsbVirtualSyncState *>(transfer->user_data);
+    QMutexLocker locker(state->mutex);
+    state->completed = true;
+    state->cond->wakeAll();
+}
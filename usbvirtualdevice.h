@@ -0,0 +1,115 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   虚拟USB设备基类
+ *
+ *在没有硬件的环境(例如CI)中代替真实设备:通过UsbComm::openVirtualDevice()打开后得到的句柄与真实设备句柄
+ *用法完全相同，同步传输、异步传输、流式传输以及基于它们的扩展类都可以直接使用。
+ *基类负责传输的调度:每个传输提交时调用子类的processTransfer()得到传输结果和完成时间，到期后在设备的
+ *完成线程中调用libusb_transfer的回调；支持超时、取消以及"暂无数据"的挂起传输。子类只需要实现设备行为。
+ */
+#ifndef USBVIRTUALDEVICE_H
+#define USBVIRTUALDEVICE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMultiMap>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include "libusb-1.0/include/libusb.h"
+#include "usbdescriptor.h"
+
+class UsbVirtualDevice : public QThread
+{
+    Q_OBJECT
+public:
+    enum {TransferPending = -1};//processTransfer()返回该值表示暂无数据，传输保持挂起
+
+    explicit UsbVirtualDevice(QObject *parent = 0);
+    virtual ~UsbVirtualDevice();
+
+    //设置设备标识(需在打开设备之前设置)
+    void setDeviceInfo(quint16 vendorId,quint16 productId,quint8 busNumber=0,quint8 deviceAddress=0,quint8 portNumber=0);
+    quint16 getVendorId() const{return vendorId;}
+    quint16 getProductId() const{return productId;}
+    quint8 getBusNumber() const{return busNumber;}
+    quint8 getDeviceAddress() const{return deviceAddress;}
+    quint8 getPortNumber() const{return portNumber;}
+    void setDeviceClass(quint8 deviceClass){this->deviceClass = deviceClass;}
+    quint8 getDeviceClass() const{return deviceClass;}
+    void setDeviceSpeed(int speed){this->speed = speed;}//连接速度，详见enum libusb_speed{}
+    int getDeviceSpeed() const{return speed;}
+
+    //设置设备是否接入(由UsbSimBackend在插拔时调用)，拔出时挂起的传输以LIBUSB_TRANSFER_NO_DEVICE完成
+    void setAttached(bool attached);
+    bool isAttached() const{return attached;}
+
+    /*传输接口(由UsbComm调用)*/
+    int transfer(quint8 transferType,quint8 endpoint,quint8 *data,int length,int *actualLength,quint32 timeout);//同步传输
+    int submitTransfer(libusb_transfer *transfer);//提交异步传输
+    int cancelTransfer(libusb_transfer *transfer);//取消异步传输
+    void cancelAllTransfers();//取消所有挂起的传输(设备关闭时调用)
+
+    void notifyDataAvailable(quint8 endpoint);//通知端点有新数据，重新处理该端点上挂起的传输(不能在processTransfer中调用)
+
+    /*设备操作(返回libusb_error，默认直接成功)*/
+    virtual int clearHalt(quint8 endpoint);
+    virtual int resetDevice();
+    //描述符树，默认返回LIBUSB_ERROR_NOT_FOUND(设备不描述接口和端点)
+    virtual int getConfigInfo(UsbConfigInfo *config);
+
+protected:
+    /* 处理一次传输(在提交时调用，调用时已持有内部锁，不能阻塞)
+     * IN方向填充transfer->buffer，OUT方向校验数据，设置transfer->actual_length，并通过completeTime返回完成的
+     * 时间点(UsbMetrics::nowNs()时间基准)。deadline为传输的超时时间点(0表示无限制)，如果数据在deadline之前
+     * 无法就绪，应返回TransferPending且不消耗数据，该传输会在超时后以LIBUSB_TRANSFER_TIMED_OUT完成。
+     * 返回值为enum libusb_transfer_status{}或TransferPending。*/
+    virtual int processTransfer(libusb_transfer *transfer,qint64 deadline,qint64 &completeTime) = 0;
+    void markDataAvailable(quint8 endpoint);//在processTransfer中通知其他端点有新数据(例如回环设备的OUT端点)
+
+    virtual void run();
+
+private:
+    struct PendingState
+    {
+        qint64 deadline;//超时时间点，0表示无限制
+        bool scheduled;//true=已确定完成时间  false=等待数据
+        int status;//完成状态
+        qint64 completeTime;
+    };
+    void processEndpoint(quint8 endpoint);//按顺序处理端点上等待数据的传输(调用前需加锁)
+    void processRetries();//处理被通知有新数据的端点(调用前需加锁)
+    void schedule(libusb_transfer *transfer,int status,qint64 completeTime);//安排完成时间(调用前需加锁)
+    void completeNow(libusb_transfer *transfer,int status);//立即以指定状态完成挂起的传输(调用前需加锁)
+    static quint8 transferEndpoint(libusb_transfer *transfer);//传输的端点地址(控制传输包含方向位)
+    static void LIBUSB_CALL syncTransferCallback(libusb_transfer *transfer);
+
+    quint16 vendorId;
+    quint16 productId;
+    quint8 busNumber;
+    quint8 deviceAddress;
+    quint8 portNumber;
+    quint8 deviceClass;
+    int speed;
+    volatile bool attached;
+
+    QMutex engineMutex;
+    QWaitCondition engineCond;
+    volatile bool stopped;
+    QHash<libusb_transfer *,PendingState> stateHash;//所有挂起的传输
+    QMultiMap<qint64,libusb_transfer *> scheduleMap;//已确定完成时间的传输，按完成时间排序
+    QHash<quint8,QList<libusb_transfer *> > waitingHash;//端点上等待数据的传输(按提交顺序)
+    QSet<quint8> retryEndpoints;//被通知有新数据的端点
+    QMutex syncMutex;
+    QWaitCondition syncCond;//同步传输完成条件变量
+};
+
+#endif // USBVIRTUALDEVICE_H
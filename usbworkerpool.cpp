@@ -0,0 +1,152 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   异步传输完成回调的工作线程池
+ */
+#include "usbworkerpool.h"
+
+#define WORKER_QUEUE_RESERVE 256 //任务队列预留的容量
+
+/*
+ *@brief:   构造函数
+ *@date:    2026.10.18
+ *@param:   parent:父对象
+ */
+UsbWorkerThread::UsbWorkerThread(QObject *parent)
+    :QThread(parent)
+{
+    stopped = false;
+    workList.reserve(WORKER_QUEUE_RESERVE);
+}
+/*
+ *@brief:   添加任务
+ *@date:    2026.10.18
+ *@param:   function:任务函数
+ *@param:   data:任务函数的参数
+ */
+void UsbWorkerThread::post(UsbWorkFunction function, void *data)
+{
+    Work work;
+    work.function = function;
+    work.data = data;
+    QMutexLocker locker(&mutex);
+    workList.append(work);
+    if(workList.size() == 1)//队列原先为空时线程可能在等待
+    {
+        cond.wakeOne();
+    }
+}
+/*
+ *@brief:   处理完队列中剩余的任务后结束线程(需再调用wait()等待)
+ *@date:    2026.10.18
+ */
+void UsbWorkerThread::stop()
+{
+    QMutexLocker locker(&mutex);
+    stopped = true;
+    cond.wakeOne();
+}
+/*
+ *@brief:   子线程运行，每次取出队列中的所有任务，在锁外依次执行
+ *@date:    2026.10.18
+ */
+void UsbWorkerThread::run()
+{
+    UsbRealtime::applyThreadConfig(threadConfig);
+    QVector<Work> runList;
+    runList.reserve(WORKER_QUEUE_RESERVE);
+    while(true)
+    {
+        mutex.lock();
+        while(workList.isEmpty() && !stopped)
+        {
+            cond.wait(&mutex);
+        }
+        if(workList.isEmpty())//已停止且没有剩余任务
+        {
+            mutex.unlock();
+            break;
+        }
+        runList.swap(workList);
+        mutex.unlock();
+        for(int i=0;i<runList.size();i++)
+        {
+            runList.at(i).function(runList.at(i).data);
+        }
+        runList.resize(0);//resize(0)不会释放预留的容量，下次交换后作为任务队列继续使用
+    }
+}
+
+/*
+ *@brief:   构造函数，创建并启动工作线程
+ *@date:    2026.10.18
+ *@param:   workerCount:工作线程数，0表示按CPU核数创建
+ *@param:   config:工作线程的实时配置，config.cpu>=0时第i个工作线程绑定到(config.cpu+i)%CPU核数
+ */
+UsbWorkerPool::UsbWorkerPool(int workerCount, const UsbThreadConfig &config)
+{
+    nextIndex = 0;
+    int cpuCount = qMax(QThread::idealThreadCount(),1);
+    if(workerCount <= 0)
+    {
+        workerCount = cpuCount;
+    }
+    for(int i=0;i<workerCount;i++)
+    {
+        UsbThreadConfig workerConfig = config;
+        if(config.cpu >= 0)//每个工作线程占用一个核
+        {
+            workerConfig.cpu = (config.cpu+i)%cpuCount;
+        }
+        UsbWorkerThread *worker = new UsbWorkerThread();
+        worker->setObjectName(QString("UsbWorker%1").arg(i));
+        worker->setThreadConfig(workerConfig);
+        worker->start();
+        workerList.append(worker);
+    }
+}
+/*
+ *@brief:   析构函数，处理完所有任务后结束工作线程
+ *@date:    2026.10.18
+ */
+UsbWorkerPool::~UsbWorkerPool()
+{
+    for(int i=0;i<workerList.size();i++)
+    {
+        workerList.at(i)->stop();
+    }
+    for(int i=0;i<workerList.size();i++)
+    {
+        workerList.at(i)->wait();
+        delete workerList.at(i);
+    }
+}
+/*
+ *@brief:   轮流分配工作线程(设备打开时调用，之后该设备的任务都交给同一个工作线程)
+ *@date:    2026.10.18
+ *@return:  int:工作线程序号
+ */
+int UsbWorkerPool::nextWorkerIndex()
+{
+    QMutexLocker locker(&mutex);
+    int index = nextIndex;
+    nextIndex = (nextIndex+1)%workerList.size();
+    return index;
+}
+/*
+ *@brief:   向指定工作线程添加任务
+ *@date:    2026.10.18
+ *@param:   workerIndex:工作线程序号(nextWorkerIndex()的返回值)
+ *@param:   function:任务函数
+ *@param:   data:任务函数的参数
+ */
+void UsbWorkerPool::post(int workerIndex, UsbWorkFunction function, void *data)
+{
+    workerList.at(workerIndex%workerList.size())->post(function,data);
+}
@@ -0,0 +1,77 @@
+/****************************************************************************
+*
+* Copyright (C) 2026 MiaoQingrui. All rights reserved.
+* Author: 缪庆瑞 <justdoit_mqr@163.com>
+*
+****************************************************************************/
+/*
+ *@author:  缪庆瑞
+ *@date:    2026.10.18
+ *@brief:   异步传输完成回调的工作线程池
+ *
+ *libusb在持有事件锁的线程中执行传输回调，所有设备的回调都串行在同一个事件线程上，设备较多时
+ *回调本身(数据处理、重新提交)会成为瓶颈。UsbComm启用该线程池后，事件线程只记录统计和抓包，
+ *回调转交给工作线程执行:每个工作线程有独立的队列，每个设备固定分配到一个工作线程(按打开顺序轮流分配)，
+ *同一设备的回调保持完成顺序，不同设备的回调在多个核上并行执行。
+ */
+#ifndef USBWORKERPOOL_H
+#define USBWORKERPOOL_H
+
+#include <QThread>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include "usbrealtime.h"
+
+//工作线程执行的任务函数
+typedef void (*UsbWorkFunction)(void *data);
+
+/* 工作线程，按提交顺序执行自己队列中的任务 */
+class UsbWorkerThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit UsbWorkerThread(QObject *parent = 0);
+
+    void post(UsbWorkFunction function,void *data);//添加任务(可在任意线程调用)
+    void stop();//处理完队列中剩余的任务后结束线程
+    //设置线程的实时配置(绑定CPU、实时调度)，在线程启动时生效(仅Linux)
+    void setThreadConfig(const UsbThreadConfig &config){this->threadConfig = config;}
+
+protected:
+    virtual void run();
+
+private:
+    struct Work
+    {
+        UsbWorkFunction function;
+        void *data;
+    };
+
+    QMutex mutex;
+    QWaitCondition cond;
+    //待执行的任务:与run()中的执行队列交换使用，两者都保留容量，稳定运行后添加任务不再申请内存
+    QVector<Work> workList;
+    bool stopped;
+    UsbThreadConfig threadConfig;//线程的实时配置
+};
+
+class UsbWorkerPool
+{
+public:
+    //workerCount=0表示按CPU核数创建，config.cpu>=0时第i个工作线程绑定到config.cpu+i
+    explicit UsbWorkerPool(int workerCount = 0,const UsbThreadConfig &config = UsbThreadConfig());
+    ~UsbWorkerPool();//处理完所有任务后结束工作线程
+
+    int getWorkerCount() const{return workerList.size();}
+    int nextWorkerIndex();//轮流分配的工作线程序号
+    void post(int workerIndex,UsbWorkFunction function,void *data);//向指定工作线程添加任务
+
+private:
+    QList<UsbWorkerThread *> workerList;
+    QMutex mutex;
+    int nextIndex;
+};
+
+#endif // USBWORKERPOOL_H
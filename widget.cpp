@@ -12,7 +12,7 @@
 
 Widget::Widget(QWidget *parent) :
     QWidget(parent),
-    ui(new Ui::Widget),hotplugMonitor(NULL),usbReceive(NULL),recvBuffer(NULL)
+    ui(new Ui::Widget),hotplugMonitor(NULL),usbReceive(NULL)
 {
     ui->setupUi(this);
 }
@@ -20,10 +20,6 @@ Widget::Widget(QWidget *parent) :
 Widget::~Widget()
 {
     delete ui;
-    if(recvBuffer)
-    {
-        free(recvBuffer);
-    }
 }
 //列出当前接入到系统的所有usb设备
 void Widget::on_pushButton_clicked()
@@ -40,22 +36,26 @@ void Widget::on_pushButton_2_clicked()
     vpidMap.insert(0x0483,0x5748);
     if(usbComm.openUsbDevice(vpidMap))
     {
-        if(usbComm.claimUsbInterface(usbComm.getDeviceHandleFromIndex(0),0))
+        libusb_device_handle *deviceHandle = usbComm.getDeviceHandleFromIndex(0);
+        //根据描述符查找打印机类接口(没有时使用接口0)和批量OUT端点(该打印机为0x07)
+        int interfaceNumber = qMax(usbComm.findInterface(deviceHandle,LIBUSB_CLASS_PRINTER),0);
+        int outEndpoint = usbComm.findEndpoint(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,LIBUSB_ENDPOINT_OUT);
+        if(outEndpoint != -1 && usbComm.claimUsbInterface(deviceHandle,interfaceNumber))
         {
             QByteArray array0("hello printers\n");
-            qDebug()<<usbComm.bulkTransfer(usbComm.getDeviceHandleFromIndex(0),0x07,
+            qDebug()<<usbComm.bulkTransfer(deviceHandle,outEndpoint,
                                            (quint8 *)array0.data(),array0.size(),0);
 
             QTextCodec *codec = QTextCodec::codecForName("GBK");
             QByteArray array1 = codec->fromUnicode(QString::fromUtf8("我看看能不能打印中文！\n"));
-            qDebug()<<usbComm.bulkTransfer(usbComm.getDeviceHandleFromIndex(0),0x07,
+            qDebug()<<usbComm.bulkTransfer(deviceHandle,outEndpoint,
                                            (quint8 *)array1.data(),array1.size(),0);
 
             QByteArray array2;//ESC控制命令(打印并走纸1行)
             array2.append(0x1b);
             array2.append(0x64);
             array2.append(0x01);
-            qDebug()<<usbComm.bulkTransfer(usbComm.getDeviceHandleFromIndex(0),0x07,
+            qDebug()<<usbComm.bulkTransfer(deviceHandle,outEndpoint,
                                            (quint8 *)array2.data(),array2.size(),0);
         }
     }
@@ -101,7 +101,8 @@ void Widget::on_pushButton_4_clicked()
             if(usbReceive->claimUsbInterface(usbReceive->getDeviceHandleFromIndex(0),0))
             {
                 flag = 1;
-                recvBuffer = (unsigned char *)malloc(package_len);
+                //接收buffer从缓冲池申请，析构时归还
+                recvBuffer = UsbPooledBuffer(package_len);
             }
         }
         if(flag != 1)
@@ -112,16 +113,23 @@ void Widget::on_pushButton_4_clicked()
     }
     if(flag == 1)
     {
-        memset(recvBuffer,0,package_len);
-        int len = usbReceive->bulkTransfer(usbReceive->getDeviceHandleFromIndex(0),0x81,recvBuffer,package_len,1);
+        memset(recvBuffer.data(),0,package_len);
+        //首个批量IN端点(该相机为0x81)，查询的是打开设备时缓存的描述符
+        libusb_device_handle *deviceHandle = usbReceive->getDeviceHandleFromIndex(0);
+        int inEndpoint = usbReceive->findEndpoint(deviceHandle,LIBUSB_TRANSFER_TYPE_BULK,LIBUSB_ENDPOINT_IN);
+        if(inEndpoint == -1)
+        {
+            qDebug()<<"no bulk in endpoint";
+            return;
+        }
+        int len = usbReceive->bulkTransfer(deviceHandle,inEndpoint,(quint8 *)recvBuffer.data(),package_len,1);
         if(len < 0)
         {
             qDebug()<<"bulkTransfer error"<<len;
         }
         else
         {
-            QByteArray array;
-            array.append((char *)recvBuffer,len);
+            QByteArray array = recvBuffer.toByteArray(len);//直接引用接收buffer，不拷贝数据
             qDebug()<<QString("array[%1]:").arg(len)<<array.toHex();
         }
     }
@@ -36,7 +36,7 @@ private:
 
     UsbMonitor *hotplugMonitor;
     UsbComm    *usbReceive;
-    unsigned char *recvBuffer;
+    UsbPooledBuffer recvBuffer;//同步接收使用的池化buffer
 
 };
 